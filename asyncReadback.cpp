@@ -0,0 +1,175 @@
+#include "asyncReadback.h"
+
+#include <GL/glew.h>
+
+#include <iostream>
+
+AsyncReadback::AsyncReadback(size_t slotLimit)
+    : maxSlots(slotLimit > 0 ? slotLimit : 1), stalls(0), bytesRead(0)
+{
+}
+
+AsyncReadback::~AsyncReadback()
+{
+}
+
+void AsyncReadback::Release()
+{
+    for (auto &slot : slots)
+    {
+        if (slot.fence)
+            glDeleteSync((GLsync)slot.fence);
+        if (slot.buffer)
+            glDeleteBuffers(1, &slot.buffer);
+    }
+    slots.clear();
+    inFlight.clear();
+    freeSlots.clear();
+    completed.clear();
+}
+
+size_t AsyncReadback::AcquireSlot(size_t bytes)
+{
+    size_t index;
+    if (!freeSlots.empty())
+    {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else if (slots.size() < maxSlots)
+    {
+        index = slots.size();
+        slots.push_back(Slot());
+        glGenBuffers(1, &slots[index].buffer);
+    }
+    else
+    {
+        // the ring is full, finish the oldest read now and keep it for the next Poll
+        stalls++;
+        size_t oldest = inFlight.front();
+        inFlight.pop_front();
+        Complete(oldest, true, [this](const Request &request, const uint8_t *pixels)
+        {
+            Result result;
+            result.request = request;
+            result.pixels.assign(pixels, pixels + (size_t)request.width * (size_t)request.height * request.bytesPerPixel);
+            completed.push_back(std::move(result));
+        });
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    }
+
+    Slot &slot = slots[index];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < bytes)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+    return index;
+}
+
+bool AsyncReadback::ReadFramebuffer(const Request &request)
+{
+    size_t bytes = (size_t)request.width * (size_t)request.height * request.bytesPerPixel;
+    if (bytes == 0)
+        return false;
+
+    size_t index = AcquireSlot(bytes);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, request.width, request.height, request.format, request.type, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    Slot &slot = slots[index];
+    slot.request = request;
+    slot.request.queued = std::chrono::steady_clock::now();
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    inFlight.push_back(index);
+    return true;
+}
+
+bool AsyncReadback::ReadTexture(unsigned int texture, const Request &request)
+{
+    size_t bytes = (size_t)request.width * (size_t)request.height * request.bytesPerPixel;
+    if (bytes == 0 || texture == 0)
+        return false;
+
+    size_t index = AcquireSlot(bytes);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureSubImage(texture, 0, 0, 0, 0, request.width, request.height, 1, request.format, request.type, (GLsizei)bytes, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    Slot &slot = slots[index];
+    slot.request = request;
+    slot.request.queued = std::chrono::steady_clock::now();
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    inFlight.push_back(index);
+    return true;
+}
+
+bool AsyncReadback::Complete(size_t index, bool wait, const std::function<void(const Request &, const uint8_t *)> &callback)
+{
+    Slot &slot = slots[index];
+    if (slot.fence)
+    {
+        GLenum status = glClientWaitSync((GLsync)slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync((GLsync)slot.fence, 0, 1000000000ull);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync((GLsync)slot.fence);
+        slot.fence = nullptr;
+        if (status == GL_WAIT_FAILED)
+        {
+            std::cerr << "Readback of " << slot.request.name << " failed" << std::endl;
+            freeSlots.push_back(index);
+            return false;
+        }
+    }
+
+    size_t bytes = (size_t)slot.request.width * (size_t)slot.request.height * slot.request.bytesPerPixel;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)bytes, GL_MAP_READ_BIT);
+    bool ok = mapped != nullptr;
+    if (ok)
+    {
+        callback(slot.request, (const uint8_t *)mapped);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        bytesRead += bytes;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    freeSlots.push_back(index);
+    return ok;
+}
+
+void AsyncReadback::Poll(const std::function<void(Result &)> &callback, bool wait)
+{
+    PollMapped([&callback](const Request &request, const uint8_t *pixels)
+    {
+        Result result;
+        result.request = request;
+        result.pixels.assign(pixels, pixels + (size_t)request.width * (size_t)request.height * request.bytesPerPixel);
+        callback(result);
+    }, wait);
+}
+
+void AsyncReadback::PollMapped(const std::function<void(const Request &, const uint8_t *)> &callback, bool wait)
+{
+    while (!completed.empty())
+    {
+        callback(completed.front().request, completed.front().pixels.data());
+        completed.pop_front();
+    }
+
+    // reads finish in order so stop at the first one that hasn't
+    while (!inFlight.empty())
+    {
+        size_t index = inFlight.front();
+        if (!wait && slots[index].fence && glClientWaitSync((GLsync)slots[index].fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            break;
+        inFlight.pop_front();
+        Complete(index, wait, callback);
+    }
+}
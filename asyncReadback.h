@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+// reads pixels back through a ring of pixel buffer objects
+//
+// a read only queues a copy into a buffer and drops a fence after it, the buffer is mapped a frame or two later
+// once the fence has signalled so neither the CPU nor the GPU ever waits on the other. the ring grows up to
+// maxSlots buffers, after that the oldest read is waited on (and counted as a stall)
+//
+// GL handles are kept as plain integers so this can be included ahead of glew
+class AsyncReadback
+{
+public:
+    struct Request
+    {
+        Request() : frame(0), width(0), height(0), format(0), type(0), bytesPerPixel(0) {}
+
+        std::string name;           // what's being read, passed through to the result
+        uint64_t frame;
+        int width, height;
+        unsigned int format, type;  // as for glReadPixels
+        size_t bytesPerPixel;
+        std::chrono::steady_clock::time_point queued;   // set when the read is queued
+    };
+
+    struct Result
+    {
+        Request request;
+        std::vector<uint8_t> pixels;    // bottom row first
+    };
+
+    AsyncReadback(size_t maxSlots = 8);
+    virtual ~AsyncReadback();
+
+    // queue a read of the currently bound read framebuffer
+    bool ReadFramebuffer(const Request &request);
+    // queue a read of the width x height corner at the origin of level 0 of a texture
+    bool ReadTexture(unsigned int texture, const Request &request);
+
+    // hand every read that has landed to the callback, in the order they were queued
+    void Poll(const std::function<void(Result &)> &callback, bool wait = false);
+    // as above but the callback reads the pixels straight out of the mapped buffer, they're only valid during the call
+    void PollMapped(const std::function<void(const Request &, const uint8_t *)> &callback, bool wait = false);
+    // delete the buffers, the GL context has to be current
+    void Release();
+
+    size_t GetInFlightCount() { return inFlight.size(); }
+    size_t GetSlotCount() { return slots.size(); }
+    size_t GetStallCount() { return stalls; }
+    uint64_t GetBytesRead() { return bytesRead; }
+
+protected:
+    struct Slot
+    {
+        Slot() : buffer(0), capacity(0), fence(nullptr) {}
+
+        unsigned int buffer;
+        size_t capacity;
+        void *fence;
+        Request request;
+    };
+
+    size_t AcquireSlot(size_t bytes);
+    // wait for (optionally) and map a slot's buffer, hand it to the callback, then return the slot to the free list
+    bool Complete(size_t slot, bool wait, const std::function<void(const Request &, const uint8_t *)> &callback);
+
+    std::vector<Slot> slots;
+    std::deque<size_t> inFlight;        // oldest first
+    std::vector<size_t> freeSlots;
+    std::deque<Result> completed;       // reads finished early because the ring was full
+    size_t maxSlots;
+    size_t stalls;
+    uint64_t bytesRead;
+};
@@ -0,0 +1,290 @@
+#include "batchRender.h"
+#include "asyncReadback.h"
+#include "workerPool.h"
+
+#include <GL/glew.h>
+
+#include <pxr/base/gf/camera.h>
+#include <pxr/base/gf/frustum.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/imaging/hd/aov.h>
+#include <pxr/imaging/hgi/texture.h>
+#include <pxr/imaging/hio/image.h>
+#include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usdGeom/camera.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    // a path tracer that never converges still stops after this many passes
+    const int maxPasses = 256;
+
+    double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    bool WriteImage(const std::string &path, int width, int height, void *pixels)
+    {
+        pxr::HioImage::StorageSpec storage;
+        storage.width = width;
+        storage.height = height;
+        storage.depth = 1;
+        storage.format = pxr::HioFormatUNorm8Vec4;
+        storage.flipped = true;     // GL rows come back bottom first
+        storage.data = pixels;
+
+        auto writer = pxr::HioImage::OpenForWriting(path);
+        if (!writer || !writer->Write(storage))
+        {
+            std::cerr << "Unable to write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+std::vector<BatchView> MakeOrbitViews(const pxr::GfVec3d &boundsMin, const pxr::GfVec3d &boundsMax, int count, int width, int height)
+{
+    std::vector<BatchView> views;
+    if (count <= 0 || width <= 0 || height <= 0)
+        return views;
+
+    // the same framing SetSceneBounds gives the interactive camera, raised a little to see the tops of things
+    pxr::GfVec3d center = (boundsMin + boundsMax) * 0.5;
+    double size = std::max((boundsMax - boundsMin).GetLength(), 1e-3);
+    double elevation = 25.0 * M_PI / 180.0;
+
+    pxr::GfFrustum frustum;
+    frustum.SetPerspective(45.0, (double)width / (double)height, size / 10.0, size * 10.0);
+    pxr::GfMatrix4d projection = frustum.ComputeProjectionMatrix();
+
+    views.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        double angle = 2.0 * M_PI * (double)i / (double)count;
+        pxr::GfVec3d direction(std::cos(elevation) * std::sin(angle), std::sin(elevation), std::cos(elevation) * std::cos(angle));
+
+        char name[32];
+        snprintf(name, sizeof(name), "orbit.%02d", i);
+
+        BatchView view;
+        view.name = name;
+        view.view.SetLookAt(center + direction * size, center, pxr::GfVec3d(0.0, 1.0, 0.0));
+        view.projection = projection;
+        view.width = width;
+        view.height = height;
+        views.push_back(view);
+    }
+    return views;
+}
+
+void CollectCameraViews(const pxr::UsdStageRefPtr &stage, int width, std::vector<BatchView> &views)
+{
+    if (!stage || width <= 0)
+        return;
+
+    for (const auto &prim : stage->Traverse())
+    {
+        pxr::UsdGeomCamera camera(prim);
+        if (!camera)
+            continue;
+
+        pxr::GfCamera gfCamera = camera.GetCamera(pxr::UsdTimeCode::Default());
+        pxr::GfFrustum frustum = gfCamera.GetFrustum();
+        float aspect = gfCamera.GetAspectRatio();
+
+        // /World/cam_main -> World_cam_main
+        std::string name = prim.GetPath().GetString().substr(1);
+        std::replace(name.begin(), name.end(), '/', '_');
+
+        BatchView view;
+        view.name = name;
+        view.view = frustum.ComputeViewMatrix();
+        view.projection = frustum.ComputeProjectionMatrix();
+        view.width = width;
+        view.height = aspect > 0.f ? std::max(1, (int)std::lround((float)width / aspect)) : width;
+        views.push_back(view);
+    }
+}
+
+bool RenderBatch(pxr::UsdImagingGLEngine *engine, const pxr::UsdPrim &root, const pxr::UsdImagingGLRenderParams &params,
+                 const std::vector<BatchView> &views, const BatchSettings &settings, BatchReport &report, BatchQueue *queue)
+{
+    report = BatchReport();
+    if (!engine || views.empty())
+        return false;
+    if (!pxr::TfIsDir(settings.directory) && !pxr::TfMakeDirs(settings.directory))
+    {
+        std::cerr << "Unable to create batch directory " << settings.directory << std::endl;
+        return false;
+    }
+
+    auto batchStart = std::chrono::high_resolution_clock::now();
+
+    AsyncReadback readback(8);
+    WorkerPool encoders;
+    encoders.SetMaxQueued(encoders.GetThreadCount() * 4);
+    std::atomic<uint64_t> encodeMicroseconds(0), imagesWritten(0);
+
+    // a contact sheet is a grid of tiles the size of the largest view, filled in as the readbacks land
+    int tileWidth = 0, tileHeight = 0;
+    for (const auto &view : views)
+    {
+        tileWidth = std::max(tileWidth, view.width);
+        tileHeight = std::max(tileHeight, view.height);
+    }
+    int columns = settings.columns > 0 ? settings.columns : (int)std::ceil(std::sqrt((double)views.size()));
+    int rows = ((int)views.size() + columns - 1) / columns;
+    std::vector<uint8_t> sheet;
+    if (settings.tiled)
+        sheet.resize((size_t)tileWidth * columns * tileHeight * rows * 4, 0);
+
+    auto receive = [&](AsyncReadback::Result &result)
+    {
+        const auto &request = result.request;
+        if (settings.tiled)
+        {
+            // rows are bottom first so the first row of tiles is the last in memory
+            size_t tile = (size_t)request.frame;
+            size_t x0 = (tile % columns) * tileWidth;
+            size_t y0 = (rows - 1 - tile / columns) * tileHeight + (tileHeight - request.height);
+            size_t sheetStride = (size_t)tileWidth * columns * 4;
+            size_t rowBytes = (size_t)request.width * 4;
+            for (int y = 0; y < request.height; ++y)
+                std::memcpy(&sheet[(y0 + y) * sheetStride + x0 * 4], &result.pixels[y * rowBytes], rowBytes);
+            return;
+        }
+
+        auto image = std::make_shared<AsyncReadback::Result>(std::move(result));
+        std::string path = settings.directory + "/" + image->request.name + ".png";
+        encoders.Submit([image, path, &encodeMicroseconds, &imagesWritten]()
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            if (WriteImage(path, image->request.width, image->request.height, image->pixels.data()))
+                imagesWritten++;
+            encodeMicroseconds += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+        });
+    };
+
+    std::vector<GLuint> queries;
+    for (size_t next = 0;; ++next)
+    {
+        size_t i = next;
+        if (queue && !queue->Next(i))
+            break;
+        if (i >= views.size())
+            break;
+
+        const auto &view = views[i];
+        engine->SetCameraState(view.view, view.projection);
+        engine->SetRenderBufferSize(pxr::GfVec2i(view.width, view.height));
+        engine->SetRenderViewport(pxr::GfVec4d(0, 0, view.width, view.height));
+        engine->SetRendererAov(pxr::HdAovTokens->color);
+        engine->SetWindowPolicy(pxr::CameraUtilConformWindowPolicy::CameraUtilFit);
+
+        BatchViewStats stats;
+        stats.name = view.name;
+        stats.width = view.width;
+        stats.height = view.height;
+        stats.gpuMs = 0.0;
+        stats.passes = 0;
+
+        // only the camera and buffer size change between views, the first Render populates and syncs the stage and
+        // the rest just draw
+        auto start = std::chrono::high_resolution_clock::now();
+        GLuint query;
+        glGenQueries(1, &query);
+        queries.push_back(query);
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        do
+        {
+            engine->Render(root, params);
+            stats.passes++;
+        } while (!engine->IsConverged() && stats.passes < maxPasses);
+        glEndQuery(GL_TIME_ELAPSED);
+        stats.cpuMs = MillisecondsSince(start);
+        report.views.push_back(stats);
+
+        start = std::chrono::high_resolution_clock::now();
+        if (auto texture = engine->GetAovTexture(pxr::HdAovTokens->color))
+        {
+            AsyncReadback::Request request;
+            request.name = view.name;
+            request.frame = i;
+            request.width = view.width;
+            request.height = view.height;
+            request.format = GL_RGBA;
+            request.type = GL_UNSIGNED_BYTE;
+            request.bytesPerPixel = 4;
+            auto dimensions = texture->GetDescriptor().dimensions;
+            if (dimensions[0] == view.width && dimensions[1] == view.height)
+                readback.ReadTexture((GLuint)texture->GetRawResource(), request);
+            else
+                std::cerr << "Skipping " << view.name << ", the renderer didn't resize its buffers" << std::endl;
+        }
+        readback.Poll(receive);
+        report.readbackMs += MillisecondsSince(start);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    readback.Poll(receive, true);
+    report.readbackMs += MillisecondsSince(start);
+
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+        report.views[i].gpuMs = (double)elapsed / 1000000.0;
+    }
+    glDeleteQueries((GLsizei)queries.size(), queries.data());
+    readback.Release();
+
+    encoders.Wait();
+    if (settings.tiled)
+    {
+        start = std::chrono::high_resolution_clock::now();
+        if (WriteImage(settings.directory + "/views.png", tileWidth * columns, tileHeight * rows, sheet.data()))
+            imagesWritten++;
+        encodeMicroseconds += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    report.encodeMs = (double)encodeMicroseconds / 1000.0;
+    report.imagesWritten = imagesWritten;
+
+    // what the first view took over a typical one is the population and sync every other view got for free
+    if (report.views.size() > 1)
+    {
+        std::vector<double> steady;
+        for (size_t i = 1; i < report.views.size(); ++i)
+            steady.push_back(report.views[i].cpuMs);
+        std::nth_element(steady.begin(), steady.begin() + steady.size() / 2, steady.end());
+        report.syncMs = std::max(0.0, report.views[0].cpuMs - steady[steady.size() / 2]);
+    }
+
+    report.totalMs = MillisecondsSince(batchStart);
+    return report.imagesWritten > 0;
+}
+
+void PrintBatchReport(const BatchReport &report, std::ostream &out)
+{
+    size_t count = report.views.size();
+    if (count == 0)
+        return;
+
+    out << "Rendered " << count << " views in " << report.totalMs << " ms, " << report.totalMs / (double)count << " ms per view" << std::endl;
+    out << "    sync      " << report.syncMs << " ms once, " << report.syncMs / (double)count << " ms amortized per view" << std::endl;
+    for (const auto &view : report.views)
+    {
+        out << "    " << view.name << "  " << view.width << "x" << view.height << "  cpu " << view.cpuMs << " ms, gpu " << view.gpuMs << " ms";
+        if (view.passes > 1)
+            out << " over " << view.passes << " passes";
+        out << std::endl;
+    }
+    out << "    readback  " << report.readbackMs << " ms, encoding " << report.encodeMs << " ms, " << report.imagesWritten << " images written" << std::endl;
+}
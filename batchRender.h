@@ -0,0 +1,91 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usdImaging/usdImagingGL/engine.h>
+#include <pxr/usdImaging/usdImagingGL/renderParams.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// one camera of a batch, rendered into its own width x height image
+struct BatchView
+{
+    BatchView()
+        : width(0), height(0)
+    {}
+
+    std::string name;
+    pxr::GfMatrix4d view;
+    pxr::GfMatrix4d projection;
+    int width, height;
+};
+
+struct BatchSettings
+{
+    BatchSettings()
+        : orbitViews(8), width(256), height(256), stageCameras(true), tiled(false), columns(0)
+    {}
+
+    // where the images go, empty disables batch rendering
+    std::string directory;
+    // views spaced evenly around the scene bounds, at a fixed elevation
+    int orbitViews;
+    int width, height;
+    // add a view for every UsdGeomCamera on the stage
+    bool stageCameras;
+    // write one contact sheet instead of an image per view, columns of 0 makes it roughly square
+    bool tiled;
+    int columns;
+    // render the views a driver process hands out over this socket instead of all of them (see renderQueue.h)
+    std::string workerSocket;
+
+    bool IsEnabled() const { return !directory.empty(); }
+};
+
+struct BatchViewStats
+{
+    std::string name;
+    int width, height;
+    double cpuMs;           // wall time of the render calls
+    double gpuMs;
+    int passes;             // progressive renderers take more than one to converge
+};
+
+struct BatchReport
+{
+    BatchReport()
+        : totalMs(0.0), syncMs(0.0), readbackMs(0.0), encodeMs(0.0), imagesWritten(0)
+    {}
+
+    std::vector<BatchViewStats> views;
+    double totalMs;
+    // population and sync, paid once by the first view instead of once per view
+    double syncMs;
+    double readbackMs, encodeMs;
+    size_t imagesWritten;
+};
+
+// hands out the views to render, without one RenderBatch renders every view in order
+class BatchQueue
+{
+public:
+    virtual ~BatchQueue() {}
+    // the index of the next view to render, false when there's nothing left
+    virtual bool Next(size_t &view) = 0;
+};
+
+// views evenly spaced on a circle around the bounds, looking at their center
+std::vector<BatchView> MakeOrbitViews(const pxr::GfVec3d &boundsMin, const pxr::GfVec3d &boundsMax, int count, int width, int height);
+// a view for every camera prim on the stage at the default time, keeping the width and fitting the height to the
+// camera's aperture
+void CollectCameraViews(const pxr::UsdStageRefPtr &stage, int width, std::vector<BatchView> &views);
+
+// render every view (or those the queue hands out) through one engine so the stage is populated and synced once for
+// the whole batch, then read them back and write them out. the engine's GL context has to be current
+bool RenderBatch(pxr::UsdImagingGLEngine *engine, const pxr::UsdPrim &root, const pxr::UsdImagingGLRenderParams &params,
+                 const std::vector<BatchView> &views, const BatchSettings &settings, BatchReport &report, BatchQueue *queue = nullptr);
+void PrintBatchReport(const BatchReport &report, std::ostream &out);
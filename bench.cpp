@@ -0,0 +1,292 @@
+#include "benchmarkSuite.h"
+#include "camera.h"
+#include "scene.h"
+#include "shader.h"
+
+#include <pxr/pxr.h>
+#include <pxr/base/arch/systemInfo.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/usd/stage.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // the camera with its protected state reachable, and somewhere for it to write the view
+    class BenchCamera : public Camera
+    {
+    public:
+        BenchCamera()
+            : eyePosition(0.f), view(1.f)
+        {
+            SetEye(&eyePosition);
+            SetViewMatrix(&view);
+            SetPosition(glm::vec3(0.f, 0.f, 10.f));
+        }
+
+        // a drag part way across the trackball, as MouseMove leaves it
+        void StartRotation()
+        {
+            rotStart = glm::vec3(0.f, 0.f, 1.f);
+            rotEnd = glm::normalize(glm::vec3(0.1f, 0.05f, 1.f));
+            state = CAMERA_STATE::ROTATE;
+        }
+
+        using Camera::RotateCamera;
+
+        glm::vec4 eyePosition;
+        glm::mat4 view;
+    };
+
+    class BenchShader : public Shader
+    {
+    public:
+        using Shader::ProcessMacros;
+        using Shader::ReadShaderSource;
+    };
+
+    // a square grid of about pointCount points, triangulated, with normals and texture coordinates
+    struct Grid
+    {
+        Grid(size_t pointCount)
+        {
+            int side = std::max(2, (int)std::sqrt((double)pointCount));
+            for (int y = 0; y < side; ++y)
+                for (int x = 0; x < side; ++x)
+                {
+                    float u = (float)x / (float)(side - 1), v = (float)y / (float)(side - 1);
+                    points.push_back(pxr::GfVec3f(u, std::sin(u * 6.f) * std::cos(v * 6.f) * 0.1f, v));
+                    normals.push_back(pxr::GfVec3f(0.f, 1.f, 0.f));
+                    texCoords.push_back(pxr::GfVec2f(u, v));
+                }
+            for (int y = 0; y + 1 < side; ++y)
+                for (int x = 0; x + 1 < side; ++x)
+                {
+                    int i = y * side + x;
+                    for (int index : { i, i + side, i + 1, i + 1, i + side, i + side + 1 })
+                        faceVertexIndices.push_back(index);
+                    faceVertexCounts.push_back(3);
+                    faceVertexCounts.push_back(3);
+                }
+        }
+
+        pxr::VtVec3fArray points, normals;
+        pxr::VtVec2fArray texCoords;
+        pxr::VtArray<int> faceVertexCounts, faceVertexIndices;
+    };
+
+    // a shader in the layout Shader::Set reads, with a few of its defines overridden by macros
+    std::string WriteShaderFile()
+    {
+        auto path = pxr::TfStringCatPaths(pxr::ArchGetTmpDir(), "usdBench.glsl");
+        std::ofstream file(path);
+        file << "#version 410\n";
+        for (int i = 0; i < 32; ++i)
+            file << "#define SETTING_" << i << " " << i << "\n";
+        for (int i = 0; i < 160; ++i)
+            file << "    color.rgb += texture(layer" << (i % 8) << ", uv * " << i << ".0).rgb * SETTING_" << (i % 32) << ";\n";
+        return path;
+    }
+
+    bool ParseNumber(const char *option, const char *text, double &value)
+    {
+        try
+        {
+            value = std::stod(text);
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            std::cerr << "Invalid number for option " << option << ": " << text << std::endl;
+            return false;
+        }
+    }
+
+    void PrintUsage(const char *program)
+    {
+        std::cout << "Usage: " << program << " [options]" << std::endl;
+        std::cout << "  --samples <n>        timed samples per benchmark (default 25)" << std::endl;
+        std::cout << "  --min-sample-ms <ms> run enough iterations for each sample to take this long (default 20)" << std::endl;
+        std::cout << "  --filter <text>      only run benchmarks whose name contains text" << std::endl;
+        std::cout << "  --stage <file>       time the extent traversal on this stage instead of a generated grid of cubes" << std::endl;
+        std::cout << "  --out <file>         write the results as JSON" << std::endl;
+        std::cout << "  --baseline <file>    compare against results written earlier and fail on regressions" << std::endl;
+        std::cout << "  --threshold <f>      slowdown counted as a regression, as a fraction (default 0.1)" << std::endl;
+    }
+}
+
+// usdBench [options]
+//
+// times the CPU hot paths of usdSimpleCpp without a window or GL context: authoring meshes, materials and cubes,
+// the extent traversal used to frame the scene, the camera update and shader source preprocessing
+int main(int argc, char **argv)
+{
+    BenchmarkSettings settings;
+    std::string outFile, baselineFile, stageFile;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        double value = 0.0;
+        if (arg == "--samples" && i + 1 < argc)
+        {
+            if (!ParseNumber(argv[i], argv[i + 1], value))
+                return 1;
+            settings.samples = (size_t)std::max(1.0, value);
+            ++i;
+        }
+        else if (arg == "--min-sample-ms" && i + 1 < argc)
+        {
+            if (!ParseNumber(argv[i], argv[i + 1], settings.minSampleMs))
+                return 1;
+            ++i;
+        }
+        else if (arg == "--threshold" && i + 1 < argc)
+        {
+            if (!ParseNumber(argv[i], argv[i + 1], settings.threshold))
+                return 1;
+            ++i;
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+            settings.filter = argv[++i];
+        else if (arg == "--stage" && i + 1 < argc)
+            stageFile = argv[++i];
+        else if (arg == "--out" && i + 1 < argc)
+            outFile = argv[++i];
+        else if (arg == "--baseline" && i + 1 < argc)
+            baselineFile = argv[++i];
+        else
+        {
+            PrintUsage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    std::vector<BenchmarkResult> baseline;
+    if (!baselineFile.empty())
+    {
+        std::ifstream in(baselineFile);
+        if (!in || !BenchmarkSuite::ReadJson(in, baseline))
+        {
+            std::cerr << "Unable to read the baseline " << baselineFile << std::endl;
+            return 1;
+        }
+    }
+
+    BenchmarkSuite suite(settings);
+    pxr::UsdStageRefPtr stage;
+    std::vector<pxr::UsdGeomMesh> meshes;
+    std::vector<pxr::SdfLayerRefPtr> layers, targets;
+
+    // authoring a mesh, the arrays are shared with the layer so this is mostly spec creation and the extent
+    std::vector<std::unique_ptr<Grid>> grids;
+    for (size_t pointCount : { 1024, 16384, 262144, 1048576 })
+    {
+        grids.emplace_back(new Grid(pointCount));
+        const Grid *grid = grids.back().get();
+        suite.Add("createMesh/" + std::to_string(pointCount),
+            [&stage, grid](size_t i) { createMesh(stage, "mesh" + std::to_string(i), grid->points, grid->faceVertexCounts, grid->faceVertexIndices, grid->texCoords, grid->normals); },
+            [&stage](size_t) { stage = pxr::UsdStage::CreateInMemory(); });
+    }
+
+    for (std::string textureFile : { std::string(), std::string("texture.png") })
+    {
+        suite.Add(textureFile.empty() ? "createPBRShader/untextured" : "createPBRShader/textured",
+            [&stage, &meshes, textureFile](size_t i) { createPBRShader(stage, meshes[i], 0.4f, 0.1f, textureFile); },
+            [&stage, &meshes](size_t iterations)
+            {
+                stage = pxr::UsdStage::CreateInMemory();
+                meshes.clear();
+                for (size_t i = 0; i < iterations; ++i)
+                    meshes.push_back(pxr::UsdGeomMesh::Define(stage, pxr::SdfPath("/mesh" + std::to_string(i))));
+            });
+    }
+
+    suite.Add("cube",
+        [&layers](size_t i) { layers[i] = cube("cube"); },
+        [&layers](size_t iterations) { layers.assign(iterations, pxr::SdfLayerRefPtr()); });
+    suite.Add("cube/TransferContent",
+        [&layers, &targets](size_t i) { targets[i]->TransferContent(layers[i]); },
+        [&layers, &targets](size_t iterations)
+        {
+            layers.clear();
+            targets.clear();
+            for (size_t i = 0; i < iterations; ++i)
+            {
+                layers.push_back(cube("cube"));
+                targets.push_back(pxr::SdfLayer::CreateAnonymous());
+            }
+        });
+
+    // the traversal CreateGLWindow frames the scene with
+    pxr::UsdStageRefPtr extentStage;
+    if (!stageFile.empty())
+    {
+        extentStage = pxr::UsdStage::Open(stageFile);
+        if (!extentStage)
+        {
+            std::cerr << "Unable to open stage " << stageFile << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        extentStage = pxr::UsdStage::CreateInMemory();
+        extentStage->GetRootLayer()->TransferContent(cubes("cube", 4096, ""));
+    }
+    suite.Add("stageExtent", [&extentStage](size_t)
+    {
+        pxr::GfVec3f extentMin, extentMax;
+        stageExtent(extentStage, extentMin, extentMax);
+    });
+
+    BenchCamera camera;
+    suite.Add("Camera::Update/rotate", [&camera](size_t)
+    {
+        camera.StartRotation();
+        camera.Update();
+    });
+    suite.Add("Camera::RotateCamera", [&camera](size_t)
+    {
+        camera.StartRotation();
+        camera.RotateCamera();
+    });
+
+    BenchShader shader;
+    for (int i = 0; i < 32; i += 4)
+        shader.AddMacro("SETTING_" + std::to_string(i), std::to_string(i * 10));
+    auto shaderFile = WriteShaderFile();
+    std::string source;
+    suite.Add("Shader::ReadShaderSource", [&shader, &shaderFile, &source](size_t)
+    {
+        source.clear();
+        shader.ReadShaderSource(shaderFile, source);
+    });
+    std::vector<std::string> lines = { "#define SETTING_4 4", "#define SETTING_31 31", "    color.rgb += texture(layer0, uv).rgb;" };
+    suite.Add("Shader::ProcessMacros", [&shader, &lines](size_t i) { shader.ProcessMacros(lines[i % lines.size()]); });
+
+    suite.Run(std::cout);
+    std::remove(shaderFile.c_str());
+
+    if (!outFile.empty())
+    {
+        std::ofstream out(outFile);
+        if (!out)
+        {
+            std::cerr << "Unable to write " << outFile << std::endl;
+            return 1;
+        }
+        suite.WriteJson(out);
+    }
+
+    if (!baselineFile.empty() && PrintBenchmarkComparison(suite.Compare(baseline), std::cout) > 0)
+        return 1;
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include "benchmarkSuite.h"
+
+#include <pxr/base/js/json.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace
+{
+    // MAD to standard deviation for normally distributed samples
+    const double madScale = 1.4826;
+    // standard error of the median relative to that of the mean
+    const double medianError = 1.2533;
+
+    double Median(std::vector<double> values)
+    {
+        if (values.empty())
+            return 0.0;
+        size_t middle = values.size() / 2;
+        std::nth_element(values.begin(), values.begin() + middle, values.end());
+        double median = values[middle];
+        if (values.size() % 2 == 0)
+            median = 0.5 * (median + *std::max_element(values.begin(), values.begin() + middle));
+        return median;
+    }
+
+    std::string FormatNs(double ns)
+    {
+        char text[32];
+        if (ns >= 1e9)
+            snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+        else if (ns >= 1e6)
+            snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+        else if (ns >= 1e3)
+            snprintf(text, sizeof(text), "%.2f us", ns / 1e3);
+        else
+            snprintf(text, sizeof(text), "%.1f ns", ns);
+        return text;
+    }
+
+    double Number(const pxr::JsObject &object, const std::string &key)
+    {
+        auto it = object.find(key);
+        if (it == object.end())
+            return 0.0;
+        if (it->second.IsReal())
+            return it->second.GetReal();
+        if (it->second.IsUInt64())
+            return (double)it->second.GetUInt64();
+        if (it->second.IsInt())
+            return (double)it->second.GetInt64();
+        return 0.0;
+    }
+}
+
+BenchmarkSuite::BenchmarkSuite(const BenchmarkSettings &benchmarkSettings)
+    : settings(benchmarkSettings)
+{
+}
+
+void BenchmarkSuite::Add(const std::string &name, std::function<void(size_t)> iteration, std::function<void(size_t)> setup)
+{
+    Benchmark benchmark;
+    benchmark.name = name;
+    benchmark.iteration = iteration;
+    benchmark.setup = setup;
+    benchmarks.push_back(benchmark);
+}
+
+double BenchmarkSuite::Sample(const Benchmark &benchmark, size_t iterations)
+{
+    if (benchmark.setup)
+        benchmark.setup(iterations);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        benchmark.iteration(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+BenchmarkResult BenchmarkSuite::Measure(const Benchmark &benchmark)
+{
+    BenchmarkResult result;
+    result.name = benchmark.name;
+
+    // grow the iterations until a sample is long enough to time reliably, which also warms the caches up
+    double minNs = settings.minSampleMs * 1e6;
+    size_t iterations = 1;
+    for (;;)
+    {
+        double ns = Sample(benchmark, iterations);
+        if (ns >= minNs || iterations >= ((size_t)1 << 30))
+            break;
+        double grow = ns > 0.0 ? std::ceil(minNs / ns * 1.2) : 10.0;
+        iterations *= (size_t)std::min(10.0, std::max(2.0, grow));
+    }
+
+    std::vector<double> perIteration;
+    for (size_t i = 0; i < std::max<size_t>(settings.samples, 1); ++i)
+        perIteration.push_back(Sample(benchmark, iterations) / (double)iterations);
+
+    std::vector<double> deviations;
+    result.medianNs = Median(perIteration);
+    for (double ns : perIteration)
+        deviations.push_back(std::abs(ns - result.medianNs));
+    result.madNs = Median(deviations) * madScale;
+    result.minNs = *std::min_element(perIteration.begin(), perIteration.end());
+    result.meanNs = std::accumulate(perIteration.begin(), perIteration.end(), 0.0) / (double)perIteration.size();
+    result.samples = perIteration.size();
+    result.iterations = iterations;
+    return result;
+}
+
+const std::vector<BenchmarkResult> &BenchmarkSuite::Run(std::ostream &out)
+{
+    results.clear();
+    for (const auto &benchmark : benchmarks)
+    {
+        if (!settings.filter.empty() && benchmark.name.find(settings.filter) == std::string::npos)
+            continue;
+        results.push_back(Measure(benchmark));
+        const auto &result = results.back();
+        char line[256];
+        snprintf(line, sizeof(line), "%-36s %12s +- %-10s min %-10s %zu x %zu", result.name.c_str(), FormatNs(result.medianNs).c_str(),
+                 FormatNs(result.madNs).c_str(), FormatNs(result.minNs).c_str(), result.samples, result.iterations);
+        out << line << std::endl;
+    }
+    return results;
+}
+
+void BenchmarkSuite::WriteJson(std::ostream &out)
+{
+    pxr::JsArray benchmarkArray;
+    for (const auto &result : results)
+    {
+        pxr::JsObject object;
+        object["name"] = pxr::JsValue(result.name);
+        object["samples"] = pxr::JsValue((uint64_t)result.samples);
+        object["iterations"] = pxr::JsValue((uint64_t)result.iterations);
+        object["medianNs"] = pxr::JsValue(result.medianNs);
+        object["madNs"] = pxr::JsValue(result.madNs);
+        object["minNs"] = pxr::JsValue(result.minNs);
+        object["meanNs"] = pxr::JsValue(result.meanNs);
+        benchmarkArray.push_back(pxr::JsValue(object));
+    }
+
+    pxr::JsObject settingsObject;
+    settingsObject["samples"] = pxr::JsValue((uint64_t)settings.samples);
+    settingsObject["minSampleMs"] = pxr::JsValue(settings.minSampleMs);
+
+    pxr::JsObject root;
+    root["settings"] = pxr::JsValue(settingsObject);
+    root["benchmarks"] = pxr::JsValue(benchmarkArray);
+    pxr::JsWriteToStream(pxr::JsValue(root), &out);
+    out << std::endl;
+}
+
+bool BenchmarkSuite::ReadJson(std::istream &in, std::vector<BenchmarkResult> &results)
+{
+    pxr::JsParseError error;
+    auto root = pxr::JsParseStream(in, &error);
+    if (!root.IsObject())
+    {
+        std::cerr << "Unable to parse the benchmark results at line " << error.line << ": " << error.reason << std::endl;
+        return false;
+    }
+    const auto &object = root.GetJsObject();
+    auto benchmarkArray = object.find("benchmarks");
+    if (benchmarkArray == object.end() || !benchmarkArray->second.IsArray())
+    {
+        std::cerr << "The benchmark results have no benchmarks" << std::endl;
+        return false;
+    }
+
+    results.clear();
+    for (const auto &value : benchmarkArray->second.GetJsArray())
+    {
+        if (!value.IsObject())
+            continue;
+        const auto &benchmark = value.GetJsObject();
+        auto name = benchmark.find("name");
+        if (name == benchmark.end() || !name->second.IsString())
+            continue;
+        BenchmarkResult result;
+        result.name = name->second.GetString();
+        result.samples = (size_t)Number(benchmark, "samples");
+        result.iterations = (size_t)Number(benchmark, "iterations");
+        result.medianNs = Number(benchmark, "medianNs");
+        result.madNs = Number(benchmark, "madNs");
+        result.minNs = Number(benchmark, "minNs");
+        result.meanNs = Number(benchmark, "meanNs");
+        results.push_back(result);
+    }
+    return true;
+}
+
+std::vector<BenchmarkComparison> BenchmarkSuite::Compare(const std::vector<BenchmarkResult> &baseline)
+{
+    std::vector<BenchmarkComparison> comparisons;
+    for (const auto &current : results)
+    {
+        auto base = std::find_if(baseline.begin(), baseline.end(), [&current](const BenchmarkResult &result) { return result.name == current.name; });
+        if (base == baseline.end() || base->medianNs <= 0.0)
+            continue;
+
+        BenchmarkComparison comparison;
+        comparison.name = current.name;
+        comparison.baselineNs = base->medianNs;
+        comparison.currentNs = current.medianNs;
+        comparison.change = current.medianNs / base->medianNs - 1.0;
+
+        // three standard errors of the difference between the two medians
+        double currentError = medianError * current.madNs / std::sqrt((double)std::max<size_t>(current.samples, 1));
+        double baseError = medianError * base->madNs / std::sqrt((double)std::max<size_t>(base->samples, 1));
+        comparison.noise = 3.0 * std::sqrt(currentError * currentError + baseError * baseError) / base->medianNs;
+
+        comparison.regression = comparison.change > settings.threshold && comparison.change > comparison.noise;
+        comparison.improvement = -comparison.change > settings.threshold && -comparison.change > comparison.noise;
+        comparisons.push_back(comparison);
+    }
+    return comparisons;
+}
+
+size_t PrintBenchmarkComparison(const std::vector<BenchmarkComparison> &comparisons, std::ostream &out)
+{
+    size_t regressions = 0;
+    out << "Against the baseline:" << std::endl;
+    for (const auto &comparison : comparisons)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "    %-36s %12s -> %-12s %+6.1f%% (noise %.1f%%)%s", comparison.name.c_str(), FormatNs(comparison.baselineNs).c_str(),
+                 FormatNs(comparison.currentNs).c_str(), comparison.change * 100.0, comparison.noise * 100.0,
+                 comparison.regression ? "  REGRESSION" : comparison.improvement ? "  faster" : "");
+        out << line << std::endl;
+        if (comparison.regression)
+            regressions++;
+    }
+    out << regressions << " of " << comparisons.size() << " benchmarks regressed" << std::endl;
+    return regressions;
+}
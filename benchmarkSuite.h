@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkSettings
+{
+    BenchmarkSettings()
+        : samples(25), minSampleMs(20.0), threshold(0.1)
+    {}
+
+    // timed samples per benchmark, each running enough iterations to last at least minSampleMs
+    size_t samples;
+    double minSampleMs;
+    // a median this much slower than the baseline's (as a fraction), and further off than the noise of both runs,
+    // is a regression
+    double threshold;
+    // only run benchmarks whose name contains this
+    std::string filter;
+};
+
+// per iteration times in nanoseconds over the samples
+struct BenchmarkResult
+{
+    BenchmarkResult()
+        : samples(0), iterations(0), medianNs(0.0), madNs(0.0), minNs(0.0), meanNs(0.0)
+    {}
+
+    std::string name;
+    size_t samples, iterations;
+    // median absolute deviation, scaled to match a standard deviation for normally distributed samples
+    double medianNs, madNs;
+    double minNs, meanNs;
+};
+
+struct BenchmarkComparison
+{
+    BenchmarkComparison()
+        : baselineNs(0.0), currentNs(0.0), change(0.0), noise(0.0), regression(false), improvement(false)
+    {}
+
+    std::string name;
+    double baselineNs, currentNs;
+    // relative change of the median and the relative change the noise alone could explain
+    double change, noise;
+    bool regression, improvement;
+};
+
+// runs microbenchmarks with repeated, calibrated samples and compares them against a stored baseline
+//
+// each benchmark is an iteration function called with its index, and an optional setup that's told how many
+// iterations the next sample runs and prepares their inputs outside of the timing
+class BenchmarkSuite
+{
+public:
+    BenchmarkSuite(const BenchmarkSettings &settings = BenchmarkSettings());
+
+    void Add(const std::string &name, std::function<void(size_t)> iteration, std::function<void(size_t)> setup = nullptr);
+    // run every benchmark matching the filter, printing each as it finishes
+    const std::vector<BenchmarkResult> &Run(std::ostream &out);
+    const std::vector<BenchmarkResult> &GetResults() { return results; }
+
+    void WriteJson(std::ostream &out);
+    static bool ReadJson(std::istream &in, std::vector<BenchmarkResult> &results);
+    // benchmarks missing from either side are left out
+    std::vector<BenchmarkComparison> Compare(const std::vector<BenchmarkResult> &baseline);
+
+protected:
+    struct Benchmark
+    {
+        std::string name;
+        std::function<void(size_t)> iteration;
+        std::function<void(size_t)> setup;
+    };
+
+    double Sample(const Benchmark &benchmark, size_t iterations);
+    BenchmarkResult Measure(const Benchmark &benchmark);
+
+    BenchmarkSettings settings;
+    std::vector<Benchmark> benchmarks;
+    std::vector<BenchmarkResult> results;
+};
+
+// returns the number of regressions
+size_t PrintBenchmarkComparison(const std::vector<BenchmarkComparison> &comparisons, std::ostream &out);
@@ -0,0 +1,192 @@
+#include "benchmarkSuite.h"
+#include "testing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+namespace
+{
+    // results set by hand, so comparisons don't depend on how fast the machine running the test is
+    class FixedSuite : public BenchmarkSuite
+    {
+    public:
+        FixedSuite(const BenchmarkSettings &settings = BenchmarkSettings())
+            : BenchmarkSuite(settings)
+        {}
+
+        void SetResults(const std::vector<BenchmarkResult> &fixed) { results = fixed; }
+    };
+
+    BenchmarkResult Result(const std::string &name, double medianNs, double madNs, size_t samples = 25)
+    {
+        BenchmarkResult result;
+        result.name = name;
+        result.samples = samples;
+        result.iterations = 1000;
+        result.medianNs = medianNs;
+        result.madNs = madNs;
+        result.minNs = medianNs - madNs;
+        result.meanNs = medianNs + madNs;
+        return result;
+    }
+
+    void Spin(double ms)
+    {
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(ms);
+        while (std::chrono::steady_clock::now() < end)
+        {
+        }
+    }
+
+    // one iteration per sample, each sample spinning for the next of the given times
+    BenchmarkResult MeasureSpins(const std::vector<double> &sampleMs)
+    {
+        BenchmarkSettings settings;
+        settings.samples = sampleMs.size();
+        // any time is long enough, so the calibration stops after one iteration and that sample only warms up
+        settings.minSampleMs = 0.0;
+        BenchmarkSuite suite(settings);
+
+        size_t sample = 0;
+        double ms = 0.0;
+        suite.Add("spin", [&ms](size_t) { Spin(ms); }, [&](size_t iterations) {
+            CHECK(iterations == 1);
+            ms = sample == 0 ? 0.0 : sampleMs[(sample - 1) % sampleMs.size()];
+            sample++;
+        });
+        std::ostringstream out;
+        const auto &results = suite.Run(out);
+        CHECK(results.size() == 1);
+        CHECK(sample == sampleMs.size() + 1);
+        return results.empty() ? BenchmarkResult() : results[0];
+    }
+
+    void TestMedianAndMad()
+    {
+        // the outlier moves the mean but neither the median nor the spread
+        auto odd = MeasureSpins({ 3.0, 1.0, 20.0, 2.0, 4.0 });
+        CHECK(odd.samples == 5 && odd.iterations == 1);
+        CHECK_NEAR(odd.medianNs, 3e6, 0.5e6);
+        CHECK_NEAR(odd.madNs, 1.4826e6, 0.75e6);
+        CHECK_NEAR(odd.minNs, 1e6, 0.5e6);
+        CHECK(odd.meanNs >= 6e6);
+
+        // an even count takes the mean of the two middle samples
+        auto even = MeasureSpins({ 4.0, 1.0, 3.0, 2.0 });
+        CHECK(even.samples == 4);
+        CHECK_NEAR(even.medianNs, 2.5e6, 0.5e6);
+        CHECK_NEAR(even.madNs, 1.4826e6, 0.75e6);
+    }
+
+    void TestFilter()
+    {
+        BenchmarkSettings settings;
+        settings.samples = 1;
+        settings.minSampleMs = 0.0;
+        settings.filter = "mesh";
+        BenchmarkSuite suite(settings);
+        size_t skipped = 0;
+        suite.Add("mesh simplify", [](size_t) {});
+        suite.Add("bvh build", [&skipped](size_t) { skipped++; });
+        std::ostringstream out;
+        const auto &results = suite.Run(out);
+        CHECK(results.size() == 1 && results[0].name == "mesh simplify");
+        CHECK(skipped == 0);
+        CHECK(out.str().find("mesh simplify") != std::string::npos);
+    }
+
+    void TestCompare()
+    {
+        FixedSuite suite;
+        suite.SetResults({ Result("same", 1000.0, 10.0), Result("slower", 2000.0, 10.0), Result("faster", 500.0, 10.0),
+                           Result("noisy", 1200.0, 500.0), Result("small", 1050.0, 0.0), Result("new", 1000.0, 10.0),
+                           Result("empty baseline", 1000.0, 10.0) });
+        std::vector<BenchmarkResult> baseline = { Result("same", 1000.0, 10.0), Result("slower", 1000.0, 10.0), Result("faster", 1000.0, 10.0),
+                                                  Result("noisy", 1000.0, 500.0), Result("small", 1000.0, 0.0), Result("removed", 1000.0, 10.0),
+                                                  Result("empty baseline", 0.0, 0.0) };
+
+        auto comparisons = suite.Compare(baseline);
+        // in the order of the current run, without the benchmarks either side lacks or a baseline that can't be divided by
+        CHECK(comparisons.size() == 5);
+        if (comparisons.size() != 5)
+            return;
+
+        const auto &same = comparisons[0];
+        CHECK(same.name == "same" && same.baselineNs == 1000.0 && same.currentNs == 1000.0);
+        CHECK(same.change == 0.0);
+        CHECK(!same.regression && !same.improvement);
+
+        const auto &slower = comparisons[1];
+        CHECK_NEAR(slower.change, 1.0, 1e-12);
+        // three standard errors of both medians: 3 * sqrt(2) * 1.2533 * 10 / sqrt(25) / 1000
+        CHECK_NEAR(slower.noise, 3.0 * std::sqrt(2.0) * 1.2533 * 10.0 / 5.0 / 1000.0, 1e-9);
+        CHECK(slower.regression && !slower.improvement);
+
+        const auto &faster = comparisons[2];
+        CHECK_NEAR(faster.change, -0.5, 1e-12);
+        CHECK(!faster.regression && faster.improvement);
+
+        // 20% slower is past the threshold, but so spread out that the noise could explain it
+        const auto &noisy = comparisons[3];
+        CHECK(noisy.change > 0.1 && noisy.noise > noisy.change);
+        CHECK(!noisy.regression);
+
+        // and 5% slower without any noise is under the threshold
+        const auto &small = comparisons[4];
+        CHECK(small.noise == 0.0);
+        CHECK(!small.regression && !small.improvement);
+
+        std::ostringstream out;
+        CHECK(PrintBenchmarkComparison(comparisons, out) == 1);
+        CHECK(out.str().find("1 of 5 benchmarks regressed") != std::string::npos);
+
+        // a stricter threshold catches the small change too
+        BenchmarkSettings strict;
+        strict.threshold = 0.01;
+        FixedSuite strictSuite(strict);
+        strictSuite.SetResults({ Result("small", 1050.0, 0.0) });
+        comparisons = strictSuite.Compare(baseline);
+        CHECK(comparisons.size() == 1 && comparisons[0].regression);
+    }
+
+    void TestJsonRoundTrip()
+    {
+        FixedSuite suite;
+        std::vector<BenchmarkResult> written = { Result("first", 1234.5, 12.25, 25), Result("second", 5e9, 1e7, 3) };
+        suite.SetResults(written);
+        std::stringstream json;
+        suite.WriteJson(json);
+
+        std::vector<BenchmarkResult> read = { Result("stale", 1.0, 1.0) };
+        CHECK(BenchmarkSuite::ReadJson(json, read));
+        CHECK(read.size() == written.size());
+        for (size_t i = 0; i < std::min(read.size(), written.size()); ++i)
+        {
+            CHECK(read[i].name == written[i].name);
+            CHECK(read[i].samples == written[i].samples && read[i].iterations == written[i].iterations);
+            CHECK(read[i].medianNs == written[i].medianNs && read[i].madNs == written[i].madNs);
+            CHECK(read[i].minNs == written[i].minNs && read[i].meanNs == written[i].meanNs);
+        }
+
+        // a file read back compares as unchanged
+        auto comparisons = suite.Compare(read);
+        CHECK(comparisons.size() == 2);
+        for (const auto &comparison : comparisons)
+            CHECK(comparison.change == 0.0 && !comparison.regression);
+
+        std::stringstream broken("{ \"benchmarks\": ");
+        CHECK(!BenchmarkSuite::ReadJson(broken, read));
+        std::stringstream empty("{ \"settings\": {} }");
+        CHECK(!BenchmarkSuite::ReadJson(empty, read));
+    }
+}
+
+int main()
+{
+    TestMedianAndMad();
+    TestFilter();
+    TestCompare();
+    TestJsonRoundTrip();
+    return Testing::Result("benchmarkSuiteTest");
+}
@@ -11,6 +11,11 @@
 #define GLFW_MOUSE_BUTTON_RIGHT 1
 #endif
 
+#include <cstdlib>
+
+// a press that stays within this many pixels is a click, the same tolerance the renderer picks with
+static const int s_dragPixels = 3;
+
 Camera::Camera()
     :
     rotateSpeed(1.f),
@@ -29,7 +34,10 @@ Camera::Camera()
     panSpeed(0.1f),
     position(0.f, 0.f, 1.f),
     up(0.f,1.f,0.f),
-    state(CAMERA_STATE::NONE)
+    state(CAMERA_STATE::NONE),
+    pressX(0),
+    pressY(0),
+    dragging(false)
 {}
 
 void Camera::Update()
@@ -152,12 +160,14 @@ void Camera::MouseDown(int button, int action, int mods, int xpos, int ypos)
 {
     if( action == GLFW_PRESS )
     {
+        pressX = xpos;
+        pressY = ypos;
         if(button == GLFW_MOUSE_BUTTON_RIGHT)
-            state = CAMERA_STATE::PAN;
+            SetState(CAMERA_STATE::PAN);
         else
-            state = CAMERA_STATE::ROTATE;
+            SetState(CAMERA_STATE::ROTATE);
     }else
-        state = CAMERA_STATE::NONE;
+        SetState(CAMERA_STATE::NONE);
 
     if (state == CAMERA_STATE::ROTATE)
     {
@@ -182,6 +192,13 @@ void Camera::MouseWheel(double xoffset ,double yoffset)
 
 void Camera::MouseMove(int xpos,int ypos)
 {
+    if( state != CAMERA_STATE::NONE && !dragging && (std::abs(xpos - pressX) >= s_dragPixels || std::abs(ypos - pressY) >= s_dragPixels) )
+    {
+        dragging = true;
+        if( motionCallback )
+            motionCallback(true);
+    }
+
     if( state == CAMERA_STATE::ROTATE )
         rotEnd = GetMouseProjectionOnTrackBall(xpos,ypos);
     else if( state == CAMERA_STATE::PAN )
@@ -197,5 +214,18 @@ glm::vec2 Camera::GetMouseOnScreen(int clientX, int clientY)
 
 void Camera::MouseUp()
 {
-	state = CAMERA_STATE::NONE;
+	SetState(CAMERA_STATE::NONE);
+}
+
+void Camera::SetState(CAMERA_STATE newState)
+{
+	state = newState;
+
+	// the drag only started once the mouse moved, see MouseMove
+	if( state == CAMERA_STATE::NONE && dragging )
+	{
+		dragging = false;
+		if( motionCallback )
+			motionCallback(false);
+	}
 }
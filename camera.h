@@ -4,6 +4,7 @@
 #include <glm/vec4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <functional>
 #include <iostream>
 
 class Camera
@@ -32,6 +33,11 @@ public:
 	virtual void MouseMove(int xpos, int ypos);
 	virtual void MouseWheel(double xoffset ,double yoffset);
 
+	// true while the camera is being dragged, a press only counts once the mouse has moved a few pixels
+	virtual bool IsMoving() { return dragging; }
+	// called with true when a drag starts and false when the button is released
+	virtual void SetMotionCallback(std::function<void(bool)> callback) { motionCallback = callback; }
+
 protected:
 	glm::vec3 GetMouseProjectionOnTrackBall(int clientX, int clientY);
 	virtual void RotateCamera();
@@ -44,6 +50,8 @@ protected:
 		PAN
 	};
 
+	void SetState(CAMERA_STATE newState);
+
 	glm::mat4 *viewMatr;
 	glm::vec4 screenDimensions;
 
@@ -62,4 +70,7 @@ protected:
 	float zoom;
 
 	CAMERA_STATE state;
+	int pressX, pressY;
+	bool dragging;
+	std::function<void(bool)> motionCallback;
 };
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "computeBenchmark.h"
+#include "computeDelegate.h"
+
+#include <GL/glew.h>
+
+#include <pxr/base/gf/frustum.h>
+#include <pxr/imaging/hd/aov.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usdImaging/usdImagingGL/engine.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+namespace
+{
+    double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void SetupEngine(pxr::UsdImagingGLEngine &engine, const pxr::TfToken &rendererPlugin, const ComputeBenchmarkSettings &settings)
+    {
+        if (!rendererPlugin.IsEmpty())
+            engine.SetRendererPlugin(rendererPlugin);
+
+        // looking down at the grid from one corner
+        pxr::GfMatrix4d view;
+        view.SetLookAt(pxr::GfVec3d(0.0, 1.5, 2.5), pxr::GfVec3d(0.0), pxr::GfVec3d(0.0, 1.0, 0.0));
+        pxr::GfFrustum frustum;
+        frustum.SetPerspective(45.0, (double)settings.width / (double)settings.height, 0.1, 100.0);
+
+        engine.SetCameraState(view, frustum.ComputeProjectionMatrix());
+        engine.SetRenderBufferSize(pxr::GfVec2i(settings.width, settings.height));
+        engine.SetRenderViewport(pxr::GfVec4d(0, 0, settings.width, settings.height));
+        engine.SetRendererAov(pxr::HdAovTokens->color);
+        engine.SetWindowPolicy(pxr::CameraUtilConformWindowPolicy::CameraUtilFit);
+    }
+
+    // warm up, then time frames updates, update hands the new points over and render draws them
+    void TimePath(const ComputeBenchmarkSettings &settings, ComputeBenchmarkPath &path, const std::function<void(const pxr::VtVec3fArray &)> &update,
+                  const std::function<void()> &render)
+    {
+        pxr::VtVec3fArray points = MakeWaveGrid(settings.gridSize).points;
+        for (int frame = -settings.warmupFrames; frame < settings.frames; ++frame)
+        {
+            // computing the points isn't part of either path
+            UpdateWaveGrid(points, settings.gridSize, (float)frame / 60.f);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            update(points);
+            render();
+            double submitMs = MillisecondsSince(start);
+            glFinish();
+            double totalMs = MillisecondsSince(start);
+
+            if (frame >= 0)
+            {
+                path.submitMs.push_back(submitMs);
+                path.totalMs.push_back(totalMs);
+            }
+        }
+    }
+
+    void PrintTimes(const char *label, std::vector<double> times, std::ostream &out)
+    {
+        if (times.empty())
+            return;
+        std::sort(times.begin(), times.end());
+        double total = 0.0;
+        for (double time : times)
+            total += time;
+        out << label << total / (double)times.size() << " ms average, " << times[times.size() / 2] << " median, "
+            << times[std::min(times.size() - 1, times.size() * 95 / 100)] << " p95" << std::endl;
+    }
+}
+
+MeshBuffers MakeWaveGrid(int size)
+{
+    MeshBuffers grid;
+    size = std::max(size, 1);
+    int side = size + 1;
+    grid.points.resize((size_t)side * side);
+    for (int z = 0; z < side; ++z)
+    {
+        for (int x = 0; x < side; ++x)
+            grid.points[(size_t)z * side + x] = pxr::GfVec3f(2.f * (float)x / (float)size - 1.f, 0.f, 2.f * (float)z / (float)size - 1.f);
+    }
+
+    grid.faceVertexCounts.assign((size_t)size * size, 4);
+    grid.faceVertexIndices.resize((size_t)size * size * 4);
+    size_t index = 0;
+    for (int z = 0; z < size; ++z)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            int corner = z * side + x;
+            grid.faceVertexIndices[index++] = corner;
+            grid.faceVertexIndices[index++] = corner + side;
+            grid.faceVertexIndices[index++] = corner + side + 1;
+            grid.faceVertexIndices[index++] = corner + 1;
+        }
+    }
+    return grid;
+}
+
+void UpdateWaveGrid(pxr::VtVec3fArray &points, int size, float time)
+{
+    size = std::max(size, 1);
+    int side = size + 1;
+    if (points.size() != (size_t)side * side)
+        return;
+
+    // one write pointer so the array only detaches once
+    pxr::GfVec3f *data = points.data();
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        float x = data[i][0], z = data[i][2];
+        data[i][1] = 0.1f * std::sin(6.f * std::sqrt(x * x + z * z) - 3.f * time);
+    }
+}
+
+bool RunComputeBenchmark(const pxr::TfToken &rendererPlugin, const ComputeBenchmarkSettings &settings, ComputeBenchmarkReport &report)
+{
+    report = ComputeBenchmarkReport();
+    if (settings.frames <= 0)
+        return false;
+
+    MeshBuffers grid = MakeWaveGrid(settings.gridSize);
+    report.vertices = grid.points.size();
+    report.triangles = grid.faceVertexCounts.size() * 2;
+
+    pxr::UsdImagingGLRenderParams params;
+    params.enableLighting = true;
+    params.clearColor = pxr::GfVec4f(0.f, 0.f, 0.f, 1.f);
+
+    // through USD: author the points, the stage notifies UsdImaging which invalidates the prim for Storm to pull
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        auto mesh = pxr::UsdGeomMesh::Define(stage, pxr::SdfPath("/grid"));
+        mesh.CreatePointsAttr().Set(grid.points);
+        mesh.CreateFaceVertexCountsAttr().Set(grid.faceVertexCounts);
+        mesh.CreateFaceVertexIndicesAttr().Set(grid.faceVertexIndices);
+        mesh.CreateDoubleSidedAttr().Set(true);
+        pxr::VtVec3fArray extent(2);
+        extent[0] = pxr::GfVec3f(-1.f, -0.1f, -1.f);
+        extent[1] = pxr::GfVec3f(1.f, 0.1f, 1.f);
+        mesh.CreateExtentAttr().Set(extent);
+
+        pxr::UsdImagingGLEngine engine;
+        SetupEngine(engine, rendererPlugin, settings);
+        auto pointsAttr = mesh.GetPointsAttr();
+        report.stage.name = "stage";
+        TimePath(settings, report.stage,
+                 [&](const pxr::VtVec3fArray &points) { pointsAttr.Set(points); },
+                 [&]() { engine.Render(stage->GetPseudoRoot(), params); });
+    }
+
+    // straight to Hydra: swap the points in the delegate and dirty them
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        ComputeGLEngine engine;
+        SetupEngine(engine, rendererPlugin, settings);
+        if (!engine.GetRenderIndex())
+        {
+            std::cerr << "The engine has no render index to insert the compute delegate into" << std::endl;
+            return false;
+        }
+
+        ComputeSceneDelegate delegate(engine.GetRenderIndex(), pxr::SdfPath("/Compute"));
+        pxr::SdfPath id = delegate.AddMesh("grid", grid);
+        report.delegate.name = "delegate";
+        TimePath(settings, report.delegate,
+                 [&](const pxr::VtVec3fArray &points) { delegate.SetPoints(id, points); },
+                 [&]() { engine.Render(stage->GetPseudoRoot(), params); });
+    }
+    return true;
+}
+
+void PrintComputeBenchmark(const ComputeBenchmarkReport &report, std::ostream &out)
+{
+    out << "Update to pixels for a " << report.vertices << " point, " << report.triangles << " triangle grid over "
+        << report.stage.totalMs.size() << " frames" << std::endl;
+    for (const auto *path : { &report.stage, &report.delegate })
+    {
+        out << "    " << path->name << std::endl;
+        PrintTimes("        submit  ", path->submitMs, out);
+        PrintTimes("        pixels  ", path->totalMs, out);
+    }
+}
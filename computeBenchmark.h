@@ -0,0 +1,53 @@
+#pragma once
+
+#include "meshOptimizer.h"
+
+#include <pxr/pxr.h>
+#include <pxr/base/tf/token.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct ComputeBenchmarkSettings
+{
+    ComputeBenchmarkSettings()
+        : frames(0), gridSize(256), width(1280), height(720), warmupFrames(8)
+    {}
+
+    // timed updates per path, 0 disables the benchmark
+    int frames;
+    // quads along each side of the animated grid
+    int gridSize;
+    int width, height;
+    // rendered first and not timed, the first sync allocates everything
+    int warmupFrames;
+};
+
+struct ComputeBenchmarkPath
+{
+    std::string name;
+    // from handing over new points until Render returns, and until the GPU has finished the frame
+    std::vector<double> submitMs, totalMs;
+};
+
+struct ComputeBenchmarkReport
+{
+    ComputeBenchmarkReport()
+        : vertices(0), triangles(0)
+    {}
+
+    size_t vertices, triangles;
+    ComputeBenchmarkPath stage;         // points authored on a UsdGeomMesh, through UsdImaging
+    ComputeBenchmarkPath delegate;      // points handed to a ComputeSceneDelegate
+};
+
+// a size x size grid of quads over [-1, 1] in x and z
+MeshBuffers MakeWaveGrid(int size);
+// move the grid's points to a travelling wave at time seconds
+void UpdateWaveGrid(pxr::VtVec3fArray &points, int size, float time);
+
+// animate the same grid through a stage and through a scene delegate, each with an engine of its own, and time how
+// long every update takes to reach the pixels. the GL context has to be current
+bool RunComputeBenchmark(const pxr::TfToken &rendererPlugin, const ComputeBenchmarkSettings &settings, ComputeBenchmarkReport &report);
+void PrintComputeBenchmark(const ComputeBenchmarkReport &report, std::ostream &out);
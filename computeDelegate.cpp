@@ -0,0 +1,225 @@
+#include "computeDelegate.h"
+#include "scene.h"
+
+#include <pxr/imaging/hd/changeTracker.h>
+#include <pxr/imaging/hd/meshTopology.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/imaging/pxOsd/tokens.h>
+#include <pxr/usd/usdGeom/tokens.h>
+
+#include <iostream>
+
+namespace
+{
+    pxr::GfRange3d ComputeExtent(const pxr::VtVec3fArray &points)
+    {
+        pxr::GfRange3d extent;
+        for (const auto &point : points)
+            extent.UnionWith(pxr::GfVec3d(point));
+        return extent;
+    }
+
+    pxr::HdInterpolation Interpolation(const pxr::TfToken &interpolation)
+    {
+        return interpolation == pxr::UsdGeomTokens->faceVarying ? pxr::HdInterpolationFaceVarying : pxr::HdInterpolationVertex;
+    }
+}
+
+ComputeSceneDelegate::ComputeSceneDelegate(pxr::HdRenderIndex *renderIndex, const pxr::SdfPath &delegateId)
+    : pxr::HdSceneDelegate(renderIndex, delegateId)
+{
+}
+
+ComputeSceneDelegate::~ComputeSceneDelegate()
+{
+    for (const auto &mesh : meshes)
+        GetRenderIndex().RemoveRprim(mesh.first);
+}
+
+ComputeSceneDelegate::Mesh *ComputeSceneDelegate::Find(const pxr::SdfPath &id)
+{
+    auto it = meshes.find(id);
+    return it != meshes.end() ? &it->second : nullptr;
+}
+
+void ComputeSceneDelegate::MarkDirty(const pxr::SdfPath &id, pxr::HdDirtyBits bits)
+{
+    GetRenderIndex().GetChangeTracker().MarkRprimDirty(id, bits);
+}
+
+pxr::SdfPath ComputeSceneDelegate::AddMesh(const std::string &name, const MeshBuffers &buffers)
+{
+    pxr::SdfPath id = GetDelegateID().AppendChild(pxr::TfToken(name));
+    if (Find(id))
+    {
+        std::cerr << "A compute mesh called " << name << " already exists" << std::endl;
+        return pxr::SdfPath();
+    }
+
+    Mesh &mesh = meshes[id];
+    mesh.name = name;
+    mesh.buffers = buffers;
+    mesh.extent = ComputeExtent(buffers.points);
+    mesh.transform.SetIdentity();
+    mesh.color = pxr::GfVec3f(0.8f, 0.8f, 0.8f);
+    mesh.visible = true;
+
+    // everything starts dirty so the first sync pulls the lot
+    GetRenderIndex().InsertRprim(pxr::HdPrimTypeTokens->mesh, this, id);
+    return id;
+}
+
+void ComputeSceneDelegate::RemoveMesh(const pxr::SdfPath &id)
+{
+    if (meshes.erase(id) > 0)
+        GetRenderIndex().RemoveRprim(id);
+}
+
+void ComputeSceneDelegate::SetPoints(const pxr::SdfPath &id, const pxr::VtVec3fArray &points)
+{
+    Mesh *mesh = Find(id);
+    if (!mesh)
+        return;
+    mesh->buffers.points = points;
+    mesh->extent = ComputeExtent(points);
+    MarkDirty(id, pxr::HdChangeTracker::DirtyPoints | pxr::HdChangeTracker::DirtyExtent);
+}
+
+void ComputeSceneDelegate::SetNormals(const pxr::SdfPath &id, const pxr::VtVec3fArray &normals)
+{
+    Mesh *mesh = Find(id);
+    if (!mesh)
+        return;
+    // a change in whether there are normals at all changes the primvar descriptors too
+    bool hadNormals = !mesh->buffers.normals.empty();
+    mesh->buffers.normals = normals;
+    MarkDirty(id, hadNormals == !normals.empty() ? pxr::HdChangeTracker::DirtyNormals
+                                                  : pxr::HdChangeTracker::DirtyNormals | pxr::HdChangeTracker::DirtyPrimvar);
+}
+
+void ComputeSceneDelegate::SetTopology(const pxr::SdfPath &id, const pxr::VtArray<int> &faceVertexCounts, const pxr::VtArray<int> &faceVertexIndices)
+{
+    Mesh *mesh = Find(id);
+    if (!mesh)
+        return;
+    mesh->buffers.faceVertexCounts = faceVertexCounts;
+    mesh->buffers.faceVertexIndices = faceVertexIndices;
+    MarkDirty(id, pxr::HdChangeTracker::DirtyTopology);
+}
+
+void ComputeSceneDelegate::SetTransform(const pxr::SdfPath &id, const pxr::GfMatrix4d &transform)
+{
+    Mesh *mesh = Find(id);
+    if (!mesh)
+        return;
+    mesh->transform = transform;
+    MarkDirty(id, pxr::HdChangeTracker::DirtyTransform);
+}
+
+void ComputeSceneDelegate::SetDisplayColor(const pxr::SdfPath &id, const pxr::GfVec3f &color)
+{
+    Mesh *mesh = Find(id);
+    if (!mesh)
+        return;
+    mesh->color = color;
+    MarkDirty(id, pxr::HdChangeTracker::DirtyPrimvar);
+}
+
+void ComputeSceneDelegate::SetVisible(const pxr::SdfPath &id, bool visible)
+{
+    Mesh *mesh = Find(id);
+    if (!mesh || mesh->visible == visible)
+        return;
+    mesh->visible = visible;
+    MarkDirty(id, pxr::HdChangeTracker::DirtyVisibility);
+}
+
+void ComputeSceneDelegate::Author(const pxr::UsdStageRefPtr &stage) const
+{
+    for (const auto &entry : meshes)
+    {
+        const Mesh &mesh = entry.second;
+        // the layer shares storage with our arrays until either side writes to them
+        const MeshBuffers &buffers = mesh.buffers;
+        pxr::UsdGeomMesh usdMesh = buffers.texCoords.empty()
+            ? createMesh(stage, mesh.name, buffers.points, buffers.faceVertexCounts, buffers.faceVertexIndices, buffers.normals)
+            : createMesh(stage, mesh.name, buffers.points, buffers.faceVertexCounts, buffers.faceVertexIndices, buffers.texCoords, buffers.normals);
+        if (!buffers.normalsInterpolation.IsEmpty())
+            usdMesh.SetNormalsInterpolation(buffers.normalsInterpolation);
+        usdMesh.CreateDisplayColorAttr().Set(pxr::VtVec3fArray(1, mesh.color));
+        if (!mesh.visible)
+            usdMesh.CreateVisibilityAttr().Set(pxr::UsdGeomTokens->invisible);
+        if (mesh.transform != pxr::GfMatrix4d(1.0))
+            usdMesh.AddTransformOp().Set(mesh.transform);
+    }
+}
+
+pxr::HdMeshTopology ComputeSceneDelegate::GetMeshTopology(const pxr::SdfPath &id)
+{
+    Mesh *mesh = Find(id);
+    if (!mesh)
+        return pxr::HdMeshTopology();
+    return pxr::HdMeshTopology(pxr::PxOsdOpenSubdivTokens->none, pxr::HdTokens->rightHanded, mesh->buffers.faceVertexCounts,
+                               mesh->buffers.faceVertexIndices);
+}
+
+pxr::GfRange3d ComputeSceneDelegate::GetExtent(const pxr::SdfPath &id)
+{
+    Mesh *mesh = Find(id);
+    return mesh ? mesh->extent : pxr::GfRange3d();
+}
+
+pxr::GfMatrix4d ComputeSceneDelegate::GetTransform(const pxr::SdfPath &id)
+{
+    Mesh *mesh = Find(id);
+    return mesh ? mesh->transform : pxr::GfMatrix4d(1.0);
+}
+
+bool ComputeSceneDelegate::GetVisible(const pxr::SdfPath &id)
+{
+    Mesh *mesh = Find(id);
+    return mesh && mesh->visible;
+}
+
+bool ComputeSceneDelegate::GetDoubleSided(const pxr::SdfPath &)
+{
+    // as createMesh authors them
+    return true;
+}
+
+pxr::VtValue ComputeSceneDelegate::Get(const pxr::SdfPath &id, const pxr::TfToken &key)
+{
+    Mesh *mesh = Find(id);
+    if (!mesh)
+        return pxr::VtValue();
+
+    if (key == pxr::HdTokens->points)
+        return pxr::VtValue(mesh->buffers.points);
+    if (key == pxr::HdTokens->normals)
+        return pxr::VtValue(mesh->buffers.normals);
+    if (key == pxr::HdTokens->displayColor)
+        return pxr::VtValue(pxr::VtVec3fArray(1, mesh->color));
+    if (key == pxr::TfToken("st"))
+        return pxr::VtValue(mesh->buffers.texCoords);
+    return pxr::VtValue();
+}
+
+pxr::HdPrimvarDescriptorVector ComputeSceneDelegate::GetPrimvarDescriptors(const pxr::SdfPath &id, pxr::HdInterpolation interpolation)
+{
+    pxr::HdPrimvarDescriptorVector primvars;
+    Mesh *mesh = Find(id);
+    if (!mesh)
+        return primvars;
+
+    const MeshBuffers &buffers = mesh->buffers;
+    if (interpolation == pxr::HdInterpolationVertex)
+        primvars.emplace_back(pxr::HdTokens->points, interpolation, pxr::HdPrimvarRoleTokens->point);
+    if (interpolation == pxr::HdInterpolationConstant)
+        primvars.emplace_back(pxr::HdTokens->displayColor, interpolation, pxr::HdPrimvarRoleTokens->color);
+    // without normals Storm computes smooth ones on the GPU
+    if (!buffers.normals.empty() && interpolation == Interpolation(buffers.normalsInterpolation))
+        primvars.emplace_back(pxr::HdTokens->normals, interpolation, pxr::HdPrimvarRoleTokens->normal);
+    if (!buffers.texCoords.empty() && interpolation == Interpolation(buffers.texCoordsInterpolation))
+        primvars.emplace_back(pxr::TfToken("st"), interpolation, pxr::HdPrimvarRoleTokens->textureCoordinate);
+    return primvars;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "meshOptimizer.h"
+
+#include <pxr/pxr.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/range3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/sceneDelegate.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usdImaging/usdImagingGL/engine.h>
+
+#include <map>
+#include <string>
+
+// the engine with its render index opened up so other scene delegates can be inserted next to UsdImaging's, the
+// index (and everything in it) is rebuilt whenever the renderer plugin changes
+class ComputeGLEngine : public pxr::UsdImagingGLEngine
+{
+public:
+    using pxr::UsdImagingGLEngine::UsdImagingGLEngine;
+
+    pxr::HdRenderIndex *GetRenderIndex() const
+    {
+        return _GetRenderIndex();
+    }
+};
+
+// meshes generated at runtime handed straight to Hydra
+//
+// the buffers live here and Storm pulls them during sync, so an update is one array swap and a dirty bit instead of
+// authoring attributes, stage change processing and UsdImaging invalidation. each setter only dirties the buffer it
+// replaces. prims go under the delegate id and are drawn by any Render of the engine whose root covers it
+class ComputeSceneDelegate : public pxr::HdSceneDelegate
+{
+public:
+    ComputeSceneDelegate(pxr::HdRenderIndex *renderIndex, const pxr::SdfPath &delegateId);
+    ~ComputeSceneDelegate() override;
+
+    // add a mesh named name under the delegate ("grid" -> /Compute/grid)
+    pxr::SdfPath AddMesh(const std::string &name, const MeshBuffers &buffers);
+    void RemoveMesh(const pxr::SdfPath &id);
+    size_t GetMeshCount() { return meshes.size(); }
+
+    void SetPoints(const pxr::SdfPath &id, const pxr::VtVec3fArray &points);
+    void SetNormals(const pxr::SdfPath &id, const pxr::VtVec3fArray &normals);
+    void SetTopology(const pxr::SdfPath &id, const pxr::VtArray<int> &faceVertexCounts, const pxr::VtArray<int> &faceVertexIndices);
+    void SetTransform(const pxr::SdfPath &id, const pxr::GfMatrix4d &transform);
+    void SetDisplayColor(const pxr::SdfPath &id, const pxr::GfVec3f &color);
+    void SetVisible(const pxr::SdfPath &id, bool visible);
+
+    // write the meshes to the stage as UsdGeomMeshes under /<name>, for keeping what was generated
+    void Author(const pxr::UsdStageRefPtr &stage) const;
+
+    // HdSceneDelegate
+    pxr::HdMeshTopology GetMeshTopology(const pxr::SdfPath &id) override;
+    pxr::GfRange3d GetExtent(const pxr::SdfPath &id) override;
+    pxr::GfMatrix4d GetTransform(const pxr::SdfPath &id) override;
+    bool GetVisible(const pxr::SdfPath &id) override;
+    bool GetDoubleSided(const pxr::SdfPath &id) override;
+    pxr::VtValue Get(const pxr::SdfPath &id, const pxr::TfToken &key) override;
+    pxr::HdPrimvarDescriptorVector GetPrimvarDescriptors(const pxr::SdfPath &id, pxr::HdInterpolation interpolation) override;
+
+protected:
+    struct Mesh
+    {
+        std::string name;
+        MeshBuffers buffers;
+        pxr::GfRange3d extent;
+        pxr::GfMatrix4d transform;
+        pxr::GfVec3f color;
+        bool visible;
+    };
+
+    Mesh *Find(const pxr::SdfPath &id);
+    void MarkDirty(const pxr::SdfPath &id, pxr::HdDirtyBits bits);
+
+    std::map<pxr::SdfPath, Mesh> meshes;
+};
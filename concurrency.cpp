@@ -0,0 +1,156 @@
+#include "concurrency.h"
+
+#include <pxr/base/tf/getenv.h>
+#include <pxr/base/work/threadLimits.h>
+
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace
+{
+    std::mutex phaseMutex;
+    std::vector<PhaseStats> phases;
+
+    bool PinCores(int firstCore, size_t count)
+    {
+        size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        if (firstCore < 0 || (size_t)firstCore >= cores)
+        {
+            std::cerr << "Unable to pin to core " << firstCore << ", there are " << cores << std::endl;
+            return false;
+        }
+        size_t last = count == 0 ? cores : std::min(cores, (size_t)firstCore + count);
+
+#if defined(_WIN32)
+        DWORD_PTR mask = 0;
+        for (size_t core = (size_t)firstCore; core < last && core < sizeof(mask) * 8; ++core)
+            mask |= (DWORD_PTR)1 << core;
+        if (!SetProcessAffinityMask(GetCurrentProcess(), mask))
+        {
+            std::cerr << "Unable to pin to cores " << firstCore << "-" << last - 1 << std::endl;
+            return false;
+        }
+#elif defined(__linux__)
+        // only this thread, the threads started after it inherit the mask
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t core = (size_t)firstCore; core < last; ++core)
+            CPU_SET(core, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        {
+            std::cerr << "Unable to pin to cores " << firstCore << "-" << last - 1 << std::endl;
+            return false;
+        }
+#else
+        std::cerr << "Pinning to cores isn't supported on this platform" << std::endl;
+        return false;
+#endif
+        std::cout << "Pinned to cores " << firstCore << "-" << last - 1 << std::endl;
+        return true;
+    }
+}
+
+void ReadConcurrencyEnvironment(ConcurrencySettings &settings)
+{
+    if (settings.threads == 0)
+        settings.threads = (size_t)pxr::TfGetenvInt("USDSIMPLECPP_THREADS", 0);
+    if (settings.firstCore < 0)
+        settings.firstCore = pxr::TfGetenvInt("USDSIMPLECPP_PIN_CORES", -1);
+}
+
+bool ConfigureConcurrency(const ConcurrencySettings &settings)
+{
+    bool succeeded = true;
+    if (settings.firstCore >= 0)
+        succeeded = PinCores(settings.firstCore, settings.threads);
+
+    if (settings.threads > 0)
+        pxr::WorkSetConcurrencyLimit((unsigned)settings.threads);
+    else
+        pxr::WorkSetMaximumConcurrencyLimit();
+    if (settings.threads > 0 && GetConcurrency() != settings.threads)
+        std::cerr << "Asked for " << settings.threads << " threads, the work library is using " << GetConcurrency()
+                  << " (PXR_WORK_THREAD_LIMIT takes precedence)" << std::endl;
+    return succeeded;
+}
+
+size_t GetConcurrency()
+{
+    return (size_t)pxr::WorkGetConcurrencyLimit();
+}
+
+double ProcessCpuMs()
+{
+#if defined(_WIN32)
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+        return 0.0;
+    // 100ns ticks
+    auto ticks = [](const FILETIME &time) { return ((unsigned long long)time.dwHighDateTime << 32) | time.dwLowDateTime; };
+    return (double)(ticks(kernel) + ticks(user)) / 10000.0;
+#elif defined(__linux__)
+    timespec time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+        return 0.0;
+    return (double)time.tv_sec * 1000.0 + (double)time.tv_nsec / 1e6;
+#else
+    return (double)std::clock() * 1000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+PhaseTimer::PhaseTimer(const std::string &name)
+    : phase(name), start(std::chrono::steady_clock::now()), cpuStart(ProcessCpuMs())
+{
+}
+
+PhaseTimer::~PhaseTimer()
+{
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    RecordPhase(phase, wallMs, ProcessCpuMs() - cpuStart);
+}
+
+void RecordPhase(const std::string &name, double wallMs, double cpuMs)
+{
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    auto it = std::find_if(phases.begin(), phases.end(), [&name](const PhaseStats &stats) { return stats.name == name; });
+    if (it == phases.end())
+    {
+        phases.push_back(PhaseStats());
+        it = phases.end() - 1;
+        it->name = name;
+    }
+    it->calls++;
+    it->wallMs += wallMs;
+    it->cpuMs += cpuMs;
+}
+
+std::vector<PhaseStats> GetPhaseStats()
+{
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    return phases;
+}
+
+void PrintConcurrencyReport(std::ostream &out)
+{
+    size_t threads = GetConcurrency();
+    auto precision = out.precision();
+    out << "Concurrency: " << threads << " threads of " << std::thread::hardware_concurrency() << " cores" << std::endl;
+    for (const auto &stats : GetPhaseStats())
+    {
+        double busy = stats.wallMs > 0.0 ? stats.cpuMs / stats.wallMs : 0.0;
+        out << "    " << std::left << std::setw(12) << stats.name << std::right << std::setw(6) << stats.calls << " calls  "
+            << std::fixed << std::setprecision(1) << std::setw(10) << stats.wallMs << " ms wall  " << std::setw(10) << stats.cpuMs
+            << " ms cpu  " << std::setprecision(2) << busy << " threads busy, " << std::setprecision(0)
+            << 100.0 * busy / (double)std::max<size_t>(threads, 1) << "% efficient" << std::defaultfloat << std::endl;
+    }
+    out.precision(precision);
+}
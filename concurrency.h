@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// one thread budget for USD's work library, Hydra's sync and our own jobs
+//
+// everything we run in parallel goes through the work library (WorkParallelForN, or a WorkerPool without threads of
+// its own), so the limit set here covers it all rather than each pool sizing itself to the machine
+struct ConcurrencySettings
+{
+    ConcurrencySettings()
+        : threads(0), firstCore(-1)
+    {}
+
+    // 0 uses every core, PXR_WORK_THREAD_LIMIT still wins if it's set
+    size_t threads;
+    // pin the process to threads cores from this one on (to the last core if threads is 0), -1 leaves it to the OS
+    int firstCore;
+};
+
+// fill in whatever the command line left unset from USDSIMPLECPP_THREADS and USDSIMPLECPP_PIN_CORES
+void ReadConcurrencyEnvironment(ConcurrencySettings &settings);
+// apply the settings, before anything starts a thread so every thread after inherits the pinning
+bool ConfigureConcurrency(const ConcurrencySettings &settings);
+// the threads the work library will use
+size_t GetConcurrency();
+
+// time spent in a phase, wall clock and cpu over the whole process, added up by name
+struct PhaseStats
+{
+    PhaseStats()
+        : calls(0), wallMs(0.0), cpuMs(0.0)
+    {}
+
+    std::string name;
+    size_t calls;
+    double wallMs, cpuMs;
+};
+
+// times the scope it lives in as one call of the phase
+class PhaseTimer
+{
+public:
+    PhaseTimer(const std::string &phase);
+    virtual ~PhaseTimer();
+
+protected:
+    std::string phase;
+    std::chrono::steady_clock::time_point start;
+    double cpuStart;
+};
+
+// process cpu time in milliseconds, every thread included
+double ProcessCpuMs();
+void RecordPhase(const std::string &name, double wallMs, double cpuMs);
+std::vector<PhaseStats> GetPhaseStats();
+
+// per phase how many threads were busy on average and what fraction of the budget that is. the cpu time is the
+// whole process's, so anything running alongside a phase (encoders, driver threads) counts towards it
+void PrintConcurrencyReport(std::ostream &out);
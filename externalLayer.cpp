@@ -0,0 +1,128 @@
+#include "externalLayer.h"
+
+#include <GL/glew.h>
+
+#include <iostream>
+
+namespace
+{
+    // the layouts the textures are in while the composite samples them, both sides have to agree on them
+    void Layouts(const std::vector<unsigned int> &colorTextures, const std::vector<unsigned int> &depthTextures,
+                 std::vector<GLuint> &textures, std::vector<GLenum> &layouts)
+    {
+        textures.clear();
+        layouts.clear();
+        for (auto texture : colorTextures)
+        {
+            textures.push_back(texture);
+            layouts.push_back(GL_LAYOUT_SHADER_READ_ONLY_EXT);
+        }
+        for (auto texture : depthTextures)
+        {
+            textures.push_back(texture);
+            layouts.push_back(GL_LAYOUT_DEPTH_STENCIL_READ_ONLY_EXT);
+        }
+    }
+}
+
+InteropTexture::InteropTexture()
+    : memoryObject(0), texture(0), width(0), height(0)
+{
+}
+
+InteropTexture::~InteropTexture()
+{
+}
+
+bool InteropTexture::Import(int memoryFd, uint64_t size, int textureWidth, int textureHeight, unsigned int internalFormat, bool dedicated)
+{
+    Release();
+    if (!GLEW_EXT_memory_object || !GLEW_EXT_memory_object_fd)
+    {
+        std::cerr << "GL_EXT_memory_object_fd isn't supported, unable to import external textures" << std::endl;
+        return false;
+    }
+
+    glCreateMemoryObjectsEXT(1, &memoryObject);
+    if (dedicated)
+    {
+        GLint value = GL_TRUE;
+        glMemoryObjectParameterivEXT(memoryObject, GL_DEDICATED_MEMORY_OBJECT_EXT, &value);
+    }
+    glImportMemoryFdEXT(memoryObject, size, GL_HANDLE_TYPE_OPAQUE_FD_EXT, memoryFd);
+
+    // optimal tiling is the default, which is what other APIs export their render targets with
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureStorageMem2DEXT(texture, 1, internalFormat, textureWidth, textureHeight, memoryObject, 0);
+    if (glGetError() != GL_NO_ERROR)
+    {
+        std::cerr << "Unable to create a " << textureWidth << "x" << textureHeight << " texture over imported memory" << std::endl;
+        Release();
+        return false;
+    }
+
+    width = textureWidth;
+    height = textureHeight;
+    return true;
+}
+
+void InteropTexture::Release()
+{
+    if (texture)
+        glDeleteTextures(1, &texture);
+    if (memoryObject)
+        glDeleteMemoryObjectsEXT(1, &memoryObject);
+    texture = 0;
+    memoryObject = 0;
+    width = height = 0;
+}
+
+InteropSemaphore::InteropSemaphore()
+    : semaphore(0)
+{
+}
+
+InteropSemaphore::~InteropSemaphore()
+{
+}
+
+bool InteropSemaphore::Import(int semaphoreFd)
+{
+    Release();
+    if (!GLEW_EXT_semaphore || !GLEW_EXT_semaphore_fd)
+    {
+        std::cerr << "GL_EXT_semaphore_fd isn't supported, unable to import external semaphores" << std::endl;
+        return false;
+    }
+
+    glGenSemaphoresEXT(1, &semaphore);
+    glImportSemaphoreFdEXT(semaphore, GL_HANDLE_TYPE_OPAQUE_FD_EXT, semaphoreFd);
+    return true;
+}
+
+void InteropSemaphore::Release()
+{
+    if (semaphore)
+        glDeleteSemaphoresEXT(1, &semaphore);
+    semaphore = 0;
+}
+
+void InteropSemaphore::Wait(const std::vector<unsigned int> &colorTextures, const std::vector<unsigned int> &depthTextures)
+{
+    if (!semaphore)
+        return;
+    std::vector<GLuint> textures;
+    std::vector<GLenum> layouts;
+    Layouts(colorTextures, depthTextures, textures, layouts);
+    glWaitSemaphoreEXT(semaphore, 0, nullptr, (GLuint)textures.size(), textures.data(), layouts.data());
+}
+
+void InteropSemaphore::Signal(const std::vector<unsigned int> &colorTextures, const std::vector<unsigned int> &depthTextures)
+{
+    if (!semaphore)
+        return;
+    std::vector<GLuint> textures;
+    std::vector<GLenum> layouts;
+    Layouts(colorTextures, depthTextures, textures, layouts);
+    glSignalSemaphoreEXT(semaphore, 0, nullptr, (GLuint)textures.size(), textures.data(), layouts.data());
+}
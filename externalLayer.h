@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class InteropSemaphore;
+
+// color and depth drawn by something other than Hydra (another GL renderer, or Vulkan through the interop classes
+// below) that the composite merges with the primary pass by depth every frame
+//
+// depth is window depth in [0, 1] for the renderer's view and projection matrices with GL's -1..1 to 0..1 mapping,
+// the same as Hydra's depth aov, smaller is nearer. color is RGBA, alpha blends it over what's behind. the textures
+// can be any size, they're sampled over the whole window
+struct ExternalLayer
+{
+    ExternalLayer()
+        : colorTexture(0), depthTexture(0), ready(nullptr), done(nullptr)
+    {}
+
+    unsigned int colorTexture;
+    unsigned int depthTexture;
+    // waited on before the composite reads the textures and signalled once it has, when the textures belong to another
+    // API. either may be null
+    InteropSemaphore *ready;
+    InteropSemaphore *done;
+
+    bool IsEnabled() const { return colorTexture != 0 && depthTexture != 0; }
+};
+
+// a GL texture over memory allocated and exported by another API, e.g. a Vulkan image exported as an opaque fd
+// (GL_EXT_memory_object_fd). the memory has to be created with the same format, size and a single level
+class InteropTexture
+{
+public:
+    InteropTexture();
+    virtual ~InteropTexture();
+
+    // GL takes ownership of the fd on success, dedicated must match how the memory was allocated
+    bool Import(int memoryFd, uint64_t size, int width, int height, unsigned int internalFormat, bool dedicated);
+    // the context has to be current
+    void Release();
+
+    unsigned int GetTexture() { return texture; }
+    int GetWidth() { return width; }
+    int GetHeight() { return height; }
+
+protected:
+    unsigned int memoryObject;
+    unsigned int texture;
+    int width, height;
+};
+
+// a semaphore shared with another API (GL_EXT_semaphore_fd) to order its writes to interop textures with our reads
+class InteropSemaphore
+{
+public:
+    InteropSemaphore();
+    virtual ~InteropSemaphore();
+
+    // GL takes ownership of the fd on success
+    bool Import(int semaphoreFd);
+    void Release();
+
+    // make the GL stream wait for the other API to signal, before reading the textures
+    void Wait(const std::vector<unsigned int> &colorTextures, const std::vector<unsigned int> &depthTextures);
+    // signal the other API once GL is done reading them
+    void Signal(const std::vector<unsigned int> &colorTextures, const std::vector<unsigned int> &depthTextures);
+
+protected:
+    unsigned int semaphore;
+};
@@ -0,0 +1,40 @@
+#include "foreignArray.h"
+
+ForeignBuffer::ForeignBuffer(void *blockData, size_t blockBytes, std::function<void()> releasedCallback)
+    : pxr::Vt_ArrayForeignDataSource(&ForeignBuffer::Detached, 1), data((uint8_t *)blockData), bytes(blockBytes),
+      released(releasedCallback), ownerReleased(false)
+{
+}
+
+ForeignBuffer *ForeignBuffer::Lend(void *data, size_t bytes, std::function<void()> released)
+{
+    return new ForeignBuffer(data, bytes, released);
+}
+
+void ForeignBuffer::Release()
+{
+    if (ownerReleased)
+        return;
+    ownerReleased = true;
+    // the same path the arrays take when they let go of the last reference
+    if (_refCount.fetch_sub(1) == 1)
+        Detached(this);
+}
+
+void ForeignBuffer::Detached(pxr::Vt_ArrayForeignDataSource *self)
+{
+    ForeignBuffer *buffer = static_cast<ForeignBuffer *>(self);
+    if (buffer->released)
+        buffer->released();
+    delete buffer;
+}
+
+void PrintIngestReport(const std::string &name, const IngestReport &report, std::ostream &out)
+{
+    size_t meshes = report.meshes > 0 ? report.meshes : 1;
+    out << "Ingested " << name << ": " << report.meshes << " meshes, " << report.arrays << " arrays, " << report.bytes << " bytes" << std::endl;
+    out << "    allocated " << report.allocations << " arrays, " << report.bytesAllocated << " bytes ("
+        << (double)report.allocations / (double)meshes << " allocations, " << report.bytesAllocated / meshes << " bytes per mesh)" << std::endl;
+    out << "    copied    " << report.arraysCopied << " arrays, " << report.bytesCopied << " bytes on the way into the layer ("
+        << report.bytesCopied / meshes << " bytes per mesh)" << std::endl;
+}
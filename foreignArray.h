@@ -0,0 +1,96 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/usd/usd/attribute.h>
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+
+// a block of memory owned by someone else (a mapped buffer, an arena, a compute kernel's output) lent to VtArrays
+// without copying it
+//
+// arrays made with Wrap point straight at the block and hold a reference on it, so do any values authored from
+// them (a layer keeps the array it was given). the owner holds one more reference until it calls Release. once all
+// of them are gone the released callback runs, from whichever thread dropped the last one, and the ForeignBuffer
+// deletes itself. writing through a wrapped array makes it copy the data first, the block is never written to
+class ForeignBuffer : public pxr::Vt_ArrayForeignDataSource
+{
+public:
+    static ForeignBuffer *Lend(void *data, size_t bytes, std::function<void()> released);
+
+    // count elements starting offset bytes into the block, empty if they don't fit or are misaligned
+    template <class T>
+    pxr::VtArray<T> Wrap(size_t offset, size_t count)
+    {
+        if (offset % alignof(T) != 0 || offset > bytes || count > (bytes - offset) / sizeof(T))
+        {
+            std::cerr << "Unable to wrap " << count << " elements at " << offset << " of a " << bytes << " byte block" << std::endl;
+            return pxr::VtArray<T>();
+        }
+        return pxr::VtArray<T>(this, (T *)(data + offset), count);
+    }
+
+    // drop the owner's reference, the memory may be released straight away if no arrays are using it
+    void Release();
+
+    uint8_t *GetData() { return data; }
+    size_t GetSize() { return bytes; }
+    // the owner counts as one until it releases
+    size_t GetReferenceCount() { return _refCount.load(); }
+
+protected:
+    ForeignBuffer(void *data, size_t bytes, std::function<void()> released);
+    static void Detached(pxr::Vt_ArrayForeignDataSource *self);
+
+    uint8_t *data;
+    size_t bytes;
+    std::function<void()> released;
+    bool ownerReleased;
+};
+
+// where the arrays behind a mesh came from and what it cost to get them into a layer
+struct IngestReport
+{
+    IngestReport()
+        : meshes(0), arrays(0), bytes(0), allocations(0), bytesAllocated(0), arraysCopied(0), bytesCopied(0)
+    {}
+
+    size_t meshes;
+    size_t arrays, bytes;
+    // heap allocations made to hold the arrays before authoring, foreign memory doesn't count
+    size_t allocations, bytesAllocated;
+    // arrays whose authored value doesn't share storage with the array it was authored from
+    size_t arraysCopied, bytesCopied;
+};
+
+// count an array that was allocated to be authored
+template <class T>
+void AccountAllocation(const pxr::VtArray<T> &array, IngestReport &report)
+{
+    if (array.empty())
+        return;
+    report.allocations++;
+    report.bytesAllocated += array.size() * sizeof(T);
+}
+
+// compare the storage behind the authored attribute with the array it was authored from
+template <class T>
+void AccountIngest(const pxr::UsdAttribute &attribute, const pxr::VtArray<T> &source, IngestReport &report)
+{
+    if (source.empty())
+        return;
+    report.arrays++;
+    report.bytes += source.size() * sizeof(T);
+
+    pxr::VtArray<T> authored;
+    if (!attribute.Get(&authored) || authored.cdata() != source.cdata())
+    {
+        report.arraysCopied++;
+        report.bytesCopied += source.size() * sizeof(T);
+    }
+}
+
+void PrintIngestReport(const std::string &name, const IngestReport &report, std::ostream &out);
@@ -0,0 +1,189 @@
+#include "frameCapture.h"
+
+#include <GL/glew.h>
+
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/imaging/hd/aov.h>
+#include <pxr/imaging/hgi/texture.h>
+#include <pxr/imaging/hio/image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+FrameCapture::FrameCapture()
+    : readback(8), framesCaptured(0), imagesWritten(0), encodeFailures(0), encodeMicroseconds(0)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+}
+
+void FrameCapture::Configure(const CaptureSettings &captureSettings)
+{
+    settings = captureSettings;
+    if (!IsEnabled())
+        return;
+
+    if (!pxr::TfIsDir(settings.directory) && !pxr::TfMakeDirs(settings.directory))
+    {
+        std::cerr << "Unable to create capture directory " << settings.directory << ", capture disabled" << std::endl;
+        settings.directory.clear();
+        return;
+    }
+
+    // a few frames of headroom per encoder before the render loop has to wait for them
+    encoders.reset(new WorkerPool(settings.encoderThreads));
+    encoders->SetMaxQueued(encoders->GetThreadCount() * 4);
+    std::cout << "Capturing to " << settings.directory << " with " << encoders->GetThreadCount() << " encoder threads" << std::endl;
+}
+
+void FrameCapture::ReadAov(pxr::UsdImagingGLEngine *engine, const pxr::TfToken &aov, const std::string &name, int width, int height)
+{
+    if (!engine)
+        return;
+    auto texture = engine->GetAovTexture(aov);
+    if (!texture)
+        return;
+
+    auto dimensions = texture->GetDescriptor().dimensions;
+    AsyncReadback::Request request;
+    request.name = name;
+    request.frame = framesCaptured;
+    // the buffers can be larger than the frame, only the corner the viewport covered holds it
+    request.width = std::min(width, dimensions[0]);
+    request.height = std::min(height, dimensions[1]);
+    if (aov == pxr::HdAovTokens->depth)
+    {
+        request.format = GL_DEPTH_COMPONENT;
+        request.type = GL_FLOAT;
+        request.bytesPerPixel = sizeof(float);
+    }
+    else if (aov == pxr::HdAovTokens->primId)
+    {
+        request.format = GL_RED_INTEGER;
+        request.type = GL_INT;
+        request.bytesPerPixel = sizeof(int32_t);
+    }
+    else
+    {
+        request.format = GL_RGBA;
+        request.type = GL_FLOAT;
+        request.bytesPerPixel = 4 * sizeof(float);
+    }
+    readback.ReadTexture((GLuint)texture->GetRawResource(), request);
+}
+
+void FrameCapture::CaptureFrame(int width, int height, int renderWidth, int renderHeight, pxr::UsdImagingGLEngine *engine, pxr::UsdImagingGLEngine *idEngine)
+{
+    if (!IsEnabled() || IsComplete())
+        return;
+
+    // the composited frame straight out of the back buffer
+    AsyncReadback::Request request;
+    request.name = "frame";
+    request.frame = framesCaptured;
+    request.width = width;
+    request.height = height;
+    request.format = GL_RGBA;
+    request.type = GL_UNSIGNED_BYTE;
+    request.bytesPerPixel = 4;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    readback.ReadFramebuffer(request);
+
+    if (settings.aovs)
+    {
+        ReadAov(engine, pxr::HdAovTokens->color, "color", renderWidth, renderHeight);
+        ReadAov(engine, pxr::HdAovTokens->depth, "depth", renderWidth, renderHeight);
+        ReadAov(idEngine, pxr::HdAovTokens->primId, "primId", renderWidth, renderHeight);
+    }
+
+    framesCaptured++;
+}
+
+void FrameCapture::Update()
+{
+    if (!encoders)
+        return;
+    readback.Poll([this](AsyncReadback::Result &result) { Encode(result); });
+}
+
+void FrameCapture::Encode(AsyncReadback::Result &result)
+{
+    // std::function needs something copyable to carry the pixels over to the worker
+    auto image = std::make_shared<AsyncReadback::Result>(std::move(result));
+    std::string directory = settings.directory;
+
+    encoders->Submit([this, image, directory]()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        const auto &request = image->request;
+
+        pxr::HioImage::StorageSpec storage;
+        storage.width = request.width;
+        storage.height = request.height;
+        storage.depth = 1;
+        storage.flipped = true;     // GL rows come back bottom first
+        storage.data = image->pixels.data();
+
+        const char *extension = ".exr";
+        if (request.type == GL_UNSIGNED_BYTE)
+        {
+            storage.format = pxr::HioFormatUNorm8Vec4;
+            extension = ".png";
+        }
+        else if (request.format == GL_RED_INTEGER)
+        {
+            // EXR has no signed integer channels, ids up to 2^24 survive the trip through a float exactly
+            int32_t *ids = (int32_t *)image->pixels.data();
+            float *values = (float *)image->pixels.data();
+            for (size_t i = 0; i < (size_t)request.width * (size_t)request.height; ++i)
+                values[i] = (float)ids[i];
+            storage.format = pxr::HioFormatFloat32;
+        }
+        else if (request.format == GL_DEPTH_COMPONENT)
+            storage.format = pxr::HioFormatFloat32;
+        else
+            storage.format = pxr::HioFormatFloat32Vec4;
+
+        char filename[64];
+        snprintf(filename, sizeof(filename), ".%04llu", (unsigned long long)request.frame);
+        std::string path = directory + "/" + request.name + filename + extension;
+
+        auto writer = pxr::HioImage::OpenForWriting(path);
+        if (!writer || !writer->Write(storage))
+        {
+            std::cerr << "Unable to write " << path << std::endl;
+            encodeFailures++;
+        }
+        else
+            imagesWritten++;
+
+        encodeMicroseconds += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    });
+}
+
+void FrameCapture::Finish(std::ostream &out)
+{
+    if (!encoders)
+        return;
+
+    readback.Poll([this](AsyncReadback::Result &result) { Encode(result); }, true);
+    encoders->Wait();
+
+    uint64_t written = imagesWritten;
+    out << "Captured " << framesCaptured << " frames, " << written << " images written";
+    if (encodeFailures > 0)
+        out << " (" << encodeFailures << " failed)";
+    out << std::endl;
+    out << "    readback  " << readback.GetBytesRead() / (1024 * 1024) << " MiB through " << readback.GetSlotCount()
+        << " buffers, " << readback.GetStallCount() << " stalls" << std::endl;
+    out << "    encoding  " << (written > 0 ? (double)encodeMicroseconds / 1000.0 / (double)written : 0.0) << " ms per image on "
+        << encoders->GetThreadCount() << " threads, render loop waited on the encoders " << encoders->GetBlockedCount() << " times" << std::endl;
+
+    readback.Release();
+    encoders.reset();
+}
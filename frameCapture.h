@@ -0,0 +1,67 @@
+#pragma once
+
+#include "asyncReadback.h"
+#include "workerPool.h"
+
+#include <pxr/pxr.h>
+#include <pxr/usdImaging/usdImagingGL/engine.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <iostream>
+#include <string>
+
+struct CaptureSettings
+{
+    CaptureSettings()
+        : aovs(false), frameCount(0), encoderThreads(0)
+    {}
+
+    // where the numbered images go, empty disables capture
+    std::string directory;
+    // also write the raw color, depth and prim id aovs as EXRs next to the composited PNGs
+    bool aovs;
+    // stop after this many frames (0 captures until the window is closed)
+    uint64_t frameCount;
+    // 0 encodes on the work library's threads, within the same limit as USD
+    size_t encoderThreads;
+};
+
+// writes every frame, and optionally the aovs behind it, to a numbered image sequence
+//
+// pixels come back through an AsyncReadback ring and are encoded on a worker pool so capturing doesn't slow the
+// render loop down. all the Capture/Update/Finish calls have to come from the thread that owns the GL context
+class FrameCapture
+{
+public:
+    FrameCapture();
+    virtual ~FrameCapture();
+
+    void Configure(const CaptureSettings &captureSettings);
+    bool IsEnabled() { return !settings.directory.empty(); }
+    // the aovs need a prim id engine of their own
+    bool CapturesAovs() { return IsEnabled() && settings.aovs; }
+    // true once frameCount frames have been queued
+    bool IsComplete() { return settings.frameCount > 0 && framesCaptured >= settings.frameCount; }
+
+    // queue readbacks of the composited frame (the bound back buffer, width x height) and the engines' aovs, cropped
+    // to the renderWidth x renderHeight corner Hydra drew into. idEngine is the engine rendering the prim id aov and
+    // may be null
+    void CaptureFrame(int width, int height, int renderWidth, int renderHeight, pxr::UsdImagingGLEngine *engine, pxr::UsdImagingGLEngine *idEngine);
+    // hand finished readbacks to the encoders, once a frame
+    void Update();
+    // wait for every readback and encode, then print a summary
+    void Finish(std::ostream &out);
+
+protected:
+    void ReadAov(pxr::UsdImagingGLEngine *engine, const pxr::TfToken &aov, const std::string &name, int width, int height);
+    void Encode(AsyncReadback::Result &result);
+
+    CaptureSettings settings;
+    AsyncReadback readback;
+    std::unique_ptr<WorkerPool> encoders;
+
+    uint64_t framesCaptured;
+    std::atomic<uint64_t> imagesWritten, encodeFailures, encodeMicroseconds;
+};
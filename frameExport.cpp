@@ -0,0 +1,158 @@
+#include "frameExport.h"
+
+#include <GL/glew.h>
+
+#include <pxr/imaging/hd/aov.h>
+#include <pxr/imaging/hgi/texture.h>
+
+#include <algorithm>
+#include <cstring>
+
+FrameExport::FrameExport()
+    : readback(8), published(0), skipped(0), totalLatencyMs(0.0), maxLatencyMs(0.0)
+{
+}
+
+FrameExport::~FrameExport()
+{
+}
+
+bool FrameExport::Configure(const ExportSettings &exportSettings)
+{
+    settings = exportSettings;
+    writer.Close();
+    if (settings.name.empty())
+        return false;
+
+    // shm_open names start with a slash
+    std::string name = settings.name[0] == '/' ? settings.name : "/" + settings.name;
+    if (!writer.Create(name, settings.slots, settings.maxWidth, settings.maxHeight))
+        return false;
+
+    std::cout << "Exporting frames to shared memory " << name << " (" << settings.slots << " slots of up to "
+              << settings.maxWidth << "x" << settings.maxHeight << ")" << std::endl;
+    return true;
+}
+
+void FrameExport::ExportFrame(uint64_t frame, int width, int height, int renderWidth, int renderHeight, pxr::UsdImagingGLEngine *engine)
+{
+    if (!IsEnabled())
+        return;
+
+    PendingFrame pendingFrame;
+    pendingFrame.frame = frame;
+    pendingFrame.renderTimeNs = SharedFrameWriter::NowNs();
+    pendingFrame.width = width;
+    pendingFrame.height = height;
+    pendingFrame.depthWidth = 0;
+    pendingFrame.depthHeight = 0;
+    pendingFrame.partsRemaining = 0;
+    pendingFrame.started = false;
+    pendingFrame.open = false;
+    pendingFrame.color = nullptr;
+    pendingFrame.depth = nullptr;
+
+    AsyncReadback::Request request;
+    request.name = "color";
+    request.frame = frame;
+    request.width = width;
+    request.height = height;
+    request.format = GL_RGBA;
+    request.type = GL_UNSIGNED_BYTE;
+    request.bytesPerPixel = 4;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    if (readback.ReadFramebuffer(request))
+        pendingFrame.partsRemaining++;
+
+    auto depthTexture = settings.depth && engine ? engine->GetAovTexture(pxr::HdAovTokens->depth) : pxr::HgiTextureHandle();
+    if (depthTexture)
+    {
+        // the buffers are kept larger than the frame, anything past the rendered corner is left over from before
+        auto dimensions = depthTexture->GetDescriptor().dimensions;
+        request.name = "depth";
+        request.width = std::min(renderWidth, dimensions[0]);
+        request.height = std::min(renderHeight, dimensions[1]);
+        request.format = GL_DEPTH_COMPONENT;
+        request.type = GL_FLOAT;
+        request.bytesPerPixel = sizeof(float);
+        if (readback.ReadTexture((GLuint)depthTexture->GetRawResource(), request))
+        {
+            pendingFrame.depthWidth = request.width;
+            pendingFrame.depthHeight = request.height;
+            pendingFrame.partsRemaining++;
+        }
+    }
+
+    if (pendingFrame.partsRemaining > 0)
+        pending.push_back(pendingFrame);
+}
+
+void FrameExport::Receive(const AsyncReadback::Request &request, const uint8_t *pixels)
+{
+    // a frame that was abandoned (or never started) can't match anything anymore
+    while (!pending.empty() && pending.front().frame < request.frame)
+        pending.pop_front();
+    if (pending.empty() || pending.front().frame != request.frame)
+        return;
+
+    PendingFrame &frame = pending.front();
+    if (!frame.started)
+    {
+        frame.started = true;
+        uint8_t *color = nullptr;
+        float *depth = nullptr;
+        frame.open = writer.Begin(frame.frame, frame.renderTimeNs, (uint32_t)frame.width, (uint32_t)frame.height,
+                                  (uint32_t)frame.depthWidth, (uint32_t)frame.depthHeight, &color, &depth);
+        frame.color = color;
+        frame.depth = depth;
+        if (!frame.open)
+            skipped++;
+    }
+
+    size_t bytes = (size_t)request.width * (size_t)request.height * request.bytesPerPixel;
+    if (frame.open)
+    {
+        if (request.format == GL_DEPTH_COMPONENT)
+            std::memcpy(frame.depth, pixels, bytes);
+        else
+            std::memcpy(frame.color, pixels, bytes);
+    }
+
+    if (--frame.partsRemaining > 0)
+        return;
+
+    if (frame.open)
+    {
+        writer.Publish();
+        double latencyMs = (double)(SharedFrameWriter::NowNs() - frame.renderTimeNs) / 1000000.0;
+        totalLatencyMs += latencyMs;
+        maxLatencyMs = std::max(maxLatencyMs, latencyMs);
+        published++;
+    }
+    pending.pop_front();
+}
+
+void FrameExport::Update()
+{
+    if (!IsEnabled())
+        return;
+    readback.PollMapped([this](const AsyncReadback::Request &request, const uint8_t *pixels) { Receive(request, pixels); });
+}
+
+void FrameExport::Finish(std::ostream &out)
+{
+    if (!IsEnabled())
+        return;
+
+    readback.PollMapped([this](const AsyncReadback::Request &request, const uint8_t *pixels) { Receive(request, pixels); }, true);
+
+    auto *header = writer.GetHeader();
+    out << "Exported " << published << " frames to " << writer.GetName() << ", latency " << GetAverageLatencyMs() << " ms average, "
+        << maxLatencyMs << " ms max" << std::endl;
+    out << "    writer    " << skipped << " skipped (" << header->oversized << " too large), " << readback.GetStallCount() << " readback stalls" << std::endl;
+    out << "    readers   " << header->consumed << " consumed, " << header->dropped << " dropped, " << header->torn << " torn reads" << std::endl;
+
+    readback.Release();
+    writer.Close();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "asyncReadback.h"
+#include "sharedFrameRing.h"
+
+#include <pxr/pxr.h>
+#include <pxr/usdImaging/usdImagingGL/engine.h>
+
+#include <deque>
+#include <iostream>
+#include <string>
+
+struct ExportSettings
+{
+    ExportSettings()
+        : slots(3), maxWidth(3840), maxHeight(2160), depth(true)
+    {}
+
+    // shared memory object name, empty disables the export
+    std::string name;
+    uint32_t slots;
+    uint32_t maxWidth, maxHeight;
+    // publish the primary depth aov alongside the composite
+    bool depth;
+};
+
+// publishes the composited frame, and the depth behind it, into a SharedFrameWriter ring every frame so a local
+// process can pick them up without copying
+//
+// the pixels come back through AsyncReadback and are copied from the mapped pack buffer straight into the ring,
+// nothing here ever waits on a reader
+class FrameExport
+{
+public:
+    FrameExport();
+    virtual ~FrameExport();
+
+    bool Configure(const ExportSettings &exportSettings);
+    bool IsEnabled() { return writer.IsOpen(); }
+
+    // queue readbacks of the bound back buffer (width x height) and the engine's depth aov, of which only the
+    // renderWidth x renderHeight corner was rendered this frame
+    void ExportFrame(uint64_t frame, int width, int height, int renderWidth, int renderHeight, pxr::UsdImagingGLEngine *engine);
+    // copy whatever has landed into the ring and publish completed frames, once a frame
+    void Update();
+    void Finish(std::ostream &out);
+
+    uint64_t GetPublishedCount() { return published; }
+    double GetAverageLatencyMs() { return published > 0 ? totalLatencyMs / (double)published : 0.0; }
+    double GetMaxLatencyMs() { return maxLatencyMs; }
+
+protected:
+    // a frame whose readbacks are in flight, frames complete in the order they were queued
+    struct PendingFrame
+    {
+        uint64_t frame;
+        uint64_t renderTimeNs;
+        int width, height;
+        int depthWidth, depthHeight;
+        int partsRemaining;
+        bool started;       // the first part has arrived and a slot was asked for
+        bool open;          // and Begin succeeded, pixels go into the ring
+        uint8_t *color;
+        float *depth;
+    };
+
+    void Receive(const AsyncReadback::Request &request, const uint8_t *pixels);
+
+    ExportSettings settings;
+    AsyncReadback readback;
+    SharedFrameWriter writer;
+    std::deque<PendingFrame> pending;
+
+    uint64_t published;
+    uint64_t skipped;
+    double totalLatencyMs, maxLatencyMs;
+};
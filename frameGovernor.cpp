@@ -0,0 +1,113 @@
+#include <GL/glew.h>
+#include "frameGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+// how far over/under budget we have to be before the scale changes
+static const double s_overBudget = 1.05;
+static const double s_underBudget = 0.75;
+// frames to wait after a change so the average reflects the new resolution
+static const int s_settleFrames = 8;
+// scales are snapped to this step so the render buffers aren't reallocated every frame
+static const float s_scaleStep = 1.f / 32.f;
+
+FrameGovernor::FrameGovernor()
+    :
+    budget(0.0),
+    minScale(0.25f),
+    scale(1.f),
+    cpuMs(0.0),
+    gpuMs(0.0),
+    averageMs(0.0),
+    framesSinceAdjust(0),
+    queryIndex(0),
+    queriesCreated(false)
+{
+    for (int i = 0; i < QUERY_COUNT; ++i)
+    {
+        queries[i] = 0;
+        queryPending[i] = false;
+    }
+}
+
+FrameGovernor::~FrameGovernor()
+{
+    if (queriesCreated)
+        glDeleteQueries(QUERY_COUNT, queries);
+}
+
+void FrameGovernor::BeginFrame()
+{
+    if (!queriesCreated)
+    {
+        glGenQueries(QUERY_COUNT, queries);
+        queriesCreated = true;
+    }
+
+    frameStart = std::chrono::high_resolution_clock::now();
+
+    // the oldest query in the ring is the one we're about to reuse, collect it if it has landed
+    GLuint query = queries[queryIndex];
+    if (queryPending[queryIndex])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            gpuMs = (double)elapsed / 1.0e6;
+        }
+        queryPending[queryIndex] = false;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void FrameGovernor::EndFrame()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    queryPending[queryIndex] = true;
+    queryIndex = (queryIndex + 1) % QUERY_COUNT;
+
+    auto frameEnd = std::chrono::high_resolution_clock::now();
+    cpuMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+
+    double frameMs = std::max(cpuMs, gpuMs);
+    averageMs = averageMs == 0.0 ? frameMs : averageMs + (frameMs - averageMs) * 0.2;
+
+    Adjust();
+}
+
+void FrameGovernor::Adjust()
+{
+    if (budget <= 0.0)
+    {
+        scale = 1.f;
+        return;
+    }
+
+    if (++framesSinceAdjust < s_settleFrames)
+        return;
+
+    float newScale = scale;
+    if (averageMs > budget * s_overBudget)
+    {
+        // cost is roughly proportional to pixel count so scale each axis by the square root
+        newScale = scale * (float)std::sqrt(budget / averageMs);
+        newScale = std::floor(newScale / s_scaleStep) * s_scaleStep;
+    }
+    else if (averageMs < budget * s_underBudget && scale < 1.f)
+    {
+        // creep back up slowly, overshooting costs a visible hitch
+        newScale = std::round((scale + 2.f * s_scaleStep) / s_scaleStep) * s_scaleStep;
+    }
+
+    newScale = std::min(1.f, std::max(minScale, newScale));
+    if (newScale != scale)
+    {
+        scale = newScale;
+        framesSinceAdjust = 0;
+    }
+}
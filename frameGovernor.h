@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+
+// scales the Hydra render buffer resolution to hold a frame time budget
+//
+// frame cost is the larger of the CPU time spent issuing the frame and the GPU time measured with
+// timer queries (read back a few frames late so we never wait on the GPU)
+class FrameGovernor
+{
+public:
+    FrameGovernor();
+    virtual ~FrameGovernor();
+
+    // budget in milliseconds, 0 disables scaling and renders at full resolution
+    void SetBudget(double budgetMs) { budget = budgetMs; }
+    double GetBudget() { return budget; }
+    void SetMinScale(float scale) { minScale = scale; }
+
+    void BeginFrame();
+    void EndFrame();
+
+    float GetScale() { return scale; }
+    double GetCpuMs() { return cpuMs; }
+    double GetGpuMs() { return gpuMs; }
+    double GetFrameMs() { return averageMs; }
+
+protected:
+    void Adjust();
+
+    enum { QUERY_COUNT = 4 };
+
+    double budget;
+    float minScale;
+    float scale;
+
+    double cpuMs, gpuMs, averageMs;
+    int framesSinceAdjust;
+
+    std::chrono::high_resolution_clock::time_point frameStart;
+
+    unsigned int queries[QUERY_COUNT];
+    bool queryPending[QUERY_COUNT];
+    int queryIndex;
+    bool queriesCreated;
+};
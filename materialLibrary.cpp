@@ -0,0 +1,60 @@
+#include "materialLibrary.h"
+#include "scene.h"
+
+#include <pxr/base/arch/hash.h>
+#include <pxr/usd/usdGeom/scope.h>
+#include <pxr/usd/usdShade/materialBindingAPI.h>
+
+#include <cstdio>
+#include <cstring>
+
+MaterialLibrary::MaterialLibrary(pxr::UsdStageRefPtr stg, const pxr::SdfPath &scope)
+    : stage(stg), scopePath(scope), requests(0)
+{
+}
+
+std::string MaterialLibrary::MakeKey(const float roughness, const float metallic, const std::string &textureFile)
+{
+    // compare the float bits exactly, two materials that differ in the last place are still different materials
+    uint32_t roughnessBits, metallicBits;
+    std::memcpy(&roughnessBits, &roughness, sizeof(float));
+    std::memcpy(&metallicBits, &metallic, sizeof(float));
+
+    char params[32];
+    snprintf(params, sizeof(params), "%08x:%08x:", roughnessBits, metallicBits);
+    return params + textureFile;
+}
+
+pxr::UsdShadeMaterial MaterialLibrary::Get(const float roughness, const float metallic, const std::string &textureFile)
+{
+    requests++;
+
+    auto key = MakeKey(roughness, metallic, textureFile);
+    auto it = materials.find(key);
+    if (it != materials.end())
+        return it->second;
+
+    if (materials.empty())
+        pxr::UsdGeomScope::Define(stage, scopePath);
+
+    // name the material after the hash of its key so the same parameters get the same path in every layer
+    char name[32];
+    snprintf(name, sizeof(name), "PBR_%016llx", (unsigned long long)pxr::ArchHash64(key.data(), key.size()));
+    auto material = createPBRMaterial(stage, scopePath.AppendChild(pxr::TfToken(name)), roughness, metallic, textureFile);
+
+    materials[key] = material;
+    return material;
+}
+
+pxr::UsdShadeMaterial MaterialLibrary::Bind(pxr::UsdGeomMesh &mesh, const float roughness, const float metallic, const std::string &textureFile)
+{
+    auto material = Get(roughness, metallic, textureFile);
+    pxr::UsdShadeMaterialBindingAPI(mesh).Bind(material);
+    return material;
+}
+
+void MaterialLibrary::PrintReport(std::ostream &out)
+{
+    out << "Material library " << scopePath.GetString() << ": " << GetRequestCount() << " requested, "
+        << GetUniqueCount() << " authored, " << GetCollapsedCount() << " collapsed" << std::endl;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/usdShade/material.h>
+
+#include <iostream>
+#include <map>
+#include <string>
+
+// authors each unique PBR material once under a shared scope and binds meshes to it
+//
+// materials are keyed on their shader parameters and texture asset, so ten thousand meshes with the same
+// roughness/metallic/texture end up bound to one material and Storm can batch their draws
+class MaterialLibrary
+{
+public:
+    MaterialLibrary(pxr::UsdStageRefPtr stage, const pxr::SdfPath &scopePath = pxr::SdfPath("/Materials"));
+
+    // find or author the material for these parameters
+    pxr::UsdShadeMaterial Get(const float roughness, const float metallic, const std::string &textureFile);
+    // find or author the material and bind it to the mesh
+    pxr::UsdShadeMaterial Bind(pxr::UsdGeomMesh &mesh, const float roughness, const float metallic, const std::string &textureFile);
+
+    size_t GetRequestCount() { return requests; }
+    size_t GetUniqueCount() { return materials.size(); }
+    // requests that were satisfied by an existing material
+    size_t GetCollapsedCount() { return requests - materials.size(); }
+
+    void PrintReport(std::ostream &out);
+
+protected:
+    static std::string MakeKey(const float roughness, const float metallic, const std::string &textureFile);
+
+    pxr::UsdStageRefPtr stage;
+    pxr::SdfPath scopePath;
+    std::map<std::string, pxr::UsdShadeMaterial> materials;
+    size_t requests;
+};
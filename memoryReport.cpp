@@ -0,0 +1,263 @@
+#include "memoryReport.h"
+
+#include <pxr/base/tf/mallocTag.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/base/vt/types.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/schema.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/usdGeom/pointBased.h>
+#include <pxr/usd/usdGeom/primvarsAPI.h>
+#include <pxr/imaging/hd/aov.h>
+#include <pxr/imaging/hgi/texture.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    std::string FormatBytes(size_t bytes)
+    {
+        std::ostringstream str;
+        if (bytes >= (size_t(1) << 30))
+            str << std::fixed << std::setprecision(2) << (double)bytes / (double)(size_t(1) << 30) << " GiB";
+        else if (bytes >= (size_t(1) << 20))
+            str << std::fixed << std::setprecision(2) << (double)bytes / (double)(size_t(1) << 20) << " MiB";
+        else if (bytes >= (size_t(1) << 10))
+            str << std::fixed << std::setprecision(2) << (double)bytes / (double)(size_t(1) << 10) << " KiB";
+        else
+            str << bytes << " B";
+        return str.str();
+    }
+
+    template <typename T>
+    bool ArrayBytes(const pxr::VtValue &value, size_t &bytes)
+    {
+        if (!value.IsHolding<pxr::VtArray<T>>())
+            return false;
+        bytes = value.UncheckedGet<pxr::VtArray<T>>().size() * sizeof(T);
+        return true;
+    }
+}
+
+bool EnableMallocTags()
+{
+    if (pxr::TfMallocTag::IsInitialized())
+        return true;
+
+    std::string errMsg;
+    if (!pxr::TfMallocTag::Initialize(&errMsg))
+    {
+        std::cerr << "Unable to enable malloc tags: " << errMsg << std::endl;
+        return false;
+    }
+    return true;
+}
+
+size_t EstimateValueBytes(const pxr::VtValue &value)
+{
+    if (value.IsEmpty())
+        return 0;
+
+    if (!value.IsArrayValued())
+        return value.IsHolding<std::string>() ? value.UncheckedGet<std::string>().size() : sizeof(double);
+
+    size_t bytes = 0;
+    if (ArrayBytes<pxr::GfVec3f>(value, bytes) ||
+        ArrayBytes<pxr::GfVec2f>(value, bytes) ||
+        ArrayBytes<pxr::GfVec4f>(value, bytes) ||
+        ArrayBytes<pxr::GfVec3d>(value, bytes) ||
+        ArrayBytes<pxr::GfVec3h>(value, bytes) ||
+        ArrayBytes<pxr::GfVec2h>(value, bytes) ||
+        ArrayBytes<pxr::GfMatrix4d>(value, bytes) ||
+        ArrayBytes<pxr::GfQuath>(value, bytes) ||
+        ArrayBytes<pxr::GfQuatf>(value, bytes) ||
+        ArrayBytes<float>(value, bytes) ||
+        ArrayBytes<double>(value, bytes) ||
+        ArrayBytes<pxr::GfHalf>(value, bytes) ||
+        ArrayBytes<int>(value, bytes) ||
+        ArrayBytes<unsigned int>(value, bytes) ||
+        ArrayBytes<int64_t>(value, bytes) ||
+        ArrayBytes<uint64_t>(value, bytes) ||
+        ArrayBytes<unsigned char>(value, bytes) ||
+        ArrayBytes<pxr::TfToken>(value, bytes))
+        return bytes;
+
+    // unknown element type, assume a float per element
+    return value.GetArraySize() * sizeof(float);
+}
+
+size_t EstimatePrimGpuBytes(const pxr::UsdPrim &prim)
+{
+    if (!prim.IsA<pxr::UsdGeomPointBased>())
+        return 0;
+
+    auto time = pxr::UsdTimeCode::EarliestTime();
+    size_t bytes = 0;
+    pxr::VtValue value;
+
+    pxr::UsdGeomPointBased pointBased(prim);
+    if (pointBased.GetPointsAttr().Get(&value, time))
+        bytes += EstimateValueBytes(value);
+    if (pointBased.GetNormalsAttr().Get(&value, time))
+        bytes += EstimateValueBytes(value);
+
+    for (const auto &primvar : pxr::UsdGeomPrimvarsAPI(prim).GetPrimvarsWithValues())
+    {
+        if (primvar.Get(&value, time))
+            bytes += EstimateValueBytes(value);
+    }
+
+    // Storm draws triangles so count the triangulated index buffer rather than the authored one
+    if (prim.IsA<pxr::UsdGeomMesh>())
+    {
+        pxr::VtArray<int> faceVertexCounts;
+        pxr::UsdGeomMesh(prim).GetFaceVertexCountsAttr().Get(&faceVertexCounts, time);
+        size_t triangles = 0;
+        for (auto count : faceVertexCounts)
+            triangles += count > 2 ? (size_t)(count - 2) : 0;
+        bytes += triangles * 3 * sizeof(int);
+    }
+
+    return bytes;
+}
+
+void CollectStageMemory(const pxr::UsdStageRefPtr &stage, size_t topN, MemoryReport &report)
+{
+    report.mallocTagsEnabled = pxr::TfMallocTag::IsInitialized();
+    if (report.mallocTagsEnabled)
+    {
+        report.mallocTotalBytes = pxr::TfMallocTag::GetTotalBytes();
+
+        pxr::TfMallocTag::CallTree tree;
+        if (pxr::TfMallocTag::GetCallTree(&tree))
+        {
+            for (const auto &site : tree.callSites)
+                report.mallocSites.emplace_back(site.name, site.nBytes);
+            std::sort(report.mallocSites.begin(), report.mallocSites.end(),
+                [](const std::pair<std::string, size_t> &a, const std::pair<std::string, size_t> &b) { return a.second > b.second; });
+            if (report.mallocSites.size() > topN)
+                report.mallocSites.resize(topN);
+        }
+    }
+
+    if (!stage)
+        return;
+
+    // walk every spec in every layer used by the stage and add up the values (defaults and time samples)
+    for (const auto &layer : stage->GetUsedLayers())
+    {
+        LayerMemoryReport layerReport;
+        layerReport.identifier = layer->GetIdentifier();
+        layer->Traverse(pxr::SdfPath::AbsoluteRootPath(), [&](const pxr::SdfPath &path)
+        {
+            layerReport.specs++;
+            if (!path.IsPropertyPath())
+                return;
+
+            layerReport.valueBytes += EstimateValueBytes(layer->GetField(path, pxr::SdfFieldKeys->Default));
+            for (double time : layer->ListTimeSamplesForPath(path))
+            {
+                pxr::VtValue sample;
+                if (layer->QueryTimeSample(path, time, &sample))
+                    layerReport.valueBytes += EstimateValueBytes(sample);
+            }
+        });
+        report.layerBytes += layerReport.valueBytes;
+        report.layers.push_back(layerReport);
+    }
+    std::sort(report.layers.begin(), report.layers.end(),
+        [](const LayerMemoryReport &a, const LayerMemoryReport &b) { return a.valueBytes > b.valueBytes; });
+
+    // estimate what each prim costs once its buffers are uploaded
+    std::vector<PrimMemoryEstimate> prims;
+    for (const auto &prim : stage->Traverse())
+    {
+        size_t bytes = EstimatePrimGpuBytes(prim);
+        if (bytes == 0)
+            continue;
+        report.primBytes += bytes;
+        prims.push_back({prim.GetPath(), bytes});
+    }
+
+    size_t count = std::min(topN, prims.size());
+    std::partial_sort(prims.begin(), prims.begin() + count, prims.end(),
+        [](const PrimMemoryEstimate &a, const PrimMemoryEstimate &b) { return a.bytes > b.bytes; });
+    prims.resize(count);
+    report.topPrims = prims;
+}
+
+void CollectEngineMemory(const std::string &name, pxr::UsdImagingGLEngine *engine, MemoryReport &report)
+{
+    if (!engine)
+        return;
+
+    EngineMemoryReport engineReport;
+    engineReport.name = name;
+
+    // render buffers the engine allocated for its aovs
+    for (const auto &aov : { pxr::HdAovTokens->color, pxr::HdAovTokens->depth, pxr::HdAovTokens->primId })
+    {
+        auto texture = engine->GetAovTexture(aov);
+        if (!texture)
+            continue;
+        size_t bytes = texture->GetByteSizeOfResource();
+        engineReport.aovs[aov.GetString()] = bytes;
+        engineReport.aovBytes += bytes;
+    }
+
+    // the render delegate reports its resource registry allocations by buffer role
+    auto stats = engine->GetRenderStats();
+    for (const auto &it : stats)
+    {
+        if (!it.second.IsHolding<size_t>())
+            continue;
+        size_t bytes = it.second.UncheckedGet<size_t>();
+        if (it.first == "gpuMemoryUsed")
+            engineReport.gpuMemoryUsed = bytes;
+        else if (it.first == "textureMemory")
+            engineReport.textureMemory = bytes;
+        else
+            engineReport.resources[it.first] = bytes;
+    }
+
+    report.engines.push_back(engineReport);
+}
+
+void PrintMemoryReport(const MemoryReport &report, std::ostream &out)
+{
+    out << "==== Memory Report ====" << std::endl;
+
+    if (report.mallocTagsEnabled)
+    {
+        out << "Heap (malloc tags): " << FormatBytes(report.mallocTotalBytes) << std::endl;
+        for (const auto &site : report.mallocSites)
+            out << "    " << std::setw(12) << FormatBytes(site.second) << "  " << site.first << std::endl;
+    }
+    else
+        out << "Heap (malloc tags): disabled, run with --memory-report to enable" << std::endl;
+
+    out << "Layer values: " << FormatBytes(report.layerBytes) << " in " << report.layers.size() << " layers" << std::endl;
+    for (const auto &layer : report.layers)
+        out << "    " << std::setw(12) << FormatBytes(layer.valueBytes) << "  " << layer.specs << " specs  " << layer.identifier << std::endl;
+
+    for (const auto &engine : report.engines)
+    {
+        out << "Engine " << engine.name << ":" << std::endl;
+        out << "    gpu memory used  " << FormatBytes(engine.gpuMemoryUsed) << std::endl;
+        out << "    texture memory   " << FormatBytes(engine.textureMemory) << std::endl;
+        out << "    render buffers   " << FormatBytes(engine.aovBytes) << std::endl;
+        for (const auto &aov : engine.aovs)
+            out << "        " << std::setw(12) << FormatBytes(aov.second) << "  " << aov.first << std::endl;
+        out << "    resource registry" << std::endl;
+        for (const auto &resource : engine.resources)
+            out << "        " << std::setw(12) << FormatBytes(resource.second) << "  " << resource.first << std::endl;
+    }
+
+    out << "Prim geometry (estimated GPU): " << FormatBytes(report.primBytes) << std::endl;
+    for (const auto &prim : report.topPrims)
+        out << "    " << std::setw(12) << FormatBytes(prim.bytes) << "  " << prim.path.GetString() << std::endl;
+
+    out << "=======================" << std::endl;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/base/vt/value.h>
+#include <pxr/usdImaging/usdImagingGL/engine.h>
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// memory used by a single UsdImagingGLEngine
+struct EngineMemoryReport
+{
+    EngineMemoryReport()
+        : aovBytes(0), gpuMemoryUsed(0), textureMemory(0)
+    {}
+
+    std::string name;
+    size_t aovBytes;
+    size_t gpuMemoryUsed;
+    size_t textureMemory;
+    std::map<std::string, size_t> aovs;          // aov name -> bytes
+    std::map<std::string, size_t> resources;     // resource registry allocation by buffer type
+};
+
+struct LayerMemoryReport
+{
+    LayerMemoryReport()
+        : specs(0), valueBytes(0)
+    {}
+
+    std::string identifier;
+    size_t specs;
+    size_t valueBytes;
+};
+
+struct PrimMemoryEstimate
+{
+    pxr::SdfPath path;
+    size_t bytes;
+};
+
+struct MemoryReport
+{
+    MemoryReport()
+        : mallocTagsEnabled(false), mallocTotalBytes(0), layerBytes(0), primBytes(0)
+    {}
+
+    bool mallocTagsEnabled;
+    size_t mallocTotalBytes;
+    std::vector<std::pair<std::string, size_t>> mallocSites;
+
+    size_t layerBytes;
+    std::vector<LayerMemoryReport> layers;
+
+    std::vector<EngineMemoryReport> engines;
+
+    size_t primBytes;
+    std::vector<PrimMemoryEstimate> topPrims;
+};
+
+// enable TfMallocTag accounting, must be called before the stage is created to be meaningful
+bool EnableMallocTags();
+
+// estimate the number of bytes held by a value (arrays of the common geometry types)
+size_t EstimateValueBytes(const pxr::VtValue &value);
+
+// estimate the GPU buffer footprint of a prim's geometry (points, primvars and triangulated indices)
+size_t EstimatePrimGpuBytes(const pxr::UsdPrim &prim);
+
+void CollectStageMemory(const pxr::UsdStageRefPtr &stage, size_t topN, MemoryReport &report);
+void CollectEngineMemory(const std::string &name, pxr::UsdImagingGLEngine *engine, MemoryReport &report);
+void PrintMemoryReport(const MemoryReport &report, std::ostream &out);
@@ -0,0 +1,245 @@
+#include "meshLod.h"
+
+#include <pxr/base/gf/range3d.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/usd/editContext.h>
+#include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usd/variantSets.h>
+#include <pxr/usd/usdGeom/bboxCache.h>
+#include <pxr/usd/usdGeom/primvarsAPI.h>
+#include <pxr/usd/usdGeom/xformCache.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    const pxr::TfToken lodVariantSet("LOD");
+    const pxr::TfToken lodErrorsKey("lod:errors");
+    const pxr::TfToken stToken("st");
+
+    size_t TriangleCount(const MeshBuffers &buffers)
+    {
+        size_t triangles = 0;
+        for (int count : buffers.faceVertexCounts)
+            triangles += count > 2 ? count - 2 : 0;
+        return triangles;
+    }
+
+    // author one level's geometry at the current edit target
+    void AuthorLevel(pxr::UsdGeomMesh &mesh, const MeshBuffers &buffers)
+    {
+        mesh.CreatePointsAttr().Set(buffers.points);
+        mesh.CreateFaceVertexCountsAttr().Set(buffers.faceVertexCounts);
+        mesh.CreateFaceVertexIndicesAttr().Set(buffers.faceVertexIndices);
+
+        pxr::VtVec3fArray extent(2);
+        if (pxr::UsdGeomPointBased::ComputeExtent(buffers.points, &extent))
+            mesh.CreateExtentAttr().Set(extent);
+
+        if (!buffers.normals.empty())
+        {
+            mesh.CreateNormalsAttr().Set(buffers.normals);
+            if (!buffers.normalsInterpolation.IsEmpty())
+                mesh.SetNormalsInterpolation(buffers.normalsInterpolation);
+        }
+        if (!buffers.texCoords.empty())
+        {
+            auto interpolation = buffers.texCoordsInterpolation.IsEmpty() ? pxr::UsdGeomTokens->varying : buffers.texCoordsInterpolation;
+            pxr::UsdGeomPrimvarsAPI(mesh).CreatePrimvar(stToken, pxr::SdfValueTypeNames->TexCoord2fArray, interpolation).Set(buffers.texCoords);
+        }
+    }
+
+    // a local opinion on any layer of the stack beats the variants, not just one on the edit target, so clear the
+    // property wherever it was authored (sublayers from --author-layers included)
+    void ClearLocalOpinions(const pxr::UsdPrim &prim, const pxr::TfToken &name)
+    {
+        pxr::SdfPath propertyPath = prim.GetPath().AppendProperty(name);
+        for (const auto &layer : prim.GetStage()->GetLayerStack())
+        {
+            auto primSpec = layer->GetPrimAtPath(prim.GetPath());
+            auto propertySpec = layer->GetPropertyAtPath(propertyPath);
+            if (primSpec && propertySpec)
+                primSpec->RemoveProperty(propertySpec);
+        }
+    }
+
+    int VariantLevel(const std::string &name)
+    {
+        return name.compare(0, 3, "lod") == 0 ? std::atoi(name.c_str() + 3) : 0;
+    }
+}
+
+int AuthorMeshLODs(pxr::UsdGeomMesh &mesh, const MeshLodSettings &settings)
+{
+    auto prim = mesh.GetPrim();
+
+    MeshBuffers base;
+    mesh.GetPointsAttr().Get(&base.points);
+    mesh.GetFaceVertexCountsAttr().Get(&base.faceVertexCounts);
+    mesh.GetFaceVertexIndicesAttr().Get(&base.faceVertexIndices);
+    if (mesh.GetNormalsAttr().Get(&base.normals))
+        base.normalsInterpolation = mesh.GetNormalsInterpolation();
+    auto stPrimvar = pxr::UsdGeomPrimvarsAPI(prim).GetPrimvar(stToken);
+    if (stPrimvar && stPrimvar.Get(&base.texCoords))
+        base.texCoordsInterpolation = stPrimvar.GetInterpolation();
+    if (base.points.empty() || base.faceVertexIndices.empty())
+        return 0;
+
+    // the simplifier wants everything per point, weld face varying input first (lod0 keeps the original)
+    MeshBuffers current = base;
+    if (current.normalsInterpolation == pxr::UsdGeomTokens->faceVarying || current.texCoordsInterpolation == pxr::UsdGeomTokens->faceVarying)
+    {
+        if (!OptimizeMesh(current, MeshOptimizeSettings()))
+            return 0;
+    }
+
+    std::vector<MeshBuffers> levels(1, base);
+    std::vector<float> errors(1, 0.f);
+    for (int level = 1; level <= settings.levels; ++level)
+    {
+        size_t triangles = TriangleCount(current);
+        MeshSimplifySettings simplify;
+        simplify.targetTriangles = (size_t)((float)triangles * settings.reduction);
+        if (simplify.targetTriangles < settings.minTriangles)
+            break;
+
+        MeshBuffers simplified;
+        float error = 0.f;
+        if (!SimplifyMesh(current, simplify, simplified, error))
+            break;
+        // nothing left that can be collapsed without tearing a seam or flipping a face
+        if (TriangleCount(simplified) * 20 >= triangles * 19)
+            break;
+
+        OptimizeMesh(simplified, MeshOptimizeSettings());
+        levels.push_back(simplified);
+        // each level is simplified from the last so their errors add up
+        errors.push_back(errors.back() + error);
+        current = simplified;
+    }
+
+    // the variants can only decide what's drawn if there are no stronger local opinions on the geometry
+    {
+        pxr::SdfChangeBlock changeBlock;
+        for (const auto &name : { pxr::UsdGeomTokens->points, pxr::UsdGeomTokens->normals, pxr::UsdGeomTokens->faceVertexCounts,
+                                  pxr::UsdGeomTokens->faceVertexIndices, pxr::UsdGeomTokens->extent, pxr::TfToken("primvars:st") })
+            ClearLocalOpinions(prim, name);
+    }
+
+    auto variantSet = prim.GetVariantSets().AddVariantSet(lodVariantSet);
+    for (size_t level = 0; level < levels.size(); ++level)
+    {
+        std::string name = "lod" + std::to_string(level);
+        variantSet.AddVariant(name);
+        variantSet.SetVariantSelection(name);
+        pxr::UsdEditContext context(variantSet.GetVariantEditContext());
+        AuthorLevel(mesh, levels[level]);
+    }
+    variantSet.SetVariantSelection("lod0");
+
+    pxr::VtFloatArray errorArray;
+    for (float error : errors)
+        errorArray.push_back(error);
+    prim.SetCustomDataByKey(lodErrorsKey, pxr::VtValue(errorArray));
+
+    return (int)levels.size();
+}
+
+LodSelector::LodSelector()
+    : pixelThreshold(1.f), lastSwitches(0)
+{
+}
+
+void LodSelector::Collect(const pxr::UsdStageRefPtr &stage)
+{
+    prims.clear();
+    collectedStage = stage;
+    if (!stage)
+        return;
+
+    pxr::UsdGeomXformCache xformCache;
+    pxr::UsdGeomBBoxCache bboxCache(pxr::UsdTimeCode::Default(), { pxr::UsdGeomTokens->default_, pxr::UsdGeomTokens->render });
+    for (const auto &prim : stage->Traverse())
+    {
+        if (!prim.HasVariantSets() || !prim.GetVariantSets().HasVariantSet(lodVariantSet))
+            continue;
+        pxr::VtValue errorValue = prim.GetCustomDataByKey(lodErrorsKey);
+        if (!errorValue.IsHolding<pxr::VtFloatArray>())
+            continue;
+        const auto &errorArray = errorValue.UncheckedGet<pxr::VtFloatArray>();
+
+        auto variantSet = prim.GetVariantSets().GetVariantSet(lodVariantSet);
+        LodPrim lodPrim;
+        lodPrim.path = prim.GetPath();
+        lodPrim.variants = variantSet.GetVariantNames();
+        std::sort(lodPrim.variants.begin(), lodPrim.variants.end(), [](const std::string &a, const std::string &b) { return VariantLevel(a) < VariantLevel(b); });
+        if (lodPrim.variants.size() != errorArray.size())
+            continue;
+
+        // errors are recorded in object space, scale them by the largest axis of the prim's transform
+        pxr::GfMatrix4d toWorld = xformCache.GetLocalToWorldTransform(prim);
+        double scale = std::max(toWorld.GetRow3(0).GetLength(), std::max(toWorld.GetRow3(1).GetLength(), toWorld.GetRow3(2).GetLength()));
+        for (float error : errorArray)
+            lodPrim.errors.push_back((float)(error * scale));
+
+        pxr::GfRange3d bounds = bboxCache.ComputeWorldBound(prim).ComputeAlignedRange();
+        if (bounds.IsEmpty())
+            continue;
+        pxr::GfVec3d center = bounds.GetMidpoint();
+        lodPrim.center = glm::vec3((float)center[0], (float)center[1], (float)center[2]);
+        lodPrim.radius = (float)(0.5 * bounds.GetSize().GetLength());
+
+        std::string selection = variantSet.GetVariantSelection();
+        auto it = std::find(lodPrim.variants.begin(), lodPrim.variants.end(), selection);
+        lodPrim.selected = it == lodPrim.variants.end() ? -1 : (int)(it - lodPrim.variants.begin());
+
+        prims.push_back(lodPrim);
+    }
+
+    std::cout << "LOD selector found " << prims.size() << " prims with LOD variants" << std::endl;
+}
+
+void LodSelector::Update(const pxr::UsdStageRefPtr &stage, const glm::vec3 &eye, const glm::mat4 &projection, float viewportHeight)
+{
+    lastSwitches = 0;
+    if (!stage)
+        return;
+    if (pxr::get_pointer(collectedStage) != pxr::get_pointer(stage))
+        Collect(stage);
+    if (prims.empty())
+        return;
+
+    // pixels covered by one world unit at unit distance
+    float pixelsPerUnit = projection[1][1] * 0.5f * viewportHeight;
+
+    // selections are a viewing choice, keep them out of the layers that get saved. they're authored with Sdf
+    // inside one change block so a frame with many switches only recomposes once
+    auto sessionLayer = stage->GetSessionLayer();
+    pxr::SdfChangeBlock changeBlock;
+    for (auto &lodPrim : prims)
+    {
+        float distance = std::max(glm::length(eye - lodPrim.center) - lodPrim.radius, 1e-4f);
+
+        // coarsest level whose error still projects under the threshold
+        int level = 0;
+        for (size_t i = 1; i < lodPrim.errors.size(); ++i)
+        {
+            if (lodPrim.errors[i] * pixelsPerUnit / distance <= pixelThreshold)
+                level = (int)i;
+        }
+        if (level == lodPrim.selected)
+            continue;
+
+        auto primSpec = pxr::SdfCreatePrimInLayer(sessionLayer, lodPrim.path);
+        if (!primSpec)
+            continue;
+        primSpec->SetVariantSelection(lodVariantSet, lodPrim.variants[level]);
+        lodPrim.selected = level;
+        lastSwitches++;
+    }
+}
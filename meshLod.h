@@ -0,0 +1,71 @@
+#pragma once
+
+#include "meshSimplifier.h"
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct MeshLodSettings
+{
+    MeshLodSettings()
+        : levels(4), reduction(0.5f), minTriangles(8)
+    {}
+
+    // levels in addition to the full resolution lod0
+    int levels;
+    // each level keeps this fraction of the previous level's triangles
+    float reduction;
+    // don't generate levels smaller than this
+    size_t minTriangles;
+};
+
+// simplify a mesh authored by createMesh into an "LOD" variant set with variants lod0 (the original) to lodN
+//
+// the mesh's geometry attributes move into the variants, which are authored on the edit target, and are cleared on
+// every layer of the stack that held them so the selection decides what's drawn. each level's object space error
+// bound is recorded in the prim's customData under lod:errors, returns the number of variants
+int AuthorMeshLODs(pxr::UsdGeomMesh &mesh, const MeshLodSettings &settings);
+
+// picks each LOD variant set's coarsest level whose error projects to less than a pixel threshold
+//
+// selections are authored on the stage's session layer so they never end up in the saved file
+class LodSelector
+{
+public:
+    LodSelector();
+
+    // find the prims with an LOD variant set and their error bounds, also happens on the first Update
+    void Collect(const pxr::UsdStageRefPtr &stage);
+    // project the errors from the eye position with the given projection and viewport height in pixels
+    void Update(const pxr::UsdStageRefPtr &stage, const glm::vec3 &eye, const glm::mat4 &projection, float viewportHeight);
+
+    void SetPixelThreshold(float pixels) { pixelThreshold = pixels; }
+    size_t GetLodPrimCount() { return prims.size(); }
+    // variant selections changed by the last Update
+    size_t GetLastSwitchCount() { return lastSwitches; }
+
+protected:
+    struct LodPrim
+    {
+        pxr::SdfPath path;
+        std::vector<std::string> variants;      // finest first
+        std::vector<float> errors;              // world space, per variant
+        glm::vec3 center;
+        float radius;
+        int selected;
+    };
+
+    pxr::UsdStageWeakPtr collectedStage;
+    std::vector<LodPrim> prims;
+    float pixelThreshold;
+    size_t lastSwitches;
+};
@@ -0,0 +1,368 @@
+#include "meshOptimizer.h"
+
+#include <pxr/usd/usdGeom/tokens.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    bool IsFaceVarying(const pxr::TfToken &interpolation)
+    {
+        return interpolation == pxr::UsdGeomTokens->faceVarying;
+    }
+
+    // checks an attribute has one value per point or one per face vertex, depending on its interpolation
+    template <typename T>
+    bool CheckAttribute(const char *name, const pxr::VtArray<T> &values, const pxr::TfToken &interpolation, size_t pointCount, size_t cornerCount)
+    {
+        if (values.empty())
+            return true;
+        size_t expected = IsFaceVarying(interpolation) ? cornerCount : pointCount;
+        if (values.size() != expected)
+        {
+            std::cerr << "OptimizeMesh: expected " << expected << " " << name << " but found " << values.size() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // all the attributes of a corner quantized to the weld tolerances
+    struct WeldKey
+    {
+        std::array<int64_t, 8> cell;
+
+        bool operator==(const WeldKey &other) const { return cell == other.cell; }
+    };
+
+    struct WeldKeyHash
+    {
+        size_t operator()(const WeldKey &key) const
+        {
+            uint64_t h = 1469598103934665603ull;
+            for (int64_t c : key.cell)
+                h = (h ^ (uint64_t)c) * 1099511628211ull;
+            return (size_t)h;
+        }
+    };
+
+    int64_t Quantize(float value, float tolerance)
+    {
+        if (tolerance > 0.f)
+            return (int64_t)std::llround((double)value / (double)tolerance);
+        // no tolerance, only bit identical values weld
+        int32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // transformed vertices per triangle for a FIFO post transform cache, polygons are counted as fans
+    double AverageCacheMissRatio(const pxr::VtArray<int> &faceVertexCounts, const pxr::VtArray<int> &faceVertexIndices, size_t pointCount, int cacheSize)
+    {
+        std::vector<int64_t> insertedAt(pointCount, -cacheSize - 1);
+        int64_t misses = 0, triangles = 0;
+        size_t corner = 0;
+        for (int count : faceVertexCounts)
+        {
+            for (int c = 0; c < count; ++c)
+            {
+                int v = faceVertexIndices[corner + c];
+                if (misses - insertedAt[v] > cacheSize)
+                {
+                    insertedAt[v] = misses;
+                    ++misses;
+                }
+            }
+            triangles += std::max(count - 2, 0);
+            corner += count;
+        }
+        return triangles > 0 ? (double)misses / (double)triangles : 0.0;
+    }
+
+    // Forsyth's linear speed vertex cache optimisation, returns the new triangle order
+    std::vector<uint32_t> OptimizeTriangleOrder(const pxr::VtArray<int> &indices, size_t vertexCount, int cacheSize)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        const float cacheDecayPower = 1.5f;
+        const float lastTriangleScore = 0.75f;
+        const float valenceBoostScale = 2.f;
+        const float valenceBoostPower = 0.5f;
+
+        // triangles using each vertex
+        std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+        for (int v : indices)
+            ++adjacencyStart[v + 1];
+        for (size_t v = 0; v < vertexCount; ++v)
+            adjacencyStart[v + 1] += adjacencyStart[v];
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                int v = indices[t * 3 + c];
+                adjacency[adjacencyStart[v] + remaining[v]++] = (uint32_t)t;
+            }
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        auto vertexScore = [&](size_t v) -> float
+        {
+            if (remaining[v] == 0)
+                return -1.f;
+            float score = 0.f;
+            int position = cachePosition[v];
+            if (position >= 0)
+            {
+                if (position < 3)
+                    score = lastTriangleScore;
+                else
+                    score = std::pow(1.f - (float)(position - 3) / (float)(cacheSize - 3), cacheDecayPower);
+            }
+            return score + valenceBoostScale * std::pow((float)remaining[v], -valenceBoostPower);
+        };
+
+        std::vector<float> scores(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+            scores[v] = vertexScore(v);
+
+        std::vector<bool> emitted(triangleCount, false);
+
+        std::vector<uint32_t> order;
+        order.reserve(triangleCount);
+        std::vector<int> cache, nextCache;
+        size_t scanCursor = 0;
+        int64_t best = -1;
+
+        while (order.size() < triangleCount)
+        {
+            // nothing in the cache is connected to anything left, start from the next unemitted triangle
+            if (best < 0)
+            {
+                while (emitted[scanCursor])
+                    ++scanCursor;
+                best = (int64_t)scanCursor;
+            }
+
+            emitted[best] = true;
+            order.push_back((uint32_t)best);
+
+            // take the triangle out of its vertices' adjacency
+            const int *tri = &indices[best * 3];
+            for (int c = 0; c < 3; ++c)
+            {
+                int v = tri[c];
+                uint32_t *begin = &adjacency[adjacencyStart[v]];
+                uint32_t *end = begin + remaining[v];
+                *std::find(begin, end, (uint32_t)best) = *(end - 1);
+                --remaining[v];
+            }
+
+            // the triangle's vertices go to the front of the cache, anything pushed past the end falls out
+            nextCache.assign(tri, tri + 3);
+            for (int v : cache)
+            {
+                if (v != tri[0] && v != tri[1] && v != tri[2])
+                    nextCache.push_back(v);
+            }
+            for (size_t i = 0; i < nextCache.size(); ++i)
+                cachePosition[nextCache[i]] = i < (size_t)cacheSize ? (int)i : -1;
+
+            // rescore the cached (and just evicted) vertices and the triangles they touch, picking the best as we go
+            best = -1;
+            float bestScore = -1.f;
+            for (int v : nextCache)
+                scores[v] = vertexScore(v);
+            for (int v : nextCache)
+            {
+                for (uint32_t a = adjacencyStart[v]; a < adjacencyStart[v] + remaining[v]; ++a)
+                {
+                    uint32_t t = adjacency[a];
+                    float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = t;
+                    }
+                }
+            }
+
+            if (nextCache.size() > (size_t)cacheSize)
+                nextCache.resize(cacheSize);
+            cache.swap(nextCache);
+        }
+        return order;
+    }
+}
+
+size_t MeshBufferBytes(const MeshBuffers &mesh)
+{
+    return mesh.points.size() * sizeof(pxr::GfVec3f)
+        + mesh.normals.size() * sizeof(pxr::GfVec3f)
+        + mesh.texCoords.size() * sizeof(pxr::GfVec2f)
+        + mesh.faceVertexCounts.size() * sizeof(int)
+        + mesh.faceVertexIndices.size() * sizeof(int);
+}
+
+bool OptimizeMesh(MeshBuffers &mesh, const MeshOptimizeSettings &settings, MeshOptimizeReport *report)
+{
+    // read through a const reference, the non-const VtArray accessors would detach shared arrays
+    const MeshBuffers &source = mesh;
+    const size_t pointCount = mesh.points.size();
+    const size_t cornerCount = mesh.faceVertexIndices.size();
+
+    // validate before touching anything
+    size_t counted = 0;
+    bool allTriangles = true;
+    for (int count : source.faceVertexCounts)
+    {
+        if (count < 3)
+        {
+            std::cerr << "OptimizeMesh: face with " << count << " vertices" << std::endl;
+            return false;
+        }
+        allTriangles = allTriangles && count == 3;
+        counted += count;
+    }
+    if (counted != cornerCount)
+    {
+        std::cerr << "OptimizeMesh: face vertex counts add up to " << counted << " but there are " << cornerCount << " indices" << std::endl;
+        return false;
+    }
+    for (int index : source.faceVertexIndices)
+    {
+        if (index < 0 || (size_t)index >= pointCount)
+        {
+            std::cerr << "OptimizeMesh: index " << index << " out of range" << std::endl;
+            return false;
+        }
+    }
+    if (!CheckAttribute("normals", mesh.normals, mesh.normalsInterpolation, pointCount, cornerCount) ||
+        !CheckAttribute("texture coordinates", mesh.texCoords, mesh.texCoordsInterpolation, pointCount, cornerCount))
+        return false;
+
+    MeshOptimizeReport result;
+    result.verticesBefore = pointCount;
+    result.bytesBefore = MeshBufferBytes(mesh);
+    result.acmrBefore = AverageCacheMissRatio(mesh.faceVertexCounts, mesh.faceVertexIndices, pointCount, settings.cacheSize);
+
+    const bool normalsFaceVarying = IsFaceVarying(mesh.normalsInterpolation);
+    const bool texCoordsFaceVarying = IsFaceVarying(mesh.texCoordsInterpolation);
+    const bool hasNormals = !mesh.normals.empty();
+    const bool hasTexCoords = !mesh.texCoords.empty();
+
+    // weld: every corner is looked up by its quantized point, normal and texture coordinate
+    std::unordered_map<WeldKey, int, WeldKeyHash> welded;
+    welded.reserve(cornerCount);
+    std::vector<int> cornerVertex(cornerCount);
+    std::vector<size_t> firstCorner;        // a representative corner for each welded vertex
+    for (size_t c = 0; c < cornerCount; ++c)
+    {
+        int p = source.faceVertexIndices[c];
+        WeldKey key;
+        key.cell.fill(0);
+        for (int i = 0; i < 3; ++i)
+            key.cell[i] = Quantize(source.points[p][i], settings.positionTolerance);
+        if (hasNormals)
+        {
+            const pxr::GfVec3f &n = source.normals[normalsFaceVarying ? c : p];
+            for (int i = 0; i < 3; ++i)
+                key.cell[3 + i] = Quantize(n[i], settings.normalTolerance);
+        }
+        if (hasTexCoords)
+        {
+            const pxr::GfVec2f &st = source.texCoords[texCoordsFaceVarying ? c : p];
+            for (int i = 0; i < 2; ++i)
+                key.cell[6 + i] = Quantize(st[i], settings.texCoordTolerance);
+        }
+
+        auto it = welded.emplace(key, (int)firstCorner.size());
+        if (it.second)
+            firstCorner.push_back(c);
+        cornerVertex[c] = it.first->second;
+    }
+
+    pxr::VtArray<int> indices(cornerCount);
+    for (size_t c = 0; c < cornerCount; ++c)
+        indices[c] = cornerVertex[c];
+    const size_t vertexCount = firstCorner.size();
+
+    // reorder triangles for the post transform cache, polygon meshes keep their face order
+    bool reordered = false;
+    if (settings.reorderIndices && allTriangles && cornerCount > 0)
+    {
+        std::vector<uint32_t> order = OptimizeTriangleOrder(indices, vertexCount, std::max(settings.cacheSize, 4));
+        pxr::VtArray<int> reorderedIndices(cornerCount);
+        for (size_t t = 0; t < order.size(); ++t)
+        {
+            for (int c = 0; c < 3; ++c)
+                reorderedIndices[t * 3 + c] = indices[order[t] * 3 + c];
+        }
+        indices.swap(reorderedIndices);
+        reordered = true;
+    }
+
+    // renumber vertices in first use order so the vertex fetches walk forward through memory
+    std::vector<int> remap(vertexCount);
+    if (settings.reorderVertices)
+    {
+        std::fill(remap.begin(), remap.end(), -1);
+        int next = 0;
+        for (int &index : indices)
+        {
+            if (remap[index] < 0)
+                remap[index] = next++;
+            index = remap[index];
+        }
+    }
+    else
+    {
+        for (size_t v = 0; v < vertexCount; ++v)
+            remap[v] = (int)v;
+    }
+
+    // gather the welded attributes from each vertex's representative corner
+    pxr::VtVec3fArray points(vertexCount);
+    pxr::VtVec3fArray normals(hasNormals ? vertexCount : 0);
+    pxr::VtVec2fArray texCoords(hasTexCoords ? vertexCount : 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        size_t c = firstCorner[v];
+        int p = source.faceVertexIndices[c];
+        int dst = remap[v];
+        points[dst] = source.points[p];
+        if (hasNormals)
+            normals[dst] = source.normals[normalsFaceVarying ? c : p];
+        if (hasTexCoords)
+            texCoords[dst] = source.texCoords[texCoordsFaceVarying ? c : p];
+    }
+
+    mesh.points.swap(points);
+    mesh.normals.swap(normals);
+    mesh.texCoords.swap(texCoords);
+    mesh.faceVertexIndices.swap(indices);
+    mesh.normalsInterpolation = pxr::UsdGeomTokens->vertex;
+    mesh.texCoordsInterpolation = pxr::UsdGeomTokens->vertex;
+
+    result.verticesAfter = vertexCount;
+    result.bytesAfter = MeshBufferBytes(mesh);
+    result.acmrAfter = AverageCacheMissRatio(mesh.faceVertexCounts, mesh.faceVertexIndices, vertexCount, settings.cacheSize);
+    result.indicesReordered = reordered;
+    if (report)
+        *report = result;
+    return true;
+}
+
+void PrintMeshOptimizeReport(const std::string &name, const MeshOptimizeReport &report, std::ostream &out)
+{
+    out << "Optimized mesh " << name << ": "
+        << report.verticesBefore << " -> " << report.verticesAfter << " vertices, "
+        << report.bytesBefore << " -> " << report.bytesAfter << " bytes, "
+        << "ACMR " << report.acmrBefore << " -> " << report.acmrAfter
+        << (report.indicesReordered ? "" : " (polygons, face order kept)") << std::endl;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/base/vt/types.h>
+
+#include <iostream>
+#include <string>
+
+// the arrays that get handed to createMesh, normals and texture coordinates can be per point or per face vertex
+struct MeshBuffers
+{
+    pxr::VtVec3fArray points;
+    pxr::VtArray<int> faceVertexCounts;
+    pxr::VtArray<int> faceVertexIndices;
+
+    pxr::VtVec3fArray normals;
+    pxr::TfToken normalsInterpolation;      // vertex/varying or faceVarying, empty means vertex
+    pxr::VtVec2fArray texCoords;
+    pxr::TfToken texCoordsInterpolation;
+};
+
+struct MeshOptimizeSettings
+{
+    MeshOptimizeSettings()
+        : positionTolerance(1e-5f), normalTolerance(1e-3f), texCoordTolerance(1e-5f), reorderIndices(true), reorderVertices(true), cacheSize(32)
+    {}
+
+    // corners closer than these in every attribute are welded into one vertex
+    float positionTolerance;
+    float normalTolerance;
+    float texCoordTolerance;
+
+    // reorder triangles for the post transform cache (triangle meshes only)
+    bool reorderIndices;
+    // renumber vertices in the order the index buffer first touches them
+    bool reorderVertices;
+    int cacheSize;
+};
+
+struct MeshOptimizeReport
+{
+    MeshOptimizeReport()
+        : verticesBefore(0), verticesAfter(0), bytesBefore(0), bytesAfter(0), acmrBefore(0.0), acmrAfter(0.0), indicesReordered(false)
+    {}
+
+    size_t verticesBefore, verticesAfter;
+    size_t bytesBefore, bytesAfter;
+    // average cache miss ratio, transformed vertices per triangle with a FIFO cache of cacheSize
+    double acmrBefore, acmrAfter;
+    bool indicesReordered;
+};
+
+// weld, reorder and renumber the mesh in place
+//
+// face varying normals/texture coordinates are folded into the welded vertices so everything comes out per point
+// (vertex interpolation), returns false and leaves the mesh untouched if the arrays don't describe a valid mesh
+bool OptimizeMesh(MeshBuffers &mesh, const MeshOptimizeSettings &settings, MeshOptimizeReport *report = nullptr);
+
+// bytes the mesh's arrays occupy (points, normals, texture coordinates, counts and indices)
+size_t MeshBufferBytes(const MeshBuffers &mesh);
+
+void PrintMeshOptimizeReport(const std::string &name, const MeshOptimizeReport &report, std::ostream &out);
@@ -0,0 +1,365 @@
+#include "meshSimplifier.h"
+
+#include <pxr/usd/usdGeom/tokens.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+    // symmetric 4x4 error quadric, the sum of squared distances to a set of planes
+    struct Quadric
+    {
+        Quadric() { std::fill(q, q + 10, 0.0); }
+
+        void AddPlane(const pxr::GfVec3d &n, double d, double weight)
+        {
+            q[0] += weight * n[0] * n[0]; q[1] += weight * n[0] * n[1]; q[2] += weight * n[0] * n[2]; q[3] += weight * n[0] * d;
+            q[4] += weight * n[1] * n[1]; q[5] += weight * n[1] * n[2]; q[6] += weight * n[1] * d;
+            q[7] += weight * n[2] * n[2]; q[8] += weight * n[2] * d;
+            q[9] += weight * d * d;
+        }
+
+        void Add(const Quadric &other)
+        {
+            for (int i = 0; i < 10; ++i)
+                q[i] += other.q[i];
+        }
+
+        double Evaluate(const pxr::GfVec3f &p) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+            double e = q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+                     + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+                     + q[7] * z * z + 2.0 * q[8] * z
+                     + q[9];
+            return std::max(e, 0.0);
+        }
+
+        double q[10];
+    };
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t from, to;
+        uint32_t fromVersion, toVersion;
+
+        // lowest cost first out of the priority queue
+        bool operator<(const Collapse &other) const { return cost > other.cost; }
+    };
+
+    uint64_t EdgeKey(uint32_t a, uint32_t b)
+    {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+    pxr::GfVec3d TriangleNormal(const pxr::GfVec3f &p0, const pxr::GfVec3f &p1, const pxr::GfVec3f &p2)
+    {
+        return pxr::GfCross(pxr::GfVec3d(p1 - p0), pxr::GfVec3d(p2 - p0));
+    }
+}
+
+bool SimplifyMesh(const MeshBuffers &mesh, const MeshSimplifySettings &settings, MeshBuffers &result, float &error)
+{
+    error = 0.f;
+    const size_t pointCount = mesh.points.size();
+    if (mesh.normalsInterpolation == pxr::UsdGeomTokens->faceVarying || mesh.texCoordsInterpolation == pxr::UsdGeomTokens->faceVarying)
+    {
+        std::cerr << "SimplifyMesh: face varying attributes need to be welded with OptimizeMesh first" << std::endl;
+        return false;
+    }
+    if ((!mesh.normals.empty() && mesh.normals.size() != pointCount) || (!mesh.texCoords.empty() && mesh.texCoords.size() != pointCount))
+    {
+        std::cerr << "SimplifyMesh: attributes don't match the number of points" << std::endl;
+        return false;
+    }
+
+    // fan triangulate, dropping anything degenerate
+    std::vector<uint32_t> triangles;
+    size_t corner = 0;
+    for (int count : mesh.faceVertexCounts)
+    {
+        if (count < 3 || corner + count > mesh.faceVertexIndices.size())
+        {
+            std::cerr << "SimplifyMesh: invalid face vertex counts" << std::endl;
+            return false;
+        }
+        for (int c = 0; c < count; ++c)
+        {
+            int index = mesh.faceVertexIndices[corner + c];
+            if (index < 0 || (size_t)index >= pointCount)
+            {
+                std::cerr << "SimplifyMesh: index " << index << " out of range" << std::endl;
+                return false;
+            }
+        }
+        for (int c = 1; c + 1 < count; ++c)
+        {
+            uint32_t a = mesh.faceVertexIndices[corner], b = mesh.faceVertexIndices[corner + c], d = mesh.faceVertexIndices[corner + c + 1];
+            if (a != b && b != d && a != d)
+            {
+                triangles.push_back(a);
+                triangles.push_back(b);
+                triangles.push_back(d);
+            }
+        }
+        corner += count;
+    }
+    const size_t triangleCount = triangles.size() / 3;
+    const pxr::VtVec3fArray &points = mesh.points;
+
+    // surface planes of the triangles around each vertex
+    std::vector<Quadric> surface(pointCount), boundary(pointCount);
+    std::vector<std::vector<uint32_t>> vertexTriangles(pointCount);
+    std::unordered_map<uint64_t, int> edgeUse;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t *tri = &triangles[t * 3];
+        pxr::GfVec3d n = TriangleNormal(points[tri[0]], points[tri[1]], points[tri[2]]);
+        if (n.Normalize() > 0.0)
+        {
+            double d = -pxr::GfDot(n, pxr::GfVec3d(points[tri[0]]));
+            for (int c = 0; c < 3; ++c)
+                surface[tri[c]].AddPlane(n, d, 1.0);
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            vertexTriangles[tri[c]].push_back((uint32_t)t);
+            ++edgeUse[EdgeKey(tri[c], tri[(c + 1) % 3])];
+        }
+    }
+
+    // open edges get a plane through them perpendicular to their triangle so they resist moving sideways
+    std::unordered_set<uint64_t> boundaryEdges;
+    std::vector<bool> onBoundary(pointCount, false);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t *tri = &triangles[t * 3];
+        pxr::GfVec3d n = TriangleNormal(points[tri[0]], points[tri[1]], points[tri[2]]);
+        n.Normalize();
+        for (int c = 0; c < 3; ++c)
+        {
+            uint32_t a = tri[c], b = tri[(c + 1) % 3];
+            if (edgeUse[EdgeKey(a, b)] != 1)
+                continue;
+            boundaryEdges.insert(EdgeKey(a, b));
+            onBoundary[a] = onBoundary[b] = true;
+            pxr::GfVec3d edge(points[b] - points[a]);
+            pxr::GfVec3d side = pxr::GfCross(edge, n);
+            if (side.Normalize() > 0.0)
+            {
+                double d = -pxr::GfDot(side, pxr::GfVec3d(points[a]));
+                boundary[a].AddPlane(side, d, 1.0);
+                boundary[b].AddPlane(side, d, 1.0);
+            }
+        }
+    }
+
+    // points that share a position with another point sit on an attribute seam, moving one would open a crack
+    std::vector<bool> locked(pointCount, false);
+    {
+        std::unordered_map<uint64_t, std::vector<uint32_t>> byPosition;
+        for (size_t v = 0; v < pointCount; ++v)
+        {
+            const float *p = points[v].data();
+            uint64_t h = 1469598103934665603ull;
+            for (int i = 0; i < 3; ++i)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &p[i], sizeof(bits));
+                h = (h ^ bits) * 1099511628211ull;
+            }
+            byPosition[h].push_back((uint32_t)v);
+        }
+        for (const auto &bucket : byPosition)
+        {
+            for (uint32_t v : bucket.second)
+            {
+                for (uint32_t other : bucket.second)
+                {
+                    if (other != v && points[other] == points[v])
+                        locked[v] = true;
+                }
+            }
+        }
+    }
+
+    std::vector<bool> triangleAlive(triangleCount, true), vertexAlive(pointCount, true);
+    std::vector<uint32_t> version(pointCount, 0);
+    std::priority_queue<Collapse> queue;
+
+    auto collapseCost = [&](uint32_t from, uint32_t to, double &deviation) -> double
+    {
+        Quadric s = surface[from], b = boundary[from];
+        s.Add(surface[to]);
+        b.Add(boundary[to]);
+        double surfaceError = s.Evaluate(points[to]);
+        double boundaryError = b.Evaluate(points[to]);
+        deviation = std::sqrt(surfaceError + boundaryError);
+        return surfaceError + settings.boundaryWeight * boundaryError;
+    };
+
+    auto pushCollapse = [&](uint32_t from, uint32_t to)
+    {
+        if (locked[from] || !vertexAlive[from] || !vertexAlive[to])
+            return;
+        // boundary points may only slide along their boundary
+        if (onBoundary[from] && boundaryEdges.count(EdgeKey(from, to)) == 0)
+            return;
+        double deviation;
+        Collapse collapse;
+        collapse.cost = collapseCost(from, to, deviation);
+        collapse.from = from;
+        collapse.to = to;
+        collapse.fromVersion = version[from];
+        collapse.toVersion = version[to];
+        queue.push(collapse);
+    };
+
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t *tri = &triangles[t * 3];
+        for (int c = 0; c < 3; ++c)
+        {
+            pushCollapse(tri[c], tri[(c + 1) % 3]);
+            pushCollapse(tri[(c + 1) % 3], tri[c]);
+        }
+    }
+
+    size_t liveTriangles = triangleCount;
+    std::vector<uint32_t> neighbours;
+    while (liveTriangles > settings.targetTriangles && !queue.empty())
+    {
+        Collapse collapse = queue.top();
+        queue.pop();
+        uint32_t from = collapse.from, to = collapse.to;
+        if (!vertexAlive[from] || !vertexAlive[to] || collapse.fromVersion != version[from] || collapse.toVersion != version[to])
+            continue;
+
+        double deviation;
+        collapseCost(from, to, deviation);
+        if (settings.maxError > 0.f && deviation > settings.maxError)
+            break;
+
+        // reject collapses that would flip or squash one of the triangles that survive it
+        bool connected = false, valid = true;
+        for (uint32_t t : vertexTriangles[from])
+        {
+            if (!triangleAlive[t])
+                continue;
+            const uint32_t *tri = &triangles[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+            {
+                connected = true;
+                continue;
+            }
+            pxr::GfVec3f moved[3];
+            for (int c = 0; c < 3; ++c)
+                moved[c] = tri[c] == from ? points[to] : points[tri[c]];
+            pxr::GfVec3d before = TriangleNormal(points[tri[0]], points[tri[1]], points[tri[2]]);
+            pxr::GfVec3d after = TriangleNormal(moved[0], moved[1], moved[2]);
+            if (pxr::GfDot(before, after) <= 0.0 || after.GetLength() <= 1e-12 * before.GetLength())
+            {
+                valid = false;
+                break;
+            }
+        }
+        if (!connected || !valid)
+            continue;
+
+        // keep track of the boundary as its edges are taken over by the surviving point
+        neighbours.clear();
+        for (uint32_t t : vertexTriangles[from])
+        {
+            if (!triangleAlive[t])
+                continue;
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t v = triangles[t * 3 + c];
+                if (v != from && v != to)
+                    neighbours.push_back(v);
+            }
+        }
+        for (uint32_t v : neighbours)
+        {
+            if (boundaryEdges.erase(EdgeKey(from, v)))
+                boundaryEdges.insert(EdgeKey(to, v));
+        }
+        boundaryEdges.erase(EdgeKey(from, to));
+
+        // triangles across the collapsed edge disappear, the rest move over to the surviving point
+        for (uint32_t t : vertexTriangles[from])
+        {
+            if (!triangleAlive[t])
+                continue;
+            uint32_t *tri = &triangles[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+            {
+                triangleAlive[t] = false;
+                --liveTriangles;
+                continue;
+            }
+            for (int c = 0; c < 3; ++c)
+            {
+                if (tri[c] == from)
+                    tri[c] = to;
+            }
+            vertexTriangles[to].push_back(t);
+        }
+        vertexTriangles[from].clear();
+        vertexAlive[from] = false;
+        surface[to].Add(surface[from]);
+        boundary[to].Add(boundary[from]);
+        ++version[to];
+        error = std::max(error, (float)deviation);
+
+        // the costs of everything around the surviving point have changed
+        auto &toTriangles = vertexTriangles[to];
+        toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&](uint32_t t) { return !triangleAlive[t]; }), toTriangles.end());
+        for (uint32_t t : toTriangles)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t v = triangles[t * 3 + c];
+                if (v == to)
+                    continue;
+                pushCollapse(v, to);
+                pushCollapse(to, v);
+            }
+        }
+    }
+
+    // compact the surviving points and triangles
+    std::vector<int> remap(pointCount, -1);
+    result = MeshBuffers();
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        if (!triangleAlive[t])
+            continue;
+        for (int c = 0; c < 3; ++c)
+        {
+            uint32_t v = triangles[t * 3 + c];
+            if (remap[v] < 0)
+            {
+                remap[v] = (int)result.points.size();
+                result.points.push_back(points[v]);
+                if (!mesh.normals.empty())
+                    result.normals.push_back(mesh.normals[v]);
+                if (!mesh.texCoords.empty())
+                    result.texCoords.push_back(mesh.texCoords[v]);
+            }
+            result.faceVertexIndices.push_back(remap[v]);
+        }
+        result.faceVertexCounts.push_back(3);
+    }
+    result.normalsInterpolation = pxr::UsdGeomTokens->vertex;
+    result.texCoordsInterpolation = pxr::UsdGeomTokens->vertex;
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "meshOptimizer.h"
+
+#include <cstddef>
+
+struct MeshSimplifySettings
+{
+    MeshSimplifySettings()
+        : targetTriangles(0), maxError(0.f), boundaryWeight(100.f)
+    {}
+
+    // stop once the mesh is down to this many triangles
+    size_t targetTriangles;
+    // or once the next collapse would move the surface further than this (object space, 0 for no limit)
+    float maxError;
+    // how strongly open edges and attribute seams resist being collapsed
+    float boundaryWeight;
+};
+
+// quadric error metric edge collapse simplification
+//
+// collapses are half edge (a vertex moves onto one of its neighbours) so the surviving vertices keep their exact
+// normals and texture coordinates. open edges may only shorten along themselves and points on seams where those
+// attributes split stay where they are. polygons are triangulated as fans and the input must have per point
+// (vertex interpolated) attributes, run OptimizeMesh first for face varying input
+//
+// error is set to the largest surface deviation estimated from the quadrics of the collapses that were made
+bool SimplifyMesh(const MeshBuffers &mesh, const MeshSimplifySettings &settings, MeshBuffers &result, float &error);
@@ -0,0 +1,234 @@
+#include "meshSimplifier.h"
+#include "testing.h"
+
+#include <pxr/usd/usdGeom/tokens.h>
+
+#include <cmath>
+#include <map>
+#include <tuple>
+
+namespace
+{
+    const double pi = 3.14159265358979323846;
+
+    // a flat square of size x size quads in z = 0, with per point normals and texture coordinates
+    MeshBuffers MakeGrid(int size)
+    {
+        MeshBuffers mesh;
+        for (int y = 0; y <= size; ++y)
+        {
+            for (int x = 0; x <= size; ++x)
+            {
+                mesh.points.push_back(pxr::GfVec3f((float)x, (float)y, 0.f));
+                mesh.normals.push_back(pxr::GfVec3f(0.f, 0.f, 1.f));
+                mesh.texCoords.push_back(pxr::GfVec2f((float)x / (float)size, (float)y / (float)size));
+            }
+        }
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                int corner = y * (size + 1) + x;
+                mesh.faceVertexCounts.push_back(4);
+                mesh.faceVertexIndices.push_back(corner);
+                mesh.faceVertexIndices.push_back(corner + 1);
+                mesh.faceVertexIndices.push_back(corner + size + 2);
+                mesh.faceVertexIndices.push_back(corner + size + 1);
+            }
+        }
+        return mesh;
+    }
+
+    // a closed uv sphere of radius 1, the poles are single points
+    MeshBuffers MakeSphere(int rings, int segments)
+    {
+        MeshBuffers mesh;
+        mesh.points.push_back(pxr::GfVec3f(0.f, 0.f, 1.f));
+        for (int r = 1; r < rings; ++r)
+        {
+            double theta = pi * (double)r / (double)rings;
+            for (int s = 0; s < segments; ++s)
+            {
+                double phi = 2.0 * pi * (double)s / (double)segments;
+                mesh.points.push_back(pxr::GfVec3f((float)(std::sin(theta) * std::cos(phi)), (float)(std::sin(theta) * std::sin(phi)), (float)std::cos(theta)));
+            }
+        }
+        mesh.points.push_back(pxr::GfVec3f(0.f, 0.f, -1.f));
+        int south = (int)mesh.points.size() - 1;
+
+        auto ringPoint = [segments](int r, int s) { return 1 + (r - 1) * segments + s % segments; };
+        for (int s = 0; s < segments; ++s)
+        {
+            mesh.faceVertexCounts.push_back(3);
+            mesh.faceVertexIndices.push_back(0);
+            mesh.faceVertexIndices.push_back(ringPoint(1, s));
+            mesh.faceVertexIndices.push_back(ringPoint(1, s + 1));
+        }
+        for (int r = 1; r + 1 < rings; ++r)
+        {
+            for (int s = 0; s < segments; ++s)
+            {
+                mesh.faceVertexCounts.push_back(4);
+                mesh.faceVertexIndices.push_back(ringPoint(r, s));
+                mesh.faceVertexIndices.push_back(ringPoint(r + 1, s));
+                mesh.faceVertexIndices.push_back(ringPoint(r + 1, s + 1));
+                mesh.faceVertexIndices.push_back(ringPoint(r, s + 1));
+            }
+        }
+        for (int s = 0; s < segments; ++s)
+        {
+            mesh.faceVertexCounts.push_back(3);
+            mesh.faceVertexIndices.push_back(south);
+            mesh.faceVertexIndices.push_back(ringPoint(rings - 1, s + 1));
+            mesh.faceVertexIndices.push_back(ringPoint(rings - 1, s));
+        }
+        return mesh;
+    }
+
+    size_t TriangleCount(const MeshBuffers &mesh)
+    {
+        size_t triangles = 0;
+        for (int count : mesh.faceVertexCounts)
+            triangles += (size_t)count - 2;
+        return triangles;
+    }
+
+    bool IndicesValid(const MeshBuffers &mesh)
+    {
+        for (int index : mesh.faceVertexIndices)
+        {
+            if (index < 0 || (size_t)index >= mesh.points.size())
+                return false;
+        }
+        return mesh.faceVertexIndices.size() == mesh.faceVertexCounts.size() * 3;
+    }
+
+    using PointKey = std::tuple<float, float, float>;
+
+    PointKey Key(const pxr::GfVec3f &point)
+    {
+        return PointKey(point[0], point[1], point[2]);
+    }
+
+    void TestStopsAtTarget()
+    {
+        MeshBuffers grid = MakeGrid(16);
+        MeshSimplifySettings settings;
+        settings.targetTriangles = TriangleCount(grid) / 2;
+        MeshBuffers result;
+        float error = -1.f;
+        CHECK(SimplifyMesh(grid, settings, result, error));
+        CHECK(IndicesValid(result));
+        // a collapse takes out one or two triangles
+        CHECK(TriangleCount(result) <= settings.targetTriangles);
+        CHECK(TriangleCount(result) + 2 >= settings.targetTriangles);
+        // a plane is reproduced exactly by its quadrics
+        CHECK_NEAR(error, 0.0, 1e-4);
+    }
+
+    void TestFlatGridKeepsItsOutline()
+    {
+        MeshBuffers grid = MakeGrid(16);
+        MeshSimplifySettings settings;
+        settings.maxError = 1e-4f;
+        MeshBuffers result;
+        float error = -1.f;
+        CHECK(SimplifyMesh(grid, settings, result, error));
+        CHECK(IndicesValid(result));
+        CHECK(TriangleCount(result) < TriangleCount(grid) / 2);
+        CHECK(error <= settings.maxError);
+
+        // moving a corner would cut into the outline, so all four survive and nothing leaves the plane
+        std::map<PointKey, size_t> points;
+        for (size_t i = 0; i < result.points.size(); ++i)
+        {
+            points[Key(result.points[i])] = i;
+            CHECK(result.points[i][2] == 0.f);
+        }
+        CHECK(points.count(PointKey(0.f, 0.f, 0.f)) == 1);
+        CHECK(points.count(PointKey(16.f, 0.f, 0.f)) == 1);
+        CHECK(points.count(PointKey(0.f, 16.f, 0.f)) == 1);
+        CHECK(points.count(PointKey(16.f, 16.f, 0.f)) == 1);
+    }
+
+    void TestSurvivorsKeepTheirAttributes()
+    {
+        MeshBuffers grid = MakeGrid(8);
+        std::map<PointKey, size_t> original;
+        for (size_t i = 0; i < grid.points.size(); ++i)
+            original[Key(grid.points[i])] = i;
+
+        MeshSimplifySettings settings;
+        settings.targetTriangles = 16;
+        MeshBuffers result;
+        float error;
+        CHECK(SimplifyMesh(grid, settings, result, error));
+        CHECK(result.normals.size() == result.points.size());
+        CHECK(result.texCoords.size() == result.points.size());
+        CHECK(result.normalsInterpolation == pxr::UsdGeomTokens->vertex);
+
+        // half edge collapses only ever drop points, so each survivor is an input point with its own attributes
+        for (size_t i = 0; i < result.points.size(); ++i)
+        {
+            auto found = original.find(Key(result.points[i]));
+            CHECK(found != original.end());
+            if (found == original.end())
+                continue;
+            CHECK(result.normals[i] == grid.normals[found->second]);
+            CHECK(result.texCoords[i] == grid.texCoords[found->second]);
+        }
+    }
+
+    void TestCurvedSurfaceRespectsMaxError()
+    {
+        MeshBuffers sphere = MakeSphere(24, 48);
+        MeshSimplifySettings settings;
+        settings.maxError = 0.01f;
+        MeshBuffers result;
+        float error = -1.f;
+        CHECK(SimplifyMesh(sphere, settings, result, error));
+        CHECK(IndicesValid(result));
+        CHECK(error >= 0.f && error <= settings.maxError);
+        CHECK(TriangleCount(result) < TriangleCount(sphere));
+        // the survivors are still on the sphere
+        for (const auto &point : result.points)
+            CHECK_NEAR(point.GetLength(), 1.0, 1e-5);
+
+        // a tighter limit leaves more of it
+        MeshSimplifySettings tighter = settings;
+        tighter.maxError = 0.001f;
+        MeshBuffers fine;
+        CHECK(SimplifyMesh(sphere, tighter, fine, error));
+        CHECK(error <= tighter.maxError);
+        CHECK(TriangleCount(fine) >= TriangleCount(result));
+    }
+
+    void TestRejectsInvalidInput()
+    {
+        MeshBuffers result;
+        float error;
+        MeshSimplifySettings settings;
+
+        MeshBuffers faceVarying = MakeGrid(2);
+        faceVarying.normalsInterpolation = pxr::UsdGeomTokens->faceVarying;
+        CHECK(!SimplifyMesh(faceVarying, settings, result, error));
+
+        MeshBuffers outOfRange = MakeGrid(2);
+        outOfRange.faceVertexIndices[0] = (int)outOfRange.points.size();
+        CHECK(!SimplifyMesh(outOfRange, settings, result, error));
+
+        MeshBuffers shortAttributes = MakeGrid(2);
+        shortAttributes.texCoords.pop_back();
+        CHECK(!SimplifyMesh(shortAttributes, settings, result, error));
+    }
+}
+
+int main()
+{
+    TestStopsAtTarget();
+    TestFlatGridKeepsItsOutline();
+    TestSurvivorsKeepTheirAttributes();
+    TestCurvedSurfaceRespectsMaxError();
+    TestRejectsInvalidInput();
+    return Testing::Result("meshSimplifierTest");
+}
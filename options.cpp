@@ -0,0 +1,370 @@
+#include "options.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    // fetch the value following an option, printing an error if it's missing
+    bool NextValue(int argc, char **argv, int &i, std::string &value)
+    {
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for option: " << argv[i] << std::endl;
+            return false;
+        }
+        value = argv[++i];
+        return true;
+    }
+
+    // a comma separated list, added to what earlier uses of the option gave
+    bool NextValue(int argc, char **argv, int &i, std::vector<std::string> &values)
+    {
+        std::string list;
+        if (!NextValue(argc, argv, i, list))
+            return false;
+        size_t start = 0;
+        while (start <= list.size())
+        {
+            size_t end = std::min(list.find(',', start), list.size());
+            if (end > start)
+                values.push_back(list.substr(start, end - start));
+            start = end + 1;
+        }
+        return true;
+    }
+
+    bool NextValue(int argc, char **argv, int &i, double &value)
+    {
+        std::string str;
+        if (!NextValue(argc, argv, i, str))
+            return false;
+        try
+        {
+            value = std::stod(str);
+        }
+        catch (const std::exception &)
+        {
+            std::cerr << "Invalid number for option " << argv[i - 1] << ": " << str << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool NextValue(int argc, char **argv, int &i, size_t &value)
+    {
+        double d = 0.0;
+        if (!NextValue(argc, argv, i, d))
+            return false;
+        if (d < 0.0)
+        {
+            std::cerr << "Option " << argv[i - 1] << " can't be negative" << std::endl;
+            return false;
+        }
+        value = (size_t)d;
+        return true;
+    }
+
+    bool NextValue(int argc, char **argv, int &i, int &value)
+    {
+        double d = 0.0;
+        if (!NextValue(argc, argv, i, d))
+            return false;
+        value = (int)d;
+        return true;
+    }
+
+    bool NextValue(int argc, char **argv, int &i, float &value)
+    {
+        double d = 0.0;
+        if (!NextValue(argc, argv, i, d))
+            return false;
+        value = (float)d;
+        return true;
+    }
+}
+
+void PrintUsage(const char *program)
+{
+    std::cout << "Usage: " << program << " [options] [texture]" << std::endl;
+    std::cout << "  --stage <file>       open a stage instead of authoring the cube" << std::endl;
+    std::cout << "  --mask <paths>       only populate these comma separated prim paths of the stage, names may use * and ?" << std::endl;
+    std::cout << "  --prim-types <types> only populate prims of these comma separated types, e.g. Mesh,Points" << std::endl;
+    std::cout << "  --stage-cache        open the stage from a flattened copy written the first time it's composed" << std::endl;
+    std::cout << "  --stage-cache-dir <dir> where flattened stages are cached (default $USDSIMPLECPP_STAGE_CACHE or ~/.cache)" << std::endl;
+    std::cout << "  --memory-report      print a memory report after the first frame (also bound to the M key)" << std::endl;
+    std::cout << "  --threads <n>        threads shared by USD and the app, default every core (or USDSIMPLECPP_THREADS)" << std::endl;
+    std::cout << "  --pin-cores <first>  pin those threads to cores from first on (or USDSIMPLECPP_PIN_CORES)" << std::endl;
+    std::cout << "  --concurrency-report print the threads busy and parallel efficiency of each phase on exit" << std::endl;
+    std::cout << "  --cubes <n>          author a grid of n cubes sharing a few materials instead of one cube" << std::endl;
+    std::cout << "  --author-layers <n>  author the cubes on n threads, each into a layer of its own composed as a sublayer" << std::endl;
+    std::cout << "  --optimize-meshes    weld vertices and reorder indices/vertices for cache locality before authoring" << std::endl;
+    std::cout << "  --foreign-buffers    author the generated arrays straight from one externally owned block" << std::endl;
+    std::cout << "  --quantize <file>    write a copy of the stage with its points, normals and texture coordinates quantized, as usdc" << std::endl;
+    std::cout << "  --quantize-normals <e> encode normals as octahedral (default), half or float" << std::endl;
+    std::cout << "  --quantize-bench <n> compare file size and load time with and without quantization over n loads" << std::endl;
+    std::cout << "  --ingest-report      print the allocations and copies made getting the generated arrays into USD" << std::endl;
+    std::cout << "  --lod <levels>       generate this many simplified levels of detail as an LOD variant set" << std::endl;
+    std::cout << "  --lod-error <px>     switch to a coarser level once its error projects under this many pixels (default 1)" << std::endl;
+    std::cout << "  --points <n>         author a generated cloud of n points, chunked for culling and updates, instead of the cube" << std::endl;
+    std::cout << "  --point-chunk <n>    points in each chunk of the cloud (default 65536)" << std::endl;
+    std::cout << "  --point-density <d>  draw about d points per pixel each chunk covers, decimating distant chunks (default off)" << std::endl;
+    std::cout << "  --capture <dir>      write each frame to a numbered PNG sequence in dir" << std::endl;
+    std::cout << "  --capture-aovs       also write the color, depth and prim id aovs as EXRs" << std::endl;
+    std::cout << "  --capture-frames <n> stop after n frames (defaults to the turntable length)" << std::endl;
+    std::cout << "  --export-shm <name>  publish each frame and its depth into a shared memory ring for local consumers" << std::endl;
+    std::cout << "  --batch <dir>        render a batch of views with one engine into dir and exit" << std::endl;
+    std::cout << "  --batch-views <n>    orbit views around the scene, the stage's cameras are added to these (default 8)" << std::endl;
+    std::cout << "  --batch-size <px>    width and height of each view (default 256)" << std::endl;
+    std::cout << "  --batch-tiled        write the views as one contact sheet instead of an image each" << std::endl;
+    std::cout << "  --workers <n>        split the batch of a --stage across n worker processes" << std::endl;
+    std::cout << "  --compute-bench <n>  time n updates of an animated grid through the stage and through a Hydra scene delegate" << std::endl;
+    std::cout << "  --compute-grid <n>   quads along each side of the benchmark grid (default 256)" << std::endl;
+    std::cout << "  --point-bench <n>    time n frames, full and partial updates of point clouds from 1M points up, and exit" << std::endl;
+    std::cout << "  --point-bench-max <n> largest cloud the point benchmark grows to (default 16777216)" << std::endl;
+    std::cout << "  --turntable <frames> orbit the camera a full turn over this many frames" << std::endl;
+    std::cout << "  --pick-report        print what each click picks and how long the ray took" << std::endl;
+    std::cout << "  --frame-budget <ms>  scale the render resolution to hold this frame time, e.g. 16 (default off)" << std::endl;
+    std::cout << "  --min-scale <s>      lowest resolution scale the frame budget may use (default 0.25)" << std::endl;
+    std::cout << "  --full-quality-motion keep full draw quality while the camera is moving" << std::endl;
+    std::cout << "  --texture-cache      show a cached low resolution preview of the texture on the first frames while it loads" << std::endl;
+    std::cout << "  --texture-cache-dir <dir> where the previews are cached (default $USDSIMPLECPP_TEXTURE_CACHE or ~/.cache)" << std::endl;
+    std::cout << "  --help               show this message" << std::endl;
+}
+
+bool ParseOptions(int argc, char **argv, AppOptions &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+
+        if (arg == "--help" || arg == "-h")
+        {
+            PrintUsage(argv[0]);
+            return false;
+        }
+        else if (arg == "--stage")
+        {
+            if (!NextValue(argc, argv, i, options.stageFile))
+                return false;
+        }
+        else if (arg == "--memory-report")
+        {
+            options.memoryReport = true;
+        }
+        else if (arg == "--threads")
+        {
+            if (!NextValue(argc, argv, i, options.threads))
+                return false;
+        }
+        else if (arg == "--pin-cores")
+        {
+            if (!NextValue(argc, argv, i, options.pinCores))
+                return false;
+        }
+        else if (arg == "--concurrency-report")
+        {
+            options.concurrencyReport = true;
+        }
+        else if (arg == "--cubes")
+        {
+            if (!NextValue(argc, argv, i, options.cubeCount))
+                return false;
+        }
+        else if (arg == "--author-layers")
+        {
+            if (!NextValue(argc, argv, i, options.authorLayers))
+                return false;
+        }
+        else if (arg == "--optimize-meshes")
+        {
+            options.optimizeMeshes = true;
+        }
+        else if (arg == "--foreign-buffers")
+        {
+            options.foreignBuffers = true;
+        }
+        else if (arg == "--ingest-report")
+        {
+            options.ingestReport = true;
+        }
+        else if (arg == "--quantize")
+        {
+            if (!NextValue(argc, argv, i, options.quantizeFile))
+                return false;
+        }
+        else if (arg == "--quantize-normals")
+        {
+            if (!NextValue(argc, argv, i, options.quantizeNormals))
+                return false;
+        }
+        else if (arg == "--quantize-bench")
+        {
+            if (!NextValue(argc, argv, i, options.quantizeBenchIterations))
+                return false;
+        }
+        else if (arg == "--lod")
+        {
+            if (!NextValue(argc, argv, i, options.lodLevels))
+                return false;
+        }
+        else if (arg == "--lod-error")
+        {
+            if (!NextValue(argc, argv, i, options.lodPixelError))
+                return false;
+        }
+        else if (arg == "--points")
+        {
+            if (!NextValue(argc, argv, i, options.pointCount))
+                return false;
+        }
+        else if (arg == "--point-chunk")
+        {
+            if (!NextValue(argc, argv, i, options.pointChunk))
+                return false;
+        }
+        else if (arg == "--point-density")
+        {
+            if (!NextValue(argc, argv, i, options.pointDensity))
+                return false;
+        }
+        else if (arg == "--capture")
+        {
+            if (!NextValue(argc, argv, i, options.captureDirectory))
+                return false;
+        }
+        else if (arg == "--capture-aovs")
+        {
+            options.captureAovs = true;
+        }
+        else if (arg == "--capture-frames")
+        {
+            if (!NextValue(argc, argv, i, options.captureFrames))
+                return false;
+        }
+        else if (arg == "--export-shm")
+        {
+            if (!NextValue(argc, argv, i, options.exportName))
+                return false;
+        }
+        else if (arg == "--batch")
+        {
+            if (!NextValue(argc, argv, i, options.batchDirectory))
+                return false;
+        }
+        else if (arg == "--batch-views")
+        {
+            if (!NextValue(argc, argv, i, options.batchViews))
+                return false;
+        }
+        else if (arg == "--batch-size")
+        {
+            if (!NextValue(argc, argv, i, options.batchSize))
+                return false;
+        }
+        else if (arg == "--batch-tiled")
+        {
+            options.batchTiled = true;
+        }
+        else if (arg == "--workers")
+        {
+            if (!NextValue(argc, argv, i, options.workers))
+                return false;
+        }
+        else if (arg == "--worker")
+        {
+            if (!NextValue(argc, argv, i, options.workerSocket))
+                return false;
+        }
+        else if (arg == "--compute-bench")
+        {
+            if (!NextValue(argc, argv, i, options.computeBenchFrames))
+                return false;
+        }
+        else if (arg == "--compute-grid")
+        {
+            if (!NextValue(argc, argv, i, options.computeGrid))
+                return false;
+        }
+        else if (arg == "--point-bench")
+        {
+            if (!NextValue(argc, argv, i, options.pointBenchFrames))
+                return false;
+        }
+        else if (arg == "--point-bench-max")
+        {
+            if (!NextValue(argc, argv, i, options.pointBenchMax))
+                return false;
+        }
+        else if (arg == "--turntable")
+        {
+            if (!NextValue(argc, argv, i, options.turntableFrames))
+                return false;
+        }
+        else if (arg == "--pick-report")
+        {
+            options.pickReport = true;
+        }
+        else if (arg == "--frame-budget")
+        {
+            if (!NextValue(argc, argv, i, options.frameBudgetMs))
+                return false;
+        }
+        else if (arg == "--min-scale")
+        {
+            if (!NextValue(argc, argv, i, options.minResolutionScale))
+                return false;
+        }
+        else if (arg == "--full-quality-motion")
+        {
+            options.motionAdaptiveQuality = false;
+        }
+        else if (arg == "--mask")
+        {
+            if (!NextValue(argc, argv, i, options.maskPaths))
+                return false;
+        }
+        else if (arg == "--prim-types")
+        {
+            if (!NextValue(argc, argv, i, options.primTypes))
+                return false;
+        }
+        else if (arg == "--stage-cache")
+        {
+            options.stageCache = true;
+        }
+        else if (arg == "--stage-cache-dir")
+        {
+            if (!NextValue(argc, argv, i, options.stageCacheDirectory))
+                return false;
+            options.stageCache = true;
+        }
+        else if (arg == "--texture-cache")
+        {
+            options.textureCache = true;
+        }
+        else if (arg == "--texture-cache-dir")
+        {
+            if (!NextValue(argc, argv, i, options.textureCacheDirectory))
+                return false;
+            options.textureCache = true;
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            PrintUsage(argv[0]);
+            return false;
+        }
+        else if (options.textureFile.empty())
+        {
+            options.textureFile = arg;
+        }
+        else
+        {
+            std::cerr << "Unexpected argument: " << arg << std::endl;
+            PrintUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
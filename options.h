@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// command line options for usdSimpleCpp
+struct AppOptions
+{
+    AppOptions()
+        : memoryReport(false), threads(0), pinCores(-1), concurrencyReport(false), frameBudgetMs(0.0), minResolutionScale(0.25f), motionAdaptiveQuality(true), stageCache(false), textureCache(false), cubeCount(0), authorLayers(0), optimizeMeshes(false), foreignBuffers(false), ingestReport(false), quantizeBenchIterations(0), lodLevels(0), lodPixelError(1.f), pointCount(0), pointChunk(65536), pointDensity(0.f), captureAovs(false), captureFrames(0), batchViews(8), batchSize(256), batchTiled(false), workers(0), computeBenchFrames(0), computeGrid(256), pointBenchFrames(0), pointBenchMax(16777216), turntableFrames(0), pickReport(false)
+    {}
+
+    // optional image used to texture the cube
+    std::string textureFile;
+
+    // open this stage instead of authoring the cube
+    std::string stageFile;
+    // only populate these prim paths (names may use * and ?) of the stage, and only keep boundables of these types
+    std::vector<std::string> maskPaths;
+    std::vector<std::string> primTypes;
+
+    // print a memory report once the first frame has been rendered
+    bool memoryReport;
+
+    // threads shared by USD and our own jobs (0 uses every core) and the first core to pin them to (-1 doesn't pin),
+    // USDSIMPLECPP_THREADS and USDSIMPLECPP_PIN_CORES are used when these aren't given
+    size_t threads;
+    int pinCores;
+    // print how well each phase (opening, authoring, bounds, sync) used the threads on exit
+    bool concurrencyReport;
+
+    // frame time budget, the render resolution is scaled down to hold it (0 disables)
+    double frameBudgetMs;
+    float minResolutionScale;
+
+    // draw proxies or bounds while the camera is moving
+    bool motionAdaptiveQuality;
+
+    // open --stage from a flattened copy written on the first open (off unless asked for), an empty directory uses
+    // the default location
+    bool stageCache;
+    std::string stageCacheDirectory;
+
+    // show a low resolution preview of the texture from the cache while the source loads, an empty directory uses
+    // the default location
+    bool textureCache;
+    std::string textureCacheDirectory;
+
+    // author a grid of this many cubes instead of a single one
+    size_t cubeCount;
+    // author the cubes in parallel into this many anonymous layers composed as sublayers (0 authors them serially
+    // and copies them into the root layer)
+    size_t authorLayers;
+
+    // weld duplicate vertices and reorder for the vertex caches before authoring
+    bool optimizeMeshes;
+
+    // lend the generated arrays to USD from one externally owned block instead of allocating each, and report what
+    // getting them into the layer allocated and copied
+    bool foreignBuffers;
+    bool ingestReport;
+
+    // write a flattened copy of the stage with only the encoded geometry to this .usdc, normals as "octahedral", "half"
+    // or "float", and time loading the stage with and without quantization over this many loads (0 doesn't)
+    std::string quantizeFile;
+    std::string quantizeNormals;
+    int quantizeBenchIterations;
+
+    // simplify meshes into an LOD variant set with this many levels below full resolution (0 disables), the viewer
+    // picks the coarsest level whose error projects to less than lodPixelError pixels
+    int lodLevels;
+    float lodPixelError;
+
+    // author a generated cloud of this many points instead of the cube (0 doesn't), spatially sorted into chunks of
+    // pointChunk points, each drawing about pointDensity points per pixel it covers (0 draws them all)
+    size_t pointCount;
+    size_t pointChunk;
+    float pointDensity;
+
+    // write every frame to a numbered image sequence in this directory (empty disables), optionally with the raw
+    // color/depth/id aovs, stopping after captureFrames frames if that's set
+    std::string captureDirectory;
+    bool captureAovs;
+    size_t captureFrames;
+
+    // publish frames into a shared memory ring with this name (empty disables)
+    std::string exportName;
+
+    // render batchViews orbit views (plus the stage's cameras) of batchSize pixels into this directory and exit,
+    // optionally as a single contact sheet
+    std::string batchDirectory;
+    int batchViews;
+    int batchSize;
+    bool batchTiled;
+
+    // split the batch across this many worker processes (0 renders it in this one), workers are started with
+    // workerSocket set to the driver's socket
+    int workers;
+    std::string workerSocket;
+
+    // time this many point updates through the stage and through the compute scene delegate, on a grid of
+    // computeGrid x computeGrid quads, and exit
+    int computeBenchFrames;
+    int computeGrid;
+
+    // time this many frames, full updates and partial updates of point clouds from 1M points up to pointBenchMax,
+    // and exit
+    int pointBenchFrames;
+    size_t pointBenchMax;
+
+    // orbit the camera a full turn over this many frames
+    size_t turntableFrames;
+
+    // print what each click picks
+    bool pickReport;
+};
+
+// returns false (after printing usage) if the command line could not be parsed
+bool ParseOptions(int argc, char **argv, AppOptions &options);
+void PrintUsage(const char *program);
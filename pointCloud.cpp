@@ -0,0 +1,452 @@
+#include "pointCloud.h"
+#include "foreignArray.h"
+
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/work/loops.h>
+#include <pxr/base/work/sort.h>
+#include <pxr/usd/sdf/attributeSpec.h>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/sdf/types.h>
+#include <pxr/usd/usdGeom/tokens.h>
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <utility>
+
+namespace
+{
+    const pxr::TfToken displayColorToken("primvars:displayColor");
+
+    double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // spread a cell index of up to 21 bits out to every third bit
+    uint64_t SpreadBits(float cell)
+    {
+        uint64_t v = (uint64_t)std::min(std::max(cell, 0.f), 2097151.f);
+        v = (v | v << 32) & 0x1f00000000ffffull;
+        v = (v | v << 16) & 0x1f0000ff0000ffull;
+        v = (v | v << 8) & 0x100f00f00f00f00full;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+        return v;
+    }
+
+    // 0 to count - 1 in bit reversed order, so every prefix is spread evenly over the range
+    std::vector<uint32_t> ReversedOrder(size_t count)
+    {
+        int bits = 0;
+        while (((size_t)1 << bits) < count)
+            bits++;
+        std::vector<uint32_t> order;
+        order.reserve(count);
+        for (size_t i = 0; i < ((size_t)1 << bits); ++i)
+        {
+            size_t reversed = 0;
+            for (int bit = 0; bit < bits; ++bit)
+                reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+            if (reversed < count)
+                order.push_back((uint32_t)reversed);
+        }
+        return order;
+    }
+
+    template <class T>
+    void SetValue(const pxr::SdfLayerHandle &layer, const pxr::SdfPath &primPath, const pxr::TfToken &name, const pxr::SdfValueTypeName &type,
+                  const pxr::VtArray<T> &value, const pxr::TfToken &interpolation = pxr::TfToken())
+    {
+        auto attr = layer->GetAttributeAtPath(primPath.AppendProperty(name));
+        if (!attr)
+        {
+            auto primSpec = pxr::SdfCreatePrimInLayer(layer, primPath);
+            if (!primSpec)
+                return;
+            attr = pxr::SdfAttributeSpec::New(primSpec, name.GetString(), type);
+            if (!attr)
+                return;
+            if (!interpolation.IsEmpty())
+                attr->SetInfo(pxr::UsdGeomTokens->interpolation, pxr::VtValue(interpolation));
+        }
+        attr->SetDefaultValue(pxr::VtValue(value));
+    }
+
+    void ClearValue(const pxr::SdfLayerHandle &layer, const pxr::SdfPath &primPath, const pxr::TfToken &name)
+    {
+        auto primSpec = layer->GetPrimAtPath(primPath);
+        auto attr = layer->GetAttributeAtPath(primPath.AppendProperty(name));
+        if (primSpec && attr)
+            primSpec->RemoveProperty(attr);
+    }
+
+    // the first count values of array, lent from its storage rather than copied
+    template <class T>
+    pxr::VtArray<T> Prefix(const pxr::VtArray<T> &array, size_t count)
+    {
+        // the callback's copy keeps the storage alive until the last array made from it goes
+        ForeignBuffer *buffer = ForeignBuffer::Lend((void *)array.cdata(), array.size() * sizeof(T), [array]() {});
+        pxr::VtArray<T> prefix = buffer->Wrap<T>(0, count);
+        buffer->Release();
+        return prefix;
+    }
+
+    float Terrain(float x, float z)
+    {
+        return 0.2f * std::sin(3.f * x) * std::cos(3.f * z);
+    }
+
+    // a well mixed 32 bit hash of i, as a float in [0, 1)
+    float Random(uint64_t i)
+    {
+        i += 0x9e3779b97f4a7c15ull;
+        i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ull;
+        i = (i ^ (i >> 27)) * 0x94d049bb133111ebull;
+        i ^= i >> 31;
+        return (float)(i >> 40) / (float)(1 << 24);
+    }
+}
+
+PointCloud::PointCloud()
+    : pointCount(0), perPointWidths(false), perPointColors(false)
+{
+}
+
+bool PointCloud::Author(const pxr::UsdStageRefPtr &authorStage, const pxr::SdfPath &path, const pxr::VtVec3fArray &points, const pxr::VtFloatArray &widths,
+                        const pxr::VtVec3fArray &colors, const PointCloudSettings &cloudSettings)
+{
+    report = PointCloudReport();
+    chunks.clear();
+    source.clear();
+    stage = authorStage;
+    settings = cloudSettings;
+    settings.chunkPoints = std::max<size_t>(settings.chunkPoints, 1);
+    pointCount = points.size();
+    if (!authorStage || points.empty())
+        return false;
+    if (pointCount > (size_t)UINT32_MAX)
+    {
+        std::cerr << "Unable to author " << pointCount << " points, a cloud holds at most " << UINT32_MAX << std::endl;
+        return false;
+    }
+
+    layer = authorStage->GetEditTarget().GetLayer();
+    if (layer->GetPrimAtPath(path))
+    {
+        std::cerr << "Unable to author a point cloud at " << path << ", there's already a prim there" << std::endl;
+        return false;
+    }
+
+    perPointWidths = widths.size() == pointCount && pointCount > 1;
+    perPointColors = colors.size() == pointCount && pointCount > 1;
+    constantWidths = !perPointWidths && widths.size() == 1 ? widths : pxr::VtFloatArray();
+    constantColors = !perPointColors && colors.size() == 1 ? colors : pxr::VtVec3fArray();
+    if (!perPointWidths && constantWidths.empty() && !widths.empty())
+        std::cerr << "Ignoring " << widths.size() << " widths for " << pointCount << " points" << std::endl;
+    if (!perPointColors && constantColors.empty() && !colors.empty())
+        std::cerr << "Ignoring " << colors.size() << " colors for " << pointCount << " points" << std::endl;
+
+    // sort along a Morton curve over the cloud's bounds, neighbours in the order are neighbours in space
+    auto sortStart = std::chrono::high_resolution_clock::now();
+    pxr::GfRange3f bounds;
+    for (const auto &point : points)
+        bounds.UnionWith(point);
+    pxr::GfVec3f size = bounds.GetSize();
+    float scale = 2097151.f / std::max({ size[0], size[1], size[2], 1e-20f });
+
+    std::vector<std::pair<uint64_t, uint32_t>> keys(pointCount);
+    pxr::WorkParallelForN(pointCount, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            pxr::GfVec3f cell = (points[i] - bounds.GetMin()) * scale;
+            keys[i].first = SpreadBits(cell[0]) | SpreadBits(cell[1]) << 1 | SpreadBits(cell[2]) << 2;
+            keys[i].second = (uint32_t)i;
+        }
+    });
+    pxr::WorkParallelSort(&keys);
+
+    // cut the curve into chunks and reverse the bits of the order within each
+    size_t chunkCount = (pointCount + settings.chunkPoints - 1) / settings.chunkPoints;
+    chunks.resize(chunkCount);
+    source.resize(pointCount);
+    std::vector<uint32_t> fullOrder = ReversedOrder(std::min(settings.chunkPoints, pointCount));
+    std::vector<uint32_t> lastOrder = ReversedOrder(pointCount - (chunkCount - 1) * settings.chunkPoints);
+    pxr::WorkParallelForN(chunkCount, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            Chunk &chunk = chunks[i];
+            chunk.path = path.AppendChild(pxr::TfToken("chunk" + std::to_string(i)));
+            chunk.first = i * settings.chunkPoints;
+            const auto &order = i + 1 == chunkCount ? lastOrder : fullOrder;
+            for (size_t k = 0; k < order.size(); ++k)
+                source[chunk.first + k] = keys[chunk.first + order[k]].second;
+
+            Gather(points, chunk, chunk.points);
+            if (perPointWidths)
+                Gather(widths, chunk, chunk.widths);
+            if (perPointColors)
+                Gather(colors, chunk, chunk.colors);
+            chunk.drawn = chunk.points.size();
+            ComputeBounds(chunk);
+        }
+    });
+    report.sortMs = MillisecondsSince(sortStart);
+
+    auto authorStart = std::chrono::high_resolution_clock::now();
+    {
+        // every chunk in one change block, the stage recomposes once
+        pxr::SdfChangeBlock changeBlock;
+        auto xformSpec = pxr::SdfCreatePrimInLayer(layer, path);
+        if (!xformSpec)
+            return false;
+        xformSpec->SetSpecifier(pxr::SdfSpecifierDef);
+        xformSpec->SetTypeName("Xform");
+        for (const auto &chunk : chunks)
+            AuthorChunk(chunk, true);
+    }
+    report.authorMs = MillisecondsSince(authorStart);
+    report.points = pointCount;
+    report.chunks = chunks.size();
+    report.pointsDrawn = pointCount;
+    return true;
+}
+
+template <class T>
+void PointCloud::Gather(const pxr::VtArray<T> &values, const Chunk &chunk, pxr::VtArray<T> &gathered)
+{
+    size_t count = std::min(settings.chunkPoints, pointCount - chunk.first);
+    gathered.resize(count);
+    // one write pointer so the array only detaches once
+    T *data = gathered.data();
+    const T *in = values.cdata();
+    const uint32_t *indices = source.data() + chunk.first;
+    for (size_t k = 0; k < count; ++k)
+        data[k] = in[indices[k]];
+}
+
+void PointCloud::ComputeBounds(Chunk &chunk)
+{
+    chunk.bounds = pxr::GfRange3f();
+    for (const auto &point : chunk.points)
+        chunk.bounds.UnionWith(point);
+
+    // points are drawn as spheres or discs, pad by the widest radius
+    float width = constantWidths.empty() ? 0.f : constantWidths[0];
+    for (float pointWidth : chunk.widths)
+        width = std::max(width, pointWidth);
+    pxr::GfVec3f pad(0.5f * width);
+    chunk.bounds = pxr::GfRange3f(chunk.bounds.GetMin() - pad, chunk.bounds.GetMax() + pad);
+}
+
+void PointCloud::AuthorChunk(const Chunk &chunk, bool create)
+{
+    if (create)
+    {
+        auto primSpec = pxr::SdfCreatePrimInLayer(layer, chunk.path);
+        if (!primSpec)
+            return;
+        primSpec->SetSpecifier(pxr::SdfSpecifierDef);
+        primSpec->SetTypeName("Points");
+        if (!constantWidths.empty())
+            SetValue(layer, chunk.path, pxr::UsdGeomTokens->widths, pxr::SdfValueTypeNames->FloatArray, constantWidths, pxr::UsdGeomTokens->constant);
+        if (!constantColors.empty())
+            SetValue(layer, chunk.path, displayColorToken, pxr::SdfValueTypeNames->Color3fArray, constantColors, pxr::UsdGeomTokens->constant);
+    }
+
+    pxr::VtVec3fArray extent(2);
+    extent[0] = chunk.bounds.GetMin();
+    extent[1] = chunk.bounds.GetMax();
+    SetValue(layer, chunk.path, pxr::UsdGeomTokens->points, pxr::SdfValueTypeNames->Point3fArray, chunk.points);
+    SetValue(layer, chunk.path, pxr::UsdGeomTokens->extent, pxr::SdfValueTypeNames->Float3Array, extent);
+    if (perPointWidths)
+        SetValue(layer, chunk.path, pxr::UsdGeomTokens->widths, pxr::SdfValueTypeNames->FloatArray, chunk.widths, pxr::UsdGeomTokens->vertex);
+    if (perPointColors)
+        SetValue(layer, chunk.path, displayColorToken, pxr::SdfValueTypeNames->Color3fArray, chunk.colors, pxr::UsdGeomTokens->vertex);
+}
+
+void PointCloud::AuthorDrawn(const Chunk &chunk)
+{
+    auto lockedStage = stage;
+    if (!lockedStage)
+        return;
+    auto sessionLayer = lockedStage->GetSessionLayer();
+
+    // the interpolation comes from the authored layer, the session only overrides the values
+    if (chunk.drawn >= chunk.points.size())
+    {
+        ClearValue(sessionLayer, chunk.path, pxr::UsdGeomTokens->points);
+        ClearValue(sessionLayer, chunk.path, pxr::UsdGeomTokens->widths);
+        ClearValue(sessionLayer, chunk.path, displayColorToken);
+        return;
+    }
+    SetValue(sessionLayer, chunk.path, pxr::UsdGeomTokens->points, pxr::SdfValueTypeNames->Point3fArray, Prefix(chunk.points, chunk.drawn));
+    if (perPointWidths)
+        SetValue(sessionLayer, chunk.path, pxr::UsdGeomTokens->widths, pxr::SdfValueTypeNames->FloatArray, Prefix(chunk.widths, chunk.drawn));
+    if (perPointColors)
+        SetValue(sessionLayer, chunk.path, displayColorToken, pxr::SdfValueTypeNames->Color3fArray, Prefix(chunk.colors, chunk.drawn));
+}
+
+size_t PointCloud::Update(const pxr::VtVec3fArray &points, const pxr::VtFloatArray &widths, const pxr::VtVec3fArray &colors)
+{
+    report.chunksUpdated = 0;
+    report.updateMs = 0.0;
+    if (chunks.empty() || !stage)
+        return 0;
+    if (points.size() != pointCount)
+    {
+        std::cerr << "Unable to update a cloud of " << pointCount << " points with " << points.size() << " points" << std::endl;
+        return 0;
+    }
+    bool updateWidths = perPointWidths && widths.size() == pointCount;
+    bool updateColors = perPointColors && colors.size() == pointCount;
+    if ((!widths.empty() && !updateWidths) || (!colors.empty() && !updateColors))
+        std::cerr << "Only per point widths and colors of a cloud authored with them can be updated, ignoring them" << std::endl;
+
+    // gather every chunk and keep the ones that changed, comparing costs far less than authoring and syncing
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<char> changed(chunks.size(), 0);
+    pxr::WorkParallelForN(chunks.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            Chunk &chunk = chunks[i];
+            pxr::VtVec3fArray chunkPoints, chunkColors;
+            pxr::VtFloatArray chunkWidths;
+            Gather(points, chunk, chunkPoints);
+            if (chunkPoints != chunk.points)
+            {
+                chunk.points = chunkPoints;
+                changed[i] = 1;
+            }
+            if (updateWidths)
+            {
+                Gather(widths, chunk, chunkWidths);
+                if (chunkWidths != chunk.widths)
+                {
+                    chunk.widths = chunkWidths;
+                    changed[i] = 1;
+                }
+            }
+            if (updateColors)
+            {
+                Gather(colors, chunk, chunkColors);
+                if (chunkColors != chunk.colors)
+                {
+                    chunk.colors = chunkColors;
+                    changed[i] = 1;
+                }
+            }
+            if (changed[i])
+                ComputeBounds(chunk);
+        }
+    });
+
+    {
+        pxr::SdfChangeBlock changeBlock;
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            if (!changed[i])
+                continue;
+            AuthorChunk(chunks[i], false);
+            // the prefix on the session layer still points at the old arrays
+            if (chunks[i].drawn < chunks[i].points.size())
+                AuthorDrawn(chunks[i]);
+            report.chunksUpdated++;
+        }
+    }
+    report.updateMs = MillisecondsSince(start);
+    return report.chunksUpdated;
+}
+
+void PointCloud::Decimate(const glm::vec3 &eye, const glm::mat4 &projection, float viewportHeight)
+{
+    if (chunks.empty() || !stage)
+        return;
+
+    // pixels covered by one world unit at unit distance, as the LOD selector projects its errors
+    float pixelsPerUnit = projection[1][1] * 0.5f * viewportHeight;
+
+    report.pointsDrawn = 0;
+    report.chunksDecimated = 0;
+    pxr::SdfChangeBlock changeBlock;
+    for (auto &chunk : chunks)
+    {
+        size_t count = chunk.points.size();
+        size_t drawn = count;
+        if (settings.density > 0.f)
+        {
+            pxr::GfVec3f mid = chunk.bounds.GetMidpoint();
+            glm::vec3 center(mid[0], mid[1], mid[2]);
+            float radius = 0.5f * (float)chunk.bounds.GetSize().GetLength();
+            float distance = std::max(glm::length(eye - center) - radius, 1e-4f);
+            float radiusPixels = radius * pixelsPerUnit / distance;
+            double wanted = std::max((double)settings.minPoints, (double)settings.density * M_PI * (double)radiusPixels * (double)radiusPixels);
+
+            // halve while that still covers the pixels, only switching between powers of two keeps the arrays the
+            // session layer holds from changing with every small camera move
+            while (drawn > 1 && (double)(drawn / 2) >= wanted)
+                drawn /= 2;
+        }
+
+        if (drawn != chunk.drawn)
+        {
+            chunk.drawn = drawn;
+            AuthorDrawn(chunk);
+        }
+        report.pointsDrawn += drawn;
+        if (drawn < count)
+            report.chunksDecimated++;
+    }
+}
+
+void MakePointCloud(size_t count, pxr::VtVec3fArray &points, pxr::VtVec3fArray &colors)
+{
+    points.resize(count);
+    colors.resize(count);
+    // one write pointer each so the arrays only detach once
+    pxr::GfVec3f *pointData = points.data();
+    pxr::GfVec3f *colorData = colors.data();
+    pxr::WorkParallelForN(count, [pointData, colorData](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            float x = 2.f * Random(2 * i) - 1.f, z = 2.f * Random(2 * i + 1) - 1.f;
+            float y = Terrain(x, z);
+            pointData[i] = pxr::GfVec3f(x, y, z);
+            // low ground green, high ground sandy
+            float height = std::min(std::max(y / 0.4f + 0.5f, 0.f), 1.f);
+            colorData[i] = pxr::GfVec3f(0.2f + 0.6f * height, 0.5f + 0.2f * height, 0.2f + 0.3f * height);
+        }
+    });
+}
+
+void UpdatePointCloudWave(pxr::VtVec3fArray &points, float time, float maxX)
+{
+    pxr::GfVec3f *data = points.data();
+    pxr::WorkParallelForN(points.size(), [data, time, maxX](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            float x = data[i][0], z = data[i][2];
+            if (x < maxX)
+                data[i][1] = Terrain(x, z) + 0.05f * std::sin(8.f * x - 3.f * time);
+        }
+    });
+}
+
+void PrintPointCloudReport(const PointCloudReport &report, std::ostream &out)
+{
+    out << "Point cloud: " << report.points << " points in " << report.chunks << " chunks, sorted in " << report.sortMs << " ms, authored in "
+        << report.authorMs << " ms" << std::endl;
+    if (report.chunksUpdated > 0)
+        out << "    last update authored " << report.chunksUpdated << " chunks in " << report.updateMs << " ms" << std::endl;
+    if (report.chunksDecimated > 0)
+        out << "    drawing " << report.pointsDrawn << " points, " << report.chunksDecimated << " chunks decimated" << std::endl;
+}
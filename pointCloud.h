@@ -0,0 +1,112 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/base/gf/range3f.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/usd/stage.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+struct PointCloudSettings
+{
+    PointCloudSettings()
+        : chunkPoints(65536), density(0.f), minPoints(256)
+    {}
+
+    // most points in one chunk, each chunk is a UsdGeomPoints of its own that Hydra culls and updates on its own
+    size_t chunkPoints;
+    // points drawn per pixel a chunk covers on screen, 0 draws every point
+    float density;
+    // decimation never leaves a chunk with fewer points than this
+    size_t minPoints;
+};
+
+struct PointCloudReport
+{
+    PointCloudReport()
+        : points(0), chunks(0), sortMs(0.0), authorMs(0.0), chunksUpdated(0), updateMs(0.0), pointsDrawn(0), chunksDecimated(0)
+    {}
+
+    size_t points, chunks;
+    double sortMs, authorMs;
+    // from the last Update
+    size_t chunksUpdated;
+    double updateMs;
+    // from the last Decimate
+    size_t pointsDrawn, chunksDecimated;
+};
+
+// a cloud of unconnected points authored as spatially sorted UsdGeomPoints chunks under one Xform
+//
+// the points are sorted along a Morton curve and cut into runs of chunkPoints, so each chunk is compact and gets a
+// tight extent. within a chunk they're stored in bit reversed order, which makes every prefix an even subsample of
+// the chunk: decimation draws a prefix, lent to the session layer without copying, and the full arrays on the
+// authored layer are never touched. everything is authored with the Sdf API in one change block per call
+class PointCloud
+{
+public:
+    PointCloud();
+
+    // widths and colors hold a value per point, one for the whole cloud, or nothing. the cloud is authored on the
+    // stage's edit target under path, which shouldn't exist yet
+    bool Author(const pxr::UsdStageRefPtr &stage, const pxr::SdfPath &path, const pxr::VtVec3fArray &points, const pxr::VtFloatArray &widths,
+                const pxr::VtVec3fArray &colors, const PointCloudSettings &settings);
+    // new positions in the order they were authored in (and per point widths and colors if they were authored
+    // that way, empty leaves them). only the chunks that changed are authored again, returns how many
+    size_t Update(const pxr::VtVec3fArray &points, const pxr::VtFloatArray &widths = pxr::VtFloatArray(), const pxr::VtVec3fArray &colors = pxr::VtVec3fArray());
+    // pick how many points each chunk draws from the pixels it covers, as seen from eye
+    void Decimate(const glm::vec3 &eye, const glm::mat4 &projection, float viewportHeight);
+
+    size_t GetChunkCount() { return chunks.size(); }
+    const PointCloudReport &GetReport() { return report; }
+
+protected:
+    struct Chunk
+    {
+        Chunk() : first(0), drawn(0) {}
+
+        pxr::SdfPath path;
+        // where the chunk starts in the sorted order
+        size_t first;
+        // in the chunk's bit reversed order
+        pxr::VtVec3fArray points, colors;
+        pxr::VtFloatArray widths;
+        pxr::GfRange3f bounds;
+        // points the decimation draws, all of them unless it's less than points.size()
+        size_t drawn;
+    };
+
+    template <class T>
+    void Gather(const pxr::VtArray<T> &source, const Chunk &chunk, pxr::VtArray<T> &gathered);
+    void ComputeBounds(Chunk &chunk);
+    // the full arrays on the authored layer, create defines the prim and the values that don't change
+    void AuthorChunk(const Chunk &chunk, bool create);
+    // the prefix the decimation draws on the session layer, nothing when every point is drawn
+    void AuthorDrawn(const Chunk &chunk);
+
+    pxr::UsdStageWeakPtr stage;
+    pxr::SdfLayerHandle layer;
+    PointCloudSettings settings;
+    std::vector<Chunk> chunks;
+    // the index the point at each sorted and reversed position was given in
+    std::vector<uint32_t> source;
+    size_t pointCount;
+    // per point values live in the chunks, a single value for the cloud is authored on every chunk as constant
+    bool perPointWidths, perPointColors;
+    pxr::VtFloatArray constantWidths;
+    pxr::VtVec3fArray constantColors;
+    PointCloudReport report;
+};
+
+// count points over a rolling terrain in [-1, 1] in x and z, coloured by height
+void MakePointCloud(size_t count, pxr::VtVec3fArray &points, pxr::VtVec3fArray &colors);
+// move the points of MakePointCloud to a travelling wave at time seconds, only those with x below maxX
+void UpdatePointCloudWave(pxr::VtVec3fArray &points, float time, float maxX = 1.f);
+
+void PrintPointCloudReport(const PointCloudReport &report, std::ostream &out);
@@ -0,0 +1,155 @@
+#include "pointCloudBenchmark.h"
+#include "pointCloud.h"
+
+#include <GL/glew.h>
+
+#include <pxr/base/gf/frustum.h>
+#include <pxr/imaging/hd/aov.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usdImaging/usdImagingGL/engine.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+namespace
+{
+    // how far the region of a partial update reaches in x, the cloud spans [-1, 1]
+    const float partialMaxX = -0.8f;
+
+    double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void SetupEngine(pxr::UsdImagingGLEngine &engine, const pxr::TfToken &rendererPlugin, const PointCloudBenchmarkSettings &settings)
+    {
+        if (!rendererPlugin.IsEmpty())
+            engine.SetRendererPlugin(rendererPlugin);
+
+        // looking down at the cloud from one corner
+        pxr::GfMatrix4d view;
+        view.SetLookAt(pxr::GfVec3d(0.0, 1.5, 2.5), pxr::GfVec3d(0.0), pxr::GfVec3d(0.0, 1.0, 0.0));
+        pxr::GfFrustum frustum;
+        frustum.SetPerspective(45.0, (double)settings.width / (double)settings.height, 0.1, 100.0);
+
+        engine.SetCameraState(view, frustum.ComputeProjectionMatrix());
+        engine.SetRenderBufferSize(pxr::GfVec2i(settings.width, settings.height));
+        engine.SetRenderViewport(pxr::GfVec4d(0, 0, settings.width, settings.height));
+        engine.SetRendererAov(pxr::HdAovTokens->color);
+        engine.SetWindowPolicy(pxr::CameraUtilConformWindowPolicy::CameraUtilFit);
+    }
+
+    // warm up, then time frames frames, update changes the cloud and returns how long PointCloud::Update took
+    void TimeFrames(const PointCloudBenchmarkSettings &settings, std::vector<double> *updateMs, std::vector<double> &totalMs,
+                    const std::function<double(int)> &update, const std::function<void()> &render)
+    {
+        for (int frame = -settings.warmupFrames; frame < settings.frames; ++frame)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            double ms = update(frame);
+            render();
+            glFinish();
+            double total = MillisecondsSince(start);
+            if (frame < 0)
+                continue;
+            if (updateMs)
+                updateMs->push_back(ms);
+            totalMs.push_back(total);
+        }
+    }
+
+    void PrintTimes(const char *label, std::vector<double> times, std::ostream &out)
+    {
+        if (times.empty())
+            return;
+        std::sort(times.begin(), times.end());
+        double total = 0.0;
+        for (double time : times)
+            total += time;
+        out << label << total / (double)times.size() << " ms average, " << times[times.size() / 2] << " median, "
+            << times[std::min(times.size() - 1, times.size() * 95 / 100)] << " p95" << std::endl;
+    }
+}
+
+bool RunPointCloudBenchmark(const pxr::TfToken &rendererPlugin, const PointCloudBenchmarkSettings &settings, PointCloudBenchmarkReport &report)
+{
+    report = PointCloudBenchmarkReport();
+    if (settings.frames <= 0)
+        return false;
+
+    pxr::UsdImagingGLRenderParams params;
+    params.enableLighting = false;
+    params.clearColor = pxr::GfVec4f(0.f, 0.f, 0.f, 1.f);
+
+    PointCloudSettings cloudSettings;
+    cloudSettings.chunkPoints = settings.chunkPoints;
+    pxr::VtFloatArray widths(1, 0.004f);
+
+    for (size_t count = std::min<size_t>(1 << 20, settings.maxPoints); count <= settings.maxPoints; count *= 4)
+    {
+        PointCloudBenchmarkStep step;
+        step.points = count;
+
+        // a stage and engine per size so nothing synced for the last one is still around
+        pxr::VtVec3fArray points, colors;
+        MakePointCloud(count, points, colors);
+        auto stage = pxr::UsdStage::CreateInMemory();
+        PointCloud cloud;
+        if (!cloud.Author(stage, pxr::SdfPath("/cloud"), points, widths, colors, cloudSettings))
+            return false;
+        // the generated colors aren't needed again, the chunks hold their own
+        colors = pxr::VtVec3fArray();
+        step.chunks = cloud.GetChunkCount();
+        step.sortMs = cloud.GetReport().sortMs;
+        step.authorMs = cloud.GetReport().authorMs;
+
+        pxr::UsdImagingGLEngine engine;
+        SetupEngine(engine, rendererPlugin, settings);
+        auto render = [&]() { engine.Render(stage->GetPseudoRoot(), params); };
+
+        auto start = std::chrono::high_resolution_clock::now();
+        render();
+        glFinish();
+        step.firstFrameMs = MillisecondsSince(start);
+
+        TimeFrames(settings, nullptr, step.staticMs, [](int) { return 0.0; }, render);
+
+        // computing the points isn't part of the update, only handing them over
+        int frameOffset = 0;
+        TimeFrames(settings, &step.fullUpdateMs, step.fullTotalMs, [&](int frame)
+        {
+            UpdatePointCloudWave(points, (float)(frame + frameOffset) / 60.f);
+            auto updateStart = std::chrono::high_resolution_clock::now();
+            cloud.Update(points);
+            return MillisecondsSince(updateStart);
+        }, render);
+
+        frameOffset = settings.frames + settings.warmupFrames;
+        TimeFrames(settings, &step.partialUpdateMs, step.partialTotalMs, [&](int frame)
+        {
+            UpdatePointCloudWave(points, (float)(frame + frameOffset) / 60.f, partialMaxX);
+            auto updateStart = std::chrono::high_resolution_clock::now();
+            step.partialChunks = cloud.Update(points);
+            return MillisecondsSince(updateStart);
+        }, render);
+
+        report.steps.push_back(step);
+    }
+    return true;
+}
+
+void PrintPointCloudBenchmark(const PointCloudBenchmarkReport &report, std::ostream &out)
+{
+    for (const auto &step : report.steps)
+    {
+        out << step.points << " points in " << step.chunks << " chunks: sorted in " << step.sortMs << " ms, authored in " << step.authorMs
+            << " ms, first frame " << step.firstFrameMs << " ms" << std::endl;
+        PrintTimes("    static frame    ", step.staticMs, out);
+        PrintTimes("    full update     ", step.fullUpdateMs, out);
+        PrintTimes("    full to pixels  ", step.fullTotalMs, out);
+        out << "    partial update of " << step.partialChunks << " chunks" << std::endl;
+        PrintTimes("    partial update  ", step.partialUpdateMs, out);
+        PrintTimes("    partial pixels  ", step.partialTotalMs, out);
+    }
+}
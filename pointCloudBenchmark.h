@@ -0,0 +1,52 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/base/tf/token.h>
+
+#include <iostream>
+#include <vector>
+
+struct PointCloudBenchmarkSettings
+{
+    PointCloudBenchmarkSettings()
+        : frames(0), maxPoints(16777216), chunkPoints(65536), width(1280), height(720), warmupFrames(4)
+    {}
+
+    // timed frames per measurement, 0 disables the benchmark
+    int frames;
+    // clouds of 1M points, then four times as many each step up to this
+    size_t maxPoints;
+    size_t chunkPoints;
+    int width, height;
+    // rendered first and not timed, the first sync allocates everything
+    int warmupFrames;
+};
+
+struct PointCloudBenchmarkStep
+{
+    PointCloudBenchmarkStep()
+        : points(0), chunks(0), sortMs(0.0), authorMs(0.0), firstFrameMs(0.0), partialChunks(0)
+    {}
+
+    size_t points, chunks;
+    double sortMs, authorMs;
+    // the first frame syncs every chunk
+    double firstFrameMs;
+    // frame times with nothing changing
+    std::vector<double> staticMs;
+    // every point moving: PointCloud::Update alone, and until the GPU has finished the frame
+    std::vector<double> fullUpdateMs, fullTotalMs;
+    // the points in one tenth of the cloud moving, and the chunks that took
+    std::vector<double> partialUpdateMs, partialTotalMs;
+    size_t partialChunks;
+};
+
+struct PointCloudBenchmarkReport
+{
+    std::vector<PointCloudBenchmarkStep> steps;
+};
+
+// author a generated cloud of increasing size through PointCloud and time its frames, full updates and updates of a
+// small region. the GL context has to be current
+bool RunPointCloudBenchmark(const pxr::TfToken &rendererPlugin, const PointCloudBenchmarkSettings &settings, PointCloudBenchmarkReport &report);
+void PrintPointCloudBenchmark(const PointCloudBenchmarkReport &report, std::ostream &out);
@@ -0,0 +1,253 @@
+#include "pointCloud.h"
+#include "testing.h"
+
+#include <pxr/usd/usdGeom/points.h>
+
+#include <glm/mat4x4.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+
+namespace
+{
+    const pxr::SdfPath cloudPath("/cloud");
+
+    using PointKey = std::tuple<float, float, float>;
+
+    PointKey Key(const pxr::GfVec3f &point)
+    {
+        return PointKey(point[0], point[1], point[2]);
+    }
+
+    pxr::SdfPath ChunkPath(size_t chunk)
+    {
+        return cloudPath.AppendChild(pxr::TfToken("chunk" + std::to_string(chunk)));
+    }
+
+    // what the stage composes, the decimated prefix if the session layer holds one
+    pxr::VtVec3fArray ComposedPoints(const pxr::UsdStageRefPtr &stage, size_t chunk)
+    {
+        pxr::VtVec3fArray points;
+        pxr::UsdGeomPoints(stage->GetPrimAtPath(ChunkPath(chunk))).GetPointsAttr().Get(&points);
+        return points;
+    }
+
+    // the full arrays on the root layer
+    pxr::VtVec3fArray AuthoredPoints(const pxr::UsdStageRefPtr &stage, size_t chunk)
+    {
+        auto attr = stage->GetRootLayer()->GetAttributeAtPath(ChunkPath(chunk).AppendProperty(pxr::UsdGeomTokens->points));
+        return attr ? attr->GetDefaultValue().GetWithDefault<pxr::VtVec3fArray>() : pxr::VtVec3fArray();
+    }
+
+    // points along the x axis at 0, 1, 2 ..., so the Morton order is the order of x and each chunk a run of it
+    pxr::VtVec3fArray MakeLine(size_t count)
+    {
+        pxr::VtVec3fArray points;
+        for (size_t i = 0; i < count; ++i)
+            points.push_back(pxr::GfVec3f((float)i, 0.f, 0.f));
+        return points;
+    }
+
+    void TestEveryPointAuthoredOnce()
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        pxr::VtVec3fArray points, colors;
+        MakePointCloud(1000, points, colors);
+        std::map<PointKey, pxr::GfVec3f> original;
+        for (size_t i = 0; i < points.size(); ++i)
+            original[Key(points[i])] = colors[i];
+        CHECK(original.size() == points.size());
+
+        PointCloudSettings settings;
+        settings.chunkPoints = 256;
+        PointCloud cloud;
+        CHECK(cloud.Author(stage, cloudPath, points, pxr::VtFloatArray(1, 0.01f), colors, settings));
+        CHECK(cloud.GetChunkCount() == 4);
+        CHECK(cloud.GetReport().points == 1000 && cloud.GetReport().chunks == 4);
+        CHECK(stage->GetPrimAtPath(cloudPath).GetTypeName() == pxr::TfToken("Xform"));
+
+        std::set<PointKey> seen;
+        for (size_t chunk = 0; chunk < cloud.GetChunkCount(); ++chunk)
+        {
+            pxr::UsdGeomPoints prim(stage->GetPrimAtPath(ChunkPath(chunk)));
+            CHECK(prim);
+            pxr::VtVec3fArray chunkPoints, chunkColors, extent;
+            pxr::VtFloatArray widths;
+            CHECK(prim.GetPointsAttr().Get(&chunkPoints));
+            CHECK(chunkPoints.size() == (chunk < 3 ? 256 : 232));
+            CHECK(prim.GetDisplayColorAttr().Get(&chunkColors) && chunkColors.size() == chunkPoints.size());
+            CHECK(prim.GetWidthsAttr().Get(&widths) && widths.size() == 1 && prim.GetWidthsInterpolation() == pxr::UsdGeomTokens->constant);
+            CHECK(prim.GetExtentAttr().Get(&extent) && extent.size() == 2);
+            if (chunkColors.size() != chunkPoints.size() || extent.size() != 2)
+                continue;
+
+            pxr::GfRange3f bounds(extent[0], extent[1]);
+            for (size_t i = 0; i < chunkPoints.size(); ++i)
+            {
+                CHECK(seen.insert(Key(chunkPoints[i])).second);
+                // each point keeps its own color through the sort
+                auto found = original.find(Key(chunkPoints[i]));
+                CHECK(found != original.end() && found->second == chunkColors[i]);
+                CHECK(bounds.Contains(chunkPoints[i]));
+            }
+        }
+        CHECK(seen.size() == points.size());
+
+        // a second cloud can't go where the first one is
+        PointCloud again;
+        CHECK(!again.Author(stage, cloudPath, points, pxr::VtFloatArray(), pxr::VtVec3fArray(), settings));
+    }
+
+    void TestPrefixesAreEvenSubsamples()
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        PointCloudSettings settings;
+        settings.chunkPoints = 16;
+        settings.density = 1.f;
+        settings.minPoints = 4;
+        PointCloud cloud;
+        CHECK(cloud.Author(stage, cloudPath, MakeLine(70), pxr::VtFloatArray(), pxr::VtVec3fArray(), settings));
+        CHECK(cloud.GetChunkCount() == 5);
+
+        // every power of two prefix of a full chunk is every 16 / n th point of its run
+        for (size_t chunk = 0; chunk < 4; ++chunk)
+        {
+            pxr::VtVec3fArray chunkPoints = AuthoredPoints(stage, chunk);
+            CHECK(chunkPoints.size() == 16);
+            if (chunkPoints.size() != 16)
+                continue;
+            for (size_t count = 1; count <= 16; count *= 2)
+            {
+                std::set<float> prefix;
+                for (size_t i = 0; i < count; ++i)
+                    prefix.insert(chunkPoints[i][0]);
+                std::set<float> even;
+                for (size_t x = 0; x < 16; x += 16 / count)
+                    even.insert((float)(chunk * 16 + x));
+                CHECK(prefix == even);
+            }
+        }
+        // the short last chunk still holds the rest of the line
+        pxr::VtVec3fArray last = AuthoredPoints(stage, 4);
+        std::set<float> rest;
+        for (const auto &point : last)
+            rest.insert(point[0]);
+        CHECK(last.size() == 6 && rest.size() == 6 && *rest.begin() == 64.f && *rest.rbegin() == 69.f);
+
+        // seen from far away every full chunk draws the fewest points, a prefix lent to the session layer. halving
+        // the short one would go under minPoints, so it draws all six
+        glm::mat4 projection(1.f);
+        cloud.Decimate(glm::vec3(0.f, 0.f, 1e6f), projection, 1000.f);
+        CHECK(cloud.GetReport().pointsDrawn == 4 * 4 + 6);
+        CHECK(cloud.GetReport().chunksDecimated == 4);
+        CHECK(ComposedPoints(stage, 4).size() == 6);
+        for (size_t chunk = 0; chunk < 4; ++chunk)
+        {
+            pxr::VtVec3fArray drawn = ComposedPoints(stage, chunk);
+            CHECK(drawn.size() == 4);
+            std::set<float> x;
+            for (const auto &point : drawn)
+                x.insert(point[0]);
+            CHECK(x == std::set<float>({ chunk * 16.f, chunk * 16.f + 4.f, chunk * 16.f + 8.f, chunk * 16.f + 12.f }));
+            CHECK(AuthoredPoints(stage, chunk).size() == 16);
+        }
+
+        // and from up close everything again, with nothing left on the session layer
+        cloud.Decimate(glm::vec3(35.f, 0.f, 0.f), projection, 1000.f);
+        CHECK(cloud.GetReport().pointsDrawn == 70 && cloud.GetReport().chunksDecimated == 0);
+        CHECK(ComposedPoints(stage, 0).size() == 16);
+        CHECK(!stage->GetSessionLayer()->GetAttributeAtPath(ChunkPath(0).AppendProperty(pxr::UsdGeomTokens->points)));
+    }
+
+    void TestUpdateOnlyAuthorsWhatChanged()
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        PointCloudSettings settings;
+        settings.chunkPoints = 16;
+        settings.density = 1.f;
+        settings.minPoints = 4;
+        pxr::VtVec3fArray points = MakeLine(64);
+        PointCloud cloud;
+        CHECK(cloud.Author(stage, cloudPath, points, pxr::VtFloatArray(), pxr::VtVec3fArray(), settings));
+
+        CHECK(cloud.Update(points) == 0);
+        CHECK(cloud.GetReport().chunksUpdated == 0);
+        // a cloud of another size isn't touched
+        CHECK(cloud.Update(MakeLine(63)) == 0);
+
+        // lifting a point in the second run only authors its chunk, and its extent follows
+        pxr::VtVec3fArray extent;
+        points[20][1] = 5.f;
+        CHECK(cloud.Update(points) == 1);
+        CHECK(cloud.GetReport().chunksUpdated == 1);
+        pxr::UsdGeomPoints chunk1(stage->GetPrimAtPath(ChunkPath(1)));
+        CHECK(chunk1.GetExtentAttr().Get(&extent) && extent.size() == 2 && extent[1][1] == 5.f);
+        bool lifted = false;
+        for (const auto &point : ComposedPoints(stage, 1))
+            lifted |= point == pxr::GfVec3f(20.f, 5.f, 0.f);
+        CHECK(lifted);
+        pxr::UsdGeomPoints chunk0(stage->GetPrimAtPath(ChunkPath(0)));
+        CHECK(chunk0.GetExtentAttr().Get(&extent) && extent.size() == 2 && extent[1][1] == 0.f);
+
+        // a decimated chunk that changes gets a prefix of its new points on the session layer
+        cloud.Decimate(glm::vec3(0.f, 0.f, 1e6f), glm::mat4(1.f), 1000.f);
+        points[16][1] = 7.f;
+        CHECK(cloud.Update(points) == 1);
+        pxr::VtVec3fArray drawn = ComposedPoints(stage, 1);
+        pxr::VtVec3fArray authored = AuthoredPoints(stage, 1);
+        CHECK(drawn.size() == 4 && authored.size() == 16);
+        // the run starts the bit reversed order, so it's in every prefix
+        CHECK(drawn.size() > 0 && drawn[0] == pxr::GfVec3f(16.f, 7.f, 0.f));
+        for (size_t i = 0; i < drawn.size() && i < authored.size(); ++i)
+            CHECK(drawn[i] == authored[i]);
+    }
+
+    void TestWaveUpdatesTheChunksItReaches()
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        pxr::VtVec3fArray points, colors;
+        MakePointCloud(4096, points, colors);
+        PointCloudSettings settings;
+        settings.chunkPoints = 256;
+        PointCloud cloud;
+        CHECK(cloud.Author(stage, cloudPath, points, pxr::VtFloatArray(), colors, settings));
+
+        // the chunks the wave reaches, the ones with a point left of maxX
+        const float maxX = -0.5f;
+        size_t reached = 0;
+        for (size_t chunk = 0; chunk < cloud.GetChunkCount(); ++chunk)
+        {
+            bool left = false;
+            for (const auto &point : AuthoredPoints(stage, chunk))
+                left |= point[0] < maxX;
+            reached += left ? 1 : 0;
+        }
+        CHECK(reached > 0 && reached < cloud.GetChunkCount());
+
+        UpdatePointCloudWave(points, 0.25f, maxX);
+        CHECK(cloud.Update(points) == reached);
+        std::set<PointKey> moved;
+        for (const auto &point : points)
+            moved.insert(Key(point));
+        for (size_t chunk = 0; chunk < cloud.GetChunkCount(); ++chunk)
+        {
+            for (const auto &point : ComposedPoints(stage, chunk))
+                CHECK(moved.count(Key(point)) == 1);
+        }
+
+        // the whole wave reaches every chunk
+        UpdatePointCloudWave(points, 0.5f);
+        CHECK(cloud.Update(points) == cloud.GetChunkCount());
+    }
+}
+
+int main()
+{
+    TestEveryPointAuthoredOnce();
+    TestPrefixesAreEvenSubsamples();
+    TestUpdateOnlyAuthorsWhatChanged();
+    TestWaveUpdatesTheChunksItReaches();
+    return Testing::Result("pointCloudTest");
+}
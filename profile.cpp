@@ -0,0 +1,82 @@
+#include "sceneProfile.h"
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/stage.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// usdProfile <stage> [--top <n>] [--out <file>]
+//
+// opens a stage the way the viewer does and writes what's in it as JSON, to see why a set is slow without drawing it
+int main(int argc, char **argv)
+{
+    std::string stageFile, outFile;
+    SceneProfileSettings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--top" && i + 1 < argc)
+        {
+            try
+            {
+                settings.topN = (size_t)std::stoul(argv[++i]);
+            }
+            catch (const std::exception &)
+            {
+                std::cerr << "Invalid number for option --top: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--out" && i + 1 < argc)
+        {
+            outFile = argv[++i];
+        }
+        else if (arg == "--help" || arg == "-h" || !stageFile.empty() || arg.rfind("--", 0) == 0)
+        {
+            std::cout << "Usage: " << argv[0] << " <stage> [options]" << std::endl;
+            std::cout << "  --top <n>            list this many of the largest subtrees and payloads (default 10)" << std::endl;
+            std::cout << "  --out <file>         write the JSON to file instead of stdout" << std::endl;
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+        else
+        {
+            stageFile = arg;
+        }
+    }
+    if (stageFile.empty())
+    {
+        std::cerr << "No stage given, see --help" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto stage = pxr::UsdStage::Open(stageFile);
+    double openMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    if (!stage)
+    {
+        std::cerr << "Unable to open stage " << stageFile << std::endl;
+        return 1;
+    }
+
+    SceneProfile profile;
+    ProfileStage(stage, settings, profile);
+    profile.openMs = openMs;
+
+    if (outFile.empty())
+    {
+        WriteSceneProfileJson(profile, std::cout);
+        return 0;
+    }
+    std::ofstream out(outFile);
+    if (!out)
+    {
+        std::cerr << "Unable to write " << outFile << std::endl;
+        return 1;
+    }
+    WriteSceneProfileJson(profile, out);
+    std::cerr << "Profiled " << profile.prims << " prims in " << profile.profileMs << " ms, written to " << outFile << std::endl;
+    return 0;
+}
@@ -0,0 +1,547 @@
+#include "quantizedMesh.h"
+
+#include <pxr/base/arch/fileSystem.h>
+#include <pxr/base/gf/math.h>
+#include <pxr/base/gf/vec2h.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3h.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/vt/dictionary.h>
+#include <pxr/base/vt/types.h>
+#include <pxr/base/work/loops.h>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/usd/editContext.h>
+#include <pxr/usd/usdGeom/primvarsAPI.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+
+namespace
+{
+    const pxr::TfToken PointsToken("quantized:points");
+    const pxr::TfToken ScaleToken("quantized:pointsScale");
+    const pxr::TfToken OffsetToken("quantized:pointsOffset");
+    const pxr::TfToken NormalsToken("quantized:normals");
+    const pxr::TfToken TexCoordsToken("quantized:st");
+    const pxr::TfToken StToken("st");
+    // custom layer data on a layer holding meshes that lost their floats, nothing else needs decoding
+    const std::string QuantizedLayerKey("quantizedGeometry");
+
+    const int PositionBits = 21;
+    const uint64_t PositionMask = (1ull << PositionBits) - 1;
+    const float SnormScale = 32767.f;
+
+    double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // only edit a value where its strongest opinion is, anywhere else the old value would still show through
+    bool AuthoredOn(const pxr::UsdAttribute &attribute, const pxr::SdfLayerHandle &layer)
+    {
+        auto stack = attribute.GetPropertyStack(pxr::UsdTimeCode::Default());
+        return !stack.empty() && stack.front()->GetLayer() == layer && attribute.HasAuthoredValue();
+    }
+
+    void EncodePositions(const pxr::VtVec3fArray &points, pxr::VtArray<uint64_t> &packed, pxr::GfVec3f &scale, pxr::GfVec3f &offset)
+    {
+        pxr::GfVec3f lo = points.cdata()[0], hi = points.cdata()[0];
+        for (const auto &point : points)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                lo[c] = std::min(lo[c], point[c]);
+                hi[c] = std::max(hi[c], point[c]);
+            }
+        }
+        offset = lo;
+        for (int c = 0; c < 3; ++c)
+            scale[c] = hi[c] > lo[c] ? (hi[c] - lo[c]) / (float)PositionMask : 1.f;
+
+        packed.resize(points.size());
+        uint64_t *out = packed.data();
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            uint64_t q = 0;
+            for (int c = 0; c < 3; ++c)
+            {
+                double steps = std::round(((double)points.cdata()[i][c] - (double)offset[c]) / (double)scale[c]);
+                q |= (uint64_t)std::min(std::max(steps, 0.0), (double)PositionMask) << (PositionBits * c);
+            }
+            out[i] = q;
+        }
+    }
+
+    // straight line code over plain arrays so it vectorizes, the masked values fit in an int before converting
+    void DecodePositions(const uint64_t *packed, size_t count, const pxr::GfVec3f &scale, const pxr::GfVec3f &offset, pxr::GfVec3f *points)
+    {
+        const float sx = scale[0], sy = scale[1], sz = scale[2];
+        const float ox = offset[0], oy = offset[1], oz = offset[2];
+        float *out = points->data();
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t q = packed[i];
+            out[i * 3 + 0] = ox + sx * (float)(int32_t)(q & PositionMask);
+            out[i * 3 + 1] = oy + sy * (float)(int32_t)((q >> PositionBits) & PositionMask);
+            out[i * 3 + 2] = oz + sz * (float)(int32_t)((q >> (PositionBits * 2)) & PositionMask);
+        }
+    }
+
+    // project onto the octahedron, fold the lower half over and store x and y as 16 bit snorms
+    uint32_t EncodeOctahedral(const pxr::GfVec3f &normal)
+    {
+        float l1 = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+        float x = l1 > 0.f ? normal[0] / l1 : 0.f;
+        float y = l1 > 0.f ? normal[1] / l1 : 0.f;
+        if (l1 > 0.f && normal[2] < 0.f)
+        {
+            float fx = (1.f - std::fabs(y)) * (x >= 0.f ? 1.f : -1.f);
+            float fy = (1.f - std::fabs(x)) * (y >= 0.f ? 1.f : -1.f);
+            x = fx;
+            y = fy;
+        }
+        int16_t qx = (int16_t)std::lround(std::min(std::max(x, -1.f), 1.f) * SnormScale);
+        int16_t qy = (int16_t)std::lround(std::min(std::max(y, -1.f), 1.f) * SnormScale);
+        return (uint32_t)(uint16_t)qx | ((uint32_t)(uint16_t)qy << 16);
+    }
+
+    // the fold is undone without branching so the loop vectorizes
+    void DecodeOctahedral(const uint32_t *packed, size_t count, pxr::GfVec3f *normals)
+    {
+        float *out = normals->data();
+        for (size_t i = 0; i < count; ++i)
+        {
+            float x = (float)(int16_t)(packed[i] & 0xffff) / SnormScale;
+            float y = (float)(int16_t)(packed[i] >> 16) / SnormScale;
+            float z = 1.f - std::fabs(x) - std::fabs(y);
+            float t = std::max(-z, 0.f);
+            x -= std::copysign(t, x);
+            y -= std::copysign(t, y);
+            float inverse = 1.f / std::sqrt(x * x + y * y + z * z);
+            out[i * 3 + 0] = x * inverse;
+            out[i * 3 + 1] = y * inverse;
+            out[i * 3 + 2] = z * inverse;
+        }
+    }
+
+    template <class Half, class Full>
+    void DecodeHalves(const Half *packed, size_t count, Full *values)
+    {
+        const pxr::GfHalf *in = packed->data();
+        float *out = values->data();
+        for (size_t i = 0; i < count * Full::dimension; ++i)
+            out[i] = (float)in[i];
+    }
+
+    // from the sine and cosine in double, acos of a float dot product can't resolve angles below a few hundredths of
+    // a degree, which is more than the encodings are out by
+    float AngleDegrees(const pxr::GfVec3f &a, const pxr::GfVec3f &b)
+    {
+        pxr::GfVec3d da(a), db(b);
+        return (float)pxr::GfRadiansToDegrees(std::atan2(pxr::GfCross(da, db).GetLength(), pxr::GfDot(da, db)));
+    }
+
+    // what a quantized mesh decodes to
+    struct DecodedMesh
+    {
+        pxr::UsdGeomMesh mesh;
+        pxr::VtVec3fArray points, normals;
+        pxr::VtVec2fArray texCoords;
+        bool hasPoints, hasNormals, hasTexCoords;
+    };
+
+    void Decode(DecodedMesh &decoded)
+    {
+        pxr::UsdPrim prim = decoded.mesh.GetPrim();
+        decoded.hasPoints = decoded.hasNormals = decoded.hasTexCoords = false;
+
+        // a stream whose floats are still authored (kept, or decoded already) is left alone
+        pxr::VtArray<uint64_t> packedPoints;
+        pxr::GfVec3f scale(1.f), offset(0.f);
+        if (!decoded.mesh.GetPointsAttr().HasAuthoredValue() && prim.GetAttribute(PointsToken).Get(&packedPoints))
+        {
+            prim.GetAttribute(ScaleToken).Get(&scale);
+            prim.GetAttribute(OffsetToken).Get(&offset);
+            decoded.points.resize(packedPoints.size());
+            DecodePositions(packedPoints.cdata(), packedPoints.size(), scale, offset, decoded.points.data());
+            decoded.hasPoints = true;
+        }
+
+        pxr::VtValue normals;
+        if (!decoded.mesh.GetNormalsAttr().HasAuthoredValue() && prim.GetAttribute(NormalsToken).Get(&normals))
+        {
+            if (normals.IsHolding<pxr::VtArray<uint32_t>>())
+            {
+                const auto &packed = normals.UncheckedGet<pxr::VtArray<uint32_t>>();
+                decoded.normals.resize(packed.size());
+                DecodeOctahedral(packed.cdata(), packed.size(), decoded.normals.data());
+                decoded.hasNormals = true;
+            }
+            else if (normals.IsHolding<pxr::VtVec3hArray>())
+            {
+                const auto &packed = normals.UncheckedGet<pxr::VtVec3hArray>();
+                decoded.normals.resize(packed.size());
+                DecodeHalves(packed.cdata(), packed.size(), decoded.normals.data());
+                decoded.hasNormals = true;
+            }
+        }
+
+        pxr::VtVec2hArray texCoords;
+        pxr::UsdAttribute texCoordsAttr = pxr::UsdGeomPrimvarsAPI(decoded.mesh).GetPrimvar(StToken).GetAttr();
+        if (!(texCoordsAttr && texCoordsAttr.HasAuthoredValue()) && prim.GetAttribute(TexCoordsToken).Get(&texCoords))
+        {
+            decoded.texCoords.resize(texCoords.size());
+            DecodeHalves(texCoords.cdata(), texCoords.size(), decoded.texCoords.data());
+            decoded.hasTexCoords = true;
+        }
+    }
+
+    // drop the encoded attributes a flattened stage picked up alongside the decoded floats
+    void StripQuantized(const pxr::SdfLayerRefPtr &layer)
+    {
+        std::vector<pxr::SdfPath> properties;
+        layer->Traverse(pxr::SdfPath::AbsoluteRootPath(), [&properties](const pxr::SdfPath &path)
+        {
+            if (path.IsPropertyPath() && pxr::TfStringStartsWith(path.GetName(), "quantized:"))
+                properties.push_back(path);
+        });
+        for (const auto &path : properties)
+        {
+            if (auto prim = layer->GetPrimAtPath(path.GetPrimPath()))
+                prim->RemoveProperty(prim->GetPropertyAtPath(path));
+        }
+    }
+
+    // everything in one layer with float geometry (anything already quantized has been decoded onto the session layer)
+    pxr::SdfLayerRefPtr FlattenFloats(const pxr::UsdStageRefPtr &stage)
+    {
+        auto flattened = stage->Flatten();
+        StripQuantized(flattened);
+        return flattened;
+    }
+
+    // encode the flattened layer in place without its floats and write it out
+    bool ExportEncoded(const pxr::SdfLayerRefPtr &flattened, const std::string &path, const QuantizeSettings &settings, QuantizeReport &report)
+    {
+        auto encodedStage = pxr::UsdStage::Open(flattened);
+        if (!encodedStage)
+            return false;
+        QuantizeSettings encodedOnly = settings;
+        encodedOnly.keepFloats = false;
+        QuantizeStage(encodedStage, encodedOnly, report);
+        if (!flattened->Export(path))
+        {
+            std::cerr << "Unable to write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // open a stage and read all of its mesh geometry, summing it so every page is touched
+    double LoadGeometry(const std::string &path, bool decode)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto stage = pxr::UsdStage::Open(path);
+        if (!stage)
+            return 0.0;
+        if (decode)
+            DecodeQuantizedMeshes(stage);
+
+        float sum = 0.f;
+        for (const auto &prim : stage->Traverse())
+        {
+            if (!prim.IsA<pxr::UsdGeomMesh>())
+                continue;
+            pxr::UsdGeomMesh mesh(prim);
+            pxr::VtVec3fArray points, normals;
+            pxr::VtVec2fArray texCoords;
+            mesh.GetPointsAttr().Get(&points);
+            mesh.GetNormalsAttr().Get(&normals);
+            pxr::UsdGeomPrimvarsAPI(mesh).GetPrimvar(StToken).Get(&texCoords);
+            for (const auto &point : points)
+                sum += point[0];
+            for (const auto &normal : normals)
+                sum += normal[0];
+            for (const auto &st : texCoords)
+                sum += st[0];
+        }
+        // keep the reads from being optimized away
+        volatile float sink = sum;
+        (void)sink;
+        return MillisecondsSince(start);
+    }
+
+    double Median(std::vector<double> times)
+    {
+        if (times.empty())
+            return 0.0;
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+}
+
+bool QuantizeMesh(pxr::UsdGeomMesh &mesh, const QuantizeSettings &settings, QuantizeReport &report)
+{
+    pxr::UsdPrim prim = mesh.GetPrim();
+    pxr::UsdStageRefPtr stage = prim.GetStage();
+    pxr::UsdAttribute pointsAttr = mesh.GetPointsAttr();
+    auto stack = pointsAttr.GetPropertyStack(pxr::UsdTimeCode::Default());
+    if (stack.empty() || pointsAttr.ValueMightBeTimeVarying() || !stage->HasLocalLayer(stack.front()->GetLayer()))
+    {
+        report.skipped++;
+        return false;
+    }
+    pxr::SdfLayerHandle layer = stack.front()->GetLayer();
+    pxr::UsdEditContext context(stage, layer);
+    bool encoded = false;
+
+    pxr::VtVec3fArray points;
+    if (settings.positions && AuthoredOn(pointsAttr, layer) && pointsAttr.Get(&points) && !points.empty())
+    {
+        pxr::VtArray<uint64_t> packed;
+        pxr::GfVec3f scale, offset;
+        EncodePositions(points, packed, scale, offset);
+
+        // a component is at most half a step out
+        pxr::VtVec3fArray decoded(points.size());
+        DecodePositions(packed.cdata(), packed.size(), scale, offset, decoded.data());
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                report.maxPositionError = std::max(report.maxPositionError, std::fabs(decoded.cdata()[i][c] - points.cdata()[i][c]));
+        }
+        for (int c = 0; c < 3; ++c)
+            report.positionErrorBound = std::max(report.positionErrorBound, scale[c] * 0.5f);
+
+        prim.CreateAttribute(PointsToken, pxr::SdfValueTypeNames->UInt64Array, true).Set(packed);
+        prim.CreateAttribute(ScaleToken, pxr::SdfValueTypeNames->Float3, true).Set(scale);
+        prim.CreateAttribute(OffsetToken, pxr::SdfValueTypeNames->Float3, true).Set(offset);
+        if (!settings.keepFloats)
+            pointsAttr.Clear();
+
+        report.points += points.size();
+        report.bytesBefore += points.size() * sizeof(pxr::GfVec3f);
+        report.pointBytesAfter += packed.size() * sizeof(uint64_t) + 2 * sizeof(pxr::GfVec3f);
+        encoded = true;
+    }
+
+    pxr::UsdAttribute normalsAttr = mesh.GetNormalsAttr();
+    pxr::VtVec3fArray normals;
+    if (settings.normals != NormalEncoding::Float && AuthoredOn(normalsAttr, layer) && normalsAttr.Get(&normals) && !normals.empty())
+    {
+        pxr::VtVec3fArray decoded(normals.size());
+        if (settings.normals == NormalEncoding::Octahedral)
+        {
+            pxr::VtArray<uint32_t> packed(normals.size());
+            for (size_t i = 0; i < normals.size(); ++i)
+                packed[i] = EncodeOctahedral(normals.cdata()[i]);
+            DecodeOctahedral(packed.cdata(), packed.size(), decoded.data());
+            prim.CreateAttribute(NormalsToken, pxr::SdfValueTypeNames->UIntArray, true).Set(packed);
+            report.normalBytesAfter += packed.size() * sizeof(uint32_t);
+        }
+        else
+        {
+            pxr::VtVec3hArray packed(normals.size());
+            for (size_t i = 0; i < normals.size(); ++i)
+                packed[i] = pxr::GfVec3h(normals.cdata()[i]);
+            DecodeHalves(packed.cdata(), packed.size(), decoded.data());
+            prim.CreateAttribute(NormalsToken, pxr::SdfValueTypeNames->Normal3hArray, true).Set(packed);
+            report.normalBytesAfter += packed.size() * sizeof(pxr::GfVec3h);
+        }
+        for (size_t i = 0; i < normals.size(); ++i)
+            report.maxNormalDegrees = std::max(report.maxNormalDegrees, AngleDegrees(normals.cdata()[i], decoded.cdata()[i]));
+        if (!settings.keepFloats)
+            normalsAttr.Clear();
+
+        report.normals += normals.size();
+        report.bytesBefore += normals.size() * sizeof(pxr::GfVec3f);
+        encoded = true;
+    }
+
+    pxr::UsdAttribute texCoordsAttr = pxr::UsdGeomPrimvarsAPI(mesh).GetPrimvar(StToken).GetAttr();
+    pxr::VtVec2fArray texCoords;
+    if (settings.halfTexCoords && texCoordsAttr && AuthoredOn(texCoordsAttr, layer) && texCoordsAttr.Get(&texCoords) && !texCoords.empty())
+    {
+        pxr::VtVec2hArray packed(texCoords.size());
+        for (size_t i = 0; i < texCoords.size(); ++i)
+            packed[i] = pxr::GfVec2h(texCoords.cdata()[i]);
+        for (size_t i = 0; i < texCoords.size(); ++i)
+        {
+            for (int c = 0; c < 2; ++c)
+                report.maxTexCoordError = std::max(report.maxTexCoordError, std::fabs((float)packed.cdata()[i][c] - texCoords.cdata()[i][c]));
+        }
+        prim.CreateAttribute(TexCoordsToken, pxr::SdfValueTypeNames->TexCoord2hArray, true).Set(packed);
+        if (!settings.keepFloats)
+            texCoordsAttr.Clear();
+
+        report.texCoords += texCoords.size();
+        report.bytesBefore += texCoords.size() * sizeof(pxr::GfVec2f);
+        report.texCoordBytesAfter += packed.size() * sizeof(pxr::GfVec2h);
+        encoded = true;
+    }
+
+    report.bytesAfter = report.pointBytesAfter + report.normalBytesAfter + report.texCoordBytesAfter;
+    if (encoded)
+    {
+        report.meshes++;
+        report.keptFloats = report.keptFloats || settings.keepFloats;
+    }
+    if (encoded && !settings.keepFloats && layer->GetCustomLayerData().count(QuantizedLayerKey) == 0)
+    {
+        pxr::VtDictionary data = layer->GetCustomLayerData();
+        data[QuantizedLayerKey] = pxr::VtValue(true);
+        layer->SetCustomLayerData(data);
+    }
+    return encoded;
+}
+
+void QuantizeStage(const pxr::UsdStageRefPtr &stage, const QuantizeSettings &settings, QuantizeReport &report)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<pxr::UsdGeomMesh> meshes;
+    for (const auto &prim : stage->Traverse())
+    {
+        if (prim.IsA<pxr::UsdGeomMesh>())
+            meshes.push_back(pxr::UsdGeomMesh(prim));
+    }
+    for (auto &mesh : meshes)
+        QuantizeMesh(mesh, settings, report);
+    report.encodeMs += MillisecondsSince(start);
+}
+
+size_t DecodeQuantizedMeshes(const pxr::UsdStageRefPtr &stage, QuantizeReport *report)
+{
+    // a stage without a marked layer has nothing to decode and isn't traversed at all
+    bool marked = false;
+    for (const auto &layer : stage->GetUsedLayers())
+        marked = marked || layer->GetCustomLayerData().count(QuantizedLayerKey) > 0;
+    if (!marked)
+        return 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<DecodedMesh> meshes;
+    for (const auto &prim : stage->Traverse())
+    {
+        if (!prim.IsA<pxr::UsdGeomMesh>())
+            continue;
+        if (prim.HasAttribute(PointsToken) || prim.HasAttribute(NormalsToken) || prim.HasAttribute(TexCoordsToken))
+        {
+            DecodedMesh decoded;
+            decoded.mesh = pxr::UsdGeomMesh(prim);
+            meshes.push_back(decoded);
+        }
+    }
+    if (meshes.empty())
+        return 0;
+
+    // reading and decoding happens in parallel, authoring the results onto one layer can't
+    pxr::WorkParallelForN(meshes.size(), [&meshes](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            Decode(meshes[i]);
+    });
+
+    size_t decodedCount = 0;
+    pxr::UsdEditContext context(stage, stage->GetSessionLayer());
+    {
+        pxr::SdfChangeBlock changes;
+        for (auto &decoded : meshes)
+        {
+            if (decoded.hasPoints || decoded.hasNormals || decoded.hasTexCoords)
+                decodedCount++;
+            if (decoded.hasPoints)
+                decoded.mesh.GetPointsAttr().Set(decoded.points);
+            if (decoded.hasNormals)
+                decoded.mesh.GetNormalsAttr().Set(decoded.normals);
+            if (decoded.hasTexCoords)
+                pxr::UsdGeomPrimvarsAPI(decoded.mesh).GetPrimvar(StToken).Set(decoded.texCoords);
+        }
+    }
+
+    if (report)
+        report->decodeMs += MillisecondsSince(start);
+    return decodedCount;
+}
+
+bool ExportQuantizedStage(const pxr::UsdStageRefPtr &stage, const std::string &path, const QuantizeSettings &settings, QuantizeReport &report)
+{
+    // text would store every encoded integer as digits, more than the floats took
+    if (pxr::TfGetExtension(path) != "usdc")
+    {
+        std::cerr << "Unable to write quantized geometry to " << path << ", it's only smaller as a .usdc" << std::endl;
+        return false;
+    }
+    return ExportEncoded(FlattenFloats(stage), path, settings, report);
+}
+
+bool BenchmarkQuantizedGeometry(const pxr::UsdStageRefPtr &stage, const QuantizeSettings &settings, int iterations, QuantizeBenchmark &benchmark)
+{
+    benchmark = QuantizeBenchmark();
+    std::string base = pxr::TfStringCatPaths(pxr::ArchGetTmpDir(), "usdSimpleCpp.quantize");
+    std::string floatPath = base + ".float.usdc", quantizedPath = base + ".quantized.usdc";
+
+    auto flattened = FlattenFloats(stage);
+    if (!flattened->Export(floatPath))
+    {
+        std::cerr << "Unable to write " << floatPath << std::endl;
+        return false;
+    }
+    QuantizeReport report;
+    if (!ExportEncoded(flattened, quantizedPath, settings, report))
+        return false;
+
+    std::error_code error;
+    benchmark.floatBytes = (size_t)std::filesystem::file_size(floatPath, error);
+    benchmark.quantizedBytes = (size_t)std::filesystem::file_size(quantizedPath, error);
+
+    // once each to warm the page cache, then alternate so both see the same conditions
+    LoadGeometry(floatPath, false);
+    LoadGeometry(quantizedPath, true);
+    std::vector<double> floatTimes, quantizedTimes;
+    for (int i = 0; i < iterations; ++i)
+    {
+        floatTimes.push_back(LoadGeometry(floatPath, false));
+        quantizedTimes.push_back(LoadGeometry(quantizedPath, true));
+    }
+    benchmark.floatLoadMs = Median(floatTimes);
+    benchmark.quantizedLoadMs = Median(quantizedTimes);
+    benchmark.iterations = iterations;
+
+    std::filesystem::remove(floatPath, error);
+    std::filesystem::remove(quantizedPath, error);
+    return true;
+}
+
+void PrintQuantizeReport(const QuantizeReport &report, std::ostream &out)
+{
+    out << "Quantized " << report.meshes << " meshes (" << report.skipped << " skipped): " << report.points << " points, "
+        << report.normals << " normals, " << report.texCoords << " texture coordinates" << std::endl;
+    if (report.bytesBefore > 0)
+        out << "    geometry " << report.bytesBefore << " -> " << report.bytesAfter << " bytes encoded ("
+            << 100.0 * (double)report.bytesAfter / (double)report.bytesBefore << "%)"
+            << (report.keptFloats ? ", stored next to the floats so other tools still load it" : "") << std::endl;
+    // points only lose a third, 21 bits a component still need a uint64 each
+    auto printStream = [&out](const char *name, size_t count, size_t floatSize, size_t bytes)
+    {
+        if (count > 0)
+            out << "        " << name << (double)bytes / (double)count << " of " << floatSize << " bytes each ("
+                << 100.0 * (double)bytes / (double)(count * floatSize) << "%)" << std::endl;
+    };
+    printStream("points     ", report.points, sizeof(pxr::GfVec3f), report.pointBytesAfter);
+    printStream("normals    ", report.normals, sizeof(pxr::GfVec3f), report.normalBytesAfter);
+    printStream("st         ", report.texCoords, sizeof(pxr::GfVec2f), report.texCoordBytesAfter);
+    out << "    max position error " << report.maxPositionError << " (bound " << report.positionErrorBound << "), normal "
+        << report.maxNormalDegrees << " degrees, texture coordinate " << report.maxTexCoordError << std::endl;
+    out << "    encoded in " << report.encodeMs << " ms, decoded in " << report.decodeMs << " ms" << std::endl;
+}
+
+void PrintQuantizeBenchmark(const QuantizeBenchmark &benchmark, std::ostream &out)
+{
+    out << "Quantized geometry over " << benchmark.iterations << " loads:" << std::endl;
+    out << "    float      " << benchmark.floatBytes << " bytes, " << benchmark.floatLoadMs << " ms to open and read" << std::endl;
+    out << "    quantized  " << benchmark.quantizedBytes << " bytes, " << benchmark.quantizedLoadMs << " ms to open, decode and read" << std::endl;
+}
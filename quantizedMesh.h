@@ -0,0 +1,98 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/mesh.h>
+
+#include <iostream>
+#include <string>
+
+// compact storage for mesh geometry
+//
+// the float points, normals and st are encoded into attributes under quantized: on the layer that held them:
+//   quantized:points          uint64[]      21 bits per component, decoded as offset + scale * q (8 bytes against 12)
+//   quantized:pointsScale     float3
+//   quantized:pointsOffset    float3
+//   quantized:normals         uint[]        octahedral, two 16 bit snorms, or normal3h[] as halves
+//   quantized:st              texCoord2h[]
+// the topology, extent and interpolations are left as they were. by default the floats stay authored next to the
+// encoding so any other tool still loads the meshes. without them the file is smaller but only loads here, where
+// DecodeQuantizedMeshes puts the floats back on the session layer for every stream that lost them. a layer that
+// lost them is marked with quantizedGeometry in its custom layer data, so stages without one are never traversed
+enum class NormalEncoding
+{
+    Float,
+    Half,
+    Octahedral
+};
+
+struct QuantizeSettings
+{
+    QuantizeSettings()
+        : positions(true), normals(NormalEncoding::Octahedral), halfTexCoords(true), keepFloats(true)
+    {}
+
+    bool positions;
+    NormalEncoding normals;
+    bool halfTexCoords;
+    // leave the float attributes authored, clearing them saves a file nothing but DecodeQuantizedMeshes can read
+    bool keepFloats;
+};
+
+struct QuantizeReport
+{
+    QuantizeReport()
+        : meshes(0), skipped(0), keptFloats(false), points(0), normals(0), texCoords(0), bytesBefore(0), bytesAfter(0),
+          pointBytesAfter(0), normalBytesAfter(0), texCoordBytesAfter(0), maxPositionError(0.f),
+          positionErrorBound(0.f), maxNormalDegrees(0.f), maxTexCoordError(0.f), encodeMs(0.0), decodeMs(0.0)
+    {}
+
+    size_t meshes;
+    // animated, or authored somewhere we can't edit (a referenced file)
+    size_t skipped;
+    // the floats are still authored, so the file grew by the encoded bytes rather than shrinking to them
+    bool keptFloats;
+    size_t points, normals, texCoords;
+    // bytes in the geometry arrays before and after encoding, and the encoded bytes of each stream
+    size_t bytesBefore, bytesAfter;
+    size_t pointBytesAfter, normalBytesAfter, texCoordBytesAfter;
+
+    // largest error measured after a round trip, and the most the quantization step allows, in object space units
+    float maxPositionError, positionErrorBound;
+    float maxNormalDegrees;
+    float maxTexCoordError;
+
+    double encodeMs, decodeMs;
+};
+
+// file size and time to open the stage and read back its geometry, with and without encoding
+struct QuantizeBenchmark
+{
+    QuantizeBenchmark()
+        : floatBytes(0), quantizedBytes(0), floatLoadMs(0.0), quantizedLoadMs(0.0), iterations(0)
+    {}
+
+    size_t floatBytes, quantizedBytes;
+    // median over the iterations, the quantized load includes decoding
+    double floatLoadMs, quantizedLoadMs;
+    int iterations;
+};
+
+// encode one mesh in place on the layer holding its geometry, measuring the error of the round trip
+bool QuantizeMesh(pxr::UsdGeomMesh &mesh, const QuantizeSettings &settings, QuantizeReport &report);
+// encode every mesh on the stage
+void QuantizeStage(const pxr::UsdStageRefPtr &stage, const QuantizeSettings &settings, QuantizeReport &report);
+
+// flatten the stage and write it with only the encoded geometry, which has to be a .usdc to come out smaller. the
+// stage itself is left with its floats
+bool ExportQuantizedStage(const pxr::UsdStageRefPtr &stage, const std::string &path, const QuantizeSettings &settings, QuantizeReport &report);
+
+// decode the quantized meshes that lost their floats onto the session layer (so saving doesn't store them again), the
+// meshes are decoded in parallel and each array in a single pass the compiler can vectorize. returns the meshes decoded
+size_t DecodeQuantizedMeshes(const pxr::UsdStageRefPtr &stage, QuantizeReport *report = nullptr);
+
+// write the flattened stage as usdc with float and with encoded geometry to the temp directory and time loading each
+bool BenchmarkQuantizedGeometry(const pxr::UsdStageRefPtr &stage, const QuantizeSettings &settings, int iterations, QuantizeBenchmark &benchmark);
+
+void PrintQuantizeReport(const QuantizeReport &report, std::ostream &out);
+void PrintQuantizeBenchmark(const QuantizeBenchmark &benchmark, std::ostream &out);
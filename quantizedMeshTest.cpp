@@ -0,0 +1,204 @@
+#include "quantizedMesh.h"
+#include "testing.h"
+
+#include <pxr/base/gf/math.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/usd/usdGeom/primvarsAPI.h>
+
+#include <cmath>
+#include <filesystem>
+#include <string>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const pxr::TfToken StToken("st");
+
+    // a wavy strip of triangles with normals pointing every way, the lower hemisphere and the axes included
+    pxr::UsdGeomMesh DefineMesh(const pxr::UsdStageRefPtr &stage, const pxr::SdfPath &path, pxr::VtVec3fArray &points,
+                                pxr::VtVec3fArray &normals, pxr::VtVec2fArray &texCoords)
+    {
+        const int count = 1000;
+        points.clear();
+        normals.clear();
+        texCoords.clear();
+        for (int i = 0; i < count; ++i)
+        {
+            float t = (float)i / (float)(count - 1);
+            points.push_back(pxr::GfVec3f(t * 25.f - 10.f, std::sin(t * 40.f) * 3.f, (float)(i % 2) * 0.5f));
+            double theta = 3.14159265358979323846 * (double)(i * 7 % count) / (double)(count - 1);
+            double phi = 2.0 * 3.14159265358979323846 * (double)(i * 13 % count) / (double)count;
+            normals.push_back(pxr::GfVec3f((float)(std::sin(theta) * std::cos(phi)), (float)(std::sin(theta) * std::sin(phi)), (float)std::cos(theta)));
+            texCoords.push_back(pxr::GfVec2f(t, 1.f - t * t));
+        }
+        normals[0] = pxr::GfVec3f(0.f, 0.f, -1.f);
+        normals[1] = pxr::GfVec3f(1.f, 0.f, 0.f);
+        normals[2] = pxr::GfVec3f(0.f, -1.f, 0.f);
+        normals[3] = pxr::GfVec3f(-0.6f, 0.f, -0.8f);
+
+        pxr::VtArray<int> faceVertexCounts, faceVertexIndices;
+        for (int i = 0; i + 2 < count; ++i)
+        {
+            faceVertexCounts.push_back(3);
+            faceVertexIndices.push_back(i);
+            faceVertexIndices.push_back(i + 1);
+            faceVertexIndices.push_back(i + 2);
+        }
+
+        auto mesh = pxr::UsdGeomMesh::Define(stage, path);
+        mesh.GetPointsAttr().Set(points);
+        mesh.GetNormalsAttr().Set(normals);
+        mesh.SetNormalsInterpolation(pxr::UsdGeomTokens->vertex);
+        mesh.GetFaceVertexCountsAttr().Set(faceVertexCounts);
+        mesh.GetFaceVertexIndicesAttr().Set(faceVertexIndices);
+        pxr::UsdGeomPrimvarsAPI(mesh).CreatePrimvar(StToken, pxr::SdfValueTypeNames->TexCoord2fArray, pxr::UsdGeomTokens->vertex).Set(texCoords);
+        return mesh;
+    }
+
+    // acos of a float dot product is too coarse for the angles measured here
+    double AngleDegrees(const pxr::GfVec3f &a, const pxr::GfVec3f &b)
+    {
+        pxr::GfVec3d da(a), db(b);
+        return pxr::GfRadiansToDegrees(std::atan2(pxr::GfCross(da, db).GetLength(), pxr::GfDot(da, db)));
+    }
+
+    void TestRoundTripStaysInsideTheBounds(NormalEncoding encoding, float maxNormalDegrees)
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        pxr::VtVec3fArray points, normals;
+        pxr::VtVec2fArray texCoords;
+        auto mesh = DefineMesh(stage, pxr::SdfPath("/mesh"), points, normals, texCoords);
+
+        QuantizeSettings settings;
+        settings.normals = encoding;
+        settings.keepFloats = false;
+        QuantizeReport report;
+        CHECK(QuantizeMesh(mesh, settings, report));
+        CHECK(report.meshes == 1 && report.points == points.size() && report.normals == normals.size());
+        // half a step of the 25 x 6 x 0.5 box over 2^21 - 1 steps, give or take the float rounding of the decode
+        const float bound = report.positionErrorBound + 1e-6f;
+        CHECK(report.maxPositionError <= bound);
+        CHECK(report.bytesAfter < report.bytesBefore);
+        CHECK(report.pointBytesAfter == points.size() * sizeof(uint64_t) + 2 * sizeof(pxr::GfVec3f));
+
+        // the floats are gone from the layer and only come back through decoding, onto the session layer
+        CHECK(!mesh.GetPointsAttr().HasAuthoredValue());
+        CHECK(!mesh.GetNormalsAttr().HasAuthoredValue());
+        CHECK(DecodeQuantizedMeshes(stage) == 1);
+        CHECK(stage->GetSessionLayer()->GetPropertyAtPath(pxr::SdfPath("/mesh.points")));
+
+        pxr::VtVec3fArray decodedPoints, decodedNormals;
+        pxr::VtVec2fArray decodedTexCoords;
+        CHECK(mesh.GetPointsAttr().Get(&decodedPoints) && decodedPoints.size() == points.size());
+        CHECK(mesh.GetNormalsAttr().Get(&decodedNormals) && decodedNormals.size() == normals.size());
+        CHECK(pxr::UsdGeomPrimvarsAPI(mesh).GetPrimvar(StToken).Get(&decodedTexCoords) && decodedTexCoords.size() == texCoords.size());
+        if (decodedPoints.size() != points.size() || decodedNormals.size() != normals.size() || decodedTexCoords.size() != texCoords.size())
+            return;
+
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                CHECK(std::fabs(decodedPoints[i][c] - points[i][c]) <= bound);
+            CHECK_NEAR(decodedNormals[i].GetLength(), 1.0, 1e-3);
+            CHECK(AngleDegrees(decodedNormals[i], normals[i]) <= maxNormalDegrees);
+            // halves keep 11 bits, values in [0, 1] round to within 2^-11
+            for (int c = 0; c < 2; ++c)
+                CHECK(std::fabs(decodedTexCoords[i][c] - texCoords[i][c]) <= 1.f / 2048.f + 1e-7f);
+        }
+        CHECK(report.maxNormalDegrees <= maxNormalDegrees);
+    }
+
+    void TestKeptFloatsStayAuthored()
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        pxr::VtVec3fArray points, normals;
+        pxr::VtVec2fArray texCoords;
+        auto mesh = DefineMesh(stage, pxr::SdfPath("/mesh"), points, normals, texCoords);
+
+        QuantizeSettings settings;
+        QuantizeReport report;
+        CHECK(settings.keepFloats);
+        CHECK(QuantizeMesh(mesh, settings, report));
+        CHECK(report.keptFloats);
+
+        // other tools still read the exact floats and there is nothing to decode
+        pxr::VtVec3fArray authored;
+        CHECK(mesh.GetPointsAttr().Get(&authored) && authored == points);
+        CHECK(mesh.GetNormalsAttr().Get(&authored) && authored == normals);
+        CHECK(mesh.GetPrim().HasAttribute(pxr::TfToken("quantized:points")));
+        CHECK(DecodeQuantizedMeshes(stage) == 0);
+        CHECK(!stage->GetSessionLayer()->GetPrimAtPath(pxr::SdfPath("/mesh")));
+    }
+
+    void TestFloatNormalsAreLeftAlone()
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        pxr::VtVec3fArray points, normals;
+        pxr::VtVec2fArray texCoords;
+        auto mesh = DefineMesh(stage, pxr::SdfPath("/mesh"), points, normals, texCoords);
+
+        QuantizeSettings settings;
+        settings.normals = NormalEncoding::Float;
+        settings.keepFloats = false;
+        QuantizeReport report;
+        CHECK(QuantizeMesh(mesh, settings, report));
+        CHECK(report.normals == 0);
+        CHECK(!mesh.GetPrim().HasAttribute(pxr::TfToken("quantized:normals")));
+        pxr::VtVec3fArray authored;
+        CHECK(mesh.GetNormalsAttr().Get(&authored) && authored == normals);
+    }
+
+    void TestExportWritesOnlyTheEncoding()
+    {
+        auto stage = pxr::UsdStage::CreateInMemory();
+        pxr::VtVec3fArray points, normals;
+        pxr::VtVec2fArray texCoords;
+        auto mesh = DefineMesh(stage, pxr::SdfPath("/mesh"), points, normals, texCoords);
+        std::string base = (std::filesystem::temp_directory_path() / ("usdSimpleCppTest.quantized." + std::to_string((long)getpid()))).string();
+
+        QuantizeSettings settings;
+        QuantizeReport report;
+        // as text the encoding would be bigger than the floats
+        CHECK(!ExportQuantizedStage(stage, base + ".usda", settings, report));
+        CHECK(ExportQuantizedStage(stage, base + ".usdc", settings, report));
+        CHECK(report.meshes == 1 && !report.keptFloats);
+
+        // the stage drawn here keeps only its floats, and isn't marked so there's nothing to decode
+        CHECK(mesh.GetPointsAttr().HasAuthoredValue());
+        CHECK(!mesh.GetPrim().HasAttribute(pxr::TfToken("quantized:points")));
+        CHECK(DecodeQuantizedMeshes(stage) == 0);
+
+        {
+            auto encoded = pxr::UsdStage::Open(base + ".usdc");
+            CHECK(encoded);
+            if (encoded)
+            {
+                pxr::UsdGeomMesh encodedMesh(encoded->GetPrimAtPath(pxr::SdfPath("/mesh")));
+                CHECK(!encodedMesh.GetPointsAttr().HasAuthoredValue() && !encodedMesh.GetNormalsAttr().HasAuthoredValue());
+                CHECK(encoded->GetRootLayer()->GetCustomLayerData().count("quantizedGeometry") == 1);
+                CHECK(DecodeQuantizedMeshes(encoded) == 1);
+                pxr::VtVec3fArray decodedPoints;
+                CHECK(encodedMesh.GetPointsAttr().Get(&decodedPoints) && decodedPoints.size() == points.size());
+            }
+        }
+        std::error_code error;
+        std::filesystem::remove(base + ".usdc", error);
+    }
+}
+
+int main()
+{
+    // two 16 bit snorms on the octahedron are within a few thousandths of a degree, halves within a few hundredths
+    TestRoundTripStaysInsideTheBounds(NormalEncoding::Octahedral, 0.01f);
+    TestRoundTripStaysInsideTheBounds(NormalEncoding::Half, 0.1f);
+    TestKeptFloatsStayAuthored();
+    TestFloatNormalsAreLeftAlone();
+    TestExportWritesOnlyTheEncoding();
+    return Testing::Result("quantizedMeshTest");
+}
@@ -0,0 +1,465 @@
+#include "renderQueue.h"
+
+#include <algorithm>
+#include <sstream>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    double MillisecondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    bool WriteAll(int fd, const std::string &data)
+    {
+        size_t written = 0;
+        while (written < data.size())
+        {
+            ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            written += (size_t)n;
+        }
+        return true;
+    }
+
+    // pull one complete line out of a buffer
+    bool TakeLine(std::string &buffer, std::string &line)
+    {
+        size_t end = buffer.find('\n');
+        if (end == std::string::npos)
+            return false;
+        line = buffer.substr(0, end);
+        buffer.erase(0, end + 1);
+        return true;
+    }
+}
+
+RenderDriver::RenderDriver()
+    : listenFd(-1), viewCount(0), viewCountKnown(false), nextView(0), viewsDone(0)
+{
+}
+
+RenderDriver::~RenderDriver()
+{
+    for (auto &worker : workers)
+    {
+        if (worker.fd >= 0)
+            close(worker.fd);
+    }
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+}
+
+bool RenderDriver::Listen()
+{
+    socketPath = "/tmp/usdSimpleCpp." + std::to_string(getpid()) + ".sock";
+    unlink(socketPath.c_str());
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 || bind(listenFd, (sockaddr *)&address, sizeof(address)) != 0 || listen(listenFd, 64) != 0)
+    {
+        std::cerr << "Unable to listen on " << socketPath << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RenderDriver::Spawn(int argc, char **argv, int index, int workerCount)
+{
+    // the same command line, the worker option tells the copies where to get their work. the thread options come
+    // after the driver's own so they replace them
+    std::vector<std::string> arguments(argv, argv + argc);
+    arguments.push_back("--worker");
+    arguments.push_back(socketPath);
+    size_t threads = std::max<size_t>(1, (concurrency.threads > 0 ? concurrency.threads : GetConcurrency()) / (size_t)workerCount);
+    arguments.push_back("--threads");
+    arguments.push_back(std::to_string(threads));
+    if (concurrency.firstCore >= 0)
+    {
+        arguments.push_back("--pin-cores");
+        arguments.push_back(std::to_string(concurrency.firstCore + index * (int)threads));
+    }
+    std::vector<char *> childArgv;
+    for (auto &argument : arguments)
+        childArgv.push_back(&argument[0]);
+    childArgv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        std::cerr << "Unable to start a worker: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (pid == 0)
+    {
+        execv("/proc/self/exe", childArgv.data());
+        _exit(127);
+    }
+    children.push_back((int)pid);
+    return true;
+}
+
+void RenderDriver::Accept()
+{
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    Worker worker;
+    worker.fd = fd;
+    worker.pid = 0;
+    worker.hasView = false;
+    worker.view = 0;
+    worker.waiting = false;
+    worker.viewsDone = 0;
+    worker.busyMs = 0.0;
+    worker.connected = std::chrono::steady_clock::now();
+    worker.disconnected = worker.connected;
+    workers.push_back(worker);
+}
+
+void RenderDriver::Send(Worker &worker, const std::string &line)
+{
+    if (!WriteAll(worker.fd, line + "\n"))
+        Lost(worker);
+}
+
+void RenderDriver::Lost(Worker &worker)
+{
+    if (worker.fd < 0)
+        return;
+    close(worker.fd);
+    worker.fd = -1;
+    worker.disconnected = std::chrono::steady_clock::now();
+    worker.waiting = false;
+
+    // somebody else renders whatever it was in the middle of
+    if (worker.hasView)
+    {
+        std::cerr << "Worker " << worker.pid << " went away during view " << worker.view << ", handing it out again" << std::endl;
+        retry.push_back(worker.view);
+        worker.hasView = false;
+        auto waiting = std::find_if(workers.begin(), workers.end(), [](const Worker &w) { return w.fd >= 0 && w.waiting; });
+        if (waiting != workers.end())
+            Assign(*waiting);
+        else if (std::none_of(workers.begin(), workers.end(), [](const Worker &w) { return w.fd >= 0; }))
+            std::cerr << "No workers are left to render view " << worker.view << std::endl;
+    }
+}
+
+bool RenderDriver::InFlight()
+{
+    return std::any_of(workers.begin(), workers.end(), [](const Worker &w) { return w.fd >= 0 && w.hasView; });
+}
+
+void RenderDriver::Assign(Worker &worker)
+{
+    worker.waiting = false;
+
+    // views given up by dead workers go first
+    if (!retry.empty())
+    {
+        worker.view = retry.front();
+        retry.pop_front();
+    }
+    else if (nextView < viewCount)
+        worker.view = nextView++;
+    else if (InFlight())
+    {
+        // one of the views still out may come back, hold on to this worker until they're done
+        worker.waiting = true;
+        return;
+    }
+    else
+    {
+        Send(worker, "stop");
+        for (auto &other : workers)
+        {
+            if (other.fd >= 0 && other.waiting)
+            {
+                other.waiting = false;
+                Send(other, "stop");
+            }
+        }
+        return;
+    }
+    worker.hasView = true;
+    Send(worker, "view " + std::to_string(worker.view));
+}
+
+bool RenderDriver::Read(Worker &worker)
+{
+    char buffer[256];
+    ssize_t n = recv(worker.fd, buffer, sizeof(buffer), 0);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        return true;
+    if (n <= 0)
+    {
+        Lost(worker);
+        return false;
+    }
+    worker.input.append(buffer, (size_t)n);
+
+    std::string line;
+    while (worker.fd >= 0 && TakeLine(worker.input, line))
+        Handle(worker, line);
+    return worker.fd >= 0;
+}
+
+void RenderDriver::Handle(Worker &worker, const std::string &line)
+{
+    std::istringstream stream(line);
+    std::string command;
+    stream >> command;
+
+    if (command == "hello")
+    {
+        size_t count = 0;
+        stream >> worker.pid >> count;
+        if (!viewCountKnown)
+        {
+            viewCount = count;
+            viewCountKnown = true;
+        }
+        else if (count != viewCount)
+            std::cerr << "Worker " << worker.pid << " sees " << count << " views, the others " << viewCount << std::endl;
+        return;
+    }
+
+    if (command != "next")
+    {
+        std::cerr << "Unexpected message from worker " << worker.pid << ": " << line << std::endl;
+        return;
+    }
+
+    size_t finished = 0;
+    double ms = 0.0;
+    if (stream >> finished >> ms && worker.hasView && finished == worker.view)
+    {
+        worker.viewsDone++;
+        worker.busyMs += ms;
+        viewsDone++;
+    }
+    worker.hasView = false;
+    Assign(worker);
+}
+
+bool RenderDriver::Run(int argc, char **argv, int workerCount, std::ostream &out)
+{
+    if (workerCount <= 0 || !Listen())
+        return false;
+
+    started = std::chrono::steady_clock::now();
+    for (int i = 0; i < workerCount; ++i)
+        Spawn(argc, argv, i, workerCount);
+    out << "Started " << children.size() << " workers on " << socketPath << std::endl;
+
+    size_t running = children.size();
+    while (running > 0)
+    {
+        std::vector<pollfd> fds;
+        fds.push_back({ listenFd, POLLIN, 0 });
+        for (auto &worker : workers)
+        {
+            if (worker.fd >= 0)
+                fds.push_back({ worker.fd, POLLIN, 0 });
+        }
+
+        // wake up now and again to notice workers that exited without connecting
+        int ready = poll(fds.data(), (nfds_t)fds.size(), 100);
+        if (ready < 0 && errno != EINTR)
+            break;
+
+        if (ready > 0)
+        {
+            if (fds[0].revents & POLLIN)
+                Accept();
+            for (size_t i = 1; i < fds.size(); ++i)
+            {
+                if (fds[i].revents == 0)
+                    continue;
+                auto worker = std::find_if(workers.begin(), workers.end(), [&](const Worker &w) { return w.fd == fds[i].fd; });
+                if (worker != workers.end())
+                    Read(*worker);
+            }
+        }
+
+        int status = 0;
+        while (running > 0 && waitpid(-1, &status, WNOHANG) > 0)
+        {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                std::cerr << "A worker exited abnormally" << std::endl;
+        }
+    }
+
+    // whatever is still connected belongs to a worker that has exited
+    for (auto &worker : workers)
+        Lost(worker);
+
+    Report(out);
+    return viewCountKnown && viewsDone == viewCount;
+}
+
+void RenderDriver::Report(std::ostream &out)
+{
+    double wallMs = MillisecondsBetween(started, std::chrono::steady_clock::now());
+    out << "Rendered " << viewsDone << " of " << viewCount << " views on " << children.size() << " workers in " << wallMs / 1000.0
+        << " s, " << (wallMs > 0.0 ? (double)viewsDone * 1000.0 / wallMs : 0.0) << " views/s" << std::endl;
+    for (const auto &worker : workers)
+    {
+        double connectedMs = MillisecondsBetween(worker.connected, worker.disconnected);
+        out << "    worker " << worker.pid << "  " << worker.viewsDone << " views, "
+            << (connectedMs > 0.0 ? (double)worker.viewsDone * 1000.0 / connectedMs : 0.0) << " views/s, "
+            << (worker.viewsDone > 0 ? worker.busyMs / (double)worker.viewsDone : 0.0) << " ms per view, busy "
+            << (connectedMs > 0.0 ? 100.0 * worker.busyMs / connectedMs : 0.0) << "%" << std::endl;
+    }
+}
+
+RenderWorker::RenderWorker()
+    : fd(-1), hasView(false), view(0)
+{
+}
+
+RenderWorker::~RenderWorker()
+{
+    Close();
+}
+
+bool RenderWorker::Connect(const std::string &socketPath, size_t viewCount)
+{
+    Close();
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        std::cerr << "Unable to connect to the driver on " << socketPath << ": " << strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+    if (!WriteAll(fd, "hello " + std::to_string(getpid()) + " " + std::to_string(viewCount) + "\n"))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void RenderWorker::Close()
+{
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+bool RenderWorker::ReadLine(std::string &line)
+{
+    while (!TakeLine(input, line))
+    {
+        char buffer[256];
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        input.append(buffer, (size_t)n);
+    }
+    return true;
+}
+
+bool RenderWorker::Next(size_t &next)
+{
+    if (fd < 0)
+        return false;
+
+    // asking for the next view reports the last one, the time covers rendering it and queueing its readback
+    auto now = std::chrono::steady_clock::now();
+    std::string request = "next";
+    if (hasView)
+        request += " " + std::to_string(view) + " " + std::to_string(MillisecondsBetween(viewStarted, now));
+    hasView = false;
+
+    std::string reply;
+    if (!WriteAll(fd, request + "\n") || !ReadLine(reply))
+    {
+        Close();
+        return false;
+    }
+
+    std::istringstream stream(reply);
+    std::string command;
+    stream >> command;
+    if (command != "view" || !(stream >> view))
+    {
+        Close();
+        return false;
+    }
+    hasView = true;
+    viewStarted = std::chrono::steady_clock::now();
+    next = view;
+    return true;
+}
+
+#else
+
+RenderDriver::RenderDriver()
+    : listenFd(-1), viewCount(0), viewCountKnown(false), nextView(0), viewsDone(0)
+{
+}
+
+RenderDriver::~RenderDriver() {}
+
+bool RenderDriver::Run(int, char **, int, std::ostream &)
+{
+    std::cerr << "Rendering with worker processes is only implemented on Linux" << std::endl;
+    return false;
+}
+
+bool RenderDriver::Listen() { return false; }
+bool RenderDriver::Spawn(int, char **, int, int) { return false; }
+void RenderDriver::Accept() {}
+bool RenderDriver::Read(Worker &) { return false; }
+void RenderDriver::Handle(Worker &, const std::string &) {}
+void RenderDriver::Assign(Worker &) {}
+bool RenderDriver::InFlight() { return false; }
+void RenderDriver::Lost(Worker &) {}
+void RenderDriver::Send(Worker &, const std::string &) {}
+void RenderDriver::Report(std::ostream &) {}
+
+RenderWorker::RenderWorker()
+    : fd(-1), hasView(false), view(0)
+{
+}
+
+RenderWorker::~RenderWorker() {}
+bool RenderWorker::Connect(const std::string &, size_t) { return false; }
+void RenderWorker::Close() {}
+bool RenderWorker::ReadLine(std::string &) { return false; }
+bool RenderWorker::Next(size_t &) { return false; }
+
+#endif
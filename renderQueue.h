@@ -0,0 +1,100 @@
+#pragma once
+
+#include "batchRender.h"
+#include "concurrency.h"
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// splits a batch across worker processes on one machine
+//
+// the driver starts N copies of this executable with the same command line plus --worker <socket>, each opens the
+// stage itself (the files are shared through the page cache) and builds the same list of views. workers pull one
+// view at a time over a unix socket so a worker stuck on an expensive view simply takes fewer of them, and a view
+// handed to a worker that dies is handed out again. workers are only told to stop once no views are out, so there's
+// always someone left to take one back. the workers need --stage, each would author and save the scene otherwise
+//
+// the protocol is a line at a time:
+//   worker  hello <pid> <views>     once connected
+//   worker  next [<view> <ms>]      asking for work, reporting the view it just finished
+//   driver  view <index>            or
+//   driver  stop                    nothing left
+class RenderDriver
+{
+public:
+    RenderDriver();
+    virtual ~RenderDriver();
+
+    // spawn workerCount workers and hand out views until they're all rendered, blocks until the workers exit
+    bool Run(int argc, char **argv, int workerCount, std::ostream &out);
+
+    // the driver's own thread budget, split evenly between the workers so they don't oversubscribe the machine. if it
+    // was pinned each worker gets its own run of cores from the first one on
+    void SetConcurrency(const ConcurrencySettings &settings) { concurrency = settings; }
+
+protected:
+    struct Worker
+    {
+        int fd;
+        int pid;
+        std::string input;
+        bool hasView;
+        size_t view;
+        // asked for work while the last views were still out, answered once they're done or one comes back
+        bool waiting;
+        size_t viewsDone;
+        double busyMs;
+        std::chrono::steady_clock::time_point connected, disconnected;
+    };
+
+    bool Listen();
+    bool Spawn(int argc, char **argv, int index, int workerCount);
+    void Accept();
+    // false once the worker has hung up
+    bool Read(Worker &worker);
+    void Handle(Worker &worker, const std::string &line);
+    // give the worker a view, keep it waiting or tell it to stop
+    void Assign(Worker &worker);
+    bool InFlight();
+    void Lost(Worker &worker);
+    void Send(Worker &worker, const std::string &line);
+    void Report(std::ostream &out);
+
+    std::string socketPath;
+    int listenFd;
+    std::vector<int> children;
+    std::vector<Worker> workers;
+    std::deque<size_t> retry;
+    size_t viewCount;
+    bool viewCountKnown;
+    size_t nextView;
+    size_t viewsDone;
+    std::chrono::steady_clock::time_point started;
+    ConcurrencySettings concurrency;
+};
+
+// the worker end, hands RenderBatch the views the driver gives out
+class RenderWorker : public BatchQueue
+{
+public:
+    RenderWorker();
+    virtual ~RenderWorker();
+
+    bool Connect(const std::string &socketPath, size_t viewCount);
+    void Close();
+
+    bool Next(size_t &view) override;
+
+protected:
+    bool ReadLine(std::string &line);
+
+    int fd;
+    std::string input;
+    bool hasView;
+    size_t view;
+    std::chrono::steady_clock::time_point viewStarted;
+};
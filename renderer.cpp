@@ -1,12 +1,30 @@
 #include <GL/glew.h>
 #include "renderer.h"
+#include "concurrency.h"
 #include "shader.h"
+#include "memoryReport.h"
+#include "renderQueue.h"
+#include "scene.h"
+#include "stageCache.h"
 
+#include <pxr/base/tf/stringUtils.h>
 #include <pxr/imaging/hdx/hgiConversions.h>
 #include <pxr/imaging/hgi/blitCmds.h>
 #include <pxr/imaging/hgi/blitCmdsOps.h>
 #include <pxr/imaging/hgi/hgi.h>
-
+#include <pxr/imaging/hd/perfLog.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/usd/usdGeom/bboxCache.h>
+#include <pxr/usd/usdGeom/imageable.h>
+#include <pxr/usd/usd/modelAPI.h>
+#include <pxr/usd/kind/registry.h>
+
+#include <glm/matrix.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 
 #define PRIMARY_DEPTH_VIS 0
@@ -29,29 +47,75 @@ std::string s_fs =
 "layout(location = 0) in vec2 uv;\n"
 "uniform sampler2D primary;"
 "uniform sampler2D secondary;"
+"uniform vec2 renderSize;\n"
+"uniform vec2 uvScale;\n"
+"uniform int upscale;\n"
+"uniform int showOverlay;\n"
+"uniform sampler2D primaryDepth;"
+"uniform sampler2D externalColor;"
+"uniform sampler2D externalDepth;"
+"uniform int showExternal;\n"
 "out vec4 fragColor;"
+// catmull-rom filter folded into 9 bilinear taps, used when the render buffers are smaller than the window
+"vec4 sampleBicubic(sampler2D tex, vec2 coord)\n"
+"{\n"
+"    vec2 samplePos = coord * renderSize;\n"
+"    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;\n"
+"    vec2 f = samplePos - texPos1;\n"
+"    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));\n"
+"    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);\n"
+"    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));\n"
+"    vec2 w3 = f * f * (-0.5 + 0.5 * f);\n"
+"    vec2 w12 = w1 + w2;\n"
+"    vec2 texPos0 = (texPos1 - 1.0) / renderSize;\n"
+"    vec2 texPos3 = (texPos1 + 2.0) / renderSize;\n"
+"    vec2 texPos12 = (texPos1 + w2 / w12) / renderSize;\n"
+// the frame only covers part of the buffers, keep the taps off whatever is left beyond it
+"    vec2 uvMax = uvScale - 0.5 / renderSize;\n"
+"    texPos0 = min(texPos0, uvMax);\n"
+"    texPos3 = min(texPos3, uvMax);\n"
+"    texPos12 = min(texPos12, uvMax);\n"
+"    vec4 result = vec4(0.0);\n"
+"    result += texture(tex, vec2(texPos0.x,  texPos0.y))  * w0.x  * w0.y;\n"
+"    result += texture(tex, vec2(texPos12.x, texPos0.y))  * w12.x * w0.y;\n"
+"    result += texture(tex, vec2(texPos3.x,  texPos0.y))  * w3.x  * w0.y;\n"
+"    result += texture(tex, vec2(texPos0.x,  texPos12.y)) * w0.x  * w12.y;\n"
+"    result += texture(tex, vec2(texPos12.x, texPos12.y)) * w12.x * w12.y;\n"
+"    result += texture(tex, vec2(texPos3.x,  texPos12.y)) * w3.x  * w12.y;\n"
+"    result += texture(tex, vec2(texPos0.x,  texPos3.y))  * w0.x  * w3.y;\n"
+"    result += texture(tex, vec2(texPos12.x, texPos3.y))  * w12.x * w3.y;\n"
+"    result += texture(tex, vec2(texPos3.x,  texPos3.y))  * w3.x  * w3.y;\n"
+"    return max(result, vec4(0.0));\n"
+"}\n"
 "void main()\n"
 "{\n"
+"   vec2 renderUv = uv * uvScale;\n"
 "   if(uv.y > 0.5){\n"
 #if SECONDARY_DEPTH_VIS
-"       float d = texture(secondary, uv).r;\n"
+"       float d = texture(secondary, renderUv).r;\n"
 //"       d = (d + 1.0) / 2.0;\n"
 "       fragColor = vec4(d, d, d, 1.0);\n"
 "       return;\n"
 #else
-"       fragColor = texture(secondary, uv).rgba;\n"
+"       fragColor = texture(secondary, renderUv).rgba;\n"
 #endif
 "   }else{\n"
 #if PRIMARY_DEPTH_VIS
-"       float d = texture(primary, uv).r;\n"
+"       float d = texture(primary, renderUv).r;\n"
 "       fragColor = vec4(d, d, d, 1.0);\n"
 "       return;\n"
 #else
-"       fragColor = texture(primary, uv).rgba;\n"
+"       fragColor = texture(primary, renderUv).rgba;\n"
 #endif
 "   }\n"
-"   vec4 overlay = texture(secondary, uv).rgba;\n"
-"   fragColor = overlay.a == 0.0 ? texture(primary, uv).rgba : texture(secondary, uv).rgba;\n"
+"   vec4 overlay = texture(secondary, renderUv).rgba;\n"
+"   vec4 color = upscale != 0 ? sampleBicubic(primary, renderUv) : texture(primary, renderUv);\n"
+// externally rendered fragments in front of Hydra's blend over it
+"   if (showExternal != 0 && texture(externalDepth, uv).r < texture(primaryDepth, renderUv).r) {\n"
+"       vec4 external = texture(externalColor, uv);\n"
+"       color.rgb = mix(color.rgb, external.rgb, external.a);\n"
+"   }\n"
+"   fragColor = (showOverlay == 0 || overlay.a == 0.0) ? color : overlay;\n"
 "}\n";
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
@@ -60,6 +124,20 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 	windowState->mouseButton = button;
 	windowState->mouseButtonState = action;
     windowState->camera->MouseDown(button, action, mods, (int)windowState->mouseX, (int)windowState->mouseY);
+
+    // a left click that doesn't drag the camera is a pick
+    if (button != GLFW_MOUSE_BUTTON_LEFT)
+        return;
+    if (action == GLFW_PRESS)
+    {
+        windowState->pressX = windowState->mouseX;
+        windowState->pressY = windowState->mouseY;
+    }
+    else if (std::abs(windowState->mouseX - windowState->pressX) < 3.0 && std::abs(windowState->mouseY - windowState->pressY) < 3.0)
+    {
+        windowState->pickRequested = true;
+        windowState->pickAdd = (mods & GLFW_MOD_SHIFT) != 0;
+    }
 }
 
 void mouse_scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
@@ -84,25 +162,64 @@ void cursor_position_callback(GLFWwindow* window, double x, double y)
 	windowState->mouseY = ypos;
 }
 
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    WindowState* windowState = static_cast<WindowState*>(glfwGetWindowUserPointer(window));
+    if (action != GLFW_PRESS)
+        return;
+
+    if (key == GLFW_KEY_M)
+        windowState->memoryReportRequested = true;
+    else if (key == GLFW_KEY_F)
+        windowState->focusRequested = true;
+}
+
 void window_size_callback(GLFWwindow* window, int width, int height)
 {
     WindowState* windowState = static_cast<WindowState*>(glfwGetWindowUserPointer(window));
     windowState->camera->SetScreenDimensions(glm::vec4(0.f, 0.f, (float)width, (float)height));
+    if (windowState->resizeDebouncer)
+        windowState->resizeDebouncer->Resize(width, height);
 }
 
 GLRenderer::GLRenderer()
 {
     primaryGraphicsEngine = nullptr;
     secondaryGraphicsEngine = nullptr;
+    idGraphicsEngine = nullptr;
     stage = nullptr;
     window = nullptr;
+    memoryReportOnFirstFrame = false;
+    motionAdaptiveQuality = true;
+    hasPickPoint = false;
+    interactiveDrawBounds = false;
+    cameraMoving = false;
+    interactiveParamsStale = true;
+    interactiveHasProxies = false;
+    interactiveScanStale = true;
+    turntableFrames = 0;
+    useStageCache = false;
+    pickReport = false;
+    nearPlane = 0.1f;
+    farPlane = 100.f;
+    projectionExtent = glm::ivec2(0, 0);
 
     this->camera.SetEye(&this->eye);
 	this->camera.SetViewMatrix(&this->viewMatrix);
+
+    // the camera tells us when a drag starts and stops, the next frame picks the matching render params. they're made
+    // again at the start of every drag from the scan, which is only redone once the stage has changed
+    this->camera.SetMotionCallback([this](bool moving)
+    {
+        this->cameraMoving = moving;
+        if (moving)
+            this->interactiveParamsStale = true;
+    });
 }
 
 GLRenderer::~GLRenderer()
 {
+    pxr::TfNotice::Revoke(stageNoticeKey);
 }
 
 void GLRenderer::SetSceneBounds(glm::vec3 &sceneMin, glm::vec3 &sceneMax)
@@ -117,50 +234,192 @@ void GLRenderer::SetSceneBounds(glm::vec3 &sceneMin, glm::vec3 &sceneMax)
     camera.SetPosition(glm::vec3(c.x, c.y, c.z - glm::length(d)));
 
     auto bounds_size = glm::length(d);
+    nearPlane = bounds_size / 10.f;
+    farPlane = bounds_size * 10.f;
+    UpdateProjection();
+}
 
-    auto extent = this->GetExtent();
+void GLRenderer::UpdateProjection()
+{
+    projectionExtent = this->GetExtent();
     auto &projection = this->GetProjectionMatrix();
-    projection = glm::perspective(glm::radians(45.f), (float)extent.x / (float)extent.y, bounds_size/10.f, bounds_size*10.0f);
+    projection = glm::perspective(glm::radians(45.f), (float)projectionExtent.x / (float)projectionExtent.y, nearPlane, farPlane);
+}
+
+void GLRenderer::ReportMemory(std::ostream &out)
+{
+    MemoryReport report;
+    CollectStageMemory(stage, 10, report);
+    CollectEngineMemory("primary", primaryGraphicsEngine, report);
+    CollectEngineMemory("secondary", secondaryGraphicsEngine, report);
+    CollectEngineMemory("id", idGraphicsEngine, report);
+    PrintMemoryReport(report, out);
+}
+
+bool GLRenderer::Pick(double x, double y, SceneBVH::Hit &hit)
+{
+    if (!stage)
+        return false;
+
+    // built in BeginRender, only edits since then are caught up on here
+    sceneBvh.Update();
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // unproject two points under the cursor, any two depths inside the frustum give the same ray
+    auto screenDims = this->camera.GetScreenDimensions();
+    float ndcX = (float)(2.0 * x / screenDims.z - 1.0);
+    float ndcY = (float)(1.0 - 2.0 * y / screenDims.w);
+    glm::mat4 inverseViewProjection = glm::inverse(this->projectionMatrix * this->viewMatrix);
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 0.f, 1.f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 0.5f, 1.f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+
+    bool found = sceneBvh.Intersect(origin, direction, hit);
+
+    if (!pickReport)
+        return found;
+    auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+    if (found)
+        std::cout << "Picked " << hit.path.GetString() << " at (" << hit.point.x << ", " << hit.point.y << ", " << hit.point.z << ") in " << elapsed << " us" << std::endl;
+    else
+        std::cout << "Picked nothing in " << elapsed << " us" << std::endl;
+    return found;
+}
+
+void GLRenderer::PrepareInteractiveRenderParams()
+{
+    if (this->interactiveScanStale)
+    {
+        ScanInteractiveScene();
+        this->interactiveScanStale = false;
+    }
+
+    // only the task level params change between the two sets so switching never dirties any prims
+    this->interactiveRenderParams = this->primaryRenderParams;
+    this->interactiveRenderParams.enableLighting = false;
+    // complexity 1 is already the coarsest refinement, the saving comes from drawing proxies or bounds instead
+
+    // proxies stand in for the render purpose geometry
+    this->interactiveDrawBounds = !this->interactiveHasProxies;
+    this->interactiveRenderParams.showRender = false;
+    this->interactiveRenderParams.showProxy = true;
+    if (this->interactiveHasProxies)
+        return;
+
+    this->interactiveRenderParams.bboxes = this->interactiveBounds;
+    this->interactiveRenderParams.bboxLineColor = pxr::GfVec4f(1.f, 1.f, 1.f, 1.f);
+}
+
+void GLRenderer::ScanInteractiveScene()
+{
+    // with proxies authored we draw those, otherwise just the bounds of the models (or gprims if there are no models).
+    // proxies almost always sit below a component, so the whole stage is searched and the first one ends it
+    this->interactiveHasProxies = false;
+    this->interactiveBounds.clear();
+    std::vector<pxr::UsdPrim> boundsPrims, gprims;
+    pxr::SdfPath component;
+    for (const auto &prim : stage->Traverse(pxr::UsdTraverseInstanceProxies()))
+    {
+        pxr::TfToken purpose;
+        pxr::UsdGeomImageable imageable(prim);
+        if (imageable && imageable.GetPurposeAttr().Get(&purpose) && purpose == pxr::UsdGeomTokens->proxy)
+        {
+            this->interactiveHasProxies = true;
+            return;
+        }
+
+        // only the outermost component gets a box
+        if (!component.IsEmpty() && prim.GetPath().HasPrefix(component))
+            continue;
+        pxr::TfToken kind;
+        if (pxr::UsdModelAPI(prim).GetKind(&kind) && pxr::KindRegistry::IsA(kind, pxr::KindTokens->component))
+        {
+            boundsPrims.push_back(prim);
+            component = prim.GetPath();
+        }
+        else if (prim.IsA<pxr::UsdGeomGprim>())
+            gprims.push_back(prim);
+    }
+
+    if (boundsPrims.empty())
+        boundsPrims.swap(gprims);
+
+    pxr::UsdGeomBBoxCache bboxCache(pxr::UsdTimeCode::Default(), { pxr::UsdGeomTokens->default_, pxr::UsdGeomTokens->render }, true);
+    this->interactiveBounds.reserve(boundsPrims.size());
+    for (const auto &prim : boundsPrims)
+        this->interactiveBounds.push_back(bboxCache.ComputeWorldBound(prim));
+}
+
+void GLRenderer::OnObjectsChanged(const pxr::UsdNotice::ObjectsChanged &notice, const pxr::UsdStageWeakPtr &sender)
+{
+    if (!notice.GetResyncedPaths().empty())
+    {
+        this->interactiveScanStale = true;
+        return;
+    }
+
+    // kinds and purposes decide what's drawn, points and transforms move the bounds
+    for (const auto &path : notice.GetChangedInfoOnlyPaths())
+    {
+        if (path.IsPrimPath())
+        {
+            this->interactiveScanStale = true;
+            return;
+        }
+        const auto &name = path.GetNameToken();
+        if (name == pxr::UsdGeomTokens->purpose || name == pxr::UsdGeomTokens->points || name == pxr::UsdGeomTokens->extent ||
+            name == pxr::UsdGeomTokens->visibility || name == pxr::UsdGeomTokens->xformOpOrder || pxr::TfStringStartsWith(name.GetString(), "xformOp:"))
+        {
+            this->interactiveScanStale = true;
+            return;
+        }
+    }
+}
+
+void GLRenderer::UpdateWindowTitle()
+{
+    char title[256];
+    snprintf(title, sizeof(title), "GL Renderer - %.2f ms (cpu %.2f, gpu %.2f) - %dx%d @ %.0f%% in %dx%d%s - %zu items in %zu batches",
+        metrics.frameMs, metrics.cpuMs, metrics.gpuMs, metrics.renderWidth, metrics.renderHeight, metrics.resolutionScale * 100.f,
+        metrics.bufferWidth, metrics.bufferHeight, resizeDebouncer.IsResizing() ? " (resizing)" : "", metrics.itemsDrawn, metrics.drawBatches);
+    glfwSetWindowTitle(window, title);
 }
 
 void GLRenderer::CreateGLWindow(uint32_t width, uint32_t height)
 {
+    // the projection is made for this size until the window reports its own
+    resizeDebouncer.Resize((int)width, (int)height);
+
     // load the scene
     //auto prim = stage->Load();
     //stage = pxr::UsdStage::Open("c:\\src\\datasets\\flighthelmet.usdc");
     //stage = pxr::UsdStage::Open("c:\\src\\datasets\\Kitchen_set\\assets\\WoodenDryingRack\\WoodenDryingRack.geom.usd");
-    stage = pxr::UsdStage::Open("c:\\src\\datasets\\Kitchen_set\\Kitchen_set.usd");
-    auto range = stage->Traverse();
-    bool extentsSet = false;
-    glm::vec3 extentMin, extentMax;
-    for (auto &it = range.begin(); it != range.end(); it++)
+    if (!stage)
     {
-        if (auto extentAttr = (*it).GetAttribute(pxr::UsdGeomTokens->extent))
+        PhaseTimer timer("open");
+        const char *stageFile = "c:\\src\\datasets\\Kitchen_set\\Kitchen_set.usd";
+        if (useStageCache)
         {
-            pxr::VtVec3fArray extentArray(2);
-            extentAttr.Get(&extentArray);
-            glm::vec3 gmin(extentArray[0][0], extentArray[0][1], extentArray[0][2]);
-            glm::vec3 gmax(extentArray[1][0], extentArray[1][1], extentArray[1][2]);
-
-            if (!extentsSet)
-            {
-                extentMin = gmin;
-                extentMax = gmax;
-                extentsSet = true;
-            }
-            else {
-                extentMin.x = std::min(extentMin.x, gmin.x);
-                extentMin.y = std::min(extentMin.y, gmin.y);
-                extentMin.z = std::min(extentMin.z, gmin.z);
-                extentMax.x = std::max(extentMax.x, gmax.x);
-                extentMax.y = std::max(extentMax.y, gmax.y);
-                extentMax.z = std::max(extentMax.z, gmax.z);
-            }
+            StageCacheReport report;
+            stage = StageCache(stageCacheDirectory).Open(stageFile, &report);
+            if (stage)
+                PrintStageCacheReport(report, std::cout);
+        }
+        else
+            stage = pxr::UsdStage::Open(stageFile);
+    }
+    {
+        PhaseTimer timer("bounds");
+        pxr::GfVec3f stageMin, stageMax;
+        if (stageExtent(stage, stageMin, stageMax))
+        {
+            glm::vec3 extentMin(stageMin[0], stageMin[1], stageMin[2]);
+            glm::vec3 extentMax(stageMax[0], stageMax[1], stageMax[2]);
+            this->SetSceneBounds(extentMin, extentMax);
         }
     }
-
-    if(extentsSet)
-        this->SetSceneBounds(extentMin, extentMax);
 
     /*
     std::copy_if(range.begin(), range.end(), std::back_inserter(meshes),
@@ -186,11 +445,15 @@ void GLRenderer::CreateGLWindow(uint32_t width, uint32_t height)
             activeRendererPlugin = token;
     }
 
-    int pluginIndex = 0;
-    std::cout << "Renderer Plugin: ";
-    std::cin >> pluginIndex;
-    if (rendererPlugins.find(pluginIndex) != rendererPlugins.end())
-        activeRendererPlugin = rendererPlugins[pluginIndex];
+    // batches and benchmarks run unattended
+    if (!batchSettings.IsEnabled() && computeBenchmark.frames == 0 && pointCloudBenchmark.frames == 0)
+    {
+        int pluginIndex = 0;
+        std::cout << "Renderer Plugin: ";
+        std::cin >> pluginIndex;
+        if (rendererPlugins.find(pluginIndex) != rendererPlugins.end())
+            activeRendererPlugin = rendererPlugins[pluginIndex];
+    }
 
     // parameters for the GL renderer
     this->primaryRenderParams.showRender = true;
@@ -201,6 +464,7 @@ void GLRenderer::CreateGLWindow(uint32_t width, uint32_t height)
     this->primaryRenderParams.cullStyle = pxr::UsdImagingGLCullStyle::CULL_STYLE_NOTHING;
     this->primaryRenderParams.colorCorrectionMode = pxr::HdxColorCorrectionTokens->disabled;
     this->primaryRenderParams.clearColor = pxr::GfVec4f(17.f / 255.f, 80.f / 255.f, 147.f / 255.f, 1.f);
+    this->primaryRenderParams.highlight = true;
 
     this->secondaryRenderParams.showRender = true;
     this->secondaryRenderParams.enableLighting = true;
@@ -216,6 +480,7 @@ void GLRenderer::CreateGLWindow(uint32_t width, uint32_t height)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, batchSettings.IsEnabled() || computeBenchmark.frames > 0 || pointCloudBenchmark.frames > 0 ? GLFW_FALSE : GLFW_TRUE);
     this->window = glfwCreateWindow(width, height, "GL Renderer", nullptr, nullptr);
 
     glfwMakeContextCurrent(window);
@@ -242,6 +507,7 @@ void GLRenderer::BeginRender()
 {
     WindowState wstate;
     wstate.camera = &(this->camera);
+    wstate.resizeDebouncer = &this->resizeDebouncer;
     glfwSetWindowUserPointer(window, (void *)&wstate);
 
     // set glfw input callbacks
@@ -249,14 +515,32 @@ void GLRenderer::BeginRender()
     glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetScrollCallback(window, mouse_scroll_callback);
     glfwSetWindowSizeCallback(window, window_size_callback);
+    glfwSetKeyCallback(window, key_callback);
 
-    primaryGraphicsEngine = new pxr::UsdImagingGLEngine();
+    // draw batch and item counts come from Hydra's perf counters
+    pxr::HdPerfLog::GetInstance().Enable();
+
+    primaryGraphicsEngine = new ComputeGLEngine();
     primaryGraphicsEngine->SetRendererPlugin(rendererPlugins[1]);
     //primaryGraphicsEngine->SetRendererPlugin(activeRendererPlugin);
 
+    // the render index only exists once the plugin is set, and is replaced if it changes
+    if (primaryGraphicsEngine->GetRenderIndex())
+        computeDelegate.reset(new ComputeSceneDelegate(primaryGraphicsEngine->GetRenderIndex(), pxr::SdfPath("/Compute")));
+
     secondaryGraphicsEngine = new pxr::UsdImagingGLEngine();
     secondaryGraphicsEngine->SetRendererPlugin(rendererPlugins[1]);
 
+    // Storm only fills the prim id aov when it's asked for, render it with an engine of its own so the others keep
+    // their buffers. it's a second sync of the whole stage, so only when the aovs are captured
+    if (frameCapture.CapturesAovs())
+    {
+        idGraphicsEngine = new pxr::UsdImagingGLEngine();
+        idGraphicsEngine->SetRendererPlugin(rendererPlugins[1]);
+        // the ids are only read back from the aov, presenting them would draw over the composite before it's captured
+        idGraphicsEngine->SetEnablePresentation(false);
+    }
+
     static pxr::TfToken tokenDenoisingEnabled("OxideDenoiseEnabled");
     primaryGraphicsEngine->SetRendererSetting(tokenDenoisingEnabled, pxr::VtValue(false));
 
@@ -287,11 +571,19 @@ void GLRenderer::BeginRender()
     lights.push_back(light1);
 
     primaryGraphicsEngine->SetLightingState(lights, material, pxr::GfVec4f(0.15f));
+    primaryGraphicsEngine->SetSelectionColor(pxr::GfVec4f(1.f, 1.f, 0.f, 0.5f));
+    appliedSelection.clear();
     secondaryGraphicsEngine->SetLightingState(lights, material, pxr::GfVec4f(0.15f));
 
     this->camera.SetPosition(sceneBounds[1] * 4.f);
     this->camera.Update();
 
+    // the proxy scan and bounds used while dragging are only taken again after an edit that could change them
+    pxr::TfNotice::Revoke(stageNoticeKey);
+    if (stage)
+        stageNoticeKey = pxr::TfNotice::Register(pxr::TfCreateWeakPtr(this), &GLRenderer::OnObjectsChanged, stage);
+    this->interactiveScanStale = true;
+
     // convert from glm to pxr::GfMatrix4d
     auto makeMatrix = [](glm::mat4x4 &mat) -> pxr::GfMatrix4d
     {
@@ -311,30 +603,176 @@ void GLRenderer::BeginRender()
     GLuint emptyVAO;
     glGenVertexArrays(1, &emptyVAO);
 
+    wstate.memoryReportRequested = memoryReportOnFirstFrame;
+
+    // the composite samples the aovs through this so upscaling is filtered whatever state Hydra left the textures in
+    GLuint compositeSampler;
+    glGenSamplers(1, &compositeSampler);
+    glSamplerParameteri(compositeSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(compositeSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(compositeSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(compositeSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // depth is compared, never filtered
+    GLuint depthSampler;
+    glGenSamplers(1, &depthSampler);
+    glSamplerParameteri(depthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(depthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glSamplerParameteri(depthSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(depthSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(depthSampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    if (computeBenchmark.frames > 0)
+    {
+        ComputeBenchmarkReport report;
+        if (RunComputeBenchmark(activeRendererPlugin, computeBenchmark, report))
+            PrintComputeBenchmark(report, std::cout);
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+    if (pointCloudBenchmark.frames > 0)
+    {
+        PointCloudBenchmarkReport report;
+        if (RunPointCloudBenchmark(activeRendererPlugin, pointCloudBenchmark, report))
+            PrintPointCloudBenchmark(report, std::cout);
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+
+    // a batch renders every view through the primary engine, so the stage is synced once, and skips the loop
+    if (batchSettings.IsEnabled())
+    {
+        pxr::GfVec3d boundsMin(sceneBounds[0].x, sceneBounds[0].y, sceneBounds[0].z);
+        pxr::GfVec3d boundsMax(sceneBounds[1].x, sceneBounds[1].y, sceneBounds[1].z);
+        auto views = MakeOrbitViews(boundsMin, boundsMax, batchSettings.orbitViews, batchSettings.width, batchSettings.height);
+        if (batchSettings.stageCameras)
+            CollectCameraViews(stage, batchSettings.width, views);
+
+        // as a worker only the views the driver hands out are ours
+        RenderWorker worker;
+        BatchQueue *queue = nullptr;
+        if (!batchSettings.workerSocket.empty() && worker.Connect(batchSettings.workerSocket, views.size()))
+            queue = &worker;
+
+        BatchReport report;
+        if (batchSettings.workerSocket.empty() || queue)
+        {
+            if (RenderBatch(primaryGraphicsEngine, stage->GetPseudoRoot(), this->primaryRenderParams, views, batchSettings, report, queue))
+                std::cout << "Wrote " << report.imagesWritten << " images to " << batchSettings.directory << std::endl;
+            PrintBatchReport(report, std::cout);
+        }
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+
+    // build the pick tree before the first frame rather than stalling the first click on it, the benchmarks and
+    // batches above never pick
+    if (stage && !glfwWindowShouldClose(window))
+    {
+        sceneBvh.Build(stage);
+        std::cout << "Built pick BVH over " << sceneBvh.GetTriangleCount() << " triangles in " << sceneBvh.GetMeshCount()
+                  << " meshes in " << sceneBvh.GetLastBuildMs() << " ms" << std::endl;
+    }
+
+    // captured and exported aovs are read back whole, so the buffers have to match the frame exactly
+    if (frameCapture.IsEnabled() || frameExport.IsEnabled())
+        resizeDebouncer.SetSizeStep(1);
+    // a sequence should come out at one resolution
+    if (frameCapture.IsEnabled() && frameGovernor.GetBudget() > 0.0)
+    {
+        std::cerr << "Capturing at full resolution, the frame budget is ignored" << std::endl;
+        frameGovernor.SetBudget(0.0);
+    }
+
+    auto lastTitleUpdate = std::chrono::high_resolution_clock::now();
+
     // render loop
     while( !glfwWindowShouldClose(window) )
     {
-        auto screenDims = this->camera.GetScreenDimensions();
-        glm::ivec2 windowDims((uint32_t)screenDims.z, (uint32_t)screenDims.w);
+        frameGovernor.BeginFrame();
+
+        // turn about the world up axis through the target, before the callbacks so they see this frame's camera
+        if (turntableFrames > 0)
+        {
+            glm::vec3 target = this->camera.GetTarget();
+            glm::mat4 turn = glm::rotate(glm::mat4(1.f), glm::two_pi<float>() / (float)turntableFrames, glm::vec3(0.f, 1.f, 0.f));
+            this->camera.SetPosition(target + glm::vec3(turn * glm::vec4(this->camera.GetPosition() - target, 0.f)));
+            this->camera.Update();
+        }
+
+        for (auto &callback : frameCallbacks)
+            callback();
+
+        resizeDebouncer.Update();
+        glm::ivec2 windowDims = resizeDebouncer.GetWindowSize();
+        if (windowDims != projectionExtent)
+            UpdateProjection();
+
+        // hydra renders at a fraction of the window when we're over the frame budget (or the window is being resized)
+        // into the corner of the render buffers and the composite scales it back up
+        float scale = frameGovernor.GetScale();
+        glm::ivec2 renderDims = resizeDebouncer.GetRenderSize(scale);
+        glm::ivec2 bufferDims = resizeDebouncer.GetBufferSize();
+
         primaryGraphicsEngine->SetCameraState(makeMatrix(this->viewMatrix), makeMatrix(this->projectionMatrix));
-        primaryGraphicsEngine->SetRenderBufferSize(pxr::GfVec2i(windowDims.x, windowDims.y));
+        primaryGraphicsEngine->SetRenderBufferSize(pxr::GfVec2i(bufferDims.x, bufferDims.y));
         primaryGraphicsEngine->SetRendererAov(pxr::HdAovTokens->color);
-        primaryGraphicsEngine->SetRenderViewport(pxr::GfVec4d(0, 0, windowDims.x, windowDims.y));
+        primaryGraphicsEngine->SetRenderViewport(pxr::GfVec4d(0, 0, renderDims.x, renderDims.y));
         primaryGraphicsEngine->SetWindowPolicy(pxr::CameraUtilConformWindowPolicy::CameraUtilFit);
-        primaryGraphicsEngine->Render(stage->GetPseudoRoot(), this->primaryRenderParams);
-        
-        auto depthTexture = primaryGraphicsEngine->GetAovTexture(pxr::HdAovTokens->depth);
-        
-        secondaryGraphicsEngine->SetCameraState(makeMatrix(this->viewMatrix), makeMatrix(this->projectionMatrix));
-        secondaryGraphicsEngine->SetRenderBufferSize(pxr::GfVec2i(windowDims.x, windowDims.y));
-        secondaryGraphicsEngine->SetRendererAov(pxr::HdAovTokens->color);
-        secondaryGraphicsEngine->SetRenderViewport(pxr::GfVec4d(0, 0, windowDims.x, windowDims.y));
-        secondaryGraphicsEngine->SetWindowPolicy(pxr::CameraUtilConformWindowPolicy::CameraUtilFit);
-        secondaryGraphicsEngine->SetRendererSetting(pxr::TfToken("clearDepth"), pxr::VtValue(true));
-
-        if (depthTexture)
-            secondaryGraphicsEngine->PopulateAovTexture(pxr::HdAovTokens->depth, depthTexture);
-        secondaryGraphicsEngine->Render(stage->GetPseudoRoot(), this->secondaryRenderParams);
+        // items drawn accumulates every frame, draw batches only changes when they're rebuilt
+        pxr::HdPerfLog::GetInstance().SetCounter(pxr::HdPerfTokens->itemsDrawn, 0.0);
+
+        // hand the selection to hydra so the primary pass highlights it
+        if (selection != appliedSelection)
+        {
+            primaryGraphicsEngine->SetSelected(selection);
+            appliedSelection = selection;
+        }
+
+        // while the camera is being dragged draw proxies or bounds without lighting and skip the overlay pass
+        bool interactive = this->motionAdaptiveQuality && this->cameraMoving;
+        if (interactive && this->interactiveParamsStale)
+        {
+            PrepareInteractiveRenderParams();
+            this->interactiveParamsStale = false;
+        }
+        {
+            // the engine syncs the changed prims and then records the draws, time spent in both counts as sync
+            PhaseTimer timer("sync");
+            if (!interactive)
+                primaryGraphicsEngine->Render(stage->GetPseudoRoot(), this->primaryRenderParams);
+            else if (!this->interactiveDrawBounds)
+                primaryGraphicsEngine->Render(stage->GetPseudoRoot(), this->interactiveRenderParams);
+            else
+            {
+                // an empty collection draws no geometry at all, just the bounding boxes
+                primaryGraphicsEngine->PrepareBatch(stage->GetPseudoRoot(), this->interactiveRenderParams);
+                primaryGraphicsEngine->RenderBatch(pxr::SdfPathVector(), this->interactiveRenderParams);
+            }
+        }
+
+        // the wireframe overlay only covers the selection so there's nothing to do without one
+        metrics.drawBatches = (size_t)pxr::HdPerfLog::GetInstance().GetCounter(pxr::HdPerfTokens->drawBatches);
+        metrics.itemsDrawn = (size_t)pxr::HdPerfLog::GetInstance().GetCounter(pxr::HdPerfTokens->itemsDrawn);
+
+        bool overlay = !interactive && !selection.empty();
+        if (overlay)
+        {
+            auto depthTexture = primaryGraphicsEngine->GetAovTexture(pxr::HdAovTokens->depth);
+
+            secondaryGraphicsEngine->SetCameraState(makeMatrix(this->viewMatrix), makeMatrix(this->projectionMatrix));
+            secondaryGraphicsEngine->SetRenderBufferSize(pxr::GfVec2i(bufferDims.x, bufferDims.y));
+            secondaryGraphicsEngine->SetRendererAov(pxr::HdAovTokens->color);
+            secondaryGraphicsEngine->SetRenderViewport(pxr::GfVec4d(0, 0, renderDims.x, renderDims.y));
+            secondaryGraphicsEngine->SetWindowPolicy(pxr::CameraUtilConformWindowPolicy::CameraUtilFit);
+            secondaryGraphicsEngine->SetRendererSetting(pxr::TfToken("clearDepth"), pxr::VtValue(true));
+
+            if (depthTexture)
+                secondaryGraphicsEngine->PopulateAovTexture(pxr::HdAovTokens->depth, depthTexture);
+            // the overlay only draws the selection, so the batch is rooted where all of it is
+            pxr::SdfPath selectionRoot = selection.front();
+            for (const auto &path : selection)
+                selectionRoot = selectionRoot.GetCommonPrefix(path);
+            pxr::UsdPrim batchRoot = stage->GetPrimAtPath(selectionRoot);
+            secondaryGraphicsEngine->PrepareBatch(batchRoot ? batchRoot : stage->GetPseudoRoot(), this->secondaryRenderParams);
+            secondaryGraphicsEngine->RenderBatch(selection, this->secondaryRenderParams);
+        }
 
         glViewport(0, 0, windowDims.x, windowDims.y);
         glClearColor(17.f / 255.f, 80.f / 255.f, 147.f / 255.f, 1.f);
@@ -342,6 +780,9 @@ void GLRenderer::BeginRender()
         glDisable(GL_DEPTH_TEST);
         glBindVertexArray(emptyVAO);
 
+        glBindSampler(0, compositeSampler);
+        glBindSampler(1, compositeSampler);
+
         glActiveTexture(GL_TEXTURE0);
 #if PRIMARY_DEPTH_VIS
         glBindTexture(GL_TEXTURE_2D, primaryGraphicsEngine->GetAovTexture(pxr::HdAovTokens->depth)->GetRawResource());
@@ -351,28 +792,154 @@ void GLRenderer::BeginRender()
         glActiveTexture(GL_TEXTURE1);
 
 #if SECONDARY_DEPTH_VIS
-        glBindTexture(GL_TEXTURE_2D, secondaryGraphicsEngine->GetAovTexture(pxr::HdAovTokens->depth)->GetRawResource());
+        auto secondaryTexture = secondaryGraphicsEngine->GetAovTexture(pxr::HdAovTokens->depth);
 #else
-        glBindTexture(GL_TEXTURE_2D, secondaryGraphicsEngine->GetAovTexture(pxr::HdAovTokens->color)->GetRawResource());
+        auto secondaryTexture = secondaryGraphicsEngine->GetAovTexture(pxr::HdAovTokens->color);
 #endif
+        glBindTexture(GL_TEXTURE_2D, secondaryTexture ? (GLuint)secondaryTexture->GetRawResource() : 0);
+
+        // merge the external layer by depth, Hydra's depth is missing while only bounds are drawn
+        auto primaryDepth = primaryGraphicsEngine->GetAovTexture(pxr::HdAovTokens->depth);
+        bool external = externalLayer.IsEnabled() && primaryDepth;
+        if (external)
+        {
+            if (externalLayer.ready)
+                externalLayer.ready->Wait({ externalLayer.colorTexture }, { externalLayer.depthTexture });
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, (GLuint)primaryDepth->GetRawResource());
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, externalLayer.colorTexture);
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_2D, externalLayer.depthTexture);
+            glBindSampler(2, depthSampler);
+            glBindSampler(3, compositeSampler);
+            glBindSampler(4, depthSampler);
+        }
 
         quadShader->Activate();
         quadShader->SetUniform("primary", 0);
         quadShader->SetUniform("secondary", 1);
+        glm::vec2 renderSize((float)bufferDims.x, (float)bufferDims.y);
+        quadShader->SetUniform("renderSize", renderSize);
+        glm::vec2 uvScale = glm::vec2(renderDims) / renderSize;
+        quadShader->SetUniform("uvScale", uvScale);
+        quadShader->SetUniform("upscale", renderDims != windowDims ? 1 : 0);
+        quadShader->SetUniform("showOverlay", overlay && secondaryTexture ? 1 : 0);
+        quadShader->SetUniform("primaryDepth", 2);
+        quadShader->SetUniform("externalColor", 3);
+        quadShader->SetUniform("externalDepth", 4);
+        quadShader->SetUniform("showExternal", external ? 1 : 0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
         quadShader->Deactivate();
-        
+
+        glBindSampler(0, 0);
+        glBindSampler(1, 0);
+        if (external)
+        {
+            glBindSampler(2, 0);
+            glBindSampler(3, 0);
+            glBindSampler(4, 0);
+            if (externalLayer.done)
+                externalLayer.done->Signal({ externalLayer.colorTexture }, { externalLayer.depthTexture });
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        // queue readbacks of what was just composited, they're picked up and encoded a frame or two later
+        if (frameCapture.IsEnabled() && !frameCapture.IsComplete())
+        {
+            if (idGraphicsEngine && frameCapture.CapturesAovs())
+            {
+                idGraphicsEngine->SetCameraState(makeMatrix(this->viewMatrix), makeMatrix(this->projectionMatrix));
+                idGraphicsEngine->SetRenderBufferSize(pxr::GfVec2i(bufferDims.x, bufferDims.y));
+                idGraphicsEngine->SetRendererAov(pxr::HdAovTokens->primId);
+                idGraphicsEngine->SetRenderViewport(pxr::GfVec4d(0, 0, renderDims.x, renderDims.y));
+                idGraphicsEngine->SetWindowPolicy(pxr::CameraUtilConformWindowPolicy::CameraUtilFit);
+                idGraphicsEngine->Render(stage->GetPseudoRoot(), this->primaryRenderParams);
+            }
+            frameCapture.CaptureFrame(windowDims.x, windowDims.y, renderDims.x, renderDims.y, primaryGraphicsEngine, idGraphicsEngine);
+        }
+        frameExport.ExportFrame(metrics.frameCount, windowDims.x, windowDims.y, renderDims.x, renderDims.y, primaryGraphicsEngine);
+
+        frameGovernor.EndFrame();
+
+        metrics.frameMs = frameGovernor.GetFrameMs();
+        metrics.cpuMs = frameGovernor.GetCpuMs();
+        metrics.gpuMs = frameGovernor.GetGpuMs();
+        metrics.resolutionScale = scale;
+        metrics.renderWidth = renderDims.x;
+        metrics.renderHeight = renderDims.y;
+        metrics.bufferWidth = bufferDims.x;
+        metrics.bufferHeight = bufferDims.y;
+        metrics.bufferReallocations = resizeDebouncer.GetReallocations();
+        metrics.frameCount++;
+
+        auto now = std::chrono::high_resolution_clock::now();
+        if (std::chrono::duration<double>(now - lastTitleUpdate).count() > 0.5)
+        {
+            UpdateWindowTitle();
+            lastTitleUpdate = now;
+        }
+
         glfwSwapBuffers(window);
+
+        frameCapture.Update();
+        frameExport.Update();
+        if (frameCapture.IsComplete())
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+
+        if (wstate.memoryReportRequested)
+        {
+            ReportMemory(std::cout);
+            wstate.memoryReportRequested = false;
+        }
+
+        if (wstate.pickRequested)
+        {
+            SceneBVH::Hit hit;
+            if (!wstate.pickAdd)
+                selection.clear();
+            if (Pick(wstate.mouseX, wstate.mouseY, hit))
+            {
+                if (std::find(selection.begin(), selection.end(), hit.path) == selection.end())
+                    selection.push_back(hit.path);
+                lastPickPoint = hit.point;
+                hasPickPoint = true;
+            }
+            wstate.pickRequested = false;
+        }
+
+        // orbit around the last picked point
+        if (wstate.focusRequested)
+        {
+            if (hasPickPoint)
+            {
+                this->camera.SetTarget(lastPickPoint);
+                this->camera.Update();
+            }
+            wstate.focusRequested = false;
+        }
+
         glfwPollEvents();
     }
     
     // cleanup
+    frameCapture.Finish(std::cout);
+    frameExport.Finish(std::cout);
+    glDeleteSamplers(1, &compositeSampler);
+    glDeleteSamplers(1, &depthSampler);
+    glDeleteVertexArrays(1, &emptyVAO);
+
+    // its prims go with the render index
+    computeDelegate.reset();
     if(primaryGraphicsEngine)
         delete primaryGraphicsEngine;
     primaryGraphicsEngine = nullptr;
     if (secondaryGraphicsEngine)
         delete secondaryGraphicsEngine;
     secondaryGraphicsEngine = nullptr;
+    if (idGraphicsEngine)
+        delete idGraphicsEngine;
+    idGraphicsEngine = nullptr;
 
     if( window )
         glfwDestroyWindow(window);
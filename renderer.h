@@ -4,7 +4,10 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
 #include <pxr/pxr.h>
+#include <pxr/base/gf/bbox3d.h>
+#include <pxr/base/tf/weakBase.h>
 #include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usd/notice.h>
 #include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usdGeom/xform.h>
 #include <pxr/usd/usdGeom/sphere.h>
@@ -18,7 +21,21 @@
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "batchRender.h"
 #include "camera.h"
+#include "computeBenchmark.h"
+#include "computeDelegate.h"
+#include "externalLayer.h"
+#include "frameCapture.h"
+#include "frameExport.h"
+#include "frameGovernor.h"
+#include "pointCloudBenchmark.h"
+#include "resizeDebouncer.h"
+#include "sceneBvh.h"
 
 class Shader;
 
@@ -26,15 +43,40 @@ class Shader;
 struct WindowState
 {
 	WindowState()
-		: mouseX(0.0), mouseY(0.0), mouseButton(-1), mouseButtonState(-1)
+		: mouseX(0.0), mouseY(0.0), mouseButton(-1), mouseButtonState(-1), camera(nullptr), memoryReportRequested(false),
+		pressX(0.0), pressY(0.0), pickRequested(false), pickAdd(false), focusRequested(false), resizeDebouncer(nullptr)
 	{}
 	double mouseX, mouseY;
 	int mouseButton;
 	int mouseButtonState;
 	Camera *camera;
+	bool memoryReportRequested;
+	double pressX, pressY;
+	bool pickRequested;
+	bool pickAdd;
+	bool focusRequested;
+	ResizeDebouncer *resizeDebouncer;
+};
+
+// per frame timings, updated at the end of every frame
+struct RenderMetrics
+{
+    RenderMetrics()
+        : frameMs(0.0), cpuMs(0.0), gpuMs(0.0), resolutionScale(1.f), renderWidth(0), renderHeight(0), bufferWidth(0),
+          bufferHeight(0), bufferReallocations(0), frameCount(0), drawBatches(0), itemsDrawn(0)
+    {}
+    double frameMs, cpuMs, gpuMs;
+    float resolutionScale;
+    int renderWidth, renderHeight;
+    // the render buffers hold the frame in their corner, they only change size once a resize has settled
+    int bufferWidth, bufferHeight;
+    size_t bufferReallocations;
+    uint64_t frameCount;
+    // from Hydra's perf counters for the primary pass
+    size_t drawBatches, itemsDrawn;
 };
 
-class GLRenderer
+class GLRenderer : public pxr::TfWeakBase
 {
     public:
     GLRenderer();
@@ -52,24 +94,149 @@ class GLRenderer
     {
         return this->projectionMatrix;
     }
+    virtual glm::mat4x4 &GetViewMatrix()
+    {
+        return this->viewMatrix;
+    }
+    // the window size, or the size it's going to be created at
     virtual glm::ivec2 GetExtent()
     {
-        return glm::ivec2(800, 600);
+        auto size = resizeDebouncer.GetWindowSize();
+        return size.x > 0 ? size : glm::ivec2(800, 600);
     }
     void SetUsdStage(pxr::UsdStageRefPtr stg)
     {
         stage = stg;
     }
+    pxr::UsdStageRefPtr GetUsdStage()
+    {
+        return stage;
+    }
+    // frame time budget in milliseconds, the render buffers are scaled down to hold it (0 disables)
+    void SetFrameBudget(double budgetMs, float minScale = 0.25f)
+    {
+        frameGovernor.SetBudget(budgetMs);
+        frameGovernor.SetMinScale(minScale);
+    }
+    const RenderMetrics &GetMetrics()
+    {
+        return metrics;
+    }
+    // draw proxies or bounds without lighting or the overlay while the camera is moving
+    void SetMotionAdaptiveQuality(bool enable)
+    {
+        motionAdaptiveQuality = enable;
+    }
+    void SetMemoryReportOnFirstFrame(bool enable)
+    {
+        memoryReportOnFirstFrame = enable;
+    }
+
+    // called at the start of every frame, before anything is rendered, from the thread that owns the stage
+    void AddFrameCallback(std::function<void()> callback)
+    {
+        frameCallbacks.push_back(callback);
+    }
+
+    // write frames (and optionally their aovs) to an image sequence, the window closes once frameCount are captured
+    void SetCapture(const CaptureSettings &settings)
+    {
+        frameCapture.Configure(settings);
+    }
+    // publish every composited frame and its depth into a shared memory ring for other local processes
+    void SetFrameExport(const ExportSettings &settings)
+    {
+        frameExport.Configure(settings);
+    }
+    // render a batch of views through the primary engine in a hidden window and exit instead of running interactively
+    void SetBatch(const BatchSettings &settings)
+    {
+        batchSettings = settings;
+    }
+    // merge color and depth rendered outside Hydra with the primary pass by depth every frame, render it from a frame
+    // callback with GetViewMatrix/GetProjectionMatrix. a layer without textures removes it
+    void SetExternalLayer(const ExternalLayer &layer)
+    {
+        externalLayer = layer;
+    }
+    // time updates through the stage against the compute delegate in a hidden window and exit
+    void SetComputeBenchmark(const ComputeBenchmarkSettings &settings)
+    {
+        computeBenchmark = settings;
+    }
+    // time point clouds of increasing size through PointCloud in a hidden window and exit
+    void SetPointCloudBenchmark(const PointCloudBenchmarkSettings &settings)
+    {
+        pointCloudBenchmark = settings;
+    }
+    // meshes handed straight to the primary engine's render index, valid from the frame callbacks
+    ComputeSceneDelegate *GetComputeDelegate()
+    {
+        return computeDelegate.get();
+    }
+    // orbit the camera a full turn around its target over this many frames (0 disables)
+    void SetTurntable(uint32_t frames)
+    {
+        turntableFrames = frames;
+    }
+    // open the stage used when none was set through a StageCache, an empty directory uses the default location
+    void SetStageCache(bool enable, const std::string &directory = "")
+    {
+        useStageCache = enable;
+        stageCacheDirectory = directory;
+    }
+
+    // cast a ray through the window position (in screen coordinates) against the stage's meshes
+    virtual bool Pick(double x, double y, SceneBVH::Hit &hit);
+    // print what each pick hit and how long the ray took
+    void SetPickReport(bool enable)
+    {
+        pickReport = enable;
+    }
+    const pxr::SdfPathVector &GetSelection()
+    {
+        return selection;
+    }
+    void SetSelection(const pxr::SdfPathVector &paths)
+    {
+        selection = paths;
+    }
+    SceneBVH &GetSceneBVH()
+    {
+        return sceneBvh;
+    }
+
+    // print where memory is going: stage layers, Hydra resources and render buffers of both engines
+    virtual void ReportMemory(std::ostream &out);
 
     protected:
+    void UpdateWindowTitle();
+    // perspective for the window's aspect with the clip planes from the scene bounds
+    void UpdateProjection();
+    void PrepareInteractiveRenderParams();
+    // look for proxies and take the bounds drawn without them, kept until the stage changes
+    void ScanInteractiveScene();
+    void OnObjectsChanged(const pxr::UsdNotice::ObjectsChanged &notice, const pxr::UsdStageWeakPtr &sender);
+
     GLFWwindow* window;
 
     // Usd
     pxr::UsdStageRefPtr stage;
-    pxr::UsdImagingGLEngine *primaryGraphicsEngine;
+    ComputeGLEngine *primaryGraphicsEngine;
     pxr::UsdImagingGLEngine *secondaryGraphicsEngine;
+    pxr::UsdImagingGLEngine *idGraphicsEngine;      // only while capturing aovs
     pxr::UsdImagingGLRenderParams primaryRenderParams;
     pxr::UsdImagingGLRenderParams secondaryRenderParams;
+    pxr::UsdImagingGLRenderParams interactiveRenderParams;
+    bool interactiveDrawBounds;
+    bool interactiveParamsStale;
+    // what the last scan found, and whether the stage has changed since
+    bool interactiveHasProxies;
+    std::vector<pxr::GfBBox3d> interactiveBounds;
+    bool interactiveScanStale;
+    pxr::TfNotice::Key stageNoticeKey;
+    bool motionAdaptiveQuality;
+    bool cameraMoving;
 
     Camera camera;
 
@@ -77,9 +244,38 @@ class GLRenderer
     glm::vec4 eye;
     glm::mat4 viewMatrix;
     glm::vec3 sceneBounds[2];
+    float nearPlane, farPlane;
+    // the extent the projection was last made for
+    glm::ivec2 projectionExtent;
 
     std::map<int, pxr::TfToken> rendererPlugins;
     pxr::TfToken activeRendererPlugin;
 
     std::shared_ptr<Shader> quadShader;
+
+    bool memoryReportOnFirstFrame;
+
+    std::vector<std::function<void()>> frameCallbacks;
+
+    FrameGovernor frameGovernor;
+    ResizeDebouncer resizeDebouncer;
+    RenderMetrics metrics;
+
+    SceneBVH sceneBvh;
+    pxr::SdfPathVector selection;
+    pxr::SdfPathVector appliedSelection;
+    glm::vec3 lastPickPoint;
+    bool hasPickPoint;
+    bool pickReport;
+
+    FrameCapture frameCapture;
+    FrameExport frameExport;
+    BatchSettings batchSettings;
+    ExternalLayer externalLayer;
+    ComputeBenchmarkSettings computeBenchmark;
+    PointCloudBenchmarkSettings pointCloudBenchmark;
+    std::unique_ptr<ComputeSceneDelegate> computeDelegate;
+    uint32_t turntableFrames;
+    bool useStageCache;
+    std::string stageCacheDirectory;
 };
@@ -0,0 +1,73 @@
+#include "resizeDebouncer.h"
+
+#include <algorithm>
+
+// long enough to cover the gaps between the size events of a drag
+static const double s_settleMs = 150.0;
+// a window that grows by less than this in either direction keeps its buffers
+static const int s_sizeStep = 128;
+
+ResizeDebouncer::ResizeDebouncer()
+    :
+    settleMs(s_settleMs),
+    sizeStep(s_sizeStep),
+    windowSize(0, 0),
+    bufferSize(0, 0),
+    resizing(false),
+    reallocations(0)
+{
+}
+
+ResizeDebouncer::~ResizeDebouncer()
+{
+}
+
+void ResizeDebouncer::Resize(int width, int height)
+{
+    glm::ivec2 size(std::max(1, width), std::max(1, height));
+    if (size == windowSize)
+        return;
+    windowSize = size;
+    // the first size is the window being created, nothing to wait for
+    if (bufferSize.x == 0)
+        return;
+    resizing = true;
+    lastResize = std::chrono::high_resolution_clock::now();
+}
+
+void ResizeDebouncer::Update()
+{
+    if (bufferSize.x == 0 && windowSize.x > 0)
+    {
+        bufferSize = SizeClass(windowSize);
+        reallocations++;
+        return;
+    }
+    if (!resizing)
+        return;
+    double sinceMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - lastResize).count();
+    if (sinceMs < settleMs)
+        return;
+
+    resizing = false;
+    auto settled = SizeClass(windowSize);
+    if (settled != bufferSize)
+    {
+        bufferSize = settled;
+        reallocations++;
+    }
+}
+
+glm::ivec2 ResizeDebouncer::GetRenderSize(float scale)
+{
+    glm::vec2 size = glm::vec2(windowSize) * scale;
+    // keep the window's aspect, only the buffers from before a drag can be too small
+    float fit = std::min({ 1.f, (float)bufferSize.x / std::max(size.x, 1.f), (float)bufferSize.y / std::max(size.y, 1.f) });
+    return glm::ivec2(std::max(1, std::min(bufferSize.x, (int)(size.x * fit + 0.5f))),
+                      std::max(1, std::min(bufferSize.y, (int)(size.y * fit + 0.5f))));
+}
+
+glm::ivec2 ResizeDebouncer::SizeClass(glm::ivec2 size)
+{
+    return glm::ivec2((size.x + sizeStep - 1) / sizeStep * sizeStep, (size.y + sizeStep - 1) / sizeStep * sizeStep);
+}
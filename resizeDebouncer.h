@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+
+#include <chrono>
+#include <cstddef>
+
+// keeps window resizes from reallocating the Hydra render buffers on every intermediate size of a drag
+//
+// the buffers are sized to the settled window rounded up to a size class, and each frame renders into the part of
+// them it needs. while the window is being dragged the frame is rendered at the settled size, shrunk to fit the
+// new aspect if it has to be, and upscaled by the composite. the buffers only move to a new size class once the
+// window has stopped changing, so a drag costs at most one reallocation and shrinking within a class costs none
+class ResizeDebouncer
+{
+public:
+    ResizeDebouncer();
+    virtual ~ResizeDebouncer();
+
+    // how long the window size has to hold before the buffers follow it
+    void SetSettleMs(double ms) { settleMs = ms; }
+    // buffer sizes are rounded up to a multiple of this many pixels, 1 keeps them exact
+    void SetSizeStep(int pixels) { sizeStep = pixels > 0 ? pixels : 1; }
+
+    // from the window size callback
+    void Resize(int width, int height);
+    // once a frame before rendering, moves the buffers to the window's size class once it has settled
+    void Update();
+
+    glm::ivec2 GetWindowSize() { return windowSize; }
+    glm::ivec2 GetBufferSize() { return bufferSize; }
+    bool IsResizing() { return resizing; }
+    // the window at this resolution scale with its aspect, fitted within the buffers
+    glm::ivec2 GetRenderSize(float scale);
+    // times the buffers have been resized, the first allocation included
+    size_t GetReallocations() { return reallocations; }
+
+protected:
+    glm::ivec2 SizeClass(glm::ivec2 size);
+
+    double settleMs;
+    int sizeStep;
+
+    glm::ivec2 windowSize;
+    glm::ivec2 bufferSize;
+    bool resizing;
+    size_t reallocations;
+
+    std::chrono::high_resolution_clock::time_point lastResize;
+};
@@ -0,0 +1,517 @@
+#include "scene.h"
+#include "materialLibrary.h"
+#include "meshOptimizer.h"
+
+#include <pxr/base/work/loops.h>
+#include <pxr/usd/usdGeom/primvarsAPI.h>
+#include <pxr/usd/usdGeom/xform.h>
+#include <pxr/usd/usdShade/materialBindingAPI.h>
+#include <pxr/usd/usdHydra/tokens.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+pxr::UsdGeomMesh createMesh(pxr::UsdStageRefPtr stage, const std::string &meshName, const pxr::VtVec3fArray &points, const pxr::VtArray<int> &faceVertexCounts, const pxr::VtArray<int> &faceVertexIndices, const pxr::VtVec3fArray& normals)
+{
+    // find the geometric extents of the mesh, only reading so a shared or foreign array isn't detached
+    pxr::VtVec3fArray extent(2);
+    if( !points.empty() )
+    {
+        extent[0] = points.cdata()[0];
+        extent[1] = points.cdata()[0];
+    }
+    for( const auto &pt : points )
+    {
+        for( int i=0; i<3; ++i )
+        {
+            extent[0][i]=std::min(pt[i], extent[0][i]);
+            extent[1][i]=std::max(pt[i], extent[1][i]);
+        }
+    }
+
+    // create the mesh and set its points, face vertex counts (number of vertices for each face) and face vertex indices
+    auto mesh = pxr::UsdGeomMesh::Define(stage, pxr::SdfPath("/" + meshName));
+
+    mesh.GetPointsAttr().Set(points);
+    mesh.GetNormalsAttr().Set(normals);
+    mesh.GetFaceVertexCountsAttr().Set(faceVertexCounts);
+    mesh.GetFaceVertexIndicesAttr().Set(faceVertexIndices);
+
+    // set geometric extents
+    mesh.GetExtentAttr().Set(extent);
+
+    mesh.GetDoubleSidedAttr().Set(true);
+
+    return mesh;
+}
+
+pxr::UsdGeomMesh createMesh(pxr::UsdStageRefPtr stage, const std::string &primName, const pxr::VtVec3fArray &points, const pxr::VtArray<int> &faceVertexCounts, const pxr::VtArray<int> &faceVertexIndices, const pxr::VtVec2fArray &texCoordArray, const pxr::VtVec3fArray &normals)
+{
+    auto mesh = createMesh(stage, primName, points, faceVertexCounts, faceVertexIndices, normals);
+
+    // add a new primvar for texture coordinates that we can reference in the shader
+    auto texCoords = mesh.CreatePrimvar(pxr::TfToken("st"), pxr::SdfValueTypeNames->TexCoord2fArray, pxr::UsdGeomTokens->varying);
+
+    // set the texture coords
+    texCoords.Set(texCoordArray);
+
+    return mesh;
+}
+
+pxr::UsdShadeMaterial createPBRMaterial(pxr::UsdStageRefPtr stage, const pxr::SdfPath &materialPath, const float roughness, const float metallic, const std::string &textureFile)
+{
+    // create path hierarchy
+    auto pbrShaderPath = materialPath.AppendPath(pxr::SdfPath("PBRShader"));
+    
+    auto material = pxr::UsdShadeMaterial::Define(stage, materialPath);
+    
+    // create the basic PBR shader and set params
+    auto pbrShader = pxr::UsdShadeShader::Define(stage, pbrShaderPath);
+    pbrShader.CreateIdAttr(pxr::VtValue(pxr::TfToken("UsdPreviewSurface")));
+    pbrShader.CreateInput(pxr::TfToken("roughness"), pxr::SdfValueTypeNames->Float).Set(roughness);
+    pbrShader.CreateInput(pxr::TfToken("metallic"), pxr::SdfValueTypeNames->Float).Set(metallic);
+
+    // connect the pbr shader to the material
+    material.CreateSurfaceOutput().ConnectToSource(pbrShader.ConnectableAPI(), pxr::TfToken("surface"));
+
+    if( textureFile.empty() ) // texturing?
+    {
+        // if not then just set a red material
+        auto clr = pxr::GfVec3f(1.0f, 1.0f, 1.0f);
+        pbrShader.CreateInput(pxr::TfToken("diffuseColor"), pxr::SdfValueTypeNames->Color3f).Set(clr);
+    }else{
+        // first create the reader
+        auto stReaderPath = materialPath.AppendPath(pxr::SdfPath("stReader"));
+        auto stReader = pxr::UsdShadeShader::Define(stage, stReaderPath);
+        stReader.CreateIdAttr(pxr::VtValue(pxr::TfToken("UsdPrimvarReader_float2")));
+
+        // create the texture sampler
+        auto diffuseTextureSamplerPath = materialPath.AppendPath(pxr::SdfPath("diffuseTexture"));
+        auto diffuseTextureSampler = pxr::UsdShadeShader::Define(stage, diffuseTextureSamplerPath);
+        diffuseTextureSampler.CreateIdAttr(pxr::VtValue(pxr::TfToken("UsdUVTexture")));
+        diffuseTextureSampler.CreateInput(pxr::TfToken("file"), pxr::SdfValueTypeNames->Asset).Set(pxr::SdfAssetPath(textureFile));
+        diffuseTextureSampler.CreateInput(pxr::TfToken("st"), pxr::SdfValueTypeNames->Float2).ConnectToSource(stReader.ConnectableAPI(), pxr::TfToken("result"));
+
+        // this bit is important...by default it will use LINEAR_MIPMAP_LINEAR (for some reason usdview doesn't require this though), thanks RenderDoc :)
+        diffuseTextureSampler.CreateInput(pxr::UsdHydraTokens->minFilter, pxr::SdfValueTypeNames->Token).Set(pxr::UsdHydraTokens->linear);
+
+        // attach the output of the sampler to the pbr shader's diffuseColor
+        diffuseTextureSampler.CreateOutput(pxr::TfToken("rgb"), pxr::SdfValueTypeNames->Float3);
+        pbrShader.CreateInput(pxr::TfToken("diffuseColor"), pxr::SdfValueTypeNames->Color3f).ConnectToSource(diffuseTextureSampler.ConnectableAPI(), pxr::TfToken("rgb"));
+
+        // connect everything together
+        auto stInput = material.CreateInput(pxr::TfToken("frame:stPrimvarName"), pxr::SdfValueTypeNames->Token);
+        stInput.Set(pxr::TfToken("st"));
+
+        stReader.CreateInput(pxr::TfToken("varname"), pxr::SdfValueTypeNames->Token).ConnectToSource(stInput);
+    }
+
+    return material;
+}
+
+pxr::UsdShadeShader createPBRShader(pxr::UsdStageRefPtr stage, pxr::UsdGeomMesh &mesh, const float roughness, const float metallic, const std::string &textureFile)
+{
+    // a material of its own under the mesh
+    auto materialPath = mesh.GetPrim().GetPrimPath().AppendPath(pxr::SdfPath("material"));
+    auto material = createPBRMaterial(stage, materialPath, roughness, metallic, textureFile);
+
+    // bind material to the mesh
+    pxr::UsdShadeMaterialBindingAPI(mesh).Bind(material);
+
+    return pxr::UsdShadeShader::Get(stage, materialPath.AppendPath(pxr::SdfPath("PBRShader")));
+}
+
+static void cubeGeometry(pxr::VtArray<int> &faceIndices, pxr::VtArray<int> &faceIndexCounts, pxr::VtVec3fArray &cube, pxr::VtVec3fArray &normals, pxr::VtVec2fArray &texCoords)
+{
+    // indices for cube triangles
+    faceIndices = {
+        0, 1, 2, 0, 2, 3,
+        4, 5, 6, 4, 6, 7,
+        8, 9, 10, 8, 10, 11,
+        12, 13, 14, 12, 14, 15,
+        16, 17, 18, 16, 18, 19,
+        20, 21, 22, 20, 22, 23
+    };
+
+    // all faces are triangles
+    faceIndexCounts = {
+        3,3,3,3,3,3,3,3,3,3,3,3
+    };
+    
+    // 24 points for a cube? well yes because they have distinct normals
+    cube.resize(24);
+    cube[ 0] = pxr::GfVec3f( 1.f, -1.f, -1.f);
+    cube[ 1] = pxr::GfVec3f( 1.f, -1.f,  1.f);
+    cube[ 2] = pxr::GfVec3f(-1.f, -1.f,  1.f);
+    cube[ 3] = pxr::GfVec3f(-1.f, -1.f, -1.f);
+    cube[ 4] = pxr::GfVec3f( 1.f,  1.f, -1.f);
+    cube[ 5] = pxr::GfVec3f(-1.f,  1.f, -1.f);
+    cube[ 6] = pxr::GfVec3f(-1.f,  1.f,  1.f);
+    cube[ 7] = pxr::GfVec3f( 1.f,  1.f,  1.f);
+    cube[ 8] = pxr::GfVec3f( 1.f, -1.f, -1.f);
+    cube[ 9] = pxr::GfVec3f( 1.f,  1.f, -1.f);
+    cube[10] = pxr::GfVec3f( 1.f,  1.f,  1.f);
+    cube[11] = pxr::GfVec3f( 1.f, -1.f,  1.f);
+    cube[12] = pxr::GfVec3f( 1.f, -1.f,  1.f);
+    cube[13] = pxr::GfVec3f( 1.f,  1.f,  1.f);
+    cube[14] = pxr::GfVec3f(-1.f,  1.f,  1.f);
+    cube[15] = pxr::GfVec3f(-1.f, -1.f,  1.f);
+    cube[16] = pxr::GfVec3f(-1.f, -1.f,  1.f);
+    cube[17] = pxr::GfVec3f(-1.f,  1.f,  1.f);
+    cube[18] = pxr::GfVec3f(-1.f,  1.f, -1.f);
+    cube[19] = pxr::GfVec3f(-1.f, -1.f, -1.f);
+    cube[20] = pxr::GfVec3f( 1.f,  1.f, -1.f);
+    cube[21] = pxr::GfVec3f( 1.f, -1.f, -1.f);
+    cube[22] = pxr::GfVec3f(-1.f, -1.f, -1.f);
+    cube[23] = pxr::GfVec3f(-1.f,  1.f, -1.f);
+
+    // one normal per face, taken from the first three of its four points
+    normals.resize(24);
+    for (size_t i = 0; i < 24; i += 4)
+    {
+        glm::vec3 p0 = glm::vec3(cube[i + 0].data()[0], cube[i + 0].data()[1], cube[i + 0].data()[2]);
+        glm::vec3 p1 = glm::vec3(cube[i + 1].data()[0], cube[i + 1].data()[1], cube[i + 1].data()[2]);
+        glm::vec3 p2 = glm::vec3(cube[i + 2].data()[0], cube[i + 2].data()[1], cube[i + 2].data()[2]);
+
+        auto n = glm::cross(glm::normalize(p0 - p1), glm::normalize(p0 - p2));
+
+        normals[i + 0] = pxr::GfVec3f(n.x, n.y, n.z);
+        normals[i + 1] = pxr::GfVec3f(n.x, n.y, n.z);
+        normals[i + 2] = pxr::GfVec3f(n.x, n.y, n.z);
+        normals[i + 3] = pxr::GfVec3f(n.x, n.y, n.z);
+    }
+
+    // tex coords...if a texture was specified we'll need these
+    texCoords.resize(24);
+    texCoords[ 0] = pxr::GfVec2f( 0.f,  0.f);
+    texCoords[ 1] = pxr::GfVec2f( 1.f,  0.f);
+    texCoords[ 2] = pxr::GfVec2f( 1.f,  1.f);
+    texCoords[ 3] = pxr::GfVec2f( 0.f,  1.f);
+    texCoords[ 4] = pxr::GfVec2f( 0.f,  0.f);
+    texCoords[ 5] = pxr::GfVec2f( 1.f,  0.f);
+    texCoords[ 6] = pxr::GfVec2f( 1.f,  1.f);
+    texCoords[ 7] = pxr::GfVec2f( 0.f,  1.f);
+    texCoords[ 8] = pxr::GfVec2f( 0.f,  0.f);
+    texCoords[ 9] = pxr::GfVec2f( 1.f,  0.f);
+    texCoords[10] = pxr::GfVec2f( 1.f,  1.f);
+    texCoords[11] = pxr::GfVec2f( 0.f,  1.f);
+    texCoords[12] = pxr::GfVec2f( 0.f,  0.f);
+    texCoords[13] = pxr::GfVec2f( 1.f,  0.f);
+    texCoords[14] = pxr::GfVec2f( 1.f,  1.f);
+    texCoords[15] = pxr::GfVec2f( 0.f,  1.f);
+    texCoords[16] = pxr::GfVec2f( 0.f,  0.f);
+    texCoords[17] = pxr::GfVec2f( 1.f,  0.f);
+    texCoords[18] = pxr::GfVec2f( 1.f,  1.f);
+    texCoords[19] = pxr::GfVec2f( 0.f,  1.f);
+    texCoords[20] = pxr::GfVec2f( 0.f,  0.f);
+    texCoords[21] = pxr::GfVec2f( 1.f,  0.f);
+    texCoords[22] = pxr::GfVec2f( 1.f,  1.f);
+    texCoords[23] = pxr::GfVec2f( 0.f,  1.f);
+}
+
+// weld and reorder the cube's arrays in place before they're authored
+static void optimizeGeometry(const std::string &name, pxr::VtArray<int> &faceIndices, pxr::VtArray<int> &faceIndexCounts, pxr::VtVec3fArray &points, pxr::VtVec3fArray &normals, pxr::VtVec2fArray &texCoords)
+{
+    MeshBuffers buffers;
+    buffers.points = points;
+    buffers.faceVertexCounts = faceIndexCounts;
+    buffers.faceVertexIndices = faceIndices;
+    buffers.normals = normals;
+    buffers.texCoords = texCoords;
+
+    MeshOptimizeReport report;
+    if (!OptimizeMesh(buffers, MeshOptimizeSettings(), &report))
+        return;
+    PrintMeshOptimizeReport(name, report, std::cout);
+
+    points = buffers.points;
+    faceIndexCounts = buffers.faceVertexCounts;
+    faceIndices = buffers.faceVertexIndices;
+    normals = buffers.normals;
+    texCoords = buffers.texCoords;
+}
+
+// a block for arrays to be lent from, freed once the last array (or layer value) using it is gone
+static ForeignBuffer *lendBlock(size_t bytes)
+{
+    uint8_t *block = new uint8_t[bytes];
+    return ForeignBuffer::Lend(block, bytes, [block]() { delete[] block; });
+}
+
+template <class T>
+static size_t blockBytes(const pxr::VtArray<T> &array)
+{
+    return array.size() * sizeof(T) + alignof(T);
+}
+
+// put an array's elements into the block at offset and point the array at them
+template <class T>
+static void moveToBlock(ForeignBuffer *block, size_t &offset, pxr::VtArray<T> &array)
+{
+    offset = (offset + alignof(T) - 1) / alignof(T) * alignof(T);
+    std::copy(array.cbegin(), array.cend(), (T *)(block->GetData() + offset));
+    array = block->Wrap<T>(offset, array.size());
+    offset += array.size() * sizeof(T);
+}
+
+// compare what was authored with the arrays it was authored from
+static void accountMesh(const pxr::UsdGeomMesh &mesh, const pxr::VtArray<int> &faceIndices, const pxr::VtArray<int> &faceIndexCounts, const pxr::VtVec3fArray &points, const pxr::VtVec3fArray &normals, const pxr::VtVec2fArray &texCoords, IngestReport &ingest)
+{
+    ingest.meshes++;
+    AccountIngest(mesh.GetPointsAttr(), points, ingest);
+    AccountIngest(mesh.GetFaceVertexCountsAttr(), faceIndexCounts, ingest);
+    AccountIngest(mesh.GetFaceVertexIndicesAttr(), faceIndices, ingest);
+    AccountIngest(mesh.GetNormalsAttr(), normals, ingest);
+    AccountIngest(pxr::UsdGeomPrimvarsAPI(mesh).GetPrimvar(pxr::TfToken("st")).GetAttr(), texCoords, ingest);
+}
+
+pxr::SdfLayerRefPtr cube(const std::string &primName, const std::string textureFile, bool optimize, bool foreignBuffers, IngestReport *ingest)
+{
+    pxr::VtArray<int> faceIndices, faceIndexCounts;
+    pxr::VtVec3fArray cube, normals;
+    pxr::VtVec2fArray texCoords;
+    cubeGeometry(faceIndices, faceIndexCounts, cube, normals, texCoords);
+    if (optimize)
+        optimizeGeometry(primName, faceIndices, faceIndexCounts, cube, normals, texCoords);
+
+    IngestReport report;
+    if (foreignBuffers)
+    {
+        // the block stands in for a generator's output, once the arrays point into it they're its only users
+        ForeignBuffer *block = lendBlock(blockBytes(faceIndices) + blockBytes(faceIndexCounts) + blockBytes(cube) + blockBytes(normals) + blockBytes(texCoords));
+        size_t offset = 0;
+        moveToBlock(block, offset, faceIndices);
+        moveToBlock(block, offset, faceIndexCounts);
+        moveToBlock(block, offset, cube);
+        moveToBlock(block, offset, normals);
+        moveToBlock(block, offset, texCoords);
+        block->Release();
+    }
+    else
+    {
+        AccountAllocation(faceIndices, report);
+        AccountAllocation(faceIndexCounts, report);
+        AccountAllocation(cube, report);
+        AccountAllocation(normals, report);
+        AccountAllocation(texCoords, report);
+    }
+
+    // create an anonymous layer in which to create the geometry
+    auto layer = pxr::SdfLayer::CreateAnonymous(primName + ".usda");
+    auto stage = pxr::UsdStage::Open(layer);
+
+    auto mesh = createMesh(stage, primName, cube, faceIndexCounts, faceIndices, texCoords, normals);
+    if (ingest)
+    {
+        accountMesh(mesh, faceIndices, faceIndexCounts, cube, normals, texCoords, report);
+        *ingest = report;
+    }
+
+    // materials live in a shared library scope so identical ones are only authored once
+    MaterialLibrary materials(stage);
+    materials.Bind(mesh, 0.4f, 0.f, textureFile);
+
+    return layer;
+}
+
+// author cubes [first, last) of a count cube grid onto a new anonymous layer, touching nothing outside it so several
+// can be built at once. the geometry arrays are only read, every cube gets its own points
+static pxr::SdfLayerRefPtr cubeRange(const std::string &primName, size_t count, size_t first, size_t last, const pxr::VtArray<int> &sourceFaceIndices,
+                                     const pxr::VtArray<int> &sourceFaceIndexCounts, const pxr::VtVec3fArray &cube, const pxr::VtVec3fArray &sourceNormals,
+                                     const pxr::VtVec2fArray &sourceTexCoords, const std::string &textureFile, bool foreignBuffers, IngestReport *ingest,
+                                     bool materialReport)
+{
+    pxr::VtArray<int> faceIndices = sourceFaceIndices, faceIndexCounts = sourceFaceIndexCounts;
+    pxr::VtVec3fArray normals = sourceNormals;
+    pxr::VtVec2fArray texCoords = sourceTexCoords;
+
+    // the shared arrays and every cube's points go in one block instead of an allocation per cube
+    IngestReport report;
+    ForeignBuffer *block = nullptr;
+    size_t pointsOffset = 0;
+    if (foreignBuffers)
+    {
+        block = lendBlock(blockBytes(faceIndices) + blockBytes(faceIndexCounts) + blockBytes(normals) + blockBytes(texCoords)
+                          + (last - first) * cube.size() * sizeof(pxr::GfVec3f) + alignof(pxr::GfVec3f));
+        moveToBlock(block, pointsOffset, faceIndices);
+        moveToBlock(block, pointsOffset, faceIndexCounts);
+        moveToBlock(block, pointsOffset, normals);
+        moveToBlock(block, pointsOffset, texCoords);
+        pointsOffset = (pointsOffset + alignof(pxr::GfVec3f) - 1) / alignof(pxr::GfVec3f) * alignof(pxr::GfVec3f);
+    }
+    else
+    {
+        AccountAllocation(faceIndices, report);
+        AccountAllocation(faceIndexCounts, report);
+        AccountAllocation(normals, report);
+        AccountAllocation(texCoords, report);
+    }
+
+    auto layer = pxr::SdfLayer::CreateAnonymous(primName + ".usda");
+    auto stage = pxr::UsdStage::Open(layer);
+    MaterialLibrary materials(stage);
+
+    // lay the cubes out on a square grid, cycling through a handful of roughness/metallic combinations
+    size_t side = (size_t)std::ceil(std::sqrt((double)count));
+    for (size_t i = first; i < last; ++i)
+    {
+        pxr::GfVec3f offset(3.f * (float)(i % side), 0.f, 3.f * (float)(i / side));
+        pxr::VtVec3fArray points;
+        if (block)
+        {
+            // written in place and then wrapped, writing through the wrapped array would copy it
+            size_t pointsAt = pointsOffset + (i - first) * cube.size() * sizeof(pxr::GfVec3f);
+            pxr::GfVec3f *destination = (pxr::GfVec3f *)(block->GetData() + pointsAt);
+            for (size_t p = 0; p < cube.size(); ++p)
+                destination[p] = cube.cdata()[p] + offset;
+            points = block->Wrap<pxr::GfVec3f>(pointsAt, cube.size());
+        }
+        else
+        {
+            points.resize(cube.size());
+            pxr::GfVec3f *destination = points.data();
+            for (size_t p = 0; p < cube.size(); ++p)
+                destination[p] = cube.cdata()[p] + offset;
+            AccountAllocation(points, report);
+        }
+
+        auto mesh = createMesh(stage, primName + "/" + primName + "_" + std::to_string(i), points, faceIndexCounts, faceIndices, texCoords, normals);
+        materials.Bind(mesh, 0.2f + 0.2f * (float)(i % 4), (i / 4) % 2 == 0 ? 0.f : 1.f, textureFile);
+        if (ingest)
+            accountMesh(mesh, faceIndices, faceIndexCounts, points, normals, texCoords, report);
+    }
+    if (block)
+        block->Release();
+    if (ingest)
+        *ingest = report;
+
+    if (materialReport)
+        materials.PrintReport(std::cout);
+    return layer;
+}
+
+pxr::SdfLayerRefPtr cubes(const std::string &primName, size_t count, const std::string textureFile, bool optimize, bool foreignBuffers, IngestReport *ingest)
+{
+    pxr::VtArray<int> faceIndices, faceIndexCounts;
+    pxr::VtVec3fArray cube, normals;
+    pxr::VtVec2fArray texCoords;
+    cubeGeometry(faceIndices, faceIndexCounts, cube, normals, texCoords);
+    // every cube shares the same topology so it only needs optimizing once
+    if (optimize)
+        optimizeGeometry(primName, faceIndices, faceIndexCounts, cube, normals, texCoords);
+
+    return cubeRange(primName, count, 0, count, faceIndices, faceIndexCounts, cube, normals, texCoords, textureFile, foreignBuffers, ingest, true);
+}
+
+std::vector<pxr::SdfLayerRefPtr> cubeLayers(const std::string &primName, size_t count, size_t layerCount, const std::string textureFile, bool optimize,
+                                            bool foreignBuffers, IngestReport *ingest)
+{
+    pxr::VtArray<int> faceIndices, faceIndexCounts;
+    pxr::VtVec3fArray cube, normals;
+    pxr::VtVec2fArray texCoords;
+    cubeGeometry(faceIndices, faceIndexCounts, cube, normals, texCoords);
+    if (optimize)
+        optimizeGeometry(primName, faceIndices, faceIndexCounts, cube, normals, texCoords);
+
+    layerCount = std::max<size_t>(1, std::min(layerCount, count));
+    std::vector<pxr::SdfLayerRefPtr> layers(layerCount);
+    std::vector<IngestReport> reports(layerCount);
+
+    // each layer has its own stage and nothing is shared between them but the read only geometry, so there's no lock
+    // to contend on. the material library names materials after their parameters, every layer authors identical ones
+    pxr::WorkParallelForN(layerCount, [&](size_t begin, size_t end)
+    {
+        for (size_t l = begin; l < end; ++l)
+        {
+            size_t first = count * l / layerCount, last = count * (l + 1) / layerCount;
+            layers[l] = cubeRange(primName, count, first, last, faceIndices, faceIndexCounts, cube, normals, texCoords, textureFile, foreignBuffers,
+                                  ingest ? &reports[l] : nullptr, false);
+        }
+    });
+
+    if (ingest)
+    {
+        *ingest = IngestReport();
+        for (const auto &report : reports)
+        {
+            ingest->meshes += report.meshes;
+            ingest->arrays += report.arrays;
+            ingest->bytes += report.bytes;
+            ingest->allocations += report.allocations;
+            ingest->bytesAllocated += report.bytesAllocated;
+            ingest->arraysCopied += report.arraysCopied;
+            ingest->bytesCopied += report.bytesCopied;
+        }
+    }
+    return layers;
+}
+
+bool exportSublayers(const pxr::SdfLayerHandle &root, const std::vector<pxr::SdfLayerRefPtr> &layers)
+{
+    std::string base = root->GetRealPath();
+    if (base.empty())
+    {
+        std::cerr << "Unable to export the sublayers of " << root->GetIdentifier() << ", it isn't saved to a file" << std::endl;
+        return false;
+    }
+    base = base.substr(0, base.rfind('.'));
+    std::string name = base.substr(base.find_last_of("/\\") + 1);
+
+    // each layer is written on its own, so they can all be written at once
+    std::vector<char> exported(layers.size(), 0);
+    pxr::WorkParallelForN(layers.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t l = begin; l < end; ++l)
+            exported[l] = layers[l]->Export(base + ".part" + std::to_string(l) + ".usdc");
+    });
+
+    // point the root at the files, relative so the set can be moved
+    std::vector<std::string> paths = root->GetSubLayerPaths();
+    bool succeeded = true;
+    for (size_t l = 0; l < layers.size(); ++l)
+    {
+        if (!exported[l])
+        {
+            std::cerr << "Unable to export sublayer " << l << " of " << root->GetIdentifier() << std::endl;
+            succeeded = false;
+            continue;
+        }
+        std::replace(paths.begin(), paths.end(), layers[l]->GetIdentifier(), "./" + name + ".part" + std::to_string(l) + ".usdc");
+    }
+    root->SetSubLayerPaths(paths);
+    return succeeded;
+}
+
+pxr::SdfLayerRefPtr cube(const std::string &primName)
+{
+    return cube(primName, "");
+}
+
+bool stageExtent(const pxr::UsdStageRefPtr &stage, pxr::GfVec3f &extentMin, pxr::GfVec3f &extentMax)
+{
+    bool extentsSet = false;
+    pxr::VtVec3fArray extentArray(2);
+    for (const auto &prim : stage->Traverse())
+    {
+        auto extentAttr = prim.GetAttribute(pxr::UsdGeomTokens->extent);
+        if (!extentAttr || !extentAttr.Get(&extentArray) || extentArray.size() < 2)
+            continue;
+
+        if (!extentsSet)
+        {
+            extentMin = extentArray[0];
+            extentMax = extentArray[1];
+            extentsSet = true;
+            continue;
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            extentMin[i] = std::min(extentMin[i], extentArray[0][i]);
+            extentMax[i] = std::max(extentMax[i], extentArray[1][i]);
+        }
+    }
+    return extentsSet;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/usdShade/material.h>
+#include <pxr/usd/usdShade/shader.h>
+
+#include "foreignArray.h"
+
+#include <string>
+#include <vector>
+
+// create a mesh at /meshName with the given topology, normals and extent. the arrays are authored as they are, the
+// layer shares their storage rather than copying it (foreign ones included)
+pxr::UsdGeomMesh createMesh(pxr::UsdStageRefPtr stage, const std::string &meshName, const pxr::VtVec3fArray &points, const pxr::VtArray<int> &faceVertexCounts, const pxr::VtArray<int> &faceVertexIndices, const pxr::VtVec3fArray& normals);
+// as above plus an "st" primvar for texturing
+pxr::UsdGeomMesh createMesh(pxr::UsdStageRefPtr stage, const std::string &primName, const pxr::VtVec3fArray &points, const pxr::VtArray<int> &faceVertexCounts, const pxr::VtArray<int> &faceVertexIndices, const pxr::VtVec2fArray &texCoordArray, const pxr::VtVec3fArray &normals);
+
+// author a UsdPreviewSurface material (optionally textured) at materialPath
+pxr::UsdShadeMaterial createPBRMaterial(pxr::UsdStageRefPtr stage, const pxr::SdfPath &materialPath, const float roughness, const float metallic, const std::string &textureFile);
+// author a material of the mesh's own under it and bind it, returns the surface shader
+pxr::UsdShadeShader createPBRShader(pxr::UsdStageRefPtr stage, pxr::UsdGeomMesh &mesh, const float roughness, const float metallic, const std::string &textureFile);
+
+// a textured cube on its own anonymous layer, optionally welded and reordered by the mesh optimizer first. with
+// foreignBuffers the arrays live in one block lent through a ForeignBuffer instead of an allocation each, ingest
+// (if given) is filled in with what authoring them cost
+pxr::SdfLayerRefPtr cube(const std::string &primName, const std::string textureFile, bool optimize = false, bool foreignBuffers = false, IngestReport *ingest = nullptr);
+pxr::SdfLayerRefPtr cube(const std::string &primName);
+// a grid of count cubes under /primName sharing a handful of materials
+pxr::SdfLayerRefPtr cubes(const std::string &primName, size_t count, const std::string textureFile, bool optimize = false, bool foreignBuffers = false, IngestReport *ingest = nullptr);
+// the same grid split across layerCount anonymous layers authored in parallel, one per work thread, to be composed as
+// sublayers instead of copied into one
+std::vector<pxr::SdfLayerRefPtr> cubeLayers(const std::string &primName, size_t count, size_t layerCount, const std::string textureFile, bool optimize = false,
+                                            bool foreignBuffers = false, IngestReport *ingest = nullptr);
+// write anonymous sublayers of root next to it as <root>.partN.usdc and point root's sublayer paths at the files
+bool exportSublayers(const pxr::SdfLayerHandle &root, const std::vector<pxr::SdfLayerRefPtr> &layers);
+// the union of the extents authored on the stage's prims, each in its own space the way the viewer frames the
+// scene. false if there are none
+bool stageExtent(const pxr::UsdStageRefPtr &stage, pxr::GfVec3f &extentMin, pxr::GfVec3f &extentMax);
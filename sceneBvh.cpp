@@ -0,0 +1,532 @@
+#include "sceneBvh.h"
+
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/base/gf/matrix4f.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/tf/weakPtr.h>
+#include <pxr/base/work/dispatcher.h>
+#include <pxr/base/work/loops.h>
+
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// leaves hold at most this many triangles
+static const uint32_t s_maxLeafSize = 4;
+// subtrees larger than this are built as separate tasks
+static const uint32_t s_parallelBuildSize = 4096;
+static const int s_binCount = 16;
+static const int s_stackSize = 256;
+
+namespace
+{
+    struct Bounds
+    {
+        Bounds()
+            : boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max())
+        {}
+        void Extend(const glm::vec3 &p)
+        {
+            boundsMin = glm::min(boundsMin, p);
+            boundsMax = glm::max(boundsMax, p);
+        }
+        void Extend(const Bounds &b)
+        {
+            boundsMin = glm::min(boundsMin, b.boundsMin);
+            boundsMax = glm::max(boundsMax, b.boundsMax);
+        }
+        float Area() const
+        {
+            glm::vec3 d = boundsMax - boundsMin;
+            return d.x < 0.f ? 0.f : 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+        glm::vec3 boundsMin, boundsMax;
+    };
+
+    // a zero component would make its reciprocal infinite and the slab test 0 * inf = NaN for bounds the ray starts
+    // on, a tiny one of the same sign keeps every slab finite
+    glm::vec3 InverseDirection(const glm::vec3 &dir)
+    {
+        glm::vec3 invDir;
+        for (int i = 0; i < 3; ++i)
+            invDir[i] = 1.f / (std::abs(dir[i]) < 1e-20f ? std::copysign(1e-20f, dir[i]) : dir[i]);
+        return invDir;
+    }
+
+    bool IntersectBounds(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::vec3 &origin, const glm::vec3 &invDir, float maxT, float &tNear)
+    {
+        glm::vec3 t0 = (boundsMin - origin) * invDir;
+        glm::vec3 t1 = (boundsMax - origin) * invDir;
+        glm::vec3 tMin = glm::min(t0, t1);
+        glm::vec3 tMax = glm::max(t0, t1);
+        tNear = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.f));
+        float tFar = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxT));
+        return tNear <= tFar;
+    }
+
+    // moller-trumbore, returns the distance along a normalized ray
+    bool IntersectTriangle(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2, const glm::vec3 &origin, const glm::vec3 &dir, float &t)
+    {
+        glm::vec3 e1 = v1 - v0;
+        glm::vec3 e2 = v2 - v0;
+        glm::vec3 p = glm::cross(dir, e2);
+        float det = glm::dot(e1, p);
+        if (std::abs(det) < 1e-12f)
+            return false;
+
+        float invDet = 1.f / det;
+        glm::vec3 s = origin - v0;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.f || u > 1.f)
+            return false;
+
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(dir, q) * invDet;
+        if (v < 0.f || u + v > 1.f)
+            return false;
+
+        t = glm::dot(e2, q) * invDet;
+        return t > 0.f;
+    }
+}
+
+SceneBVH::SceneBVH()
+    :
+    time(pxr::UsdTimeCode::Default()),
+    needsRefit(false),
+    needsRebuild(false),
+    nodeCount(0),
+    lastBuildMs(0.0)
+{}
+
+SceneBVH::~SceneBVH()
+{
+    pxr::TfNotice::Revoke(noticeKey);
+}
+
+void SceneBVH::Build(const pxr::UsdStageRefPtr &buildStage, pxr::UsdTimeCode buildTime)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (get_pointer(buildStage) != get_pointer(stage))
+    {
+        pxr::TfNotice::Revoke(noticeKey);
+        stage = buildStage;
+        if (stage)
+            noticeKey = pxr::TfNotice::Register(pxr::TfCreateWeakPtr(this), &SceneBVH::OnObjectsChanged, stage);
+    }
+    time = buildTime;
+    needsRefit = false;
+    needsRebuild = false;
+
+    nodes.clear();
+    nodeCount = 0;
+    if (!stage || !GatherTriangles(time, true) || triangles.empty())
+        return;
+
+    uint32_t count = (uint32_t)triangles.size();
+
+    centroids.resize(count);
+    pxr::WorkParallelForN(count, [this](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            centroids[i] = (triangles[i].v0 + triangles[i].v1 + triangles[i].v2) * (1.f / 3.f);
+    });
+
+    triangleOrder.resize(count);
+    std::iota(triangleOrder.begin(), triangleOrder.end(), 0u);
+
+    // a binary tree with at least one triangle per leaf can't have more than 2n - 1 nodes
+    nodes.resize(2 * (size_t)count - 1);
+    nodeCount = 1;
+    {
+        pxr::WorkDispatcher dispatcher;
+        dispatcher.Run([this, count, &dispatcher]() { BuildNode(0, 0, count, &dispatcher); });
+        dispatcher.Wait();
+    }
+    nodes.resize(nodeCount);
+
+    centroids.clear();
+    centroids.shrink_to_fit();
+
+    lastBuildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool SceneBVH::Refit(pxr::UsdTimeCode refitTime)
+{
+    if (!stage || nodes.empty())
+        return false;
+
+    time = refitTime;
+    if (!GatherTriangles(time, false))
+        return false;
+
+    RefitNodes();
+    needsRefit = false;
+    return true;
+}
+
+void SceneBVH::Update()
+{
+    if (needsRebuild)
+        Build(pxr::UsdStageRefPtr(stage), time);
+    else if (needsRefit && !Refit(time))
+        Build(pxr::UsdStageRefPtr(stage), time);
+}
+
+void SceneBVH::OnObjectsChanged(const pxr::UsdNotice::ObjectsChanged &notice, const pxr::UsdStageWeakPtr &sender)
+{
+    if (!notice.GetResyncedPaths().empty())
+    {
+        needsRebuild = true;
+        return;
+    }
+
+    // points and transforms only move triangles, a change to the face counts/indices needs a new tree
+    for (const auto &path : notice.GetChangedInfoOnlyPaths())
+    {
+        if (!path.IsPropertyPath())
+            continue;
+        const auto &name = path.GetNameToken();
+        if (name == pxr::UsdGeomTokens->faceVertexCounts || name == pxr::UsdGeomTokens->faceVertexIndices)
+            needsRebuild = true;
+        else if (name == pxr::UsdGeomTokens->points || name == pxr::UsdGeomTokens->xformOpOrder ||
+                 pxr::TfStringStartsWith(name.GetString(), "xformOp:"))
+            needsRefit = true;
+    }
+}
+
+bool SceneBVH::GatherTriangles(pxr::UsdTimeCode gatherTime, bool topology)
+{
+    if (topology)
+    {
+        meshes.clear();
+        // instanced meshes only exist as proxies under each instance, each with its own transform
+        for (const auto &prim : stage->Traverse(pxr::UsdTraverseInstanceProxies()))
+        {
+            if (!prim.IsA<pxr::UsdGeomMesh>())
+                continue;
+            MeshSource source;
+            source.path = prim.GetPath();
+            source.prim = prim;
+            source.pointCount = 0;
+            source.firstTriangle = 0;
+            source.triangleCount = 0;
+            meshes.push_back(source);
+        }
+
+        // fan triangulate each mesh's faces into point index triples
+        pxr::WorkParallelForN(meshes.size(), [this, gatherTime](size_t begin, size_t end)
+        {
+            for (size_t m = begin; m < end; ++m)
+            {
+                auto &source = meshes[m];
+                pxr::UsdGeomMesh mesh(source.prim);
+                pxr::VtArray<int> faceVertexCounts, faceVertexIndices;
+                mesh.GetFaceVertexCountsAttr().Get(&faceVertexCounts, gatherTime);
+                mesh.GetFaceVertexIndicesAttr().Get(&faceVertexIndices, gatherTime);
+
+                source.corners.clear();
+                size_t corner = 0;
+                for (int count : faceVertexCounts)
+                {
+                    if (corner + count > faceVertexIndices.size())
+                        break;
+                    for (int i = 2; i < count; ++i)
+                    {
+                        source.corners.push_back(faceVertexIndices[corner]);
+                        source.corners.push_back(faceVertexIndices[corner + i - 1]);
+                        source.corners.push_back(faceVertexIndices[corner + i]);
+                    }
+                    corner += count;
+                }
+                source.triangleCount = (uint32_t)(source.corners.size() / 3);
+            }
+        });
+
+        uint32_t total = 0;
+        for (auto &source : meshes)
+        {
+            source.firstTriangle = total;
+            total += source.triangleCount;
+        }
+
+        triangles.resize(total);
+        triangleMesh.resize(total);
+        for (uint32_t m = 0; m < (uint32_t)meshes.size(); ++m)
+            std::fill_n(triangleMesh.begin() + meshes[m].firstTriangle, meshes[m].triangleCount, m);
+    }
+
+    // move the points to world space and write out the triangles
+    std::atomic<bool> topologyMatches(true);
+    pxr::WorkParallelForN(meshes.size(), [this, gatherTime, topology, &topologyMatches](size_t begin, size_t end)
+    {
+        for (size_t m = begin; m < end; ++m)
+        {
+            auto &source = meshes[m];
+            pxr::VtVec3fArray points;
+            pxr::UsdGeomMesh(source.prim).GetPointsAttr().Get(&points, gatherTime);
+
+            if (topology)
+                source.pointCount = points.size();
+            else if (points.size() != source.pointCount)
+            {
+                topologyMatches = false;
+                continue;
+            }
+
+            pxr::GfMatrix4f xform(pxr::UsdGeomImageable(source.prim).ComputeLocalToWorldTransform(gatherTime));
+            std::vector<glm::vec3> world(points.size());
+            for (size_t i = 0; i < points.size(); ++i)
+            {
+                auto p = xform.Transform(points[i]);
+                world[i] = glm::vec3(p[0], p[1], p[2]);
+            }
+
+            auto pointAt = [&world](int index) { return index >= 0 && (size_t)index < world.size() ? world[index] : glm::vec3(0.f); };
+            for (uint32_t t = 0; t < source.triangleCount; ++t)
+            {
+                auto &triangle = triangles[source.firstTriangle + t];
+                triangle.v0 = pointAt(source.corners[t * 3 + 0]);
+                triangle.v1 = pointAt(source.corners[t * 3 + 1]);
+                triangle.v2 = pointAt(source.corners[t * 3 + 2]);
+            }
+        }
+    });
+
+    return topologyMatches;
+}
+
+void SceneBVH::BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, pxr::WorkDispatcher *dispatcher)
+{
+    Bounds bounds, centroidBounds;
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        const auto &triangle = triangles[triangleOrder[i]];
+        bounds.Extend(triangle.v0);
+        bounds.Extend(triangle.v1);
+        bounds.Extend(triangle.v2);
+        centroidBounds.Extend(centroids[triangleOrder[i]]);
+    }
+
+    Node &node = nodes[nodeIndex];
+    node.boundsMin = bounds.boundsMin;
+    node.boundsMax = bounds.boundsMax;
+    node.firstChild = first;
+    node.count = count;
+    if (count <= s_maxLeafSize)
+        return;
+
+    // binned surface area heuristic over the largest centroid axis
+    glm::vec3 extent = centroidBounds.boundsMax - centroidBounds.boundsMin;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    float axisMin = centroidBounds.boundsMin[axis];
+    float axisExtent = extent[axis];
+
+    uint32_t mid = first + count / 2;
+    if (axisExtent > 0.f)
+    {
+        Bounds binBounds[s_binCount];
+        uint32_t binCounts[s_binCount] = {};
+        float binScale = (float)s_binCount / axisExtent;
+        auto binOf = [&](uint32_t triangle)
+        {
+            return std::min(s_binCount - 1, (int)((centroids[triangle][axis] - axisMin) * binScale));
+        };
+
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            int bin = binOf(triangleOrder[i]);
+            const auto &triangle = triangles[triangleOrder[i]];
+            binCounts[bin]++;
+            binBounds[bin].Extend(triangle.v0);
+            binBounds[bin].Extend(triangle.v1);
+            binBounds[bin].Extend(triangle.v2);
+        }
+
+        // sweep from the right to get the cost of every right hand side, then from the left to find the best split
+        float rightArea[s_binCount];
+        uint32_t rightCount[s_binCount];
+        Bounds sweep;
+        uint32_t sweepCount = 0;
+        for (int b = s_binCount - 1; b > 0; --b)
+        {
+            sweep.Extend(binBounds[b]);
+            sweepCount += binCounts[b];
+            rightArea[b] = sweep.Area();
+            rightCount[b] = sweepCount;
+        }
+
+        float bestCost = std::numeric_limits<float>::max();
+        int bestSplit = -1;
+        sweep = Bounds();
+        sweepCount = 0;
+        for (int b = 1; b < s_binCount; ++b)
+        {
+            sweep.Extend(binBounds[b - 1]);
+            sweepCount += binCounts[b - 1];
+            if (sweepCount == 0 || rightCount[b] == 0)
+                continue;
+            float cost = sweep.Area() * (float)sweepCount + rightArea[b] * (float)rightCount[b];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        if (bestSplit > 0)
+        {
+            auto it = std::partition(triangleOrder.begin() + first, triangleOrder.begin() + first + count,
+                [&](uint32_t triangle) { return binOf(triangle) < bestSplit; });
+            mid = (uint32_t)(it - triangleOrder.begin());
+        }
+    }
+
+    // every centroid in the same place (or the binning put them all on one side), split down the middle
+    if (mid == first || mid == first + count)
+        mid = first + count / 2;
+
+    uint32_t leftCount = mid - first;
+    uint32_t rightCount = count - leftCount;
+    uint32_t children = nodeCount.fetch_add(2);
+    node.firstChild = children;
+    node.count = 0;
+
+    if (count > s_parallelBuildSize)
+        dispatcher->Run([this, children, first, leftCount, dispatcher]() { BuildNode(children, first, leftCount, dispatcher); });
+    else
+        BuildNode(children, first, leftCount, dispatcher);
+    BuildNode(children + 1, mid, rightCount, dispatcher);
+}
+
+void SceneBVH::RefitNodes()
+{
+    // children are always allocated after their parent so a reverse sweep visits them first
+    for (size_t n = nodes.size(); n-- > 0;)
+    {
+        Node &node = nodes[n];
+        Bounds bounds;
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.firstChild; i < node.firstChild + node.count; ++i)
+            {
+                const auto &triangle = triangles[triangleOrder[i]];
+                bounds.Extend(triangle.v0);
+                bounds.Extend(triangle.v1);
+                bounds.Extend(triangle.v2);
+            }
+        }
+        else
+        {
+            const Node &left = nodes[node.firstChild];
+            const Node &right = nodes[node.firstChild + 1];
+            bounds.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+            bounds.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+        }
+        node.boundsMin = bounds.boundsMin;
+        node.boundsMax = bounds.boundsMax;
+    }
+}
+
+bool SceneBVH::Intersect(const glm::vec3 &origin, const glm::vec3 &direction, Hit &hit) const
+{
+    if (nodes.empty())
+        return false;
+
+    glm::vec3 dir = glm::normalize(direction);
+    glm::vec3 invDir = InverseDirection(dir);
+    float closest = std::numeric_limits<float>::max();
+    uint32_t closestTriangle = std::numeric_limits<uint32_t>::max();
+
+    // a lopsided tree can be deeper than the stack on hand, the rest spills to the heap rather than missing hits
+    uint32_t stack[s_stackSize];
+    int stackSize = 0;
+    std::vector<uint32_t> spill;
+    auto push = [&](uint32_t index)
+    {
+        if (stackSize < s_stackSize)
+            stack[stackSize++] = index;
+        else
+            spill.push_back(index);
+    };
+    push(0);
+    while (stackSize > 0 || !spill.empty())
+    {
+        uint32_t index;
+        if (!spill.empty())
+        {
+            index = spill.back();
+            spill.pop_back();
+        }
+        else
+            index = stack[--stackSize];
+        const Node &node = nodes[index];
+        float tNear;
+        if (!IntersectBounds(node.boundsMin, node.boundsMax, origin, invDir, closest, tNear))
+            continue;
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.firstChild; i < node.firstChild + node.count; ++i)
+            {
+                const auto &triangle = triangles[triangleOrder[i]];
+                float t;
+                if (IntersectTriangle(triangle.v0, triangle.v1, triangle.v2, origin, dir, t) && t < closest)
+                {
+                    closest = t;
+                    closestTriangle = triangleOrder[i];
+                }
+            }
+            continue;
+        }
+
+        // visit the nearer child first so the far one is more likely to be culled
+        float tLeft, tRight;
+        const Node &left = nodes[node.firstChild];
+        const Node &right = nodes[node.firstChild + 1];
+        bool hitLeft = IntersectBounds(left.boundsMin, left.boundsMax, origin, invDir, closest, tLeft);
+        bool hitRight = IntersectBounds(right.boundsMin, right.boundsMax, origin, invDir, closest, tRight);
+        if (hitLeft && hitRight)
+        {
+            bool leftFirst = tLeft <= tRight;
+            push(leftFirst ? node.firstChild + 1 : node.firstChild);
+            push(leftFirst ? node.firstChild : node.firstChild + 1);
+        }
+        else if (hitLeft)
+            push(node.firstChild);
+        else if (hitRight)
+            push(node.firstChild + 1);
+    }
+
+    if (closestTriangle == std::numeric_limits<uint32_t>::max())
+        return false;
+
+    const auto &triangle = triangles[closestTriangle];
+    hit.path = meshes[triangleMesh[closestTriangle]].path;
+    hit.triangle = closestTriangle - meshes[triangleMesh[closestTriangle]].firstTriangle;
+    hit.distance = closest;
+    hit.point = origin + dir * closest;
+    hit.normal = glm::normalize(glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0));
+    return true;
+}
+
+bool SceneBVH::Occluded(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance) const
+{
+    Hit hit;
+    return Intersect(origin, direction, hit) && hit.distance < maxDistance;
+}
+
+bool SceneBVH::GetBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) const
+{
+    if (nodes.empty())
+        return false;
+    boundsMin = nodes[0].boundsMin;
+    boundsMax = nodes[0].boundsMax;
+    return true;
+}
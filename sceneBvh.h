@@ -0,0 +1,101 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/base/tf/weakBase.h>
+
+#include <glm/vec3.hpp>
+
+#include <atomic>
+#include <vector>
+
+namespace pxr
+{
+    class WorkDispatcher;
+}
+
+// CPU ray queries against the world space triangles of every mesh on a stage, instanced ones included
+//
+// the triangles are gathered and the tree is built in parallel, when only points change (deformation, edits) the
+// existing tree is refit rather than rebuilt
+class SceneBVH : public pxr::TfWeakBase
+{
+public:
+    struct Hit
+    {
+        Hit() : distance(0.f), triangle(0) {}
+        pxr::SdfPath path;
+        glm::vec3 point;
+        glm::vec3 normal;
+        float distance;
+        uint32_t triangle;
+    };
+
+    SceneBVH();
+    virtual ~SceneBVH();
+
+    // build over the stage's meshes and start listening for changes to it
+    void Build(const pxr::UsdStageRefPtr &stage, pxr::UsdTimeCode time = pxr::UsdTimeCode::Default());
+    // recompute the triangles and node bounds, returns false if the topology no longer matches
+    bool Refit(pxr::UsdTimeCode time = pxr::UsdTimeCode::Default());
+    // bring the tree up to date with any stage changes since the last build/refit
+    void Update();
+
+    // nearest hit along the ray (direction need not be normalized)
+    bool Intersect(const glm::vec3 &origin, const glm::vec3 &direction, Hit &hit) const;
+    // true if anything is hit closer than maxDistance
+    bool Occluded(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance) const;
+    bool GetBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) const;
+
+    bool IsBuilt() const { return !nodes.empty(); }
+    size_t GetTriangleCount() const { return triangles.size(); }
+    size_t GetMeshCount() const { return meshes.size(); }
+    double GetLastBuildMs() const { return lastBuildMs; }
+
+protected:
+    struct Triangle
+    {
+        glm::vec3 v0, v1, v2;
+    };
+
+    struct Node
+    {
+        glm::vec3 boundsMin;
+        uint32_t firstChild;    // leaf: first triangle index, interior: left child (right is firstChild + 1)
+        glm::vec3 boundsMax;
+        uint32_t count;         // triangles in a leaf, 0 for interior nodes
+    };
+
+    struct MeshSource
+    {
+        pxr::SdfPath path;
+        pxr::UsdPrim prim;
+        size_t pointCount;
+        uint32_t firstTriangle;
+        uint32_t triangleCount;
+        std::vector<int> corners;   // 3 point indices per triangle, fan triangulated
+    };
+
+    void OnObjectsChanged(const pxr::UsdNotice::ObjectsChanged &notice, const pxr::UsdStageWeakPtr &sender);
+
+    bool GatherTriangles(pxr::UsdTimeCode time, bool topology);
+    void BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, pxr::WorkDispatcher *dispatcher);
+    void RefitNodes();
+
+    pxr::UsdStageWeakPtr stage;
+    pxr::TfNotice::Key noticeKey;
+    pxr::UsdTimeCode time;
+    bool needsRefit, needsRebuild;
+
+    std::vector<MeshSource> meshes;
+    std::vector<Triangle> triangles;        // in tree order once built
+    std::vector<uint32_t> triangleMesh;     // triangle -> index into meshes
+    std::vector<uint32_t> triangleOrder;    // tree order -> gathered order, refits write through this
+    std::vector<glm::vec3> centroids;
+    std::vector<Node> nodes;
+    std::atomic<uint32_t> nodeCount;
+
+    double lastBuildMs;
+};
@@ -0,0 +1,442 @@
+#include "sceneProfile.h"
+#include "memoryReport.h"
+
+#include <pxr/base/arch/hash.h>
+#include <pxr/base/js/json.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/work/loops.h>
+#include <pxr/usd/kind/registry.h>
+#include <pxr/usd/pcp/layerStack.h>
+#include <pxr/usd/pcp/node.h>
+#include <pxr/usd/pcp/primIndex.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/usd/modelAPI.h>
+#include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usdGeom/gprim.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/usdGeom/pointBased.h>
+#include <pxr/usd/usdGeom/primvarsAPI.h>
+#include <pxr/usd/usdShade/material.h>
+#include <pxr/usd/usdShade/materialBindingAPI.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <unordered_map>
+
+namespace
+{
+    const size_t None = (size_t)-1;
+
+    // everything the parallel pass works out for one prim
+    struct PrimRecord
+    {
+        PrimRecord()
+            : parent(None), prototype(None), instanceOf(None), vertices(0), triangles(0), primvarBytes(0), gpuBytes(0),
+              isMaterial(false), materialKey(0), isComponent(false), payloadArcs(0), payloadBytes(0)
+        {
+            std::fill_n(arcs, (size_t)pxr::PcpNumArcTypes, (size_t)0);
+        }
+
+        pxr::UsdPrim prim;
+        size_t parent;
+        // the prototype this prim lives in, and the one it instances if it's an instance
+        size_t prototype, instanceOf;
+
+        size_t vertices, triangles, primvarBytes, gpuBytes;
+
+        bool isMaterial;
+        uint64_t materialKey;
+        pxr::SdfPath boundMaterial;
+
+        bool isComponent;
+        size_t arcs[pxr::PcpNumArcTypes];
+        size_t payloadArcs, payloadBytes;
+        std::vector<std::string> payloadLayers;
+    };
+
+    const char *ArcName(pxr::PcpArcType arc)
+    {
+        switch (arc)
+        {
+        case pxr::PcpArcTypeInherit: return "inherit";
+        case pxr::PcpArcTypeVariant: return "variant";
+        case pxr::PcpArcTypeRelocate: return "relocate";
+        case pxr::PcpArcTypeReference: return "reference";
+        case pxr::PcpArcTypePayload: return "payload";
+        case pxr::PcpArcTypeSpecialize: return "specialize";
+        default: return "root";
+        }
+    }
+
+    // hash a material's shading network relative to the material, so two copies at different paths compare equal
+    uint64_t MaterialKey(const pxr::UsdPrim &material)
+    {
+        const pxr::SdfPath &root = material.GetPath();
+        std::string key;
+        for (const auto &prim : pxr::UsdPrimRange(material))
+        {
+            key += prim.GetPath().MakeRelativePath(root).GetString() + ":" + prim.GetTypeName().GetString() + "\n";
+            for (const auto &attribute : prim.GetAuthoredAttributes())
+            {
+                key += attribute.GetName().GetString() + "=";
+                pxr::VtValue value;
+                if (attribute.Get(&value))
+                    key += pxr::TfStringify(value);
+                pxr::SdfPathVector sources;
+                attribute.GetConnections(&sources);
+                for (const auto &source : sources)
+                    key += "<" + source.MakeRelativePath(root).GetString() + ">";
+                key += "\n";
+            }
+        }
+        return pxr::ArchHash64(key.data(), key.size());
+    }
+
+    void ProfilePrim(PrimRecord &record)
+    {
+        const pxr::UsdPrim &prim = record.prim;
+        auto time = pxr::UsdTimeCode::EarliestTime();
+
+        if (prim.IsA<pxr::UsdGeomPointBased>())
+        {
+            pxr::VtVec3fArray points;
+            pxr::UsdGeomPointBased(prim).GetPointsAttr().Get(&points, time);
+            record.vertices = points.size();
+        }
+        if (prim.IsA<pxr::UsdGeomMesh>())
+        {
+            pxr::VtArray<int> faceVertexCounts;
+            pxr::UsdGeomMesh(prim).GetFaceVertexCountsAttr().Get(&faceVertexCounts, time);
+            for (int count : faceVertexCounts)
+                record.triangles += count > 2 ? (size_t)(count - 2) : 0;
+        }
+        pxr::VtValue value;
+        for (const auto &primvar : pxr::UsdGeomPrimvarsAPI(prim).GetPrimvarsWithValues())
+        {
+            if (primvar.Get(&value, time))
+                record.primvarBytes += EstimateValueBytes(value);
+        }
+        record.gpuBytes = EstimatePrimGpuBytes(prim);
+
+        if (prim.IsA<pxr::UsdShadeMaterial>())
+        {
+            record.isMaterial = true;
+            record.materialKey = MaterialKey(prim);
+        }
+        if (prim.IsA<pxr::UsdGeomGprim>())
+        {
+            if (auto material = pxr::UsdShadeMaterialBindingAPI(prim).ComputeBoundMaterial())
+                record.boundMaterial = material.GetPath();
+        }
+
+        pxr::TfToken kind;
+        record.isComponent = pxr::UsdModelAPI(prim).GetKind(&kind) && pxr::KindRegistry::IsA(kind, pxr::KindTokens->component);
+
+        // a prototype's root shares its prim index with the instance it came from, which already counted the arcs
+        if (record.prototype != None && record.parent == None)
+            return;
+        std::set<std::string> payloadLayers;
+        for (const pxr::PcpNodeRef &node : prim.GetPrimIndex().GetNodeRange())
+        {
+            if (node.IsRootNode() || node.IsDueToAncestor() || node.IsCulled())
+                continue;
+            record.arcs[node.GetArcType()]++;
+            if (node.GetArcType() != pxr::PcpArcTypePayload)
+                continue;
+            record.payloadArcs++;
+            for (const auto &layer : node.GetLayerStack()->GetLayers())
+            {
+                if (!layer->GetRealPath().empty())
+                    payloadLayers.insert(layer->GetRealPath());
+            }
+        }
+        for (const auto &path : payloadLayers)
+        {
+            std::error_code error;
+            auto bytes = std::filesystem::file_size(path, error);
+            if (!error)
+                record.payloadBytes += (size_t)bytes;
+            record.payloadLayers.push_back(path);
+        }
+    }
+
+    void Gather(const pxr::UsdPrimRange &range, size_t prototype, const std::map<pxr::SdfPath, size_t> &prototypeIndices,
+                std::vector<PrimRecord> &records, std::unordered_map<pxr::SdfPath, size_t, pxr::SdfPath::Hash> &indices)
+    {
+        for (auto it = range.begin(); it != range.end(); ++it)
+        {
+            PrimRecord record;
+            record.prim = *it;
+            record.prototype = prototype;
+            auto parent = indices.find(it->GetParent().GetPath());
+            if (parent != indices.end())
+                record.parent = parent->second;
+            if (it->IsInstance())
+            {
+                auto instanced = prototypeIndices.find(it->GetPrototype().GetPath());
+                if (instanced != prototypeIndices.end())
+                    record.instanceOf = instanced->second;
+            }
+            indices[it->GetPath()] = records.size();
+            records.push_back(record);
+        }
+    }
+
+    pxr::JsObject ToJson(const SubtreeProfile &subtree)
+    {
+        pxr::JsObject object;
+        object["path"] = pxr::JsValue(subtree.path.GetString());
+        object["prims"] = pxr::JsValue((uint64_t)subtree.prims);
+        object["triangles"] = pxr::JsValue((uint64_t)subtree.triangles);
+        object["gpuBytes"] = pxr::JsValue((uint64_t)subtree.gpuBytes);
+        return object;
+    }
+
+    pxr::JsObject ToJson(const std::map<std::string, size_t> &counts)
+    {
+        pxr::JsObject object;
+        for (const auto &count : counts)
+            object[count.first] = pxr::JsValue((uint64_t)count.second);
+        return object;
+    }
+}
+
+void ProfileStage(const pxr::UsdStageRefPtr &stage, const SceneProfileSettings &settings, SceneProfile &profile)
+{
+    profile = SceneProfile();
+    if (!stage)
+        return;
+    auto start = std::chrono::high_resolution_clock::now();
+    profile.rootLayer = stage->GetRootLayer()->GetIdentifier();
+
+    // the prims are gathered in traversal order, so every parent comes before its children, then worked on in parallel
+    std::vector<pxr::UsdPrim> prototypePrims = stage->GetPrototypes();
+    std::map<pxr::SdfPath, size_t> prototypeIndices;
+    for (size_t p = 0; p < prototypePrims.size(); ++p)
+        prototypeIndices[prototypePrims[p].GetPath()] = p;
+
+    std::vector<PrimRecord> records;
+    std::unordered_map<pxr::SdfPath, size_t, pxr::SdfPath::Hash> indices;
+    Gather(stage->Traverse(), None, prototypeIndices, records, indices);
+    for (size_t p = 0; p < prototypePrims.size(); ++p)
+        Gather(pxr::UsdPrimRange(prototypePrims[p]), p, prototypeIndices, records, indices);
+
+    pxr::WorkParallelForN(records.size(), [&records](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            ProfilePrim(records[i]);
+    });
+
+    // what one instance of each prototype costs once expanded, prototypes can hold instances of other prototypes
+    std::vector<std::vector<size_t>> prototypeRecords(prototypePrims.size());
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        if (records[i].prototype != None)
+            prototypeRecords[records[i].prototype].push_back(i);
+    }
+    std::vector<SubtreeProfile> expanded(prototypePrims.size());
+    std::vector<bool> expandedDone(prototypePrims.size(), false);
+    std::function<const SubtreeProfile &(size_t)> expand = [&](size_t p) -> const SubtreeProfile &
+    {
+        if (!expandedDone[p])
+        {
+            expandedDone[p] = true;
+            SubtreeProfile &total = expanded[p];
+            total.path = prototypePrims[p].GetPath();
+            for (size_t i : prototypeRecords[p])
+            {
+                total.prims++;
+                total.triangles += records[i].triangles;
+                total.gpuBytes += records[i].gpuBytes;
+                if (records[i].instanceOf != None)
+                {
+                    const SubtreeProfile &nested = expand(records[i].instanceOf);
+                    total.prims += nested.prims;
+                    total.triangles += nested.triangles;
+                    total.gpuBytes += nested.gpuBytes;
+                }
+            }
+        }
+        return expanded[p];
+    };
+
+    // add each prim into its parent's subtree, children come after their parents so walk backwards
+    std::vector<SubtreeProfile> subtrees(records.size());
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        subtrees[i].path = records[i].prim.GetPath();
+        subtrees[i].prims = 1;
+        subtrees[i].triangles = records[i].triangles;
+        subtrees[i].gpuBytes = records[i].gpuBytes;
+        if (records[i].instanceOf != None)
+        {
+            const SubtreeProfile &instanced = expand(records[i].instanceOf);
+            subtrees[i].prims += instanced.prims;
+            subtrees[i].triangles += instanced.triangles;
+            subtrees[i].gpuBytes += instanced.gpuBytes;
+        }
+    }
+    for (size_t i = records.size(); i-- > 0;)
+    {
+        size_t parent = records[i].parent;
+        if (parent == None)
+            continue;
+        subtrees[parent].prims += subtrees[i].prims;
+        subtrees[parent].triangles += subtrees[i].triangles;
+        subtrees[parent].gpuBytes += subtrees[i].gpuBytes;
+    }
+
+    std::set<uint64_t> materialKeys;
+    std::set<pxr::SdfPath> boundMaterials;
+    size_t arcs[pxr::PcpNumArcTypes] = {};
+    std::vector<size_t> components;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        const PrimRecord &record = records[i];
+        if (record.prototype == None)
+            profile.prims++;
+        else
+            profile.prototypePrims++;
+        std::string type = record.prim.GetTypeName().GetString();
+        profile.primTypes[type.empty() ? "untyped" : type]++;
+
+        profile.vertices += record.vertices;
+        profile.triangles += record.triangles;
+        profile.primvarBytes += record.primvarBytes;
+        profile.gpuBytes += record.gpuBytes;
+        if (record.prototype == None && record.parent == None)
+            profile.instancedTriangles += subtrees[i].triangles;
+
+        if (record.isMaterial)
+        {
+            profile.materials++;
+            materialKeys.insert(record.materialKey);
+        }
+        if (!record.boundMaterial.IsEmpty())
+        {
+            profile.boundGprims++;
+            boundMaterials.insert(record.boundMaterial);
+        }
+        if (record.instanceOf != None)
+            profile.instances++;
+
+        for (int arc = 0; arc < pxr::PcpNumArcTypes; ++arc)
+            arcs[arc] += record.arcs[arc];
+
+        if (record.payloadArcs > 0)
+        {
+            PayloadProfile payload;
+            payload.subtree = subtrees[i];
+            payload.arcs = record.payloadArcs;
+            payload.fileBytes = record.payloadBytes;
+            payload.layers = record.payloadLayers;
+            profile.payloads.push_back(payload);
+        }
+        if (record.isComponent && record.prototype == None)
+            components.push_back(i);
+    }
+    profile.uniqueMaterials = materialKeys.size();
+    profile.boundMaterials = boundMaterials.size();
+    profile.prototypes = prototypePrims.size();
+    for (int arc = 0; arc < pxr::PcpNumArcTypes; ++arc)
+    {
+        if (arc != pxr::PcpArcTypeRoot && arcs[arc] > 0)
+            profile.arcs[ArcName((pxr::PcpArcType)arc)] = arcs[arc];
+    }
+    profile.layers = stage->GetUsedLayers().size();
+    profile.layerStack = stage->GetLayerStack().size();
+
+    // the biggest payloads on disk first
+    std::sort(profile.payloads.begin(), profile.payloads.end(),
+        [](const PayloadProfile &a, const PayloadProfile &b) { return a.fileBytes != b.fileBytes ? a.fileBytes > b.fileBytes : a.subtree.gpuBytes > b.subtree.gpuBytes; });
+    if (profile.payloads.size() > settings.topN)
+        profile.payloads.resize(settings.topN);
+
+    // every prim's subtree is smaller than its parent's, so rank the models (as the interactive bounds do) rather
+    // than listing the root and its ancestors of the biggest mesh. without any models fall back to every prim
+    if (components.empty())
+    {
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            if (records[i].prototype == None)
+                components.push_back(i);
+        }
+    }
+    size_t count = std::min(settings.topN, components.size());
+    std::partial_sort(components.begin(), components.begin() + count, components.end(),
+        [&subtrees](size_t a, size_t b) { return subtrees[a].gpuBytes > subtrees[b].gpuBytes; });
+    for (size_t i = 0; i < count; ++i)
+        profile.largestSubtrees.push_back(subtrees[components[i]]);
+
+    profile.profileMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void WriteSceneProfileJson(const SceneProfile &profile, std::ostream &out)
+{
+    pxr::JsObject prims;
+    prims["total"] = pxr::JsValue((uint64_t)profile.prims);
+    prims["inPrototypes"] = pxr::JsValue((uint64_t)profile.prototypePrims);
+    prims["byType"] = pxr::JsValue(ToJson(profile.primTypes));
+
+    pxr::JsObject geometry;
+    geometry["vertices"] = pxr::JsValue((uint64_t)profile.vertices);
+    geometry["triangles"] = pxr::JsValue((uint64_t)profile.triangles);
+    geometry["instancedTriangles"] = pxr::JsValue((uint64_t)profile.instancedTriangles);
+    geometry["primvarBytes"] = pxr::JsValue((uint64_t)profile.primvarBytes);
+    geometry["gpuBytes"] = pxr::JsValue((uint64_t)profile.gpuBytes);
+
+    pxr::JsObject materials;
+    materials["total"] = pxr::JsValue((uint64_t)profile.materials);
+    materials["unique"] = pxr::JsValue((uint64_t)profile.uniqueMaterials);
+    materials["bound"] = pxr::JsValue((uint64_t)profile.boundMaterials);
+    materials["boundGprims"] = pxr::JsValue((uint64_t)profile.boundGprims);
+
+    pxr::JsObject instancing;
+    instancing["instances"] = pxr::JsValue((uint64_t)profile.instances);
+    instancing["prototypes"] = pxr::JsValue((uint64_t)profile.prototypes);
+    instancing["instancesPerPrototype"] = pxr::JsValue(profile.prototypes > 0 ? (double)profile.instances / (double)profile.prototypes : 0.0);
+    instancing["triangleRatio"] = pxr::JsValue(profile.triangles > 0 ? (double)profile.instancedTriangles / (double)profile.triangles : 0.0);
+
+    pxr::JsObject composition;
+    composition["arcs"] = pxr::JsValue(ToJson(profile.arcs));
+    composition["layers"] = pxr::JsValue((uint64_t)profile.layers);
+    composition["layerStack"] = pxr::JsValue((uint64_t)profile.layerStack);
+
+    pxr::JsArray payloads;
+    for (const auto &payload : profile.payloads)
+    {
+        pxr::JsObject object = ToJson(payload.subtree);
+        object["arcs"] = pxr::JsValue((uint64_t)payload.arcs);
+        object["fileBytes"] = pxr::JsValue((uint64_t)payload.fileBytes);
+        pxr::JsArray layers;
+        for (const auto &layer : payload.layers)
+            layers.push_back(pxr::JsValue(layer));
+        object["layers"] = pxr::JsValue(layers);
+        payloads.push_back(pxr::JsValue(object));
+    }
+
+    pxr::JsArray subtrees;
+    for (const auto &subtree : profile.largestSubtrees)
+        subtrees.push_back(pxr::JsValue(ToJson(subtree)));
+
+    pxr::JsObject timing;
+    timing["openMs"] = pxr::JsValue(profile.openMs);
+    timing["profileMs"] = pxr::JsValue(profile.profileMs);
+
+    pxr::JsObject root;
+    root["stage"] = pxr::JsValue(profile.rootLayer);
+    root["prims"] = pxr::JsValue(prims);
+    root["geometry"] = pxr::JsValue(geometry);
+    root["materials"] = pxr::JsValue(materials);
+    root["instancing"] = pxr::JsValue(instancing);
+    root["composition"] = pxr::JsValue(composition);
+    root["payloads"] = pxr::JsValue(payloads);
+    root["largestSubtrees"] = pxr::JsValue(subtrees);
+    root["timing"] = pxr::JsValue(timing);
+
+    pxr::JsWriteToStream(pxr::JsValue(root), &out);
+    out << std::endl;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+struct SceneProfileSettings
+{
+    SceneProfileSettings()
+        : topN(10)
+    {}
+
+    // how many of the largest subtrees and payloads to list
+    size_t topN;
+};
+
+// what a prim and everything below it adds up to
+struct SubtreeProfile
+{
+    SubtreeProfile()
+        : prims(0), triangles(0), gpuBytes(0)
+    {}
+
+    pxr::SdfPath path;
+    size_t prims;
+    // instances count their prototype's triangles and bytes as if they were expanded
+    size_t triangles;
+    size_t gpuBytes;
+};
+
+struct PayloadProfile
+{
+    PayloadProfile()
+        : arcs(0), fileBytes(0)
+    {}
+
+    SubtreeProfile subtree;
+    size_t arcs;
+    // size on disk of the layers the payloads bring in
+    size_t fileBytes;
+    std::vector<std::string> layers;
+};
+
+struct SceneProfile
+{
+    SceneProfile()
+        : prims(0), prototypePrims(0), vertices(0), triangles(0), instancedTriangles(0), primvarBytes(0), gpuBytes(0),
+          materials(0), uniqueMaterials(0), boundMaterials(0), boundGprims(0), instances(0), prototypes(0), layers(0),
+          layerStack(0), openMs(0.0), profileMs(0.0)
+    {}
+
+    std::string rootLayer;
+    size_t prims, prototypePrims;
+    std::map<std::string, size_t> primTypes;
+
+    // authored geometry, prototypes counted once
+    size_t vertices, triangles;
+    // what gets drawn with every instance expanded
+    size_t instancedTriangles;
+    size_t primvarBytes;
+    // Storm shares buffers between instances so prototypes are only counted once here
+    size_t gpuBytes;
+
+    // material prims, how many of them differ in their shading networks, and how many are actually bound
+    size_t materials, uniqueMaterials, boundMaterials;
+    size_t boundGprims;
+
+    size_t instances, prototypes;
+
+    // composed arcs by type, not counting those a prim inherits from its ancestors
+    std::map<std::string, size_t> arcs;
+    size_t layers, layerStack;
+
+    std::vector<PayloadProfile> payloads;
+    std::vector<SubtreeProfile> largestSubtrees;
+
+    // opening the stage (filled in by whoever opened it) and walking it
+    double openMs, profileMs;
+};
+
+// walk the stage (prototypes included) and gather the profile, the per-prim work is spread across the work threads
+void ProfileStage(const pxr::UsdStageRefPtr &stage, const SceneProfileSettings &settings, SceneProfile &profile);
+void WriteSceneProfileJson(const SceneProfile &profile, std::ostream &out);
@@ -81,6 +81,7 @@ bool Shader::CompileLink()
 			compile_failed = true;
 			return false;
 		}
+		delete[] infoLog;
 	}
 
 	if( geometry_shader_source.length() > 0 )
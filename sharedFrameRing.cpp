@@ -0,0 +1,340 @@
+#include "sharedFrameRing.h"
+
+#include <iostream>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <new>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "the frame ring needs lock free atomics to share them between processes");
+
+#if defined(__linux__)
+namespace
+{
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // the futex word is the atomic's storage, lock free atomics have the same representation as the plain type
+    uint32_t *FutexWord(const std::atomic<uint32_t> &word)
+    {
+        return (uint32_t *)&word;
+    }
+}
+#endif
+
+SharedFrameWriter::SharedFrameWriter()
+    : fd(-1), mappedBytes(0), header(nullptr), writing(nullptr)
+{
+}
+
+SharedFrameWriter::~SharedFrameWriter()
+{
+    Close();
+}
+
+uint64_t SharedFrameWriter::NowNs()
+{
+#if defined(__linux__)
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+#if defined(__linux__)
+
+bool SharedFrameWriter::Create(const std::string &shmName, uint32_t slotCount, uint32_t maxWidth, uint32_t maxHeight)
+{
+    Close();
+    if (slotCount < 2)
+        slotCount = 2;
+
+    // page align the pixel arrays so consumers can hand them straight to an upload or an import
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t colorOffset = AlignUp(sizeof(SharedFrameSlot), 64);
+    size_t depthOffset = AlignUp(colorOffset + (size_t)maxWidth * maxHeight * 4, 64);
+    size_t slotStride = AlignUp(depthOffset + (size_t)maxWidth * maxHeight * sizeof(float), page);
+    size_t headerBytes = AlignUp(sizeof(SharedFrameHeader), page);
+    size_t bytes = headerBytes + slotStride * slotCount;
+
+    // start from a fresh object, a stale one left by a crash may have a different layout
+    shm_unlink(shmName.c_str());
+    fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        std::cerr << "Unable to create shared memory " << shmName << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, (off_t)bytes) != 0)
+    {
+        std::cerr << "Unable to size shared memory " << shmName << ": " << strerror(errno) << std::endl;
+        close(fd);
+        fd = -1;
+        shm_unlink(shmName.c_str());
+        return false;
+    }
+    void *mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        std::cerr << "Unable to map shared memory " << shmName << ": " << strerror(errno) << std::endl;
+        close(fd);
+        fd = -1;
+        shm_unlink(shmName.c_str());
+        return false;
+    }
+
+    name = shmName;
+    mappedBytes = bytes;
+    header = new (mapped) SharedFrameHeader();
+    header->version = SharedFrame::version;
+    header->slotCount = slotCount;
+    header->maxWidth = maxWidth;
+    header->maxHeight = maxHeight;
+    header->slotStride = slotStride;
+    header->colorOffset = colorOffset;
+    header->depthOffset = depthOffset;
+    header->publishCount = 0;
+    header->newestSlot = 0;
+    header->published = 0;
+    header->oversized = 0;
+    header->consumed = 0;
+    header->dropped = 0;
+    header->torn = 0;
+    for (uint32_t i = 0; i < slotCount; ++i)
+    {
+        auto *slot = new ((uint8_t *)mapped + headerBytes + slotStride * i) SharedFrameSlot();
+        slot->sequence = 0;
+    }
+
+    // readers check the magic last so they never see a half initialized header
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SharedFrame::magic;
+    return true;
+}
+
+void SharedFrameWriter::Close()
+{
+    if (header)
+    {
+        header->magic = 0;
+        munmap(header, mappedBytes);
+        header = nullptr;
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        fd = -1;
+    }
+    writing = nullptr;
+}
+
+bool SharedFrameWriter::Begin(uint64_t frame, uint64_t renderTimeNs, uint32_t width, uint32_t height, uint32_t depthWidth, uint32_t depthHeight,
+                              uint8_t **color, float **depth)
+{
+    if (!header)
+        return false;
+    if (width > header->maxWidth || height > header->maxHeight || depthWidth > header->maxWidth || depthHeight > header->maxHeight)
+    {
+        header->oversized++;
+        return false;
+    }
+
+    // the slot after the newest, a reader still on it will see the sequence change and retry
+    uint32_t index = header->publishCount.load() == 0 ? 0 : (header->newestSlot.load() + 1) % header->slotCount;
+    size_t headerBytes = AlignUp(sizeof(SharedFrameHeader), (size_t)sysconf(_SC_PAGESIZE));
+    uint8_t *base = (uint8_t *)header + headerBytes + header->slotStride * index;
+    writing = (SharedFrameSlot *)base;
+
+    writing->sequence.store(2 * frame + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    writing->frame = frame;
+    writing->renderTimeNs = renderTimeNs;
+    writing->width = width;
+    writing->height = height;
+    writing->depthWidth = depthWidth;
+    writing->depthHeight = depthHeight;
+    writing->colorFormat = SharedFrame::FormatRGBA8;
+    writing->depthFormat = depthWidth > 0 ? SharedFrame::FormatDepth32F : SharedFrame::FormatNone;
+
+    *color = base + header->colorOffset;
+    *depth = (float *)(base + header->depthOffset);
+    return true;
+}
+
+void SharedFrameWriter::Publish()
+{
+    if (!header || !writing)
+        return;
+
+    writing->publishTimeNs = NowNs();
+    writing->sequence.store(2 * (writing->frame + 1), std::memory_order_release);
+
+    size_t headerBytes = AlignUp(sizeof(SharedFrameHeader), (size_t)sysconf(_SC_PAGESIZE));
+    header->newestSlot.store((uint32_t)(((uint8_t *)writing - (uint8_t *)header - headerBytes) / header->slotStride), std::memory_order_release);
+    header->published++;
+    header->publishCount.fetch_add(1, std::memory_order_release);
+    writing = nullptr;
+
+    // waking nobody is a single syscall, cheap enough not to track whether anyone is waiting
+    syscall(SYS_futex, FutexWord(header->publishCount), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+SharedFrameReader::SharedFrameReader()
+    : fd(-1), mappedBytes(0), header(nullptr), acquiredSequence(0), lastFrame(0), haveFrame(false), lastPublishCount(0), lastLatencyMs(0.0)
+{
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+    Close();
+}
+
+bool SharedFrameReader::Open(const std::string &shmName)
+{
+    Close();
+    fd = shm_open(shmName.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SharedFrameHeader))
+    {
+        Close();
+        return false;
+    }
+    // read/write only so the consumer counters in the header can be updated
+    void *mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+    mappedBytes = (size_t)info.st_size;
+    header = (SharedFrameHeader *)mapped;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->magic != SharedFrame::magic || header->version != SharedFrame::version)
+    {
+        std::cerr << "Shared memory " << shmName << " isn't a version " << SharedFrame::version << " frame ring" << std::endl;
+        Close();
+        return false;
+    }
+    lastPublishCount = 0;
+    haveFrame = false;
+    return true;
+}
+
+void SharedFrameReader::Close()
+{
+    if (header)
+        munmap(header, mappedBytes);
+    header = nullptr;
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+bool SharedFrameReader::WaitForFrame(int timeoutMs)
+{
+    if (!header)
+        return false;
+
+    uint32_t current = header->publishCount.load(std::memory_order_acquire);
+    if (current != lastPublishCount)
+        return true;
+
+    timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (long)(timeoutMs % 1000) * 1000000l;
+    syscall(SYS_futex, FutexWord(header->publishCount), FUTEX_WAIT, current, &timeout, nullptr, 0);
+    return header->publishCount.load(std::memory_order_acquire) != lastPublishCount;
+}
+
+const SharedFrameSlot *SharedFrameReader::Acquire(const uint8_t **color, const float **depth)
+{
+    if (!header || header->publishCount.load(std::memory_order_acquire) == 0)
+        return nullptr;
+
+    size_t headerBytes = AlignUp(sizeof(SharedFrameHeader), (size_t)sysconf(_SC_PAGESIZE));
+    for (int attempt = 0; attempt < 4; ++attempt)
+    {
+        lastPublishCount = header->publishCount.load(std::memory_order_acquire);
+        uint32_t index = header->newestSlot.load(std::memory_order_acquire);
+        const uint8_t *base = (const uint8_t *)header + headerBytes + header->slotStride * index;
+        const SharedFrameSlot *slot = (const SharedFrameSlot *)base;
+
+        acquiredSequence = slot->sequence.load(std::memory_order_acquire);
+        if (acquiredSequence & 1)
+        {
+            // lapped by the writer before we got to it
+            header->torn++;
+            continue;
+        }
+        *color = base + header->colorOffset;
+        *depth = (const float *)(base + header->depthOffset);
+        return slot;
+    }
+    return nullptr;
+}
+
+bool SharedFrameReader::Validate(const SharedFrameSlot *slot)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->sequence.load(std::memory_order_relaxed) != acquiredSequence)
+    {
+        header->torn++;
+        return false;
+    }
+
+    uint64_t frame = slot->frame;
+    if (haveFrame && frame > lastFrame + 1)
+        header->dropped += frame - lastFrame - 1;
+    lastFrame = frame;
+    haveFrame = true;
+    header->consumed++;
+    lastLatencyMs = (double)(SharedFrameWriter::NowNs() - slot->renderTimeNs) / 1000000.0;
+    return true;
+}
+
+#else
+
+bool SharedFrameWriter::Create(const std::string &, uint32_t, uint32_t, uint32_t)
+{
+    std::cerr << "Shared memory frame export is only implemented on Linux" << std::endl;
+    return false;
+}
+
+void SharedFrameWriter::Close() {}
+bool SharedFrameWriter::Begin(uint64_t, uint64_t, uint32_t, uint32_t, uint32_t, uint32_t, uint8_t **, float **) { return false; }
+void SharedFrameWriter::Publish() {}
+
+SharedFrameReader::SharedFrameReader()
+    : fd(-1), mappedBytes(0), header(nullptr), acquiredSequence(0), lastFrame(0), haveFrame(false), lastPublishCount(0), lastLatencyMs(0.0)
+{
+}
+
+SharedFrameReader::~SharedFrameReader() {}
+bool SharedFrameReader::Open(const std::string &) { return false; }
+void SharedFrameReader::Close() {}
+bool SharedFrameReader::WaitForFrame(int) { return false; }
+const SharedFrameSlot *SharedFrameReader::Acquire(const uint8_t **, const float **) { return nullptr; }
+bool SharedFrameReader::Validate(const SharedFrameSlot *) { return false; }
+
+#endif
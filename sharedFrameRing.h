@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// layout of a frame ring in POSIX shared memory, shared with the consumer processes
+//
+//   SharedFrameHeader | slot 0 | slot 1 | ... | slot slotCount-1
+//
+// each slot is a SharedFrameSlot followed by the color (RGBA8) then depth (float) pixels, bottom row first. slots
+// are written round robin and guarded by a seqlock: the slot's sequence is odd while it's being written and
+// 2 * (frame + 1) once it's complete, so a reader that sees the same even sequence before and after reading the
+// pixels knows they weren't overwritten underneath it. the writer never waits for readers, readers that fall
+// behind skip frames (and count them)
+//
+// header.publishCount is also a futex word, bumped and woken on every publish
+namespace SharedFrame
+{
+    const uint32_t magic = 0x55534446;      // "USDF"
+    const uint32_t version = 1;
+
+    enum PixelFormat : uint32_t
+    {
+        FormatNone = 0,
+        FormatRGBA8 = 1,
+        FormatDepth32F = 2,
+    };
+}
+
+struct SharedFrameSlot
+{
+    std::atomic<uint64_t> sequence;
+    uint64_t frame;
+    uint64_t renderTimeNs;          // CLOCK_MONOTONIC when the frame was rendered
+    uint64_t publishTimeNs;         // and when it landed in the ring
+    uint32_t width, height;             // of the color image
+    uint32_t depthWidth, depthHeight;   // of the depth, the part of the aov rendered this frame, which is smaller than
+                                        // the window while the governor scales the resolution down or a resize settles
+    uint32_t colorFormat, depthFormat;
+};
+
+struct SharedFrameHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t maxWidth, maxHeight;
+    uint64_t slotStride;            // bytes from one slot to the next
+    uint64_t colorOffset;           // from the start of a slot
+    uint64_t depthOffset;
+
+    std::atomic<uint32_t> publishCount;     // futex word
+    std::atomic<uint32_t> newestSlot;       // index of the newest complete slot, valid once publishCount > 0
+
+    // written by the writer
+    std::atomic<uint64_t> published;
+    std::atomic<uint64_t> oversized;        // frames bigger than the slots, not published
+
+    // written by readers
+    std::atomic<uint64_t> consumed;
+    std::atomic<uint64_t> dropped;          // frames a reader never saw because it fell behind
+    std::atomic<uint64_t> torn;             // reads that were overwritten while they happened and retried
+};
+
+// the writing end, owns the shared memory object and unlinks it when destroyed
+class SharedFrameWriter
+{
+public:
+    SharedFrameWriter();
+    virtual ~SharedFrameWriter();
+
+    // name as for shm_open ("/usdSimpleCpp"), slots are sized for maxWidth x maxHeight
+    bool Create(const std::string &name, uint32_t slotCount, uint32_t maxWidth, uint32_t maxHeight);
+    void Close();
+    bool IsOpen() { return header != nullptr; }
+
+    // start writing a frame into the next slot, returns its color and depth storage or null if it doesn't fit
+    bool Begin(uint64_t frame, uint64_t renderTimeNs, uint32_t width, uint32_t height, uint32_t depthWidth, uint32_t depthHeight,
+               uint8_t **color, float **depth);
+    // mark the slot complete and wake any waiting readers
+    void Publish();
+
+    SharedFrameHeader *GetHeader() { return header; }
+    const std::string &GetName() { return name; }
+
+    static uint64_t NowNs();
+
+protected:
+    std::string name;
+    int fd;
+    size_t mappedBytes;
+    SharedFrameHeader *header;
+    SharedFrameSlot *writing;
+};
+
+// the reading end, included here so consumers can build against this header alone
+class SharedFrameReader
+{
+public:
+    SharedFrameReader();
+    virtual ~SharedFrameReader();
+
+    bool Open(const std::string &name);
+    void Close();
+
+    // block up to timeoutMs for a frame newer than the last one read
+    bool WaitForFrame(int timeoutMs);
+    // the newest complete slot, check it's still intact with Validate after reading from it
+    const SharedFrameSlot *Acquire(const uint8_t **color, const float **depth);
+    // true if the slot wasn't overwritten since Acquire, records drops and latency
+    bool Validate(const SharedFrameSlot *slot);
+
+    const SharedFrameHeader *GetHeader() { return header; }
+    // render to read (renderTimeNs to Validate), of the last validated frame
+    double GetLastLatencyMs() { return lastLatencyMs; }
+
+protected:
+    int fd;
+    size_t mappedBytes;
+    SharedFrameHeader *header;
+    uint64_t acquiredSequence;
+    uint64_t lastFrame;
+    bool haveFrame;
+    uint32_t lastPublishCount;
+    double lastLatencyMs;
+};
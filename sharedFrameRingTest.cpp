@@ -0,0 +1,162 @@
+#include "sharedFrameRing.h"
+#include "testing.h"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+namespace
+{
+    const uint32_t maxWidth = 4, maxHeight = 4;
+
+    // a name of its own per process so parallel runs don't share a ring
+    std::string RingName(const char *test)
+    {
+        return "/usdSimpleCppTest." + std::string(test) + "." + std::to_string((long)getpid());
+    }
+
+    // a frame whose pixels all hold its number, so a reader can tell which frame it's looking at
+    bool WriteFrame(SharedFrameWriter &writer, uint64_t frame, uint32_t width = maxWidth, uint32_t height = maxHeight)
+    {
+        uint8_t *color = nullptr;
+        float *depth = nullptr;
+        if (!writer.Begin(frame, SharedFrameWriter::NowNs(), width, height, width / 2, height / 2, &color, &depth))
+            return false;
+        std::memset(color, (int)(frame & 0xff), (size_t)width * height * 4);
+        for (uint32_t i = 0; i < (width / 2) * (height / 2); ++i)
+            depth[i] = (float)frame;
+        writer.Publish();
+        return true;
+    }
+
+    void TestReadsWhatWasPublished()
+    {
+        SharedFrameWriter writer;
+        CHECK(writer.Create(RingName("read"), 3, maxWidth, maxHeight));
+        SharedFrameReader reader;
+        CHECK(reader.Open(writer.GetName()));
+
+        const uint8_t *color = nullptr;
+        const float *depth = nullptr;
+        CHECK(!reader.WaitForFrame(0));
+        CHECK(reader.Acquire(&color, &depth) == nullptr);
+
+        CHECK(WriteFrame(writer, 7));
+        CHECK(reader.WaitForFrame(0));
+        const SharedFrameSlot *slot = reader.Acquire(&color, &depth);
+        CHECK(slot != nullptr);
+        if (!slot)
+            return;
+        CHECK(slot->frame == 7);
+        CHECK(slot->sequence.load() == 2 * (7 + 1));
+        CHECK(slot->width == maxWidth && slot->height == maxHeight);
+        CHECK(slot->depthWidth == maxWidth / 2 && slot->depthHeight == maxHeight / 2);
+        CHECK(slot->colorFormat == SharedFrame::FormatRGBA8 && slot->depthFormat == SharedFrame::FormatDepth32F);
+        CHECK(slot->publishTimeNs >= slot->renderTimeNs);
+        CHECK(color[0] == 7 && color[maxWidth * maxHeight * 4 - 1] == 7);
+        CHECK(depth[0] == 7.f);
+        CHECK(reader.Validate(slot));
+        CHECK(reader.GetLastLatencyMs() >= 0.0);
+        CHECK(reader.GetHeader()->consumed == 1);
+        CHECK(reader.GetHeader()->torn == 0);
+
+        // nothing new until the next publish
+        CHECK(!reader.WaitForFrame(0));
+    }
+
+    void TestOverwrittenReadIsTorn()
+    {
+        SharedFrameWriter writer;
+        CHECK(writer.Create(RingName("torn"), 3, maxWidth, maxHeight));
+        SharedFrameReader reader;
+        CHECK(reader.Open(writer.GetName()));
+
+        CHECK(WriteFrame(writer, 0));
+        const uint8_t *color = nullptr;
+        const float *depth = nullptr;
+        const SharedFrameSlot *slot = reader.Acquire(&color, &depth);
+        CHECK(slot != nullptr);
+        if (!slot)
+            return;
+
+        // a writer in the middle of the slot leaves its sequence odd
+        for (uint64_t frame = 1; frame < 3; ++frame)
+            CHECK(WriteFrame(writer, frame));
+        uint8_t *writeColor = nullptr;
+        float *writeDepth = nullptr;
+        CHECK(writer.Begin(3, SharedFrameWriter::NowNs(), maxWidth, maxHeight, 0, 0, &writeColor, &writeDepth));
+        CHECK((slot->sequence.load() & 1) == 1);
+        CHECK(!reader.Validate(slot));
+        CHECK(reader.GetHeader()->torn == 1);
+        CHECK(reader.GetHeader()->consumed == 0);
+
+        // and once it's done the slot holds the new frame, which reads cleanly
+        writer.Publish();
+        slot = reader.Acquire(&color, &depth);
+        CHECK(slot != nullptr && slot->frame == 3);
+        CHECK(slot && reader.Validate(slot));
+    }
+
+    void TestSlowReaderCountsDrops()
+    {
+        SharedFrameWriter writer;
+        CHECK(writer.Create(RingName("drops"), 3, maxWidth, maxHeight));
+        SharedFrameReader reader;
+        CHECK(reader.Open(writer.GetName()));
+
+        const uint8_t *color = nullptr;
+        const float *depth = nullptr;
+        CHECK(WriteFrame(writer, 0));
+        const SharedFrameSlot *slot = reader.Acquire(&color, &depth);
+        CHECK(slot && reader.Validate(slot));
+
+        // the reader only ever sees the newest frame, the two before it are gone
+        for (uint64_t frame = 1; frame <= 3; ++frame)
+            CHECK(WriteFrame(writer, frame));
+        slot = reader.Acquire(&color, &depth);
+        CHECK(slot != nullptr && slot->frame == 3);
+        CHECK(slot && reader.Validate(slot));
+        CHECK(color[0] == 3);
+        CHECK(reader.GetHeader()->dropped == 2);
+        CHECK(reader.GetHeader()->consumed == 2);
+        CHECK(reader.GetHeader()->published == 4);
+    }
+
+    void TestOversizedFramesAreNotPublished()
+    {
+        SharedFrameWriter writer;
+        CHECK(writer.Create(RingName("oversized"), 2, maxWidth, maxHeight));
+        CHECK(!WriteFrame(writer, 0, maxWidth * 2, maxHeight));
+        CHECK(writer.GetHeader()->oversized == 1);
+        CHECK(writer.GetHeader()->published == 0);
+
+        SharedFrameReader reader;
+        CHECK(reader.Open(writer.GetName()));
+        const uint8_t *color = nullptr;
+        const float *depth = nullptr;
+        CHECK(reader.Acquire(&color, &depth) == nullptr);
+    }
+
+    void TestClosedRingCantBeOpened()
+    {
+        std::string name;
+        {
+            SharedFrameWriter writer;
+            CHECK(writer.Create(RingName("closed"), 2, maxWidth, maxHeight));
+            name = writer.GetName();
+        }
+        SharedFrameReader reader;
+        CHECK(!reader.Open(name));
+    }
+}
+
+int main()
+{
+    TestReadsWhatWasPublished();
+    TestOverwrittenReadIsTorn();
+    TestSlowReaderCountsDrops();
+    TestOversizedFramesAreNotPublished();
+    TestClosedRingCantBeOpened();
+    return Testing::Result("sharedFrameRingTest");
+}
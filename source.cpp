@@ -1,7 +1,19 @@
 #include "renderer.h"
+#include "options.h"
+#include "memoryReport.h"
+#include "textureCache.h"
+#include "scene.h"
+#include "meshLod.h"
+#include "pointCloud.h"
+#include "renderQueue.h"
+#include "concurrency.h"
+#include "quantizedMesh.h"
+#include "stageCache.h"
+#include "stageSubset.h"
 
 #include <pxr/pxr.h>
 #include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usd/editContext.h>
 #include <pxr/usd/usdGeom/xform.h>
 #include <pxr/usd/usdGeom/sphere.h>
 #include <pxr/usd/usdGeom/mesh.h>
@@ -11,230 +23,258 @@
 #include <pxr/usd/usdShade/shader.h>
 #include <pxr/usd/usdHydra/tokens.h>
 
+#include <chrono>
+#include <cmath>
 #include <iostream>
 
-pxr::UsdGeomMesh createMesh(pxr::UsdStageRefPtr stage, const std::string &meshName, pxr::VtVec3fArray &points, pxr::VtArray<int> &faceVertexCounts, pxr::VtArray<int> &faceVertexIndices, pxr::VtVec3fArray& normals)
+int main(int argc, char **argv)
 {
-    // find the geometric extents of the mesh
-    pxr::VtVec3fArray extent(2);
-    extent[0] = points[0];
-    extent[1] = points[0];
-    for( auto &pt : points )
+    AppOptions options;
+    if( !ParseOptions(argc, argv, options) )
+        return 1;
+
+    // malloc tags have to be enabled before USD starts allocating to be of any use
+    if( options.memoryReport )
+        EnableMallocTags();
+
+    // one thread budget for USD and our own jobs, set before anything starts a thread so they all inherit the pinning
+    ConcurrencySettings concurrency;
+    concurrency.threads = options.threads;
+    concurrency.firstCore = options.pinCores;
+    ReadConcurrencyEnvironment(concurrency);
+    ConfigureConcurrency(concurrency);
+
+    if( !options.textureFile.empty() )
     {
-        for( int i=0; i<3; ++i )
+        std::cout << "Using specified texture filename: " << options.textureFile << std::endl;
+    }
+
+    // the driver only hands out views, the copies of this process it starts do the rendering
+    if( options.workers > 0 && options.workerSocket.empty() )
+    {
+        if( options.batchDirectory.empty() )
         {
-            extent[0][i]=std::min(pt[0], extent[0][i]);
-            extent[1][i]=std::max(pt[0], extent[1][i]);
+            std::cerr << "--workers needs a --batch directory" << std::endl;
+            return 1;
         }
+        // workers share one stage on disk, authoring the scene would have each of them write helloWorld.usda
+        if( options.stageFile.empty() )
+        {
+            std::cerr << "--workers needs a --stage to render" << std::endl;
+            return 1;
+        }
+        RenderDriver driver;
+        driver.SetConcurrency(concurrency);
+        return driver.Run(argc, argv, options.workers, std::cout) ? 0 : 1;
     }
 
-    // create the mesh and set its points, face vertex counts (number of vertices for each face) and face vertex indices
-    auto mesh = pxr::UsdGeomMesh::Define(stage, pxr::SdfPath("/" + meshName));
-
-    mesh.GetPointsAttr().Set(points);
-    mesh.GetNormalsAttr().Set(normals);
-    mesh.GetFaceVertexCountsAttr().Set(faceVertexCounts);
-    mesh.GetFaceVertexIndicesAttr().Set(faceVertexIndices);
-
-    // set geometric extents
-    mesh.GetExtentAttr().Set(extent);
-
-    mesh.GetDoubleSidedAttr().Set(true);
-
-    return mesh;
-}
-
-pxr::UsdGeomMesh createMesh(pxr::UsdStageRefPtr stage, const std::string &primName, pxr::VtVec3fArray &points, pxr::VtArray<int> &faceVertexCounts, pxr::VtArray<int> &faceVertexIndices, pxr::VtVec2fArray &texCoordArray, pxr::VtVec3fArray &normals)
-{
-    auto mesh = createMesh(stage, primName, points, faceVertexCounts, faceVertexIndices, normals);
-
-    // add a new primvar for texture coordinates that we can reference in the shader
-    auto texCoords = mesh.CreatePrimvar(pxr::TfToken("st"), pxr::SdfValueTypeNames->TexCoord2fArray, pxr::UsdGeomTokens->varying);
-
-    // set the texture coords
-    texCoords.Set(texCoordArray);
-
-    return mesh;
-}
-
-pxr::UsdShadeShader createPBRShader(pxr::UsdStageRefPtr stage, pxr::UsdGeomMesh &mesh, const float roughness, const float metallic, const std::string &textureFile)
-{
-    // create path hierarchy
-    auto path = mesh.GetPrim().GetPrimPath();
-    auto materialPath = path.AppendPath(pxr::SdfPath("material"));
-    auto pbrShaderPath = materialPath.AppendPath(pxr::SdfPath("PBRShader"));
-    
-    auto material = pxr::UsdShadeMaterial::Define(stage, materialPath);
-    
-    // create the basic PBR shader and set params
-    auto pbrShader = pxr::UsdShadeShader::Define(stage, pbrShaderPath);
-    pbrShader.CreateIdAttr(pxr::VtValue(pxr::TfToken("UsdPreviewSurface")));
-    pbrShader.CreateInput(pxr::TfToken("roughness"), pxr::SdfValueTypeNames->Float).Set(roughness);
-    pbrShader.CreateInput(pxr::TfToken("metallic"), pxr::SdfValueTypeNames->Float).Set(metallic);
+    GLRenderer renderer;
+    renderer.SetMemoryReportOnFirstFrame(options.memoryReport);
+    renderer.SetFrameBudget(options.frameBudgetMs, options.minResolutionScale);
+    renderer.SetMotionAdaptiveQuality(options.motionAdaptiveQuality);
+    renderer.SetTurntable((uint32_t)options.turntableFrames);
+    renderer.SetStageCache(options.stageCache, options.stageCacheDirectory);
+    renderer.SetPickReport(options.pickReport);
+
+    CaptureSettings capture;
+    capture.directory = options.captureDirectory;
+    capture.aovs = options.captureAovs;
+    // a turntable capture stops once it's come full circle
+    capture.frameCount = options.captureFrames > 0 ? options.captureFrames : options.turntableFrames;
+    renderer.SetCapture(capture);
+
+    ExportSettings exportSettings;
+    exportSettings.name = options.exportName;
+    renderer.SetFrameExport(exportSettings);
+
+    BatchSettings batch;
+    batch.directory = options.batchDirectory;
+    batch.orbitViews = options.batchViews;
+    batch.width = batch.height = options.batchSize;
+    batch.tiled = options.batchTiled;
+    batch.workerSocket = options.workerSocket;
+    // each worker only sees its share of the views
+    if( batch.tiled && !batch.workerSocket.empty() )
+    {
+        std::cerr << "Contact sheets aren't supported with --workers, writing an image per view" << std::endl;
+        batch.tiled = false;
+    }
+    renderer.SetBatch(batch);
 
-    // connect the pbr shader to the material
-    material.CreateSurfaceOutput().ConnectToSource(pbrShader.ConnectableAPI(), pxr::TfToken("surface"));
+    ComputeBenchmarkSettings computeBenchmark;
+    computeBenchmark.frames = options.computeBenchFrames;
+    computeBenchmark.gridSize = options.computeGrid;
+    renderer.SetComputeBenchmark(computeBenchmark);
 
-    // bind material to the mesh
-    pxr::UsdShadeMaterialBindingAPI(mesh).Bind(material);
+    PointCloudBenchmarkSettings pointCloudBenchmark;
+    pointCloudBenchmark.frames = options.pointBenchFrames;
+    pointCloudBenchmark.maxPoints = options.pointBenchMax;
+    pointCloudBenchmark.chunkPoints = options.pointChunk;
+    renderer.SetPointCloudBenchmark(pointCloudBenchmark);
 
-    if( textureFile.empty() ) // texturing?
+    std::string primName("cube");
+    pxr::UsdStageRefPtr usdStage;
+    // layers authored in parallel, composed as sublayers of the root until they're exported on save
+    std::vector<pxr::SdfLayerRefPtr> layerParts;
+    PointCloud pointCloud;
+    if( !options.stageFile.empty() )
     {
-        // if not then just set a red material
-        auto clr = pxr::GfVec3f(1.0f, 1.0f, 1.0f);
-        pbrShader.CreateInput(pxr::TfToken("diffuseColor"), pxr::SdfValueTypeNames->Color3f).Set(clr);
-    }else{
-        // first create the reader
-        auto stReaderPath = materialPath.AppendPath(pxr::SdfPath("stReader"));
-        auto stReader = pxr::UsdShadeShader::Define(stage, stReaderPath);
-        stReader.CreateIdAttr(pxr::VtValue(pxr::TfToken("UsdPrimvarReader_float2")));
-
-        // create the texture sampler
-        auto diffuseTextureSamplerPath = materialPath.AppendPath(pxr::SdfPath("diffuseTexture"));
-        auto diffuseTextureSampler = pxr::UsdShadeShader::Define(stage, diffuseTextureSamplerPath);
-        diffuseTextureSampler.CreateIdAttr(pxr::VtValue(pxr::TfToken("UsdUVTexture")));
-        diffuseTextureSampler.CreateInput(pxr::TfToken("file"), pxr::SdfValueTypeNames->Asset).Set(pxr::SdfAssetPath(textureFile));
-        diffuseTextureSampler.CreateInput(pxr::TfToken("st"), pxr::SdfValueTypeNames->Float2).ConnectToSource(stReader.ConnectableAPI(), pxr::TfToken("result"));
-
-        // this bit is important...by default it will use LINEAR_MIPMAP_LINEAR (for some reason usdview doesn't require this though), thanks RenderDoc :)
-        diffuseTextureSampler.CreateInput(pxr::UsdHydraTokens->minFilter, pxr::SdfValueTypeNames->Token).Set(pxr::UsdHydraTokens->linear);
-
-        // attach the output of the sampler to the pbr shader's diffuseColor
-        diffuseTextureSampler.CreateOutput(pxr::TfToken("rgb"), pxr::SdfValueTypeNames->Float3);
-        pbrShader.CreateInput(pxr::TfToken("diffuseColor"), pxr::SdfValueTypeNames->Color3f).ConnectToSource(diffuseTextureSampler.ConnectableAPI(), pxr::TfToken("rgb"));
-
-        // connect everything together
-        auto stInput = material.CreateInput(pxr::TfToken("frame:stPrimvarName"), pxr::SdfValueTypeNames->Token);
-        stInput.Set(pxr::TfToken("st"));
-
-        stReader.CreateInput(pxr::TfToken("varname"), pxr::SdfValueTypeNames->Token).ConnectToSource(stInput);
+        PhaseTimer timer("open");
+        StageSubset subset;
+        subset.paths = options.maskPaths;
+        subset.primTypes = options.primTypes;
+        StageCache stageCache(options.stageCacheDirectory);
+        if( !subset.IsEmpty() )
+        {
+            StageSubsetReport subsetReport;
+            usdStage = OpenStageSubset(options.stageFile, subset, options.stageCache ? &stageCache : nullptr, subsetReport);
+            if( usdStage )
+                PrintStageSubsetReport(subsetReport, std::cout);
+        }
+        else if( options.stageCache )
+        {
+            StageCacheReport stageCacheReport;
+            usdStage = stageCache.Open(options.stageFile, &stageCacheReport);
+            if( usdStage )
+                PrintStageCacheReport(stageCacheReport, std::cout);
+        }
+        else
+            usdStage = pxr::UsdStage::Open(options.stageFile);
+        if( !usdStage )
+        {
+            std::cerr << "Unable to open stage " << options.stageFile << std::endl;
+            return 1;
+        }
     }
-
-    return pbrShader;
-}
-
-pxr::SdfLayerRefPtr cube(const std::string &primName, const std::string textureFile)
-{
-    // indices for cube triangles
-    pxr::VtArray<int> faceIndices = {
-        0, 1, 2, 0, 2, 3,
-        4, 5, 6, 4, 6, 7,
-        8, 9, 10, 8, 10, 11,
-        12, 13, 14, 12, 14, 15,
-        16, 17, 18, 16, 18, 19,
-        20, 21, 22, 20, 22, 23
-    };
-
-    // all faces are triangles
-    pxr::VtArray<int> faceIndexCounts = {
-        3,3,3,3,3,3,3,3,3,3,3,3
-    };
-    
-    // 24 points for a cube? well yes because they have distinct normals
-    pxr::VtVec3fArray cube(24);
-    cube[ 0] = pxr::GfVec3f( 1.f, -1.f, -1.f);
-    cube[ 1] = pxr::GfVec3f( 1.f, -1.f,  1.f);
-    cube[ 2] = pxr::GfVec3f(-1.f, -1.f,  1.f);
-    cube[ 3] = pxr::GfVec3f(-1.f, -1.f, -1.f);
-    cube[ 4] = pxr::GfVec3f( 1.f,  1.f, -1.f);
-    cube[ 5] = pxr::GfVec3f(-1.f,  1.f, -1.f);
-    cube[ 6] = pxr::GfVec3f(-1.f,  1.f,  1.f);
-    cube[ 7] = pxr::GfVec3f( 1.f,  1.f,  1.f);
-    cube[ 8] = pxr::GfVec3f( 1.f, -1.f, -1.f);
-    cube[ 9] = pxr::GfVec3f( 1.f,  1.f, -1.f);
-    cube[10] = pxr::GfVec3f( 1.f,  1.f,  1.f);
-    cube[11] = pxr::GfVec3f( 1.f, -1.f,  1.f);
-    cube[12] = pxr::GfVec3f( 1.f, -1.f,  1.f);
-    cube[13] = pxr::GfVec3f( 1.f,  1.f,  1.f);
-    cube[14] = pxr::GfVec3f(-1.f,  1.f,  1.f);
-    cube[15] = pxr::GfVec3f(-1.f, -1.f,  1.f);
-    cube[16] = pxr::GfVec3f(-1.f, -1.f,  1.f);
-    cube[17] = pxr::GfVec3f(-1.f,  1.f,  1.f);
-    cube[18] = pxr::GfVec3f(-1.f,  1.f, -1.f);
-    cube[19] = pxr::GfVec3f(-1.f, -1.f, -1.f);
-    cube[20] = pxr::GfVec3f( 1.f,  1.f, -1.f);
-    cube[21] = pxr::GfVec3f( 1.f, -1.f, -1.f);
-    cube[22] = pxr::GfVec3f(-1.f, -1.f, -1.f);
-    cube[23] = pxr::GfVec3f(-1.f,  1.f, -1.f);
-
-    pxr::VtVec3fArray normals(24);
-    for (size_t i = 0; i < 24; i += 3)
+    else
     {
-        glm::vec3 p0 = glm::vec3(cube[i + 0].data()[0], cube[i + 0].data()[1], cube[i + 0].data()[2]);
-        glm::vec3 p1 = glm::vec3(cube[i + 1].data()[0], cube[i + 1].data()[1], cube[i + 1].data()[2]);
-        glm::vec3 p2 = glm::vec3(cube[i + 2].data()[0], cube[i + 2].data()[1], cube[i + 2].data()[2]);
-
-        auto n = glm::cross(glm::normalize(p0 - p1), glm::normalize(p0 - p2));
-
-        normals[i + 0] = pxr::GfVec3f(n.x, n.y, n.z);
-        normals[i + 1] = pxr::GfVec3f(n.x, n.y, n.z);
-        normals[i + 2] = pxr::GfVec3f(n.x, n.y, n.z);
+        usdStage = pxr::UsdStage::CreateNew("helloWorld.usda");
+
+        // create cube geometry and material on anonymous layer
+        PhaseTimer timer("authoring");
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        pxr::SdfLayerRefPtr cubeLayer;
+        IngestReport ingest;
+        // a cloud is far too big for the usda, it gets a sublayer of its own that's written as usdc on save
+        if( options.pointCount > 0 )
+            layerParts.push_back(pxr::SdfLayer::CreateAnonymous("points.usdc"));
+        else if( options.cubeCount > 0 && options.authorLayers > 0 )
+            layerParts = cubeLayers(primName, options.cubeCount, options.authorLayers, options.textureFile, options.optimizeMeshes, options.foreignBuffers, &ingest);
+        else if( options.cubeCount > 0 )
+            cubeLayer = cubes(primName, options.cubeCount, options.textureFile, options.optimizeMeshes, options.foreignBuffers, &ingest);
+        else
+            cubeLayer = cube(primName, options.textureFile, options.optimizeMeshes, options.foreignBuffers, &ingest);
+        if( options.ingestReport && options.pointCount == 0 )
+            PrintIngestReport(primName, ingest, std::cout);
+
+        // compose the parallel layers as they are rather than copying them, otherwise transfer content to the root
+        // layer of the stage
+        if( layerParts.empty() )
+            usdStage->GetRootLayer()->TransferContent(cubeLayer);
+        for( const auto &layer : layerParts )
+            usdStage->GetRootLayer()->InsertSubLayerPath(layer->GetIdentifier());
+        if( options.pointCount > 0 )
+        {
+            pxr::VtVec3fArray points, colors;
+            MakePointCloud(options.pointCount, points, colors);
+            PointCloudSettings pointSettings;
+            pointSettings.chunkPoints = options.pointChunk;
+            pointSettings.density = options.pointDensity;
+            // about the spacing of the points, the cloud covers two units across
+            pxr::VtFloatArray widths(1, 2.f / std::sqrt((float)options.pointCount));
+            pxr::UsdEditContext editContext(usdStage, layerParts.back());
+            if( pointCloud.Author(usdStage, pxr::SdfPath("/points"), points, widths, colors, pointSettings) )
+                PrintPointCloudReport(pointCloud.GetReport(), std::cout);
+        }
+        std::cout << "Built the scene in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count()
+                  << " ms" << (layerParts.empty() ? "" : " across " + std::to_string(layerParts.size()) + " layers") << std::endl;
     }
 
-    // tex coords...if a texture was specified we'll need these
-    pxr::VtVec2fArray texCoords(24);
-    texCoords[ 0] = pxr::GfVec2f( 0.f,  0.f);
-    texCoords[ 1] = pxr::GfVec2f( 1.f,  0.f);
-    texCoords[ 2] = pxr::GfVec2f( 1.f,  1.f);
-    texCoords[ 3] = pxr::GfVec2f( 0.f,  1.f);
-    texCoords[ 4] = pxr::GfVec2f( 0.f,  0.f);
-    texCoords[ 5] = pxr::GfVec2f( 1.f,  0.f);
-    texCoords[ 6] = pxr::GfVec2f( 1.f,  1.f);
-    texCoords[ 7] = pxr::GfVec2f( 0.f,  1.f);
-    texCoords[ 8] = pxr::GfVec2f( 0.f,  0.f);
-    texCoords[ 9] = pxr::GfVec2f( 1.f,  0.f);
-    texCoords[10] = pxr::GfVec2f( 1.f,  1.f);
-    texCoords[11] = pxr::GfVec2f( 0.f,  1.f);
-    texCoords[12] = pxr::GfVec2f( 0.f,  0.f);
-    texCoords[13] = pxr::GfVec2f( 1.f,  0.f);
-    texCoords[14] = pxr::GfVec2f( 1.f,  1.f);
-    texCoords[15] = pxr::GfVec2f( 0.f,  1.f);
-    texCoords[16] = pxr::GfVec2f( 0.f,  0.f);
-    texCoords[17] = pxr::GfVec2f( 1.f,  0.f);
-    texCoords[18] = pxr::GfVec2f( 1.f,  1.f);
-    texCoords[19] = pxr::GfVec2f( 0.f,  1.f);
-    texCoords[20] = pxr::GfVec2f( 0.f,  0.f);
-    texCoords[21] = pxr::GfVec2f( 1.f,  0.f);
-    texCoords[22] = pxr::GfVec2f( 1.f,  1.f);
-    texCoords[23] = pxr::GfVec2f( 0.f,  1.f);
-
-    // create an anonymous layer in which to create the geometry
-    auto layer = pxr::SdfLayer::CreateAnonymous(primName + ".usda");
-    auto stage = pxr::UsdStage::Open(layer);
-
-    auto mesh = createMesh(stage, primName, cube, faceIndexCounts, faceIndices, texCoords, normals);
-    
-    auto pbrShader = createPBRShader(stage, mesh, 0.4f, 0.f, textureFile);
+    // a stage saved with only the encoded geometry is decoded onto the session layer to draw it, --quantize writes such
+    // a copy of this one and leaves the stage drawn and saved here with its floats
+    QuantizeSettings quantizeSettings;
+    if( options.quantizeNormals == "half" )
+        quantizeSettings.normals = NormalEncoding::Half;
+    else if( options.quantizeNormals == "float" )
+        quantizeSettings.normals = NormalEncoding::Float;
+    else if( !options.quantizeNormals.empty() && options.quantizeNormals != "octahedral" )
+    {
+        std::cerr << "Unknown normal encoding " << options.quantizeNormals << ", expected octahedral, half or float" << std::endl;
+        return 1;
+    }
+    QuantizeReport quantizeReport;
+    bool decoded = DecodeQuantizedMeshes(usdStage, &quantizeReport) > 0;
+    if( !options.quantizeFile.empty() && ExportQuantizedStage(usdStage, options.quantizeFile, quantizeSettings, quantizeReport) )
+        std::cout << "Wrote the quantized geometry to " << options.quantizeFile << std::endl;
+    if( decoded || quantizeReport.meshes > 0 )
+        PrintQuantizeReport(quantizeReport, std::cout);
+    if( options.quantizeBenchIterations > 0 )
+    {
+        QuantizeBenchmark quantizeBenchmark;
+        if( BenchmarkQuantizedGeometry(usdStage, quantizeSettings, options.quantizeBenchIterations, quantizeBenchmark) )
+            PrintQuantizeBenchmark(quantizeBenchmark, std::cout);
+    }
 
-    return layer;
-}
+    // replace each mesh's geometry with an LOD variant set, the selector picks levels from the camera every frame
+    LodSelector lodSelector;
+    if( options.lodLevels > 0 )
+    {
+        MeshLodSettings lodSettings;
+        lodSettings.levels = options.lodLevels;
+        // gather the meshes first, adding variant sets recomposes the prims and would invalidate the traversal
+        std::vector<pxr::UsdGeomMesh> meshes;
+        for( const auto &prim : usdStage->Traverse() )
+        {
+            if( prim.IsA<pxr::UsdGeomMesh>() )
+                meshes.push_back(pxr::UsdGeomMesh(prim));
+        }
+        size_t variantCount = 0;
+        for( auto &mesh : meshes )
+            variantCount += AuthorMeshLODs(mesh, lodSettings);
+        std::cout << "Authored " << variantCount << " LOD variants for " << meshes.size() << " meshes" << std::endl;
 
-pxr::SdfLayerRefPtr cube(const std::string &primName)
-{
-    return cube(primName, "");
-}
+        lodSelector.SetPixelThreshold(options.lodPixelError);
+        renderer.AddFrameCallback([&renderer, &lodSelector]()
+        {
+            auto &camera = renderer.GetCamera();
+            lodSelector.Update(renderer.GetUsdStage(), camera.GetPosition(), renderer.GetProjectionMatrix(), camera.GetScreenDimensions().w);
+        });
+    }
 
-int main(int argc, char **argv)
-{
-    if( argc == 2 )
+    // distant chunks of the cloud draw a stratified subset of their points, chosen from the camera every frame
+    if( options.pointDensity > 0.f && pointCloud.GetChunkCount() > 0 )
     {
-        std::cout << "Using specified texture filename: " << argv[1] << std::endl;
+        renderer.AddFrameCallback([&renderer, &pointCloud]()
+        {
+            auto &camera = renderer.GetCamera();
+            pointCloud.Decimate(camera.GetPosition(), renderer.GetProjectionMatrix(), camera.GetScreenDimensions().w);
+        });
     }
 
-    GLRenderer renderer;
-
-    auto usdStage = pxr::UsdStage::CreateNew("helloWorld.usda");
-    
-    // create cube geometry and material on anonymous layer
-    std::string primName("cube");
-    auto cubeLayer = argc != 2 ? cube(primName) : cube(primName, argv[1]);
-
-    // transfer content to the root layer of the stage
-    usdStage->GetRootLayer()->TransferContent(cubeLayer);
+    // show a cached preview of the texture while the source loads, only for the textures authored here, an opened stage
+    // keeps its own
+    TextureCache textureCache(options.textureCacheDirectory);
+    TextureStreamer textureStreamer(textureCache);
+    if( !options.textureFile.empty() && options.textureCache && options.stageFile.empty() )
+    {
+        for( const auto &prim : usdStage->Traverse() )
+        {
+            pxr::UsdShadeShader textureShader(prim);
+            pxr::TfToken shaderId;
+            if( !textureShader || !textureShader.GetShaderId(&shaderId) || shaderId != pxr::TfToken("UsdUVTexture") )
+                continue;
+            pxr::SdfAssetPath file;
+            auto fileInput = textureShader.GetInput(pxr::TfToken("file"));
+            if( !fileInput || !fileInput.Get(&file) || file.GetAssetPath() != options.textureFile )
+                continue;
+            textureStreamer.Request(textureShader, options.textureFile);
+        }
+        renderer.AddFrameCallback([&textureStreamer]() { textureStreamer.Update(); });
+    }
 
     // get the extents of the geometry
     auto prim = usdStage->GetPrimAtPath(pxr::SdfPath("/" + primName));
-    if( auto extentAttr = prim.GetAttribute(pxr::UsdGeomTokens->extent) )
+    if( auto extentAttr = prim ? prim.GetAttribute(pxr::UsdGeomTokens->extent) : pxr::UsdAttribute() )
     {
         pxr::VtVec3fArray extentArray(2);
         extentAttr.Get(&extentArray);
@@ -247,7 +287,14 @@ int main(int argc, char **argv)
     renderer.CreateGLWindow(1280, 720);
     renderer.BeginRender();
 
-    // save stage to file
-    usdStage->Save();
+    // save stage to file, a stage that was opened is left as it was
+    if( options.stageFile.empty() )
+    {
+        if( !layerParts.empty() )
+            exportSublayers(usdStage->GetRootLayer(), layerParts);
+        usdStage->Save();
+    }
+    if( options.concurrencyReport )
+        PrintConcurrencyReport(std::cout);
     return 0;
 }
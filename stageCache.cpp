@@ -0,0 +1,350 @@
+#include "stageCache.h"
+
+#include <pxr/base/arch/hash.h>
+#include <pxr/base/arch/systemInfo.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/getenv.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/usd/stageCacheContext.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+    const char *manifestHeader = "usdSimpleCpp stage cache 2";
+    // ends the key in the manifest, the layer stamps follow
+    const char *manifestLayers = "layers";
+
+    struct FileStamp
+    {
+        FileStamp() : size(0), modified(0) {}
+        bool operator==(const FileStamp &other) const { return size == other.size && modified == other.modified; }
+
+        unsigned long long size;
+        long long modified;
+    };
+
+    bool ReadStamp(const std::string &path, FileStamp &stamp)
+    {
+        std::error_code error;
+        auto size = std::filesystem::file_size(path, error);
+        if (error)
+            return false;
+        auto modified = std::filesystem::last_write_time(path, error);
+        if (error)
+            return false;
+        stamp.size = (unsigned long long)size;
+        stamp.modified = (long long)modified.time_since_epoch().count();
+        return true;
+    }
+
+    // rename over an existing file, which std::rename doesn't do everywhere
+    bool Replace(const std::string &from, const std::string &to)
+    {
+        std::error_code error;
+        std::filesystem::rename(from, to, error);
+        if (!error)
+            return true;
+        std::cerr << "Unable to move " << from << " to " << to << ": " << error.message() << std::endl;
+        std::filesystem::remove(from, error);
+        return false;
+    }
+
+    // a suffix no other process writing the same entry will pick
+    std::string TempSuffix()
+    {
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), ".%08x", (unsigned)std::random_device()());
+        return suffix;
+    }
+
+    // the key's variant selections as opinions on a session layer of their own
+    pxr::SdfLayerRefPtr SelectionLayer(const StageCacheKey &key)
+    {
+        auto layer = pxr::SdfLayer::CreateAnonymous("stageCacheSelections.usda");
+        for (const auto &prim : key.variants)
+        {
+            auto spec = pxr::SdfCreatePrimInLayer(layer, prim.first);
+            for (const auto &selection : prim.second)
+                spec->SetVariantSelection(selection.first, selection.second);
+        }
+        return layer;
+    }
+
+    // the original stage as the key asks for it
+    pxr::UsdStageRefPtr Compose(const std::string &rootFile, const StageCacheKey &key, const pxr::UsdStagePopulationMask *mask)
+    {
+        auto rootLayer = pxr::SdfLayer::FindOrOpen(rootFile);
+        if (!rootLayer)
+            return nullptr;
+        auto sessionLayer = key.variants.empty() ? pxr::SdfLayer::CreateAnonymous() : SelectionLayer(key);
+        return mask ? pxr::UsdStage::OpenMasked(rootLayer, sessionLayer, *mask, key.load)
+                    : pxr::UsdStage::Open(rootLayer, sessionLayer, key.load);
+    }
+
+    double MsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
+
+std::string StageCacheKey::ToString() const
+{
+    std::string text = load == pxr::UsdStage::LoadAll ? "load all\n" : "load none\n";
+    for (const auto &prim : variants)
+    {
+        for (const auto &selection : prim.second)
+            text += "select " + prim.first.AppendVariantSelection(selection.first, selection.second).GetString() + "\n";
+    }
+    return text;
+}
+
+StageCache::StageCache(const std::string &cacheDirectory)
+    : directory(cacheDirectory)
+{
+    if (directory.empty())
+        directory = pxr::TfGetenv("USDSIMPLECPP_STAGE_CACHE");
+    if (directory.empty())
+    {
+        std::string home = pxr::TfGetenv("HOME");
+        if (home.empty())
+            home = pxr::TfGetenv("LOCALAPPDATA");
+        directory = home.empty() ? pxr::TfStringCatPaths(pxr::ArchGetTmpDir(), "usdSimpleCpp/stages")
+                                 : pxr::TfStringCatPaths(home, ".cache/usdSimpleCpp/stages");
+    }
+}
+
+pxr::UsdStageCache &StageCache::GetStages()
+{
+    static pxr::UsdStageCache stages;
+    return stages;
+}
+
+std::string StageCache::EntryPath(const std::string &rootFile, const StageCacheKey &key, const std::string &extension)
+{
+    // the name is only there to find an entry by eye, the hash of the whole path and the key keeps them apart
+    auto hashed = rootFile + "\n" + key.ToString();
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)pxr::ArchHash64(hashed.data(), hashed.size()));
+    auto name = pxr::TfStringGetBeforeSuffix(pxr::TfGetBaseName(rootFile));
+    return pxr::TfStringCatPaths(directory, name + "-" + hash + extension);
+}
+
+bool StageCache::IsValid(const std::string &rootFile, const StageCacheKey &key, std::string &reason)
+{
+    std::ifstream manifest(EntryPath(rootFile, key, ".txt"));
+    if (!manifest.is_open() || !pxr::TfIsFile(EntryPath(rootFile, key, ".usdc")))
+    {
+        reason = key.IsDefault() ? "not cached yet" : "not cached yet with these selections";
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(manifest, line) || line != manifestHeader || !std::getline(manifest, line) || line != rootFile)
+    {
+        reason = "cached by another version or for another file";
+        return false;
+    }
+    std::string cachedKey;
+    while (std::getline(manifest, line) && line != manifestLayers)
+        cachedKey += line + "\n";
+    if (line != manifestLayers || cachedKey != key.ToString())
+    {
+        reason = "cached with other selections";
+        return false;
+    }
+    while (std::getline(manifest, line))
+    {
+        std::istringstream fields(line);
+        FileStamp cached, current;
+        fields >> cached.size >> cached.modified;
+        std::string path;
+        if (!fields || !std::getline(fields >> std::ws, path))
+        {
+            reason = "the manifest is damaged";
+            return false;
+        }
+        if (!ReadStamp(path, current))
+        {
+            reason = path + " is missing";
+            return false;
+        }
+        if (!(current == cached))
+        {
+            reason = path + " has changed";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StageCache::Write(const pxr::UsdStageRefPtr &stage, const std::string &rootFile, const StageCacheKey &key, StageCacheReport &report)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // stamp the layers before flattening, an edit made while we write then invalidates the entry instead of being lost
+    std::vector<std::pair<std::string, FileStamp>> layers;
+    for (const auto &layer : stage->GetUsedLayers())
+    {
+        // the session layer, its selections are in the key
+        if (layer->IsAnonymous())
+            continue;
+        FileStamp stamp;
+        if (layer->GetRealPath().empty() || !ReadStamp(layer->GetRealPath(), stamp))
+        {
+            std::cerr << "Not caching " << rootFile << ", " << layer->GetIdentifier() << " isn't a file" << std::endl;
+            return false;
+        }
+        layers.emplace_back(layer->GetRealPath(), stamp);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        std::cerr << "Unable to create the stage cache " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    // other processes may be writing the same entry, each writes its own temporary files and the last rename wins
+    auto flattenedFile = EntryPath(rootFile, key, ".usdc");
+    auto manifestFile = EntryPath(rootFile, key, ".txt");
+    auto suffix = TempSuffix();
+    auto flattenedTemp = EntryPath(rootFile, key, suffix + ".tmp.usdc");
+    auto manifestTemp = EntryPath(rootFile, key, suffix + ".tmp.txt");
+    auto flattened = stage->Flatten(false);
+    if (!flattened || !flattened->Export(flattenedTemp))
+    {
+        std::cerr << "Unable to flatten " << rootFile << " into " << flattenedFile << std::endl;
+        std::filesystem::remove(flattenedTemp, error);
+        return false;
+    }
+
+    // the old manifest goes first so a copy is never paired with a manifest that wasn't written for it
+    std::filesystem::remove(manifestFile, error);
+    if (!Replace(flattenedTemp, flattenedFile))
+        return false;
+    // a stale copy opened earlier in this process is still registered, pick up the new contents
+    if (auto existing = pxr::SdfLayer::Find(flattenedFile))
+        existing->Reload(true);
+
+    {
+        std::ofstream manifest(manifestTemp, std::ios::trunc);
+        manifest << manifestHeader << "\n" << rootFile << "\n" << key.ToString() << manifestLayers << "\n";
+        for (const auto &layer : layers)
+            manifest << layer.second.size << " " << layer.second.modified << " " << layer.first << "\n";
+        if (!manifest)
+        {
+            std::cerr << "Unable to write " << manifestFile << std::endl;
+            std::filesystem::remove(manifestTemp, error);
+            return false;
+        }
+    }
+    if (!Replace(manifestTemp, manifestFile))
+        return false;
+
+    report.written = true;
+    report.layers = layers.size();
+    report.writeMs = MsSince(start);
+    return true;
+}
+
+pxr::UsdStageRefPtr StageCache::Open(const std::string &stageFile, StageCacheReport *report, const StageCacheKey &key)
+{
+    StageCacheReport local;
+    auto &result = report ? *report : local;
+    result = StageCacheReport();
+    result.file = stageFile;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto rootFile = pxr::TfAbsPath(stageFile);
+    result.hit = IsValid(rootFile, key, result.reason);
+
+    // a stage with the same root layer already in the cache is returned instead of opening another. the copy
+    // already has the key's selections in it, the original only matches them without a session layer of its own
+    auto &stages = GetStages();
+    size_t cached = stages.Size();
+    pxr::UsdStageRefPtr stage;
+    if (result.hit || key.IsDefault())
+    {
+        pxr::UsdStageCacheContext context(stages);
+        stage = pxr::UsdStage::Open(result.hit ? EntryPath(rootFile, key, ".usdc") : rootFile);
+        result.shared = stage && stages.Size() == cached;
+    }
+    else
+        stage = Compose(rootFile, key, nullptr);
+    result.openMs = MsSince(start);
+    if (!stage)
+        return stage;
+
+    if (!result.hit && !result.shared)
+        Write(stage, rootFile, key, result);
+    return stage;
+}
+
+pxr::UsdStageRefPtr StageCache::OpenMasked(const std::string &stageFile, const pxr::UsdStagePopulationMask &mask, StageCacheReport *report,
+                                           const StageCacheKey &key)
+{
+    StageCacheReport local;
+    auto &result = report ? *report : local;
+    result = StageCacheReport();
+    result.file = stageFile;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto rootFile = pxr::TfAbsPath(stageFile);
+    result.hit = IsValid(rootFile, key, result.reason);
+    auto stage = result.hit ? pxr::UsdStage::OpenMasked(EntryPath(rootFile, key, ".usdc"), mask) : Compose(rootFile, key, &mask);
+    result.openMs = MsSince(start);
+    return stage;
+}
+
+bool StageCache::Invalidate(const std::string &stageFile)
+{
+    // every key of the file has an entry with the same name in front of its hash, the manifests tell which are its own
+    auto rootFile = pxr::TfAbsPath(stageFile);
+    auto prefix = pxr::TfStringGetBeforeSuffix(pxr::TfGetBaseName(rootFile)) + "-";
+    std::vector<std::filesystem::path> entries;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(directory, error))
+    {
+        auto name = entry.path().filename().string();
+        if (!pxr::TfStringStartsWith(name, prefix) || entry.path().extension() != ".txt" || pxr::TfStringContains(name, ".tmp."))
+            continue;
+        std::ifstream manifest(entry.path());
+        std::string header, file;
+        if (std::getline(manifest, header) && std::getline(manifest, file) && file == rootFile)
+            entries.push_back(entry.path());
+    }
+
+    bool removed = false;
+    for (auto manifest : entries)
+    {
+        removed = std::filesystem::remove(manifest, error) || removed;
+        removed = std::filesystem::remove(manifest.replace_extension(".usdc"), error) || removed;
+    }
+    return removed;
+}
+
+void PrintStageCacheReport(const StageCacheReport &report, std::ostream &out)
+{
+    if (report.shared)
+        out << "Shared the open stage " << report.file << std::endl;
+    else if (report.hit)
+        out << "Opened " << report.file << " from the stage cache in " << report.openMs << " ms" << std::endl;
+    else
+    {
+        out << "Composed " << report.file << " in " << report.openMs << " ms (" << report.reason << ")";
+        if (report.written)
+            out << ", flattened " << report.layers << " layers into the stage cache in " << report.writeMs << " ms";
+        out << std::endl;
+    }
+}
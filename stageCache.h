@@ -0,0 +1,86 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/usd/sdf/types.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usd/stageCache.h>
+
+#include <iostream>
+#include <map>
+#include <string>
+
+// what a stage is opened with besides its layers, each key is flattened into a copy of its own
+struct StageCacheKey
+{
+    StageCacheKey()
+        : load(pxr::UsdStage::LoadAll)
+    {}
+
+    bool IsDefault() const { return load == pxr::UsdStage::LoadAll && variants.empty(); }
+    // one line per setting, recorded in the manifest and hashed into the entry's name
+    std::string ToString() const;
+
+    pxr::UsdStage::InitialLoadSet load;
+    // variant selections made on the session layer before composing, by prim
+    std::map<pxr::SdfPath, pxr::SdfVariantSelectionMap> variants;
+};
+
+struct StageCacheReport
+{
+    StageCacheReport()
+        : hit(false), shared(false), written(false), layers(0), openMs(0.0), writeMs(0.0)
+    {}
+
+    // opened from the flattened file, or handed the stage another open already made
+    bool hit, shared;
+    // flattened and written after composing
+    bool written;
+    // layers the flattened file depends on
+    size_t layers;
+    double openMs, writeMs;
+    // why the flattened file couldn't be used
+    std::string reason;
+    std::string file;
+};
+
+// opens composed stages from a flattened usdc written the first time they were opened
+//
+// each stage gets a flattened copy and a manifest in the cache directory, named after the hash of its absolute path
+// and its key. the manifest records the key, the load set and the variant selections made on the session layer, and
+// lists every layer the composed stage used (sublayers, references and payloads) with its size and modification time.
+// the copy is only used while all of them still match. asset paths that would now resolve to a different file without
+// any of those layers changing aren't noticed, the cache is only used when --stage-cache asks for it
+//
+// flattening bakes in the variant selections and loads the payloads, so the copy has nothing left to switch or load.
+// opening with other selections or another load set flattens another copy, selections authored in the layers
+// themselves change a layer's stamp
+//
+// every open goes through one process wide UsdStageCache, so opening the same file twice shares the stage
+class StageCache
+{
+public:
+    // an empty directory uses $USDSIMPLECPP_STAGE_CACHE or the user's cache directory
+    StageCache(const std::string &cacheDirectory = "");
+
+    // only stages opened with the default key are shared, the others have a session layer of their own
+    pxr::UsdStageRefPtr Open(const std::string &stageFile, StageCacheReport *report = nullptr, const StageCacheKey &key = StageCacheKey());
+    // populate only the mask, from the flattened copy when it's valid. masked stages aren't shared through the
+    // UsdStageCache and never write the flattened copy, it has to hold the whole stage
+    pxr::UsdStageRefPtr OpenMasked(const std::string &stageFile, const pxr::UsdStagePopulationMask &mask, StageCacheReport *report = nullptr,
+                                   const StageCacheKey &key = StageCacheKey());
+    // remove the flattened copies of every key so the next open composes the stage again
+    bool Invalidate(const std::string &stageFile);
+
+    const std::string &GetDirectory() { return directory; }
+
+    static pxr::UsdStageCache &GetStages();
+
+protected:
+    std::string EntryPath(const std::string &rootFile, const StageCacheKey &key, const std::string &extension);
+    bool IsValid(const std::string &rootFile, const StageCacheKey &key, std::string &reason);
+    bool Write(const pxr::UsdStageRefPtr &stage, const std::string &rootFile, const StageCacheKey &key, StageCacheReport &report);
+
+    std::string directory;
+};
+
+void PrintStageCacheReport(const StageCacheReport &report, std::ostream &out);
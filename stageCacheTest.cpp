@@ -0,0 +1,259 @@
+#include "stageCache.h"
+#include "testing.h"
+
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // a root layer with a sublayer and a reference, each one a file the cache has to keep an eye on
+    struct TestFiles
+    {
+        TestFiles(const char *test)
+        {
+            directory = (std::filesystem::temp_directory_path() / ("usdSimpleCppTest." + std::string(test) + "." + std::to_string((long)getpid()))).string();
+            std::filesystem::remove_all(directory);
+            std::filesystem::create_directories(directory);
+            root = pxr::TfStringCatPaths(directory, "root.usda");
+            sub = pxr::TfStringCatPaths(directory, "sub.usda");
+            reference = pxr::TfStringCatPaths(directory, "ref.usda");
+            cache = pxr::TfStringCatPaths(directory, "cache");
+
+            Write(root, "#usda 1.0\n(\n    subLayers = [@./sub.usda@]\n)\n\ndef Xform \"root\" (\n    references = @./ref.usda@</model>\n)\n{\n}\n");
+            WriteSize(1);
+            Write(reference, "#usda 1.0\n\ndef Xform \"model\"\n{\n    def Cube \"cube\"\n    {\n    }\n}\n");
+        }
+
+        ~TestFiles()
+        {
+            // nothing may hold on to the layers once the files are gone
+            StageCache::GetStages().Clear();
+            std::error_code error;
+            std::filesystem::remove_all(directory, error);
+        }
+
+        void Write(const std::string &path, const std::string &text)
+        {
+            std::ofstream file(path, std::ios::trunc);
+            file << text;
+        }
+
+        // the digits change the size of the file as well, so the edit is seen even inside one timestamp tick
+        void WriteSize(int size)
+        {
+            Write(sub, "#usda 1.0\n\nover \"root\"\n{\n    double size = " + std::to_string(size) + "\n}\n");
+        }
+
+        std::string directory, root, sub, reference, cache;
+    };
+
+    double Size(const pxr::UsdStageRefPtr &stage)
+    {
+        double size = 0.0;
+        if (stage)
+            stage->GetPrimAtPath(pxr::SdfPath("/root")).GetAttribute(pxr::TfToken("size")).Get(&size);
+        return size;
+    }
+
+    // opens through the cache with nothing shared from an earlier open
+    pxr::UsdStageRefPtr OpenFresh(StageCache &cache, const std::string &file, StageCacheReport &report)
+    {
+        StageCache::GetStages().Clear();
+        return cache.Open(file, &report);
+    }
+
+    void TestWritesThenHits()
+    {
+        TestFiles files("hits");
+        StageCache cache(files.cache);
+        CHECK(cache.GetDirectory() == files.cache);
+
+        StageCacheReport report;
+        auto stage = OpenFresh(cache, files.root, report);
+        CHECK(stage);
+        CHECK(!report.hit && !report.shared);
+        CHECK(report.written);
+        // the root, its sublayer and the reference
+        CHECK(report.layers == 3);
+        CHECK(Size(stage) == 1.0);
+        CHECK(stage->GetPrimAtPath(pxr::SdfPath("/root/cube")));
+
+        // a second open in the same process shares the stage
+        auto shared = cache.Open(files.root, &report);
+        CHECK(report.shared);
+        CHECK(shared == stage);
+
+        stage = nullptr;
+        shared = nullptr;
+        stage = OpenFresh(cache, files.root, report);
+        CHECK(report.hit && !report.written);
+        CHECK(Size(stage) == 1.0);
+        CHECK(stage->GetPrimAtPath(pxr::SdfPath("/root/cube")));
+    }
+
+    void TestEditedLayerInvalidates()
+    {
+        TestFiles files("edited");
+        StageCache cache(files.cache);
+        StageCacheReport report;
+        CHECK(OpenFresh(cache, files.root, report) && report.written);
+
+        files.WriteSize(22);
+        auto stage = OpenFresh(cache, files.root, report);
+        CHECK(!report.hit);
+        CHECK(pxr::TfStringContains(report.reason, "sub.usda has changed"));
+        CHECK(report.written);
+        CHECK(Size(stage) == 22.0);
+
+        // the new copy has the edit in it
+        stage = nullptr;
+        stage = OpenFresh(cache, files.root, report);
+        CHECK(report.hit);
+        CHECK(Size(stage) == 22.0);
+    }
+
+    void TestMissingLayerInvalidates()
+    {
+        TestFiles files("missing");
+        StageCache cache(files.cache);
+        StageCacheReport report;
+        CHECK(OpenFresh(cache, files.root, report) && report.written);
+
+        std::filesystem::remove(files.reference);
+        auto stage = OpenFresh(cache, files.root, report);
+        CHECK(!report.hit);
+        CHECK(pxr::TfStringContains(report.reason, "ref.usda is missing"));
+        // composed from the files as they are now, without the referenced cube
+        CHECK(stage && !stage->GetPrimAtPath(pxr::SdfPath("/root/cube")));
+    }
+
+    void TestInvalidateRemovesTheEntry()
+    {
+        TestFiles files("invalidate");
+        StageCache cache(files.cache);
+        StageCacheReport report;
+        CHECK(OpenFresh(cache, files.root, report) && report.written);
+
+        CHECK(cache.Invalidate(files.root));
+        CHECK(!cache.Invalidate(files.root));
+        auto stage = OpenFresh(cache, files.root, report);
+        CHECK(!report.hit);
+        CHECK(report.reason == "not cached yet");
+        CHECK(report.written);
+    }
+
+    void TestVariantsAreCachedPerSelection()
+    {
+        TestFiles files("variants");
+        files.Write(files.root, "#usda 1.0\n\ndef Xform \"root\" (\n    variants = { string look = \"red\" }\n    prepend variantSets = \"look\"\n)\n{\n"
+                                "    variantSet \"look\" = {\n        \"red\" { double size = 1 }\n        \"blue\" { double size = 2 }\n    }\n}\n");
+        StageCache cache(files.cache);
+        StageCacheReport report;
+        auto stage = OpenFresh(cache, files.root, report);
+        CHECK(stage && report.written);
+        CHECK(Size(stage) == 1.0);
+
+        // another selection is flattened into a copy of its own
+        StageCacheKey blue;
+        blue.variants[pxr::SdfPath("/root")]["look"] = "blue";
+        StageCache::GetStages().Clear();
+        stage = cache.Open(files.root, &report, blue);
+        CHECK(!report.hit && !report.shared && report.written);
+        CHECK(report.reason == "not cached yet with these selections");
+        CHECK(Size(stage) == 2.0);
+
+        // and both are read back with their own selection baked in
+        stage = nullptr;
+        StageCache::GetStages().Clear();
+        stage = cache.Open(files.root, &report, blue);
+        CHECK(report.hit);
+        CHECK(Size(stage) == 2.0);
+        stage = OpenFresh(cache, files.root, report);
+        CHECK(report.hit);
+        CHECK(Size(stage) == 1.0);
+
+        // both go when the file is invalidated
+        stage = nullptr;
+        StageCache::GetStages().Clear();
+        CHECK(cache.Invalidate(files.root));
+        CHECK(!cache.Invalidate(files.root));
+        cache.Open(files.root, &report, blue);
+        CHECK(!report.hit);
+    }
+
+    void TestPayloadsAreCachedPerLoadSet()
+    {
+        TestFiles files("payloads");
+        files.Write(files.root, "#usda 1.0\n\ndef Xform \"root\" (\n    payload = @./ref.usda@</model>\n)\n{\n}\n");
+        StageCache cache(files.cache);
+        StageCacheReport report;
+        auto stage = OpenFresh(cache, files.root, report);
+        CHECK(stage && report.written);
+        // the root and the payload
+        CHECK(report.layers == 2);
+        CHECK(stage->GetPrimAtPath(pxr::SdfPath("/root/cube")));
+
+        StageCacheKey unloaded;
+        unloaded.load = pxr::UsdStage::LoadNone;
+        StageCache::GetStages().Clear();
+        stage = cache.Open(files.root, &report, unloaded);
+        CHECK(!report.hit && report.written);
+        CHECK(stage && !stage->GetPrimAtPath(pxr::SdfPath("/root/cube")));
+
+        stage = nullptr;
+        StageCache::GetStages().Clear();
+        stage = cache.Open(files.root, &report, unloaded);
+        CHECK(report.hit);
+        CHECK(stage && stage->GetPrimAtPath(pxr::SdfPath("/root")) && !stage->GetPrimAtPath(pxr::SdfPath("/root/cube")));
+        stage = OpenFresh(cache, files.root, report);
+        CHECK(report.hit);
+        CHECK(stage->GetPrimAtPath(pxr::SdfPath("/root/cube")));
+
+        // an edit to the payload invalidates the copy that loaded it
+        stage = nullptr;
+        files.Write(files.reference, "#usda 1.0\n\ndef Xform \"model\"\n{\n    def Sphere \"sphere\"\n    {\n    }\n}\n");
+        stage = OpenFresh(cache, files.root, report);
+        CHECK(!report.hit && pxr::TfStringContains(report.reason, "ref.usda has changed"));
+        CHECK(stage->GetPrimAtPath(pxr::SdfPath("/root/sphere")));
+    }
+
+    void TestMaskedOpensDontWrite()
+    {
+        TestFiles files("masked");
+        StageCache cache(files.cache);
+        StageCacheReport report;
+        auto stage = cache.OpenMasked(files.root, pxr::UsdStagePopulationMask({ pxr::SdfPath("/root") }), &report);
+        CHECK(stage);
+        CHECK(!report.hit && !report.written);
+        CHECK(!std::filesystem::exists(files.cache) || std::filesystem::is_empty(files.cache));
+
+        // once the whole stage has been written, masked opens read from the copy too
+        CHECK(OpenFresh(cache, files.root, report) && report.written);
+        stage = cache.OpenMasked(files.root, pxr::UsdStagePopulationMask({ pxr::SdfPath("/root") }), &report);
+        CHECK(report.hit);
+        CHECK(Size(stage) == 1.0);
+    }
+}
+
+int main()
+{
+    TestWritesThenHits();
+    TestEditedLayerInvalidates();
+    TestMissingLayerInvalidates();
+    TestInvalidateRemovesTheEntry();
+    TestVariantsAreCachedPerSelection();
+    TestPayloadsAreCachedPerLoadSet();
+    TestMaskedOpensDontWrite();
+    return Testing::Result("stageCacheTest");
+}
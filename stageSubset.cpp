@@ -0,0 +1,306 @@
+#include "stageSubset.h"
+
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/usd/sdf/changeBlock.h>
+#include <pxr/usd/sdf/primSpec.h>
+#include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usd/relationship.h>
+#include <pxr/usd/usd/schemaRegistry.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace
+{
+    // a path split into names, with the part before the first wildcard as a path of its own
+    struct PathPattern
+    {
+        std::vector<std::string> names;
+        pxr::SdfPath prefix;
+        size_t prefixLength;
+    };
+
+    bool HasWildcards(const std::string &name)
+    {
+        return name.find_first_of("*?") != std::string::npos;
+    }
+
+    // * and ? within one name
+    bool MatchName(const char *pattern, const char *name)
+    {
+        const char *star = nullptr, *resume = nullptr;
+        while (*name)
+        {
+            if (*pattern == '?' || *pattern == *name)
+            {
+                ++pattern;
+                ++name;
+            }
+            else if (*pattern == '*')
+            {
+                star = pattern++;
+                resume = name;
+            }
+            else if (star)
+            {
+                pattern = star + 1;
+                name = ++resume;
+            }
+            else
+                return false;
+        }
+        while (*pattern == '*')
+            ++pattern;
+        return !*pattern;
+    }
+
+    bool ParsePattern(const std::string &path, PathPattern &pattern)
+    {
+        if (path.empty() || path[0] != '/')
+            return false;
+        pattern.names = pxr::TfStringTokenize(path, "/");
+        pattern.prefix = pxr::SdfPath::AbsoluteRootPath();
+        pattern.prefixLength = 0;
+        for (const auto &name : pattern.names)
+        {
+            if (HasWildcards(name))
+                break;
+            if (!pxr::SdfPath::IsValidIdentifier(name))
+                return false;
+            pattern.prefix = pattern.prefix.AppendChild(pxr::TfToken(name));
+            pattern.prefixLength++;
+        }
+        return true;
+    }
+
+    // payload prims aren't loaded on the stage we match against, and still count
+    const pxr::Usd_PrimFlagsConjunction matchPredicate = pxr::UsdPrimIsActive && pxr::UsdPrimIsDefined && !pxr::UsdPrimIsAbstract;
+
+    void MatchChildren(const pxr::UsdPrim &prim, const PathPattern &pattern, size_t depth, pxr::UsdStagePopulationMask &mask, size_t &matched)
+    {
+        for (const auto &child : prim.GetFilteredChildren(matchPredicate))
+        {
+            if (!MatchName(pattern.names[depth].c_str(), child.GetName().GetText()))
+                continue;
+            if (depth + 1 == pattern.names.size())
+            {
+                mask.Add(child.GetPath());
+                matched++;
+            }
+            else
+                MatchChildren(child, pattern, depth + 1, mask, matched);
+        }
+    }
+
+    bool IsKept(const pxr::SdfPathSet &kept, pxr::SdfPath path)
+    {
+        for (; !path.IsEmpty() && !path.IsAbsoluteRootPath(); path = path.GetParentPath())
+            if (kept.count(path))
+                return true;
+        return false;
+    }
+
+    // a mask can't reach into an instance and its proxies can't be deactivated on their own, a prim inside one
+    // stands for the whole instance
+    pxr::UsdPrim OutsideInstances(pxr::UsdPrim prim)
+    {
+        while (prim && prim.IsInstanceProxy())
+            prim = prim.GetParent();
+        return prim;
+    }
+
+    // keeps the prims of the types with everything under them, whatever those bind or target and the ancestors of
+    // both, and deactivates everything else on the session layer
+    bool KeepTypes(const pxr::UsdStageRefPtr &stage, const std::vector<pxr::TfType> &types, StageSubsetReport &report)
+    {
+        pxr::SdfPathSet kept;
+        auto range = pxr::UsdPrimRange::Stage(stage, pxr::UsdTraverseInstanceProxies());
+        for (auto it = range.begin(); it != range.end(); ++it)
+        {
+            const auto &prim = *it;
+            if (std::none_of(types.begin(), types.end(), [&prim](const pxr::TfType &type) { return prim.IsA(type); }))
+                continue;
+            kept.insert(OutsideInstances(prim).GetPath());
+            // everything below is kept already
+            it.PruneChildren();
+        }
+        report.typed = kept.size();
+        if (kept.empty())
+            return false;
+
+        // the materials and anything else the kept prims point at, and what those point at in turn
+        std::vector<pxr::SdfPath> pending(kept.begin(), kept.end());
+        while (!pending.empty())
+        {
+            auto root = stage->GetPrimAtPath(pending.back());
+            pending.pop_back();
+            if (!root)
+                continue;
+            for (const auto &prim : pxr::UsdPrimRange(root, pxr::UsdTraverseInstanceProxies()))
+            {
+                for (const auto &relationship : prim.GetRelationships())
+                {
+                    pxr::SdfPathVector targets;
+                    relationship.GetForwardedTargets(&targets);
+                    for (const auto &target : targets)
+                    {
+                        auto targetPrim = OutsideInstances(stage->GetPrimAtPath(target.GetPrimPath()));
+                        if (targetPrim && !IsKept(kept, targetPrim.GetPath()) && kept.insert(targetPrim.GetPath()).second)
+                            pending.push_back(targetPrim.GetPath());
+                    }
+                }
+            }
+        }
+
+        pxr::SdfPathSet ancestors;
+        for (const auto &path : kept)
+        {
+            for (auto parent = path.GetParentPath(); !parent.IsEmpty(); parent = parent.GetParentPath())
+                if (!ancestors.insert(parent).second)
+                    break;
+        }
+
+        // walking down through the ancestors, every other child is deactivated with everything under it
+        std::vector<pxr::SdfPath> inactive;
+        std::vector<pxr::UsdPrim> walk(1, stage->GetPseudoRoot());
+        while (!walk.empty())
+        {
+            auto prim = walk.back();
+            walk.pop_back();
+            for (const auto &child : prim.GetChildren())
+            {
+                if (kept.count(child.GetPath()))
+                    continue;
+                if (ancestors.count(child.GetPath()))
+                    walk.push_back(child);
+                else
+                    inactive.push_back(child.GetPath());
+            }
+        }
+
+        {
+            auto sessionLayer = stage->GetSessionLayer();
+            pxr::SdfChangeBlock changes;
+            for (const auto &path : inactive)
+                pxr::SdfCreatePrimInLayer(sessionLayer, path)->SetActive(false);
+        }
+        report.deactivated = inactive.size();
+        return true;
+    }
+
+    double MsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+}
+
+pxr::UsdStageRefPtr OpenStageSubset(const std::string &stageFile, const StageSubset &subset, StageCache *stageCache, StageSubsetReport &report)
+{
+    report = StageSubsetReport();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<pxr::TfType> types;
+    for (const auto &typeName : subset.primTypes)
+    {
+        auto type = pxr::UsdSchemaRegistry::GetTypeFromName(pxr::TfToken(typeName));
+        if (type.IsUnknown())
+        {
+            std::cerr << "Unknown prim type " << typeName << std::endl;
+            return nullptr;
+        }
+        types.push_back(type);
+    }
+
+    // plain paths go into the mask as they are, the rest are matched under their prefix
+    pxr::UsdStagePopulationMask mask, prefixMask;
+    std::vector<PathPattern> patterns;
+    for (const auto &path : subset.paths)
+    {
+        PathPattern pattern;
+        if (!ParsePattern(path, pattern))
+        {
+            std::cerr << "Invalid prim path pattern " << path << std::endl;
+            return nullptr;
+        }
+        if (pattern.prefixLength == pattern.names.size())
+        {
+            mask.Add(pattern.prefix);
+            report.matched++;
+        }
+        else
+        {
+            prefixMask.Add(pattern.prefix);
+            patterns.push_back(pattern);
+        }
+    }
+
+    if (!patterns.empty())
+    {
+        // only the prefixes are composed and nothing is loaded, which is cheap next to opening the subset itself
+        StageCacheKey unloaded;
+        unloaded.load = pxr::UsdStage::LoadNone;
+        auto probe = stageCache ? stageCache->OpenMasked(stageFile, prefixMask, nullptr, unloaded)
+                                : pxr::UsdStage::OpenMasked(stageFile, prefixMask, pxr::UsdStage::LoadNone);
+        if (!probe)
+            return nullptr;
+        for (const auto &pattern : patterns)
+            if (auto prim = probe->GetPrimAtPath(pattern.prefix))
+                MatchChildren(prim, pattern, pattern.prefixLength, mask, report.matched);
+        report.matchMs = MsSince(start);
+    }
+    if (!subset.paths.empty() && mask.IsEmpty())
+    {
+        std::cerr << "No prims of " << stageFile << " match " << pxr::TfStringJoin(subset.paths, ", ") << std::endl;
+        return nullptr;
+    }
+
+    pxr::UsdStageRefPtr stage;
+    if (mask.IsEmpty())
+        stage = stageCache ? stageCache->Open(stageFile, &report.cache) : pxr::UsdStage::Open(stageFile);
+    else
+        stage = stageCache ? stageCache->OpenMasked(stageFile, mask, &report.cache) : pxr::UsdStage::OpenMasked(stageFile, mask);
+    if (!stage)
+        return nullptr;
+
+    if (!mask.IsEmpty())
+    {
+        // bring in the materials and anything else the subset points at outside of itself
+        stage->ExpandPopulationMask();
+        std::vector<std::string> paths;
+        for (const auto &path : stage->GetPopulationMask().GetPaths())
+            paths.push_back(path.GetString());
+        report.mask = pxr::TfStringJoin(paths, ", ");
+    }
+
+    if (!types.empty())
+    {
+        auto typeStart = std::chrono::high_resolution_clock::now();
+        bool kept = KeepTypes(stage, types, report);
+        report.matchMs += MsSince(typeStart);
+        if (!kept)
+        {
+            std::cerr << "No prims of " << stageFile << " are of type " << pxr::TfStringJoin(subset.primTypes, ", ") << std::endl;
+            return nullptr;
+        }
+    }
+
+    auto range = stage->Traverse();
+    report.prims = (size_t)std::distance(range.begin(), range.end());
+    report.openMs = MsSince(start);
+    return stage;
+}
+
+void PrintStageSubsetReport(const StageSubsetReport &report, std::ostream &out)
+{
+    if (!report.cache.file.empty())
+        PrintStageCacheReport(report.cache, out);
+    out << "Opened a subset of " << report.prims << " prims in " << report.openMs << " ms";
+    if (!report.mask.empty())
+        out << ", masked to " << report.mask << " from " << report.matched << " matched paths";
+    if (report.typed)
+        out << ", kept " << report.typed << " prims of the listed types and deactivated " << report.deactivated << " others";
+    if (!report.mask.empty() || report.typed)
+        out << " (matching took " << report.matchMs << " ms)";
+    out << std::endl;
+}
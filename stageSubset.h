@@ -0,0 +1,53 @@
+#pragma once
+
+#include "stageCache.h"
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/stage.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// the part of a stage a session works on, everything outside it is never composed
+//
+// paths are absolute prim paths whose names may use * and ?, e.g. /Kitchen_set/Props_grp/*Chair*. the wildcards
+// are matched on a stage opened without payloads, so they can only match names down to the payload prims. whatever
+// the matched prims bind or target (materials, skeletons) is populated too
+//
+// prim types are only known once the prims are composed and loaded, so they're matched on the stage that's opened
+// (masked to the paths when there are any). each match keeps everything under it, whatever it targets and its
+// ancestors, and the rest is deactivated on the session layer. finding them costs a traversal of that stage, with
+// instances expanded
+struct StageSubset
+{
+    bool IsEmpty() const { return paths.empty() && primTypes.empty(); }
+
+    std::vector<std::string> paths;
+    // schema type names such as Mesh, Points or Xform, only prims of these types are kept active (with their ancestors
+    // and descendants), within the paths when there are any
+    std::vector<std::string> primTypes;
+};
+
+struct StageSubsetReport
+{
+    StageSubsetReport()
+        : matched(0), typed(0), deactivated(0), prims(0), matchMs(0.0), openMs(0.0)
+    {}
+
+    // prim paths the mask was built from, after expanding wildcards
+    size_t matched;
+    // prims of the listed types that were kept, and the prims deactivated around them
+    size_t typed, deactivated;
+    // active prims on the opened stage
+    size_t prims;
+    double matchMs, openMs;
+    std::string mask;
+    // how the stage cache opened it, when one was used
+    StageCacheReport cache;
+};
+
+// open only the subset, through the stage cache when there is one
+pxr::UsdStageRefPtr OpenStageSubset(const std::string &stageFile, const StageSubset &subset, StageCache *stageCache, StageSubsetReport &report);
+
+void PrintStageSubsetReport(const StageSubsetReport &report, std::ostream &out);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+
+// what the tests next to the modules share, each one is an executable registered with ctest that prints the checks
+// that failed and returns non-zero if there were any
+namespace Testing
+{
+    inline int &Failures()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline void Fail(const char *file, int line, const char *expression)
+    {
+        std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+        Failures()++;
+    }
+
+    inline bool Near(double a, double b, double tolerance)
+    {
+        return std::fabs(a - b) <= tolerance;
+    }
+
+    inline int Result(const char *name)
+    {
+        if (Failures() == 0)
+            std::cout << name << ": all checks passed" << std::endl;
+        else
+            std::cerr << name << ": " << Failures() << " checks failed" << std::endl;
+        return Failures() == 0 ? 0 : 1;
+    }
+}
+
+#define CHECK(expression) \
+    do { if (!(expression)) Testing::Fail(__FILE__, __LINE__, #expression); } while (false)
+
+#define CHECK_NEAR(a, b, tolerance) \
+    do { if (!Testing::Near((a), (b), (tolerance))) Testing::Fail(__FILE__, __LINE__, #a " near " #b); } while (false)
@@ -0,0 +1,388 @@
+#include "textureCache.h"
+
+#include <pxr/base/arch/hash.h>
+#include <pxr/base/arch/fileSystem.h>
+#include <pxr/base/arch/systemInfo.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/getenv.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/imaging/hio/image.h>
+#include <pxr/imaging/hio/types.h>
+#include <pxr/usd/sdf/assetPath.h>
+#include <pxr/usd/usd/editContext.h>
+#include <pxr/usd/usdHydra/tokens.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    // an image held as floats while it's being resampled
+    struct ImageBuffer
+    {
+        ImageBuffer() : width(0), height(0), channels(0) {}
+        int width, height, channels;
+        std::vector<float> data;
+
+        float At(int x, int y, int c) const
+        {
+            x = std::min(std::max(x, 0), width - 1);
+            y = std::min(std::max(y, 0), height - 1);
+            return data[((size_t)y * width + x) * channels + c];
+        }
+    };
+
+    int NearestPowerOfTwo(int value)
+    {
+        int pot = 1;
+        while (pot * 2 <= value)
+            pot *= 2;
+        // round up when we're closer to the next power
+        return (value - pot > pot * 2 - value) ? pot * 2 : pot;
+    }
+
+    bool ReadImage(const std::string &path, ImageBuffer &image)
+    {
+        auto hioImage = pxr::HioImage::OpenForReading(path);
+        if (!hioImage)
+            return false;
+
+        auto format = hioImage->GetFormat();
+        if (pxr::HioGetHioType(format) != pxr::HioTypeUnsignedByte)
+        {
+            std::cerr << "TextureCache: only 8 bit images are cached, using " << path << " as is" << std::endl;
+            return false;
+        }
+
+        image.width = hioImage->GetWidth();
+        image.height = hioImage->GetHeight();
+        image.channels = pxr::HioGetComponentCount(format);
+
+        std::vector<unsigned char> pixels((size_t)image.width * image.height * image.channels);
+        pxr::HioImage::StorageSpec storage;
+        storage.width = image.width;
+        storage.height = image.height;
+        storage.depth = 1;
+        storage.format = format;
+        storage.flipped = false;
+        storage.data = pixels.data();
+        if (!hioImage->Read(storage))
+            return false;
+
+        image.data.resize(pixels.size());
+        for (size_t i = 0; i < pixels.size(); ++i)
+            image.data[i] = (float)pixels[i] / 255.f;
+        return true;
+    }
+
+    bool WriteImage(const std::string &path, const ImageBuffer &image)
+    {
+        static const pxr::HioFormat formats[] = { pxr::HioFormatUNorm8, pxr::HioFormatUNorm8Vec2, pxr::HioFormatUNorm8Vec3, pxr::HioFormatUNorm8Vec4 };
+
+        std::vector<unsigned char> pixels(image.data.size());
+        for (size_t i = 0; i < pixels.size(); ++i)
+            pixels[i] = (unsigned char)(std::min(std::max(image.data[i], 0.f), 1.f) * 255.f + 0.5f);
+
+        auto hioImage = pxr::HioImage::OpenForWriting(path);
+        if (!hioImage)
+            return false;
+
+        pxr::HioImage::StorageSpec storage;
+        storage.width = image.width;
+        storage.height = image.height;
+        storage.depth = 1;
+        storage.format = formats[image.channels - 1];
+        storage.flipped = false;
+        storage.data = pixels.data();
+        return hioImage->Write(storage);
+    }
+
+    void Resample(const ImageBuffer &src, int width, int height, ImageBuffer &dst)
+    {
+        dst.width = width;
+        dst.height = height;
+        dst.channels = src.channels;
+        dst.data.resize((size_t)width * height * src.channels);
+
+        float sx = (float)src.width / (float)width;
+        float sy = (float)src.height / (float)height;
+        for (int y = 0; y < height; ++y)
+        {
+            float fy = ((float)y + 0.5f) * sy - 0.5f;
+            int y0 = (int)std::floor(fy);
+            float ty = fy - (float)y0;
+            for (int x = 0; x < width; ++x)
+            {
+                float fx = ((float)x + 0.5f) * sx - 0.5f;
+                int x0 = (int)std::floor(fx);
+                float tx = fx - (float)x0;
+                for (int c = 0; c < src.channels; ++c)
+                {
+                    float top = src.At(x0, y0, c) * (1.f - tx) + src.At(x0 + 1, y0, c) * tx;
+                    float bottom = src.At(x0, y0 + 1, c) * (1.f - tx) + src.At(x0 + 1, y0 + 1, c) * tx;
+                    dst.data[((size_t)y * width + x) * dst.channels + c] = top * (1.f - ty) + bottom * ty;
+                }
+            }
+        }
+    }
+
+    // 2x2 box filter down to the next level, the source is a power of two so sizes halve exactly
+    void Downsample(const ImageBuffer &src, ImageBuffer &dst)
+    {
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.channels = src.channels;
+        dst.data.resize((size_t)dst.width * dst.height * dst.channels);
+
+        for (int y = 0; y < dst.height; ++y)
+            for (int x = 0; x < dst.width; ++x)
+                for (int c = 0; c < dst.channels; ++c)
+                {
+                    float sum = src.At(x * 2, y * 2, c) + src.At(x * 2 + 1, y * 2, c) + src.At(x * 2, y * 2 + 1, c) + src.At(x * 2 + 1, y * 2 + 1, c);
+                    dst.data[((size_t)y * dst.width + x) * dst.channels + c] = sum * 0.25f;
+                }
+    }
+}
+
+TextureCache::TextureCache(const std::string &cacheDirectory)
+    : directory(cacheDirectory)
+{
+    if (directory.empty())
+        directory = pxr::TfGetenv("USDSIMPLECPP_TEXTURE_CACHE");
+    if (directory.empty())
+    {
+        std::string home = pxr::TfGetenv("HOME");
+        if (home.empty())
+            home = pxr::TfGetenv("LOCALAPPDATA");
+        directory = home.empty() ? pxr::TfStringCatPaths(pxr::ArchGetTmpDir(), "usdSimpleCpp/textures")
+                                 : pxr::TfStringCatPaths(home, ".cache/usdSimpleCpp/textures");
+    }
+}
+
+std::string TextureCache::HashFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return std::string();
+
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)pxr::ArchHash64(contents.data(), contents.size()));
+    return hash;
+}
+
+bool TextureCache::ReadManifest(const std::string &entryDirectory, Entry &entry)
+{
+    std::ifstream manifest(pxr::TfStringCatPaths(entryDirectory, "manifest.txt"));
+    if (!manifest.is_open())
+        return false;
+
+    manifest >> entry.width >> entry.height;
+    if (!manifest || entry.width <= 0 || entry.height <= 0)
+        return false;
+
+    auto preview = pxr::TfStringCatPaths(entryDirectory, "preview.png");
+    if (!pxr::TfIsFile(preview))
+        return false;
+    entry.preview = preview;
+    return true;
+}
+
+std::string TextureCache::EntryDirectory(const Entry &entry)
+{
+    // a suffix of its own, so entries of an older layout in the same directory are never read as previews
+    return pxr::TfStringCatPaths(directory, entry.hash + ".preview");
+}
+
+bool TextureCache::Find(const std::string &sourceFile, Entry &entry)
+{
+    entry.hash = HashFile(sourceFile);
+    if (entry.hash.empty())
+        return false;
+    return ReadManifest(EntryDirectory(entry), entry);
+}
+
+bool TextureCache::Prepare(const std::string &sourceFile, Entry &entry)
+{
+    if (Find(sourceFile, entry))
+        return true;
+    if (entry.hash.empty())
+    {
+        std::cerr << "TextureCache: unable to read " << sourceFile << std::endl;
+        return false;
+    }
+
+    ImageBuffer source;
+    if (!ReadImage(sourceFile, source))
+        return false;
+
+    // write the entry somewhere private and move it into place once it's complete, so readers (including other
+    // processes) never see a half written one
+    auto entryDirectory = EntryDirectory(entry);
+    auto buildDirectory = entryDirectory + ".tmp" + std::to_string(pxr::ArchGetProcessId());
+    if (!pxr::TfMakeDirs(buildDirectory, -1, true))
+    {
+        std::cerr << "TextureCache: unable to create " << buildDirectory << std::endl;
+        return false;
+    }
+
+    // box filter down from a power of two so every source pixel counts towards the preview
+    ImageBuffer level;
+    Resample(source, NearestPowerOfTwo(source.width), NearestPowerOfTwo(source.height), level);
+    while (std::max(level.width, level.height) > PreviewSize)
+    {
+        ImageBuffer next;
+        Downsample(level, next);
+        level.data.swap(next.data);
+        level.width = next.width;
+        level.height = next.height;
+    }
+
+    auto path = pxr::TfStringCatPaths(buildDirectory, "preview.png");
+    if (!WriteImage(path, level))
+    {
+        std::cerr << "TextureCache: unable to write " << path << std::endl;
+        pxr::TfRmTree(buildDirectory);
+        return false;
+    }
+    {
+        std::ofstream manifest(pxr::TfStringCatPaths(buildDirectory, "manifest.txt"));
+        manifest << level.width << " " << level.height << std::endl;
+    }
+
+    if (std::rename(buildDirectory.c_str(), entryDirectory.c_str()) != 0)
+    {
+        // someone else finished the same entry first
+        pxr::TfRmTree(buildDirectory);
+    }
+
+    return ReadManifest(entryDirectory, entry);
+}
+
+TextureStreamer::TextureStreamer(TextureCache &textureCache)
+    : cache(textureCache), stopping(false)
+{
+    worker = std::thread(&TextureStreamer::Worker, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    worker.join();
+}
+
+void TextureStreamer::Request(const pxr::UsdShadeShader &textureShader, const std::string &sourceFile)
+{
+    auto stream = std::make_shared<Stream>();
+    stream->shader = textureShader;
+    stream->sourceFile = sourceFile;
+    stream->previewFrames = -1;
+    stream->ready = false;
+
+    // a warm cache gets the preview authored immediately, a cold one waits for the worker
+    if (cache.Find(sourceFile, stream->entry))
+    {
+        stream->ready = true;
+        ShowPreview(*stream);
+    }
+    else
+    {
+        // don't let Storm decode the full source on the first frame while we convert it, show the fallback instead
+        SetInput(*stream, pxr::TfToken("file"), pxr::VtValue(pxr::SdfAssetPath()));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(stream);
+        condition.notify_one();
+    }
+    streams.push_back(stream);
+}
+
+void TextureStreamer::Update()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = streams.begin(); it != streams.end();)
+    {
+        auto &stream = **it;
+        if (!stream.ready)
+        {
+            ++it;
+            continue;
+        }
+
+        // the callbacks run before the frame renders, so the preview is drawn by the frame this makes it count. after
+        // that (or if conversion failed) the session's opinions are cleared and the shader reads the source it was
+        // authored with, which Storm loads and builds the mips of itself
+        if (stream.entry.IsValid() && stream.previewFrames < 1)
+        {
+            if (stream.previewFrames < 0)
+                ShowPreview(stream);
+            stream.previewFrames++;
+            ++it;
+            continue;
+        }
+        SetInput(stream, pxr::TfToken("file"), pxr::VtValue());
+        SetInput(stream, pxr::UsdHydraTokens->minFilter, pxr::VtValue());
+        it = streams.erase(it);
+    }
+}
+
+bool TextureStreamer::IsIdle()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return streams.empty();
+}
+
+void TextureStreamer::ShowPreview(Stream &stream)
+{
+    SetInput(stream, pxr::TfToken("file"), pxr::VtValue(pxr::SdfAssetPath(stream.entry.preview)));
+    // the preview is only up for a frame, don't have Storm build mips for it
+    if (stream.shader.GetInput(pxr::UsdHydraTokens->minFilter))
+        SetInput(stream, pxr::UsdHydraTokens->minFilter, pxr::VtValue(pxr::UsdHydraTokens->linear));
+    stream.previewFrames = 0;
+}
+
+void TextureStreamer::SetInput(Stream &stream, const pxr::TfToken &name, const pxr::VtValue &value)
+{
+    auto input = stream.shader.GetInput(name);
+    auto stage = stream.shader.GetPrim().GetStage();
+    if (!input || !stage)
+        return;
+    // cache paths are per user and the level shown depends on timing, none of it belongs in the saved file
+    pxr::UsdEditContext context(stage, stage->GetSessionLayer());
+    if (value.IsEmpty())
+        input.GetAttr().Clear();
+    else
+        input.Set(value);
+}
+
+void TextureStreamer::Worker()
+{
+    while (true)
+    {
+        std::shared_ptr<Stream> stream;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !pending.empty(); });
+            if (stopping)
+                return;
+            stream = pending.front();
+            pending.pop_front();
+        }
+
+        TextureCache::Entry entry;
+        cache.Prepare(stream->sourceFile, entry);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stream->entry = entry;
+        stream->ready = true;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usdShade/shader.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// converts source images once into low resolution previews in an on-disk cache keyed by the hash of their contents
+//
+// each entry is the image box filtered down to at most PreviewSize pixels on a side, small enough to decode on the
+// first frame. it's only a stand-in: the source is still what's drawn once it has loaded, Storm builds its mips
+class TextureCache
+{
+public:
+    static const int PreviewSize = 128;
+
+    struct Entry
+    {
+        Entry() : width(0), height(0) {}
+        bool IsValid() const { return !preview.empty(); }
+
+        std::string hash;
+        std::string preview;
+        int width, height;                  // of the preview
+    };
+
+    // an empty directory uses $USDSIMPLECPP_TEXTURE_CACHE or the user's cache directory
+    TextureCache(const std::string &cacheDirectory = "");
+
+    // look the source up in the cache without building anything
+    bool Find(const std::string &sourceFile, Entry &entry);
+    // decode the source and write out its preview if it isn't cached yet
+    bool Prepare(const std::string &sourceFile, Entry &entry);
+
+    const std::string &GetDirectory() { return directory; }
+
+    static std::string HashFile(const std::string &path);
+
+protected:
+    std::string EntryDirectory(const Entry &entry);
+    bool ReadManifest(const std::string &entryDirectory, Entry &entry);
+
+    std::string directory;
+};
+
+// points UsdUVTexture file inputs at the cached preview for a frame, then back at their source
+//
+// the preview is authored on the stage's session layer, the saved layers keep the source image whatever the timing.
+// cache misses are converted on a background thread and show the fallback until then. everything touching the stage
+// happens in Update() which has to be called from the thread that owns the stage (the render loop)
+class TextureStreamer
+{
+public:
+    TextureStreamer(TextureCache &textureCache);
+    virtual ~TextureStreamer();
+
+    void Request(const pxr::UsdShadeShader &textureShader, const std::string &sourceFile);
+    void Update();
+    bool IsIdle();
+
+protected:
+    struct Stream
+    {
+        pxr::UsdShadeShader shader;
+        std::string sourceFile;
+        TextureCache::Entry entry;
+        int previewFrames;              // frames the preview has been drawn for, -1 until it's authored
+        bool ready;
+    };
+
+    void Worker();
+    void ShowPreview(Stream &stream);
+    // set an input of the stream's shader on the session layer, an empty value clears the session's opinion
+    void SetInput(Stream &stream, const pxr::TfToken &name, const pxr::VtValue &value);
+
+    TextureCache &cache;
+    std::vector<std::shared_ptr<Stream>> streams;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::shared_ptr<Stream>> pending;
+    std::thread worker;
+    bool stopping;
+};
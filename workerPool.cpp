@@ -0,0 +1,116 @@
+#include "workerPool.h"
+#include "concurrency.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(size_t threadCount, size_t queueLimit)
+    : maxQueued(queueLimit), running(0), blocked(0), stopping(false)
+{
+    if (threadCount == 0)
+        dispatcher.reset(new pxr::WorkDispatcher());
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.emplace_back(&WorkerPool::Run, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    jobTaken.notify_all();
+    for (auto &thread : threads)
+        thread.join();
+    // waits for the tasks still queued
+    dispatcher.reset();
+}
+
+size_t WorkerPool::GetThreadCount()
+{
+    return dispatcher ? GetConcurrency() : threads.size();
+}
+
+void WorkerPool::Submit(std::function<void()> job)
+{
+    // with a single thread nothing would pick the task up while we wait on it, so just do the job
+    if (dispatcher && GetConcurrency() <= 1)
+    {
+        job();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (maxQueued > 0 && jobs.size() >= maxQueued)
+    {
+        blocked++;
+        jobTaken.wait(lock, [this]() { return jobs.size() < maxQueued || stopping; });
+    }
+    jobs.push_back(std::move(job));
+    lock.unlock();
+    if (dispatcher)
+        dispatcher->Run([this]() { RunOne(); });
+    else
+        jobReady.notify_one();
+}
+
+void WorkerPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return jobs.empty() && running == 0; });
+}
+
+size_t WorkerPool::GetPendingCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size() + running;
+}
+
+void WorkerPool::RunOne()
+{
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (jobs.empty())
+            return;
+        job = std::move(jobs.front());
+        jobs.pop_front();
+        running++;
+    }
+    jobTaken.notify_one();
+
+    job();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running--;
+    }
+    idle.notify_all();
+}
+
+void WorkerPool::Run()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [this]() { return !jobs.empty() || stopping; });
+            if (jobs.empty())
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            running++;
+        }
+        jobTaken.notify_one();
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+        }
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/base/work/dispatcher.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a queue of jobs worked through by the work library's threads, or by a fixed set of threads of its own
+//
+// Submit blocks once maxQueued jobs are waiting so a producer that outruns the workers (a render loop handing out
+// frames to encode) can't queue up unbounded memory. without threads of its own each job is a task in the same arena
+// as USD's, so our jobs and Hydra's sync share the one thread budget instead of oversubscribing the cores
+class WorkerPool
+{
+public:
+    // 0 threads runs the jobs on the work library, 0 maxQueued doesn't limit the queue. Submit and Wait should be called
+    // from one thread
+    WorkerPool(size_t threadCount = 0, size_t maxQueued = 0);
+    virtual ~WorkerPool();
+
+    void Submit(std::function<void()> job);
+    // block until every submitted job has finished
+    void Wait();
+
+    void SetMaxQueued(size_t limit)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        maxQueued = limit;
+    }
+
+    size_t GetThreadCount();
+    size_t GetPendingCount();
+    // times Submit had to wait for room in the queue
+    size_t GetBlockedCount() { return blocked; }
+
+protected:
+    void Run();
+    // take the next job off the queue and run it, each task handed to the work library does one
+    void RunOne();
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<pxr::WorkDispatcher> dispatcher;
+    std::mutex mutex;
+    std::condition_variable jobReady, jobTaken, idle;
+    std::deque<std::function<void()>> jobs;
+    size_t maxQueued;
+    size_t running;
+    size_t blocked;
+    bool stopping;
+};